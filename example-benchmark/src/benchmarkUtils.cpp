@@ -0,0 +1,164 @@
+#include "benchmarkUtils.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <fstream>
+#include <thread>
+
+#ifdef TARGET_WIN32
+#include <psapi.h>
+#pragma comment(lib,"psapi.lib")
+#endif
+#ifdef TARGET_LINUX
+#include <sys/resource.h>
+#endif
+
+//--------------------------------------------------------------
+UINT64 getResidentBytes(){
+#if defined(TARGET_LINUX)
+	std::ifstream statm("/proc/self/statm");
+	UINT64 pages = 0, resident = 0;
+	if (statm >> pages >> resident){
+		return resident * sysconf(_SC_PAGESIZE);
+	}
+	return 0;
+#elif defined(TARGET_WIN32)
+	PROCESS_MEMORY_COUNTERS counters;
+	if (GetProcessMemoryInfo(GetCurrentProcess(), &counters, sizeof(counters))){
+		return counters.WorkingSetSize;
+	}
+	return 0;
+#else
+	return 0;
+#endif
+}
+
+//--------------------------------------------------------------
+double getProcessCPUSeconds(){
+#if defined(TARGET_LINUX)
+	rusage usage;
+	if (getrusage(RUSAGE_SELF, &usage) == 0){
+		return usage.ru_utime.tv_sec + usage.ru_stime.tv_sec + (usage.ru_utime.tv_usec + usage.ru_stime.tv_usec) / 1e6;
+	}
+	return 0;
+#elif defined(TARGET_WIN32)
+	FILETIME created, exited, kernel, user;
+	if (GetProcessTimes(GetCurrentProcess(), &created, &exited, &kernel, &user)){
+		//in 100ns units
+		return ((((UINT64)kernel.dwHighDateTime << 32) | kernel.dwLowDateTime) + (((UINT64)user.dwHighDateTime << 32) | user.dwLowDateTime)) / 1e7;
+	}
+	return 0;
+#else
+	return 0;
+#endif
+}
+
+//--------------------------------------------------------------
+bool runForAudioSeconds(ofXAudioEngine* engine, double seconds){
+	NullWaveDevice* device = engine->getNullDevice();
+	UINT64 lastTicks = device->getTickCount();
+	UINT64 endTicks = lastTicks + (UINT64)(seconds / device->getTickSeconds() + 0.5);
+	INT64 lastProgress = ofXAudioNowNanos();
+	while (lastTicks < endTicks){
+		std::this_thread::sleep_for(std::chrono::microseconds(100));
+		UINT64 ticks = device->getTickCount();
+		if (ticks != lastTicks){
+			lastTicks = ticks;
+			lastProgress = ofXAudioNowNanos();
+		} else if (ofXAudioNowNanos() - lastProgress > (INT64)10000000000LL){
+			return false;
+		}
+	}
+	return true;
+}
+
+//--------------------------------------------------------------
+int playToEnd(ofXAudioEngine* engine, const vector<ofXAudioSoundPlayer*>& players){
+	//a free-running device waits on every voice still running, so each is stopped as soon as it's done. a voice waiting
+	//on its refill looks stopped too, so only one whose playhead reached the end counts.
+	//a stream that stops getting anywhere has failed
+	int numPlayers = (int)players.size();
+	vector<bool> done(numPlayers, false);
+	int numDone = 0;
+	for (int i = 0; i < numPlayers; i++){
+		if (players[i]->isLoaded()){
+			players[i]->play();
+		} else {
+			done[i] = true;
+			numDone++;
+		}
+	}
+	UINT64 lastTicks = engine->getNullDevice()->getTickCount();
+	INT64 lastProgress = ofXAudioNowNanos();
+	while (numDone < numPlayers){
+		std::this_thread::sleep_for(std::chrono::microseconds(100));
+		for (int i = 0; i < numPlayers; i++){
+			const ofXAudioPlayhead& playhead = players[i]->getPlayhead();
+			if (!done[i] && !players[i]->getIsPlaying() && playhead.getFrame() >= playhead.getLength()){
+				players[i]->stop();
+				done[i] = true;
+				numDone++;
+			}
+		}
+
+		UINT64 ticks = engine->getNullDevice()->getTickCount();
+		if (ticks != lastTicks){
+			lastTicks = ticks;
+			lastProgress = ofXAudioNowNanos();
+		} else if (ofXAudioNowNanos() - lastProgress > (INT64)10000000000LL){
+			return numPlayers - numDone;
+		}
+	}
+	return 0;
+}
+
+//--------------------------------------------------------------
+double median(vector<double> values){
+	if (values.empty()){
+		return 0;
+	}
+	std::sort(values.begin(), values.end());
+	size_t middle = values.size() / 2;
+	return values.size() & 1 ? values[middle] : (values[middle - 1] + values[middle]) / 2;
+}
+
+//--------------------------------------------------------------
+string percentilesJson(vector<double> values){
+	std::sort(values.begin(), values.end());
+	double sum = 0;
+	for (size_t i = 0; i < values.size(); i++){
+		sum += values[i];
+	}
+	//nearest rank, as the histograms report them
+	const double percentiles[] = { 50, 90, 99, 99.9 };
+	const char* names[] = { "p50", "p90", "p99", "p99.9" };
+	std::ostringstream json;
+	json<<"{\"count\": "<<values.size()<<", \"mean\": "<<(values.empty() ? 0 : sum / values.size());
+	for (int i = 0; i < 4; i++){
+		size_t rank = (size_t)ceil(percentiles[i] / 100 * values.size());
+		json<<", \""<<names[i]<<"\": "<<(values.empty() ? 0 : values[(std::max)(rank, (size_t)1) - 1]);
+	}
+	json<<", \"max\": "<<(values.empty() ? 0 : values.back())<<"}";
+	return json.str();
+}
+
+//--------------------------------------------------------------
+string quote(const string& s){
+	string quoted = "\"";
+	for (size_t i = 0; i < s.size(); i++){
+		if (s[i] == '"' || s[i] == '\\'){
+			quoted += '\\';
+		}
+		quoted += s[i];
+	}
+	return quoted + "\"";
+}
+
+//--------------------------------------------------------------
+string histogramJson(const ofXAudioHistogram::Snapshot& h){
+	std::ostringstream json;
+	json<<"{\"count\": "<<h.count<<", \"mean\": "<<h.getMean()<<", \"p50\": "<<h.getPercentile(50)<<", \"p90\": "<<h.getPercentile(90)
+		<<", \"p99\": "<<h.getPercentile(99)<<", \"p99.9\": "<<h.getPercentile(99.9)<<", \"max\": "<<h.max<<"}";
+	return json.str();
+}
@@ -0,0 +1,26 @@
+#pragma once
+#include "ofMain.h"
+
+#include "ofXAudioSoundPlayer.h"
+
+//what the benchmark's suites share: measuring the process, summarising the runs and writing them out as json
+
+//the process's resident memory in bytes, or 0 where there's no way to tell
+UINT64 getResidentBytes();
+//the cpu time every thread of the process has used so far, user and kernel, in seconds; 0 where there's no way to tell
+double getProcessCPUSeconds();
+
+//waits while the free-running null device plays this much audio; false if it stops getting anywhere first, which
+//it does when none of its voices are running
+bool runForAudioSeconds(ofXAudioEngine* engine, double seconds);
+//plays the loaded players (stopped, as preloadSound() leaves streams) through to the end on the free-running null device,
+//stopping each once it's done; returns how many stalled on the way
+int playToEnd(ofXAudioEngine* engine, const vector<ofXAudioSoundPlayer*>& players);
+
+double median(vector<double> values);
+//the json for a set of timings, or anything else measured many times: the count, mean, percentiles and worst
+string percentilesJson(vector<double> values);
+
+//s as a json string, quotes and all
+string quote(const string& s);
+string histogramJson(const ofXAudioHistogram::Snapshot& h);
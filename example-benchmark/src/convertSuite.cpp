@@ -0,0 +1,120 @@
+#include "suites.h"
+#include "benchmarkUtils.h"
+#include "waveConvert.h"
+
+#include <random>
+
+namespace {
+
+	//a buffer's worth at a time, as a stream converts them, out of a source about the size of a few buffers, so it's
+	//the conversion that's timed rather than the memory it comes from
+	const size_t blockSamples = 4096;
+	const size_t sourceBlocks = 16;
+	const double secondsPerRun = 0.2;
+
+	typedef size_t (*Kernel)(WAVE_SAMPLE_TYPE type, const BYTE* pSrc, float* pDest, size_t count);
+
+	struct NamedKernel {
+		const char* name;
+		Kernel kernel;
+	};
+
+	size_t convertScalar(WAVE_SAMPLE_TYPE type, const BYTE* pSrc, float* pDest, size_t count){
+		return 0;
+	}
+
+	size_t convertDispatched(WAVE_SAMPLE_TYPE type, const BYTE* pSrc, float* pDest, size_t count){
+		waveConvertToFloat(type, pSrc, pDest, count);
+		return count;
+	}
+
+	//converts blocks for about secondsPerRun, returning the samples per second
+	double timeKernel(Kernel kernel, WAVE_SAMPLE_TYPE type, const vector<BYTE>& source, vector<float>& dest){
+		size_t sampleSize = waveSampleSize(type);
+		UINT64 samples = 0;
+		INT64 start = ofXAudioNowNanos();
+		INT64 elapsed = 0;
+		do {
+			for (size_t b = 0; b < sourceBlocks; b++){
+				const BYTE* pSrc = &source[b * blockSamples * sampleSize];
+				size_t done = kernel(type, pSrc, dest.data(), blockSamples);
+				waveConvertScalar(type, pSrc, dest.data(), done, blockSamples);
+			}
+			samples += blockSamples * sourceBlocks;
+			elapsed = ofXAudioNowNanos() - start;
+		} while (elapsed < secondsPerRun * 1e9);
+		return samples / (elapsed / 1e9);
+	}
+
+}
+
+//--------------------------------------------------------------
+string runConvertSuite(BenchmarkContext& context){
+	const WAVE_SAMPLE_TYPE types[] = { WST_UINT8, WST_INT16, WST_INT24, WST_INT32, WST_FLOAT32, WST_FLOAT64 };
+	const char* typeNames[] = { "unknown", "uint8", "int16", "int24", "int32", "float32", "float64" };
+
+	vector<NamedKernel> kernels;
+	NamedKernel scalar = { "scalar", convertScalar };
+	kernels.push_back(scalar);
+#ifdef WAVECONVERT_SSE2
+	NamedKernel sse2 = { "sse2", waveConvertSSE2 };
+	kernels.push_back(sse2);
+#endif
+#ifdef WAVECONVERT_AVX2
+	if (waveHasAVX2()){
+		NamedKernel avx2 = { "avx2", waveConvertAVX2 };
+		kernels.push_back(avx2);
+	}
+#endif
+#ifdef WAVECONVERT_NEON
+	NamedKernel neon = { "neon", waveConvertNEON };
+	kernels.push_back(neon);
+#endif
+	NamedKernel dispatched = { "dispatched", convertDispatched };
+	kernels.push_back(dispatched);
+
+	std::mt19937 random(0x5eed);
+	vector<float> dest(blockSamples);
+	std::ostringstream json;
+	json.precision(10);
+	json<<"[";
+	for (size_t t = 0; t < sizeof(types) / sizeof(types[0]); t++){
+		WAVE_SAMPLE_TYPE type = types[t];
+		ofLogNotice()<<"benchmark: convert "<<typeNames[type];
+
+		//random bytes, except floats, which are kept to the range samples are in
+		vector<BYTE> source(blockSamples * sourceBlocks * waveSampleSize(type));
+		for (size_t i = 0; i < source.size(); i++){
+			source[i] = (BYTE)random();
+		}
+		if (type == WST_FLOAT32 || type == WST_FLOAT64){
+			std::uniform_real_distribution<double> sample(-1, 1);
+			for (size_t i = 0; i < blockSamples * sourceBlocks; i++){
+				if (type == WST_FLOAT32){
+					float f = (float)sample(random);
+					memcpy(&source[i * 4], &f, sizeof(f));
+				} else {
+					double d = sample(random);
+					memcpy(&source[i * 8], &d, sizeof(d));
+				}
+			}
+		}
+
+		double scalarRate = 0;
+		for (size_t k = 0; k < kernels.size(); k++){
+			vector<double> rates;
+			for (int r = 0; r < context.repeats; r++){
+				rates.push_back(timeKernel(kernels[k].kernel, type, source, dest));
+			}
+			double rate = median(rates);
+			if (k == 0){
+				scalarRate = rate;
+			}
+			json<<(t == 0 && k == 0 ? "\n" : ",\n")<<"{\"type\": "<<quote(typeNames[type])<<", \"kernel\": "<<quote(kernels[k].name)
+				<<", \"blockSamples\": "<<blockSamples<<", \"samplesPerSecond\": "<<rate
+				<<", \"speedup\": "<<(scalarRate > 0 ? rate / scalarRate : 0)<<"}";
+		}
+	}
+	json<<"\n]";
+	return json.str();
+}
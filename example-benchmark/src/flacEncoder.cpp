@@ -0,0 +1,549 @@
+#include "flacEncoder.h"
+
+#include <cmath>
+#include <cstring>
+
+namespace {
+
+	const int lpcOrder = 8;
+	const int lpcPrecision = 12;
+	const double seekPointSeconds = 10;
+	const UINT64 placeholderSeekPoint = ~(UINT64)0;
+	const char* vendor = "ofxXAudioSoundPlayer benchmark";
+
+	//writes bits from the top down, as FLAC packs them
+	class BitWriter {
+	public:
+		vector<BYTE> bytes;
+
+		BitWriter() : cache(0), bits(0) {}
+
+		//the low n bits of value, n up to 32
+		void put(DWORD value, int n){
+			if (n == 0){
+				return;
+			}
+			cache = cache << n | (value & (n == 32 ? 0xffffffffu : (1u << n) - 1));
+			bits += n;
+			while (bits >= 8){
+				bits -= 8;
+				bytes.push_back((BYTE)(cache >> bits));
+			}
+		}
+
+		void putSigned(INT32 value, int n){
+			put((DWORD)value, n);
+		}
+
+		//q zeroes and a one
+		void putUnary(DWORD q){
+			for (; q >= 32; q -= 32){
+				put(0, 32);
+			}
+			put(1, q + 1);
+		}
+
+		void putRice(INT32 value, int k){
+			DWORD z = (DWORD)(value << 1) ^ (DWORD)(value >> 31);
+			putUnary(z >> k);
+			put(z, k);
+		}
+
+		void align(){
+			if (bits > 0){
+				put(0, 8 - bits);
+			}
+		}
+
+	private:
+		UINT64 cache;
+		int bits;
+	};
+
+	BYTE crc8(const BYTE* p, size_t n){
+		BYTE crc = 0;
+		for (size_t i = 0; i < n; i++){
+			crc ^= p[i];
+			for (int b = 0; b < 8; b++){
+				crc = (BYTE)(crc & 0x80 ? (crc << 1) ^ 0x07 : crc << 1);
+			}
+		}
+		return crc;
+	}
+
+	WORD crc16(const BYTE* p, size_t n){
+		WORD crc = 0;
+		for (size_t i = 0; i < n; i++){
+			crc ^= (WORD)(p[i] << 8);
+			for (int b = 0; b < 8; b++){
+				crc = (WORD)(crc & 0x8000 ? (crc << 1) ^ 0x8005 : crc << 1);
+			}
+		}
+		return crc;
+	}
+
+	//the frame number, in the extended utf-8 FLAC uses
+	void putUtf8(BitWriter& w, UINT64 v){
+		if (v < 0x80){
+			w.put((DWORD)v, 8);
+			return;
+		}
+		int n = 2;
+		while (n < 7 && v >= (UINT64)1 << (5 * n + 1)){
+			n++;
+		}
+		w.put((0xff << (8 - n) & 0xff) | (DWORD)(v >> (6 * (n - 1))), 8);
+		for (int i = n - 2; i >= 0; i--){
+			w.put(0x80 | (DWORD)(v >> (6 * i) & 0x3f), 8);
+		}
+	}
+
+	//how a channel of a block is to be coded, and what that costs in bits
+	struct SubframePlan {
+		enum { CONSTANT, VERBATIM, FIXED, LPC } type;
+		int order;
+		int shift;
+		vector<INT32> coefficients;
+		vector<INT32> residual; //from sample order on
+		int partitionOrder;
+		vector<int> parameters;
+		UINT64 bits;
+	};
+
+	//the cheapest rice partitioning of a residual: each partition's parameter from the mean of its values, which is close
+	//to the best a search would find
+	UINT64 planResidual(const vector<INT32>& residual, DWORD blockSize, int order, int* pPartitionOrder, vector<int>* pParameters){
+		vector<UINT64> sums(residual.size() + 1, 0);
+		for (size_t i = 0; i < residual.size(); i++){
+			sums[i + 1] = sums[i] + ((DWORD)(residual[i] << 1) ^ (DWORD)(residual[i] >> 31));
+		}
+
+		int maxOrder = 0;
+		while (maxOrder < 8 && blockSize % (2u << maxOrder) == 0 && (blockSize >> (maxOrder + 1)) > (DWORD)order){
+			maxOrder++;
+		}
+
+		UINT64 best = ~(UINT64)0;
+		for (int po = 0; po <= maxOrder; po++){
+			DWORD partitionSize = blockSize >> po;
+			UINT64 bits = 0;
+			vector<int> parameters;
+			for (DWORD p = 0; p < (1u << po); p++){
+				size_t begin = p == 0 ? 0 : p * partitionSize - order, end = (p + 1) * partitionSize - order;
+				UINT64 count = end - begin, sum = sums[end] - sums[begin];
+				int k = 0;
+				while (k < 30 && count << (k + 1) < sum){
+					k++;
+				}
+				parameters.push_back(k);
+				bits += 5 + count * (k + 1) + (sum >> k);
+			}
+			if (bits < best){
+				best = bits;
+				*pPartitionOrder = po;
+				*pParameters = parameters;
+			}
+		}
+		return best + 6;
+	}
+
+	//the order 8 predictor for a block, by levinson-durbin on its welch-windowed autocorrelation; false if it's silent
+	bool lpcCoefficients(const INT32* x, DWORD n, double* pCoefficients){
+		vector<double> windowed(n);
+		double half = (n - 1) / 2.0;
+		for (DWORD i = 0; i < n; i++){
+			double r = (i - half) / (half + 1);
+			windowed[i] = x[i] * (1 - r * r);
+		}
+		double ac[lpcOrder + 1];
+		for (int lag = 0; lag <= lpcOrder; lag++){
+			ac[lag] = 0;
+			for (DWORD i = lag; i < n; i++){
+				ac[lag] += windowed[i] * windowed[i - lag];
+			}
+		}
+		if (ac[0] == 0){
+			return false;
+		}
+		ac[0] *= 1 + 1e-9;
+
+		double a[lpcOrder + 1] = { 0 };
+		double error = ac[0];
+		for (int i = 1; i <= lpcOrder; i++){
+			double k = ac[i];
+			for (int j = 1; j < i; j++){
+				k -= a[j] * ac[i - j];
+			}
+			k /= error;
+			double previous[lpcOrder + 1];
+			memcpy(previous, a, sizeof(a));
+			a[i] = k;
+			for (int j = 1; j < i; j++){
+				a[j] = previous[j] - k * previous[i - j];
+			}
+			error *= 1 - k * k;
+			if (error <= 0){
+				return false;
+			}
+		}
+		memcpy(pCoefficients, a + 1, lpcOrder * sizeof(double));
+		return true;
+	}
+
+	void planFixed(const INT32* x, DWORD n, int bps, int order, SubframePlan* plan){
+		plan->type = SubframePlan::FIXED;
+		plan->order = order;
+		plan->residual.resize(n - order);
+		for (DWORD i = order; i < n; i++){
+			INT64 prediction = 0;
+			switch (order){
+			case 1: prediction = x[i - 1]; break;
+			case 2: prediction = 2 * (INT64)x[i - 1] - x[i - 2]; break;
+			case 3: prediction = 3 * (INT64)x[i - 1] - 3 * (INT64)x[i - 2] + x[i - 3]; break;
+			case 4: prediction = 4 * (INT64)x[i - 1] - 6 * (INT64)x[i - 2] + 4 * (INT64)x[i - 3] - x[i - 4]; break;
+			}
+			plan->residual[i - order] = (INT32)(x[i] - prediction);
+		}
+		plan->bits = 8 + order * bps + planResidual(plan->residual, n, order, &plan->partitionOrder, &plan->parameters);
+	}
+
+	bool planLpc(const INT32* x, DWORD n, int bps, SubframePlan* plan){
+		double a[lpcOrder];
+		if (n <= (DWORD)lpcOrder * 2 || !lpcCoefficients(x, n, a)){
+			return false;
+		}
+
+		//the largest shift the coefficients fit the precision at
+		double largest = 0;
+		for (int j = 0; j < lpcOrder; j++){
+			largest = (std::max)(largest, std::abs(a[j]));
+		}
+		const int limit = (1 << (lpcPrecision - 1)) - 1;
+		int shift = 15;
+		while (shift > 0 && largest * (1 << shift) > limit){
+			shift--;
+		}
+
+		plan->type = SubframePlan::LPC;
+		plan->order = lpcOrder;
+		plan->shift = shift;
+		plan->coefficients.resize(lpcOrder);
+		for (int j = 0; j < lpcOrder; j++){
+			double q = floor(a[j] * (1 << shift) + 0.5);
+			plan->coefficients[j] = (INT32)(std::max)(-limit - 1.0, (std::min)((double)limit, q));
+		}
+		plan->residual.resize(n - lpcOrder);
+		for (DWORD i = lpcOrder; i < n; i++){
+			INT64 sum = 0;
+			for (int j = 0; j < lpcOrder; j++){
+				sum += (INT64)plan->coefficients[j] * x[i - 1 - j];
+			}
+			plan->residual[i - lpcOrder] = (INT32)(x[i] - (sum >> shift));
+		}
+		plan->bits = 8 + lpcOrder * bps + 4 + 5 + lpcOrder * lpcPrecision
+			+ planResidual(plan->residual, n, lpcOrder, &plan->partitionOrder, &plan->parameters);
+		return true;
+	}
+
+	//the cheapest way to code the block of one channel
+	void planSubframe(const INT32* x, DWORD n, int bps, SubframePlan* plan){
+		bool constant = true;
+		for (DWORD i = 1; i < n && constant; i++){
+			constant = x[i] == x[0];
+		}
+		if (constant){
+			plan->type = SubframePlan::CONSTANT;
+			plan->bits = 8 + bps;
+			return;
+		}
+
+		plan->type = SubframePlan::VERBATIM;
+		plan->bits = 8 + (UINT64)n * bps;
+		SubframePlan candidate;
+		for (int order = 0; order <= 4 && (DWORD)order < n; order++){
+			planFixed(x, n, bps, order, &candidate);
+			if (candidate.bits < plan->bits){
+				*plan = candidate;
+			}
+		}
+		if (planLpc(x, n, bps, &candidate) && candidate.bits < plan->bits){
+			*plan = candidate;
+		}
+	}
+
+	void writeResidual(BitWriter& w, const SubframePlan& plan, DWORD blockSize){
+		//parameters past 14 need the 5 bit coding
+		int method = 0;
+		for (size_t p = 0; p < plan.parameters.size(); p++){
+			method = plan.parameters[p] > 14 ? 1 : method;
+		}
+		w.put(method, 2);
+		w.put(plan.partitionOrder, 4);
+		DWORD partitionSize = blockSize >> plan.partitionOrder;
+		for (size_t p = 0; p < plan.parameters.size(); p++){
+			size_t begin = p == 0 ? 0 : p * partitionSize - plan.order, end = (p + 1) * partitionSize - plan.order;
+			int k = plan.parameters[p];
+			w.put(k, method == 1 ? 5 : 4);
+			for (size_t i = begin; i < end; i++){
+				w.putRice(plan.residual[i], k);
+			}
+		}
+	}
+
+	void writeSubframe(BitWriter& w, const INT32* x, DWORD n, int bps, const SubframePlan& plan){
+		switch (plan.type){
+		case SubframePlan::CONSTANT:
+			w.put(0, 8);
+			w.putSigned(x[0], bps);
+			break;
+		case SubframePlan::VERBATIM:
+			w.put(1 << 1, 8);
+			for (DWORD i = 0; i < n; i++){
+				w.putSigned(x[i], bps);
+			}
+			break;
+		case SubframePlan::FIXED:
+			w.put((8 + plan.order) << 1, 8);
+			for (int i = 0; i < plan.order; i++){
+				w.putSigned(x[i], bps);
+			}
+			writeResidual(w, plan, n);
+			break;
+		case SubframePlan::LPC:
+			w.put((32 + plan.order - 1) << 1, 8);
+			for (int i = 0; i < plan.order; i++){
+				w.putSigned(x[i], bps);
+			}
+			w.put(lpcPrecision - 1, 4);
+			w.putSigned(plan.shift, 5);
+			for (int j = 0; j < plan.order; j++){
+				w.putSigned(plan.coefficients[j], lpcPrecision);
+			}
+			writeResidual(w, plan, n);
+			break;
+		}
+	}
+
+	void put24(vector<BYTE>& b, DWORD v){
+		b.push_back((BYTE)(v >> 16));
+		b.push_back((BYTE)(v >> 8));
+		b.push_back((BYTE)v);
+	}
+
+	void put64(vector<BYTE>& b, UINT64 v){
+		for (int i = 56; i >= 0; i -= 8){
+			b.push_back((BYTE)(v >> i));
+		}
+	}
+
+	void putLE32(vector<BYTE>& b, DWORD v){
+		for (int i = 0; i < 32; i += 8){
+			b.push_back((BYTE)(v >> i));
+		}
+	}
+
+}
+
+FlacEncoder::FlacEncoder()
+	: file(NULL)
+	, sampleRate(0)
+	, channels(0)
+	, bitsPerSample(0)
+	, totalFrames(0)
+	, framesDone(0)
+	, frameNumber(0)
+	, headerBytes(0)
+	, bytesWritten(0)
+	, minFrameBytes(0)
+	, maxFrameBytes(0)
+	, pendingFrames(0)
+	, ok(false)
+{
+}
+
+FlacEncoder::~FlacEncoder(){
+	if (file != NULL){
+		fclose(file);
+	}
+}
+
+bool FlacEncoder::open(const string& path, int _sampleRate, int _channels, int _bitsPerSample, UINT64 _totalFrames){
+	if (_channels < 1 || _channels > 8 || _bitsPerSample < 4 || _bitsPerSample > 24 || _sampleRate <= 0){
+		return false;
+	}
+	file = fopen(path.c_str(), "wb");
+	if (file == NULL){
+		return false;
+	}
+	sampleRate = _sampleRate;
+	channels = _channels;
+	bitsPerSample = _bitsPerSample;
+	totalFrames = _totalFrames;
+	framesDone = 0;
+	frameNumber = 0;
+	bytesWritten = 0;
+	minFrameBytes = 0xffffff;
+	maxFrameBytes = 0;
+	pending.assign(channels, vector<INT32>(blockSize));
+	pendingFrames = 0;
+
+	//a seek point at every 10 seconds, filled in as the frames they fall in are written
+	UINT64 interval = (UINT64)(seekPointSeconds * sampleRate);
+	seekSamples.assign((size_t)((totalFrames + interval - 1) / interval), placeholderSeekPoint);
+	seekOffsets.assign(seekSamples.size(), 0);
+
+	//room for the header, written properly once the frame sizes are known
+	headerBytes = 4 + 4 + 34 + 4 + 18 * (long)seekSamples.size() + 4 + 4 + (long)strlen(vendor) + 4;
+	vector<BYTE> zeroes(headerBytes, 0);
+	ok = fwrite(&zeroes[0], 1, zeroes.size(), file) == zeroes.size();
+	return ok;
+}
+
+bool FlacEncoder::write(const INT32* samples, size_t frames){
+	for (size_t i = 0; i < frames && ok; i++){
+		for (int c = 0; c < channels; c++){
+			pending[c][pendingFrames] = samples[i * channels + c];
+		}
+		if (++pendingFrames == (DWORD)blockSize){
+			ok = encodeFrame(pending, pendingFrames);
+			pendingFrames = 0;
+		}
+	}
+	return ok;
+}
+
+bool FlacEncoder::encodeFrame(const vector<vector<INT32> >& samples, DWORD frames){
+	//the seek points that fall in this frame point at it
+	UINT64 interval = (UINT64)(seekPointSeconds * sampleRate);
+	for (size_t s = 0; s < seekSamples.size(); s++){
+		UINT64 target = s * interval;
+		if (target >= framesDone && target < framesDone + frames){
+			seekSamples[s] = framesDone;
+			seekOffsets[s] = bytesWritten;
+		}
+	}
+
+	//the channels, or for stereo whichever pairing of left, right, mid and side is cheapest
+	int assignment = channels - 1;
+	vector<SubframePlan> plans(channels);
+	vector<const INT32*> data(channels);
+	vector<int> bps(channels, bitsPerSample);
+	vector<INT32> mid, side;
+	for (int c = 0; c < channels; c++){
+		data[c] = &samples[c][0];
+		planSubframe(data[c], frames, bitsPerSample, &plans[c]);
+	}
+	if (channels == 2){
+		mid.resize(frames);
+		side.resize(frames);
+		for (DWORD i = 0; i < frames; i++){
+			mid[i] = (samples[0][i] + samples[1][i]) >> 1;
+			side[i] = samples[0][i] - samples[1][i];
+		}
+		SubframePlan midPlan, sidePlan;
+		planSubframe(&mid[0], frames, bitsPerSample, &midPlan);
+		planSubframe(&side[0], frames, bitsPerSample + 1, &sidePlan);
+		UINT64 independent = plans[0].bits + plans[1].bits, leftSide = plans[0].bits + sidePlan.bits;
+		UINT64 sideRight = sidePlan.bits + plans[1].bits, midSide = midPlan.bits + sidePlan.bits;
+		UINT64 best = (std::min)((std::min)(independent, leftSide), (std::min)(sideRight, midSide));
+		//the side channel takes a bit more than the others
+		if (best == midSide){
+			assignment = 10;
+			plans[0] = midPlan;
+			data[0] = &mid[0];
+		} else if (best == leftSide){
+			assignment = 8;
+		} else if (best == sideRight){
+			assignment = 9;
+		}
+		int sideChannel = assignment == 9 ? 0 : 1;
+		if (assignment != 1){
+			plans[sideChannel] = sidePlan;
+			data[sideChannel] = &side[0];
+			bps[sideChannel]++;
+		}
+	}
+
+	//the header: fixed block size, then the codes for the block size, rate and sample size, where there are codes for them
+	BitWriter w;
+	w.put(0xfff8, 16);
+	int blockCode = frames == (DWORD)blockSize ? 12 : (frames <= 256 ? 6 : 7);
+	int rateCode = 0;
+	const int rates[] = { 0, 88200, 176400, 192000, 8000, 16000, 22050, 24000, 32000, 44100, 48000, 96000 };
+	for (int r = 1; r < 12; r++){
+		rateCode = rates[r] == sampleRate ? r : rateCode;
+	}
+	int sizeCode = bitsPerSample == 8 ? 1 : bitsPerSample == 12 ? 2 : bitsPerSample == 16 ? 4 : bitsPerSample == 20 ? 5 : bitsPerSample == 24 ? 6 : 0;
+	w.put(blockCode, 4);
+	w.put(rateCode, 4);
+	w.put(assignment, 4);
+	w.put(sizeCode, 3);
+	w.put(0, 1);
+	putUtf8(w, frameNumber);
+	if (blockCode == 6){
+		w.put(frames - 1, 8);
+	} else if (blockCode == 7){
+		w.put(frames - 1, 16);
+	}
+	w.put(crc8(&w.bytes[0], w.bytes.size()), 8);
+
+	for (int c = 0; c < channels; c++){
+		writeSubframe(w, data[c], frames, bps[c], plans[c]);
+	}
+	w.align();
+	w.put(crc16(&w.bytes[0], w.bytes.size()), 16);
+
+	framesDone += frames;
+	frameNumber++;
+	bytesWritten += w.bytes.size();
+	minFrameBytes = (std::min)(minFrameBytes, (DWORD)w.bytes.size());
+	maxFrameBytes = (std::max)(maxFrameBytes, (DWORD)w.bytes.size());
+	return fwrite(&w.bytes[0], 1, w.bytes.size(), file) == w.bytes.size();
+}
+
+bool FlacEncoder::close(){
+	if (file == NULL){
+		return false;
+	}
+	if (ok && pendingFrames > 0){
+		for (int c = 0; c < channels; c++){
+			pending[c].resize(pendingFrames);
+		}
+		ok = encodeFrame(pending, pendingFrames);
+		pendingFrames = 0;
+	}
+	ok = ok && framesDone == totalFrames;
+
+	//the stream info, then the seek table, then a vorbis comment with no comments, as an encoder would write
+	vector<BYTE> h;
+	h.insert(h.end(), "fLaC", "fLaC" + 4);
+	h.push_back(0);
+	put24(h, 34);
+	h.push_back((BYTE)(blockSize >> 8));
+	h.push_back((BYTE)blockSize);
+	h.push_back((BYTE)(blockSize >> 8));
+	h.push_back((BYTE)blockSize);
+	put24(h, frameNumber > 0 ? minFrameBytes : 0);
+	put24(h, maxFrameBytes);
+	put64(h, (UINT64)sampleRate << 44 | (UINT64)(channels - 1) << 41 | (UINT64)(bitsPerSample - 1) << 36 | totalFrames);
+	h.insert(h.end(), 16, 0); //no md5
+	h.push_back(3);
+	put24(h, 18 * (DWORD)seekSamples.size());
+	for (size_t s = 0; s < seekSamples.size(); s++){
+		put64(h, seekSamples[s]);
+		put64(h, seekOffsets[s]);
+		DWORD frames = seekSamples[s] == placeholderSeekPoint ? 0 : (DWORD)(std::min)((UINT64)blockSize, totalFrames - seekSamples[s]);
+		h.push_back((BYTE)(frames >> 8));
+		h.push_back((BYTE)frames);
+	}
+	h.push_back(0x80 | 4);
+	put24(h, 4 + (DWORD)strlen(vendor) + 4);
+	putLE32(h, (DWORD)strlen(vendor));
+	h.insert(h.end(), vendor, vendor + strlen(vendor));
+	putLE32(h, 0);
+
+	ok = ok && (long)h.size() == headerBytes && fseek(file, 0, SEEK_SET) == 0 && fwrite(&h[0], 1, h.size(), file) == h.size();
+	ok = fclose(file) == 0 && ok;
+	file = NULL;
+	return ok;
+}
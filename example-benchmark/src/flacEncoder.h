@@ -0,0 +1,47 @@
+#pragma once
+#include "ofMain.h"
+
+#include "waveTypes.h"
+
+#include <cstdio>
+
+//a small FLAC encoder for the benchmark corpus, so the decoder is measured on files shaped like a real encoder's:
+//4096 frame blocks, each channel the cheapest of constant, fixed (orders 0 to 4) and order 8 LPC subframes with
+//partitioned rice residuals, stereo as whichever of left/right, left/side, side/right or mid/side comes out smallest,
+//and a seek table every 10 seconds. it has none of a real encoder's search, so it compresses a little less well
+class FlacEncoder {
+public:
+
+	FlacEncoder();
+	~FlacEncoder();
+
+	//starts a file of totalFrames sample frames; the stream info and seek table are filled in by close()
+	bool open(const string& path, int sampleRate, int channels, int bitsPerSample, UINT64 totalFrames);
+	//encodes frames of interleaved samples, right-justified in 32 bits; only the last call may leave a block part full
+	bool write(const INT32* samples, size_t frames);
+	//encodes what's left, fills in the header and closes the file; false if anything couldn't be written
+	bool close();
+
+	static const int blockSize = 4096;
+
+protected:
+
+	bool encodeFrame(const vector<vector<INT32> >& channels, DWORD frames);
+
+	FILE* file;
+	int sampleRate;
+	int channels;
+	int bitsPerSample;
+	UINT64 totalFrames;
+	UINT64 framesDone;
+	UINT64 frameNumber;
+	long headerBytes;
+	UINT64 bytesWritten; //of frames, after the header
+	DWORD minFrameBytes;
+	DWORD maxFrameBytes;
+	vector<vector<INT32> > pending; //a block's worth of each channel, filling up
+	DWORD pendingFrames;
+	vector<UINT64> seekSamples;
+	vector<UINT64> seekOffsets;
+	bool ok;
+};
@@ -0,0 +1,128 @@
+#include "suites.h"
+#include "benchmarkUtils.h"
+#include "waveDecoder.h"
+
+#include <atomic>
+#include <thread>
+
+namespace {
+
+	//a tenth of a second at a time, about what a stream's refill asks the decoder for
+	const double chunkSeconds = 0.1;
+
+	//decodes the whole file, through the system cache so it's the decoding that's timed rather than the disk; returns false
+	//if it couldn't be opened or decoded, or came out the wrong length. with check set, compares every sample with what
+	//the corpus encoded
+	bool decodeFile(const WavCorpusFile& file, bool check){
+		WaveFileSource* source = WaveFileSource::create(true);
+		WaveDecoder* decoder = NULL;
+		bool ok = source->open(ofXAudioToFilePath(file.path).c_str());
+		if (ok){
+			decoder = WaveDecoder::create(source);
+			ok = decoder != NULL && decoder->getLength() == file.frames;
+		}
+
+		DWORD sampleBytes = file.bitsPerSample / 8;
+		DWORD chunkFrames = (DWORD)(file.sampleRate * chunkSeconds);
+		vector<BYTE> pcm((size_t)chunkFrames * file.channels * sampleBytes);
+		vector<INT32> expected(check ? (size_t)chunkFrames * file.channels : 0);
+		UINT64 frames = 0;
+		while (ok && frames < file.frames){
+			DWORD decoded = 0;
+			ok = decoder->decode(&pcm[0], chunkFrames, &decoded) && decoded > 0;
+			if (ok && check){
+				WavCorpus::getFlacSamples(file, frames, &expected[0], decoded);
+				for (size_t i = 0; i < (size_t)decoded * file.channels && ok; i++){
+					//little endian, and 8 bit unsigned as in a wave
+					INT32 v = 0;
+					memcpy(&v, &pcm[i * sampleBytes], sampleBytes);
+					v = sampleBytes == 1 ? v - 128 : (INT32)((DWORD)v << (32 - 8 * sampleBytes)) >> (32 - 8 * sampleBytes);
+					ok = v == expected[i];
+				}
+			}
+			frames += decoded;
+		}
+		ok = ok && frames == file.frames;
+
+		delete decoder;
+		delete source;
+		return ok;
+	}
+
+	//the file decoded on numThreads threads at once, each with a decoder of its own; gives the seconds that took and the
+	//cpu time it used, counting any decode that went wrong in *pFailures
+	void decodeOnThreads(const WavCorpusFile& file, int numThreads, double* pWallSeconds, double* pCPUSeconds, int* pFailures){
+		std::atomic<int> failures(0);
+		double cpuBefore = getProcessCPUSeconds();
+		INT64 start = ofXAudioNowNanos();
+		vector<std::thread> threads;
+		for (int t = 0; t < numThreads; t++){
+			threads.push_back(std::thread([&](){
+				if (!decodeFile(file, false)){
+					failures++;
+				}
+			}));
+		}
+		for (int t = 0; t < numThreads; t++){
+			threads[t].join();
+		}
+		*pWallSeconds = (ofXAudioNowNanos() - start) / 1e9;
+		*pCPUSeconds = getProcessCPUSeconds() - cpuBefore;
+		*pFailures += failures;
+	}
+
+	string runFile(BenchmarkContext& context, const WavCorpusFile& file){
+		ofLogNotice()<<"benchmark: flac "<<file.name;
+		int caseFailures = 0;
+
+		//the first time through checks the samples, and leaves the file in the system cache for the timed ones
+		if (!decodeFile(file, true)){
+			ofLogError()<<"benchmark: "<<file.name<<" didn't decode to what was encoded";
+			caseFailures++;
+		}
+
+		//one decoder on its own, as the cost of a stream, then one on every hardware thread, for what a whole box can do
+		int numThreads = (std::max)((int)std::thread::hardware_concurrency(), 1);
+		vector<double> perCore, allCores, allCoresPerCore;
+		for (int r = 0; r < context.repeats; r++){
+			double wall = 0, cpu = 0;
+			decodeOnThreads(file, 1, &wall, &cpu, &caseFailures);
+			perCore.push_back(cpu > 0 ? file.getSeconds() / cpu : 0);
+			decodeOnThreads(file, numThreads, &wall, &cpu, &caseFailures);
+			allCores.push_back(wall > 0 ? file.getSeconds() * numThreads / wall : 0);
+			allCoresPerCore.push_back(cpu > 0 ? file.getSeconds() * numThreads / cpu : 0);
+		}
+		context.failures += caseFailures;
+
+		UINT64 fileBytes = WavCorpus::getFileBytes(file);
+		std::ostringstream json;
+		json.precision(10);
+		json<<"{\"file\": "<<quote(file.name)<<", \"sampleRate\": "<<file.sampleRate<<", \"channels\": "<<file.channels
+			<<", \"bitsPerSample\": "<<file.bitsPerSample<<", \"seconds\": "<<file.getSeconds()<<", \"fileBytes\": "<<fileBytes
+			<<", \"compressionRatio\": "<<(double)fileBytes / file.getDataBytes()
+			<<", \"realtimePerCore\": "<<median(perCore)<<", \"threads\": "<<numThreads<<", \"realtimeAllThreads\": "<<median(allCores)
+			<<", \"realtimePerCoreAllThreads\": "<<median(allCoresPerCore)<<", \"failures\": "<<caseFailures<<"}";
+		return json.str();
+	}
+
+}
+
+//--------------------------------------------------------------
+string runFlacSuite(BenchmarkContext& context){
+	std::ostringstream json;
+	json<<"[";
+	bool first = true;
+	const vector<WavCorpusFile>& files = context.corpus->getFiles();
+	for (size_t i = 0; i < files.size(); i++){
+		if (files[i].layout == "flac"){
+			json<<(first ? "\n" : ",\n")<<runFile(context, files[i]);
+			first = false;
+		}
+	}
+	if (first){
+		ofLogError()<<"benchmark: the corpus has no FLAC files";
+		context.failures++;
+	}
+	json<<"\n]";
+	return json.str();
+}
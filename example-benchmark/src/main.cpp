@@ -0,0 +1,13 @@
+#include "ofMain.h"
+#include "ofAppNoWindow.h"
+#include "ofApp.h"
+
+//========================================================================
+int main(int argc, char* argv[]){
+	// no window: the benchmark runs in setup() and exits
+	ofAppNoWindow window;
+	ofSetupOpenGL(&window, 1024, 768, OF_WINDOW);
+
+	vector<string> args(argv + 1, argv + argc);
+	ofRunApp(new ofApp(args));
+}
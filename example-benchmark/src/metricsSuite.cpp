@@ -0,0 +1,150 @@
+#include "suites.h"
+#include "benchmarkUtils.h"
+
+#include <atomic>
+#include <thread>
+
+namespace {
+
+	//the metrics of this many streams, taken in turn, so their counters aren't all sitting in the cache as one stream's would
+	const int numMetrics = 256;
+	const int buffersPerRun = 200000;
+	//streams playing at once, so there's enough cpu time to measure and the device has a mix to do
+	const int numPlayers = 8;
+
+	//buffer sizes and counts from the default down to the smallest a buffer gets, where the per buffer cost counts most.
+	//sizes round up to whole sectors and frames, which for 24 bit stereo is 12288 bytes, so the last two both come to that
+	const int bufferBytes[] = { 65536, 24576, 4096 };
+	const int bufferCounts[] = { 3, 4, 8 };
+
+	//what ofXAudioStream does for each buffer, numBuffers times round the metrics: the clock read as a refill starts, the
+	//clock read and the three records as the buffer goes out, and the clock read as the voice finishes it. the totals
+	//are recorded into as well, as the engine's are
+	void runInstrumentation(ofXAudioMetrics* metrics, int numBuffers){
+		std::atomic<INT64> bufferEnded(0);
+		INT64 submitMark = 0;
+		for (int i = 0; i < numBuffers; i++){
+			ofXAudioMetrics& m = metrics[i % numMetrics];
+			submitMark = ofXAudioNowNanos();
+
+			//with a spread of times and depths, so the records land in different buckets as real ones do
+			INT64 now = ofXAudioNowNanos();
+			m.recordRead((UINT64)(now - submitMark) / 1000 + (i * 37) % 4000, 65536);
+			m.recordSubmit(i % 4);
+			submitMark = now;
+			INT64 ended = bufferEnded.exchange(0, std::memory_order_relaxed);
+			if (ended != 0 && now > ended){
+				m.recordResubmit((UINT64)(now - ended) / 1000 + (i * 13) % 500);
+			}
+
+			INT64 none = 0;
+			bufferEnded.compare_exchange_strong(none, ofXAudioNowNanos(), std::memory_order_relaxed);
+		}
+	}
+
+	//the instrumentation on numThreads threads at once, each with streams of its own but all sharing the totals; returns
+	//the median over the repeats of the cpu nanoseconds a buffer, so threads taking turns on too few cores don't count
+	double measureInstrumentation(BenchmarkContext& context, int numThreads){
+		ofXAudioMetricsTotals totals;
+		vector<ofXAudioMetrics*> metrics(numThreads);
+		for (int t = 0; t < numThreads; t++){
+			metrics[t] = new ofXAudioMetrics[numMetrics];
+			for (int i = 0; i < numMetrics; i++){
+				metrics[t][i].setTotals(&totals);
+			}
+		}
+
+		vector<double> nanos;
+		for (int r = 0; r < context.repeats; r++){
+			double cpuBefore = getProcessCPUSeconds();
+			vector<std::thread> threads;
+			for (int t = 0; t < numThreads; t++){
+				threads.push_back(std::thread(runInstrumentation, metrics[t], buffersPerRun));
+			}
+			for (int t = 0; t < numThreads; t++){
+				threads[t].join();
+			}
+			nanos.push_back((getProcessCPUSeconds() - cpuBefore) * 1e9 / ((double)buffersPerRun * numThreads));
+		}
+
+		for (int t = 0; t < numThreads; t++){
+			for (int i = 0; i < numMetrics; i++){
+				metrics[t][i].setTotals(NULL);
+			}
+			delete[] metrics[t];
+		}
+		return median(nanos);
+	}
+
+	//the whole cpu cost of a buffer: the file streamed to the end by each player with buffers of the size, the process's cpu time over the
+	//buffers that took, the device's and the refill workers' included. the size buffers came to goes in pActualBytes
+	double measureBufferCost(BenchmarkContext& context, const WavCorpusFile& file, int bytes, int count, int* pActualBytes, int* pFailures){
+		vector<double> nanos;
+		for (int r = 0; r < context.repeats; r++){
+			vector<ofXAudioSoundPlayer*> players;
+			for (int p = 0; p < numPlayers; p++){
+				ofXAudioSoundPlayer* player = new ofXAudioSoundPlayer();
+				player->setBufferSize(bytes, count);
+				if (!player->preloadSound(file.path, true)){
+					(*pFailures)++;
+				}
+				*pActualBytes = player->getBufferSize();
+				players.push_back(player);
+			}
+			double cpuBefore = getProcessCPUSeconds();
+			if (playToEnd(context.engine, players) > 0){
+				ofLogError()<<"benchmark: "<<file.name<<" stalled with "<<bytes<<" byte buffers";
+				(*pFailures)++;
+			}
+			double cpu = getProcessCPUSeconds() - cpuBefore;
+			UINT64 buffers = 0;
+			for (int p = 0; p < numPlayers; p++){
+				ofXAudioMetrics::Snapshot s;
+				players[p]->getMetrics(&s);
+				buffers += s.buffers;
+				*pFailures += (int)s.failures;
+				players[p]->unloadSound();
+				delete players[p];
+			}
+			nanos.push_back(buffers > 0 ? cpu * 1e9 / buffers : 0);
+		}
+		return median(nanos);
+	}
+
+}
+
+//--------------------------------------------------------------
+string runMetricsSuite(BenchmarkContext& context){
+	const WavCorpusFile* file = context.corpus->findFile("extensible", 48000, 2, 24);
+	if (file == NULL){
+		ofLogError()<<"benchmark: the corpus has no 48kHz stereo 24 bit file for the metrics suite";
+		context.failures++;
+		return "{}";
+	}
+
+	//what recording costs a buffer, on its own and with every hardware thread recording into the same totals
+	ofLogNotice()<<"benchmark: metrics instrumentation";
+	int numThreads = (std::max)((int)std::thread::hardware_concurrency(), 2);
+	double nanosPerBuffer = measureInstrumentation(context, 1);
+	double nanosPerBufferContended = measureInstrumentation(context, numThreads);
+
+	//against what a buffer costs altogether
+	std::ostringstream json;
+	json.precision(10);
+	json<<"{\"instrumentationNSPerBuffer\": "<<nanosPerBuffer<<", \"contendedThreads\": "<<numThreads
+		<<", \"contendedInstrumentationNSPerBuffer\": "<<nanosPerBufferContended<<", \"streaming\": [";
+	for (size_t b = 0; b < sizeof(bufferBytes) / sizeof(bufferBytes[0]); b++){
+		ofLogNotice()<<"benchmark: metrics "<<bufferBytes[b]<<" byte buffers";
+		int caseFailures = 0;
+		int actualBytes = 0;
+		double cost = measureBufferCost(context, *file, bufferBytes[b], bufferCounts[b], &actualBytes, &caseFailures);
+		context.failures += caseFailures;
+		double overhead = cost > 0 ? nanosPerBuffer / cost * 100 : 0;
+		json<<(b == 0 ? "\n" : ",\n")<<"{\"file\": "<<quote(file->name)<<", \"bufferBytes\": "<<actualBytes<<", \"buffers\": "<<bufferCounts[b]
+			<<", \"cpuNSPerBuffer\": "<<cost<<", \"overheadPercent\": "<<overhead
+			<<", \"contendedOverheadPercent\": "<<(cost > 0 ? nanosPerBufferContended / cost * 100 : 0)
+			<<", \"underOnePercent\": "<<(cost > 0 && overhead < 1 ? "true" : "false")<<", \"failures\": "<<caseFailures<<"}";
+	}
+	json<<"\n]}";
+	return json.str();
+}
@@ -0,0 +1,203 @@
+#include "suites.h"
+#include "benchmarkUtils.h"
+#include "nullWaveVoice.h"
+
+#include <random>
+
+namespace {
+
+	//the block an audio callback is typically asked for
+	const DWORD blockFrames = 128;
+	const DWORD outputRate = 48000;
+	const double secondsPerRun = 0.5;
+
+	//the mixer alone, with the voices' audio already float at the output's rate: as many as an output's callback might sum
+	const int mixerVoices = 64;
+	const UINT32 mixerChannels[] = { 1, 2, 6 };
+
+	//and the whole of the null device's tick: each voice's samples converted, taken to the output's rate when they
+	//aren't at it, and mixed
+	const int deviceVoiceCounts[] = { 1, 16, 64, 256 };
+
+	struct DeviceFormat {
+		const char* name;
+		DWORD sampleRate;
+		WORD channels;
+		WORD bitsPerSample;
+		bool isFloat;
+	};
+
+	const DeviceFormat deviceFormats[] = {
+		{ "int16 48kHz stereo", 48000, 2, 16, false },
+		{ "int16 44.1kHz stereo", 44100, 2, 16, false },
+		{ "float32 48kHz mono", 48000, 1, 32, true },
+	};
+
+	//counts the blocks the device hands on, and reads each, as something sending them on would
+	class CountingOutput : public NullWaveOutput {
+	public:
+		std::atomic<UINT64> blocks;
+		float peak;
+
+		CountingOutput() : blocks(0), peak(0) {}
+
+		void OnMix(const float* pBlock, DWORD frames, DWORD channels){
+			for (DWORD i = 0; i < frames * channels; i++){
+				peak = (std::max)(peak, std::abs(pBlock[i]));
+			}
+			blocks++;
+		}
+	};
+
+	//mixes mixerVoices blocks of inChannels into a stereo block, round and round, for about secondsPerRun, each voice's
+	//gains ramping every block as they would under a pan or fade; returns the voices mixed per millisecond
+	double timeMixer(WaveMixer& mixer, const vector<float>& source, UINT32 inChannels){
+		WaveMixGains from = waveMixGains(0.5f, -0.5f, inChannels), to = waveMixGains(0.75f, 0.5f, inChannels);
+		UINT64 mixed = 0;
+		INT64 start = ofXAudioNowNanos();
+		INT64 elapsed = 0;
+		do {
+			mixer.clear(blockFrames);
+			for (int v = 0; v < mixerVoices; v++){
+				mixer.mix(&source[(size_t)v * blockFrames * inChannels], inChannels, from, to);
+			}
+			std::swap(from, to);
+			mixed += mixerVoices;
+			elapsed = ofXAudioNowNanos() - start;
+		} while (elapsed < secondsPerRun * 1e9);
+		return mixed / (elapsed / 1e6);
+	}
+
+	string runMixer(BenchmarkContext& context, UINT32 inChannels, std::mt19937& random){
+		ofLogNotice()<<"benchmark: mix mixer "<<inChannels<<"ch";
+		std::uniform_real_distribution<float> sample(-1, 1);
+		vector<float> source((size_t)mixerVoices * blockFrames * inChannels);
+		for (size_t i = 0; i < source.size(); i++){
+			source[i] = sample(random);
+		}
+		WaveMixer mixer;
+		if (!mixer.setup(2, blockFrames)){
+			ofLogError()<<"benchmark: couldn't set up the mixer";
+			context.failures++;
+			return "";
+		}
+
+		vector<double> rates;
+		for (int r = 0; r < context.repeats; r++){
+			rates.push_back(timeMixer(mixer, source, inChannels));
+		}
+		std::ostringstream json;
+		json.precision(10);
+		json<<"{\"path\": \"mixer\", \"sourceChannels\": "<<inChannels<<", \"voices\": "<<mixerVoices<<", \"blockFrames\": "<<blockFrames
+			<<", \"voicesPerCPUMS\": "<<median(rates)<<"}";
+		return json.str();
+	}
+
+	//plays numVoices voices of the buffer on a free-running device of its own that ticks blockFrames at a time, for about
+	//secondsPerRun once it's under way; the device thread does all the work, so the process's cpu time is its.
+	//false if the voices couldn't be queued or the mix came out silent
+	bool mixOnDevice(const WAVEFORMATEX& wf, const XAUDIO2_BUFFER& buffer, int numVoices, UINT64* pBlocks, double* pCPUMS, double* pWallSeconds){
+		CountingOutput output;
+		bool queued = true;
+		{
+			NullWaveDevice device(NullWaveDevice::TIMING_FREERUN, (double)blockFrames / outputRate, outputRate, 2);
+			device.setOutput(&output);
+			for (int v = 0; v < numVoices; v++){
+				NullWaveVoice* voice = device.createVoice(&wf, NULL);
+				voice->setVolume(1.0f / numVoices);
+				voice->setPan((v % 9) / 4.0f - 1);
+				queued = voice->submit(&buffer) && queued;
+				voice->start();
+			}
+
+			while (output.blocks < 10){
+				std::this_thread::yield();
+			}
+			UINT64 blocksBefore = output.blocks;
+			double cpuBefore = getProcessCPUSeconds();
+			INT64 start = ofXAudioNowNanos();
+			std::this_thread::sleep_for(std::chrono::milliseconds((int)(secondsPerRun * 1000)));
+			*pBlocks = output.blocks - blocksBefore;
+			*pCPUMS = (getProcessCPUSeconds() - cpuBefore) * 1e3;
+			*pWallSeconds = (ofXAudioNowNanos() - start) / 1e9;
+		}
+
+		//the device is gone, and its thread with it, so what the output saw can be looked at
+		return queued && output.peak > 0;
+	}
+
+	//numVoices voices of a second of looped noise in the format, mixed a tick at a time
+	string runDevice(BenchmarkContext& context, const DeviceFormat& format, int numVoices, std::mt19937& random){
+		ofLogNotice()<<"benchmark: mix device "<<format.name<<" x"<<numVoices;
+		WAVEFORMATEX wf = {0};
+		wf.wFormatTag = format.isFloat ? WAVE_FORMAT_IEEE_FLOAT : WAVE_FORMAT_PCM;
+		wf.nChannels = format.channels;
+		wf.nSamplesPerSec = format.sampleRate;
+		wf.wBitsPerSample = format.bitsPerSample;
+		wf.nBlockAlign = format.channels * format.bitsPerSample / 8;
+		wf.nAvgBytesPerSec = wf.nSamplesPerSec * wf.nBlockAlign;
+
+		vector<BYTE> audio((size_t)format.sampleRate * wf.nBlockAlign);
+		std::uniform_real_distribution<float> sample(-0.25f, 0.25f);
+		for (size_t i = 0; i < audio.size() / (format.bitsPerSample / 8); i++){
+			if (format.isFloat){
+				float f = sample(random);
+				memcpy(&audio[i * 4], &f, sizeof(f));
+			} else {
+				short s = (short)(sample(random) * 32767);
+				memcpy(&audio[i * 2], &s, sizeof(s));
+			}
+		}
+		XAUDIO2_BUFFER buffer = {0};
+		buffer.AudioBytes = (UINT32)audio.size();
+		buffer.pAudioData = audio.data();
+		buffer.LoopCount = XAUDIO2_LOOP_INFINITE;
+
+		vector<double> rates, realtime;
+		int caseFailures = 0;
+		for (int r = 0; r < context.repeats; r++){
+			UINT64 blocks = 0;
+			double cpuMS = 0, wallSeconds = 0;
+			if (!mixOnDevice(wf, buffer, numVoices, &blocks, &cpuMS, &wallSeconds)){
+				ofLogError()<<"benchmark: the voices wouldn't queue, or their mix came out silent";
+				caseFailures++;
+			}
+			rates.push_back(cpuMS > 0 ? blocks * numVoices / cpuMS : 0);
+			realtime.push_back(blocks * blockFrames / (double)outputRate / wallSeconds);
+		}
+		context.failures += caseFailures;
+
+		std::ostringstream json;
+		json.precision(10);
+		json<<"{\"path\": \"device\", \"format\": "<<quote(format.name)<<", \"voices\": "<<numVoices<<", \"blockFrames\": "<<blockFrames
+			<<", \"voicesPerCPUMS\": "<<median(rates)<<", \"realtimeFactor\": "<<median(realtime)<<", \"failures\": "<<caseFailures<<"}";
+		return json.str();
+	}
+
+}
+
+//--------------------------------------------------------------
+string runMixSuite(BenchmarkContext& context){
+	std::mt19937 random(0x5eed);
+	vector<string> cases;
+	for (size_t c = 0; c < sizeof(mixerChannels) / sizeof(mixerChannels[0]); c++){
+		cases.push_back(runMixer(context, mixerChannels[c], random));
+	}
+	for (size_t f = 0; f < sizeof(deviceFormats) / sizeof(deviceFormats[0]); f++){
+		for (size_t n = 0; n < sizeof(deviceVoiceCounts) / sizeof(deviceVoiceCounts[0]); n++){
+			cases.push_back(runDevice(context, deviceFormats[f], deviceVoiceCounts[n], random));
+		}
+	}
+
+	std::ostringstream json;
+	json<<"[";
+	bool first = true;
+	for (size_t i = 0; i < cases.size(); i++){
+		if (!cases[i].empty()){
+			json<<(first ? "\n" : ",\n")<<cases[i];
+			first = false;
+		}
+	}
+	json<<"\n]";
+	return json.str();
+}
@@ -0,0 +1,107 @@
+#include "suites.h"
+#include "benchmarkUtils.h"
+
+namespace {
+
+	const int playCounts[] = { 1, 8, 32 };
+	//each play starts this far into the one before, and they all play on this long after the last has started; short of
+	//the end of the file, since a free-running device waits on a stream that's ended until it's stopped
+	const double staggerSeconds = 0.25;
+	const double tailSeconds = 2;
+
+	//numPlays overlapping plays of the file: retriggers of one multi-play player, sharing a block cache, or as many
+	//players of their own, each streaming the file itself. measures the memory they take and what's read from disk
+	string runPlays(BenchmarkContext& context, const WavCorpusFile& file, bool shared, int numPlays){
+		ofLogNotice()<<"benchmark: multiPlay "<<(shared ? "shared" : "separate")<<" x"<<numPlays;
+		ofXAudioEngine* engine = context.engine;
+		ofXAudioStreamCache* streamCache = engine->getStreamCache();
+
+		vector<double> memoryBytes, bufferBytes, diskBytes;
+		int caseFailures = 0;
+		for (int r = 0; r < context.repeats; r++){
+			UINT64 residentBefore = getResidentBytes();
+			WaveBufferPool::Stats poolBefore, poolAfter;
+			engine->getBufferPool()->getStats(&poolBefore);
+			UINT64 cacheReadBefore = streamCache->getBytesRead();
+
+			vector<ofXAudioSoundPlayer*> players(shared ? 1 : numPlays);
+			for (size_t i = 0; i < players.size(); i++){
+				players[i] = new ofXAudioSoundPlayer();
+				players[i]->setMultiPlay(shared);
+				if (!players[i]->preloadSound(file.path, true)){
+					caseFailures++;
+				}
+			}
+			for (int i = 0; i < numPlays; i++){
+				players[shared ? 0 : i]->play();
+				if (!runForAudioSeconds(engine, i + 1 < numPlays ? staggerSeconds : tailSeconds)){
+					ofLogError()<<"benchmark: multiPlay stalled";
+					caseFailures++;
+					break;
+				}
+			}
+			if (shared && players[0]->getNumPlays() != numPlays){
+				ofLogError()<<"benchmark: multiPlay started "<<players[0]->getNumPlays()<<" plays, not "<<numPlays;
+				caseFailures++;
+			}
+
+			//with every play still going: the process's memory, the stream buffers and shared blocks, and the reads so far
+			UINT64 residentAfter = getResidentBytes();
+			engine->getBufferPool()->getStats(&poolAfter);
+			memoryBytes.push_back(residentAfter > residentBefore ? (double)(residentAfter - residentBefore) : 0);
+			bufferBytes.push_back((double)(poolAfter.leasedBytes - poolBefore.leasedBytes) + streamCache->getNumBytes());
+			UINT64 read = 0;
+			if (shared){
+				read = streamCache->getBytesRead() - cacheReadBefore;
+			} else {
+				for (size_t i = 0; i < players.size(); i++){
+					ofXAudioMetrics::Snapshot s;
+					players[i]->getMetrics(&s);
+					read += s.bytesRead;
+				}
+			}
+			diskBytes.push_back((double)read);
+
+			for (size_t i = 0; i < players.size(); i++){
+				ofXAudioMetrics::Snapshot s;
+				players[i]->getMetrics(&s);
+				caseFailures += (int)s.failures;
+				players[i]->unloadSound();
+				delete players[i];
+			}
+		}
+		context.failures += caseFailures;
+
+		//the audio the plays got through between them, to set the reads against
+		double playedSeconds = numPlays * tailSeconds + staggerSeconds * numPlays * (numPlays - 1) / 2;
+		double playedBytes = playedSeconds * file.sampleRate * file.channels * (file.bitsPerSample / 8);
+		std::ostringstream json;
+		json.precision(10);
+		json<<"{\"file\": "<<quote(file.name)<<", \"mode\": "<<quote(shared ? "shared" : "separate")<<", \"plays\": "<<numPlays
+			<<", \"memoryBytes\": "<<median(memoryBytes)<<", \"bufferBytes\": "<<median(bufferBytes)
+			<<", \"diskBytes\": "<<median(diskBytes)<<", \"diskBytesPerPlayedByte\": "<<(playedBytes > 0 ? median(diskBytes) / playedBytes : 0)
+			<<", \"failures\": "<<caseFailures<<"}";
+		return json.str();
+	}
+
+}
+
+//--------------------------------------------------------------
+string runMultiPlaySuite(BenchmarkContext& context){
+	const WavCorpusFile* file = context.corpus->findFile("extensible", 48000, 2, 24);
+	if (file == NULL || file->getSeconds() < staggerSeconds * playCounts[2] + tailSeconds + 1){
+		ofLogError()<<"benchmark: the corpus has no 48kHz stereo 24 bit file long enough for the multiPlay suite";
+		context.failures++;
+		return "[]";
+	}
+
+	std::ostringstream json;
+	json<<"[";
+	for (int shared = 1; shared >= 0; shared--){
+		for (size_t n = 0; n < sizeof(playCounts) / sizeof(playCounts[0]); n++){
+			json<<(shared == 1 && n == 0 ? "\n" : ",\n")<<runPlays(context, *file, shared != 0, playCounts[n]);
+		}
+	}
+	json<<"\n]";
+	return json.str();
+}
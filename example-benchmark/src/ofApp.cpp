@@ -0,0 +1,216 @@
+#include "ofApp.h"
+
+#include "benchmarkUtils.h"
+#include "suites.h"
+
+#include <fstream>
+#include <thread>
+
+//--------------------------------------------------------------
+ofApp::ofApp(const vector<string>& args)
+	: corpusDir(ofToDataPath("corpus", true))
+	, outPath(ofToDataPath("benchmark.json", true))
+	, largeGB(0)
+	, repeats(3)
+	, concurrentStreams(8)
+	, streamingThreads(0)
+	, engine(NULL)
+	, failures(0)
+{
+	for (size_t i = 0; i + 1 < args.size(); i += 2){
+		if (args[i] == "--corpus"){
+			corpusDir = args[i + 1];
+		} else if (args[i] == "--out"){
+			outPath = args[i + 1];
+		} else if (args[i] == "--large"){
+			largeGB = ofToDouble(args[i + 1]);
+		} else if (args[i] == "--repeats"){
+			repeats = (std::max)(ofToInt(args[i + 1]), 1);
+		} else if (args[i] == "--streams"){
+			concurrentStreams = (std::max)(ofToInt(args[i + 1]), 1);
+		} else if (args[i] == "--threads"){
+			streamingThreads = (std::max)(ofToInt(args[i + 1]), 1);
+		} else if (args[i] == "--only"){
+			only = "," + args[i + 1] + ",";
+		} else {
+			ofLogWarning()<<"benchmark: unknown argument "<<args[i];
+		}
+	}
+}
+
+//--------------------------------------------------------------
+void ofApp::setup(){
+	corpus.setup(corpusDir, largeGB);
+	if (!corpus.generate()){
+		ofExit(1);
+		return;
+	}
+
+	//the null device, free-running: it plays each stream as fast as the refills keep it fed, so the work done is the same
+	//every run and the wall time is what it cost
+	ofXAudioEngine::setBackend(ofXAudioEngine::OFXAUDIO_BACKEND_NULL, NullWaveDevice::TIMING_FREERUN);
+	if (streamingThreads > 0){
+		ofXAudioEngine::setNumStreamingThreads(streamingThreads);
+	}
+	engine = ofXAudioEngine::acquire();
+	if (engine == NULL){
+		ofLogError()<<"benchmark: couldn't create the engine";
+		ofExit(1);
+		return;
+	}
+
+	std::ostringstream json;
+	json<<"{\n\"schema\": 2,\n\"backend\": \"null-freerun\",\n\"tickSeconds\": "<<engine->getNullDevice()->getTickSeconds()
+		<<",\n\"hardwareThreads\": "<<std::thread::hardware_concurrency()<<",\n\"outputSampleRate\": "<<engine->getOutputSampleRate()<<",\n\"streamingThreads\": "<<engine->getScheduler()->getNumWorkers()
+		<<",\n\"repeats\": "<<repeats;
+
+	//every file on its own, read and mapped, then the concurrent cases on a typical file
+	if (isSelected("results")){
+		json<<",\n\"results\": [";
+		const vector<WavCorpusFile>& files = corpus.getFiles();
+		bool first = true;
+		for (size_t i = 0; i < files.size(); i++){
+			for (int mapped = 0; mapped < 2; mapped++){
+				json<<(first ? "\n" : ",\n")<<runCase(files[i], mapped != 0, 1);
+				first = false;
+			}
+		}
+		const WavCorpusFile* typical = corpus.findFile("extensible", 48000, 2, 24);
+		if (typical != NULL){
+			json<<",\n"<<runCase(*typical, false, concurrentStreams);
+			json<<",\n"<<runCase(*typical, true, concurrentStreams);
+		}
+		json<<"\n]";
+	}
+
+	//then the suites that each look at one part of the addon
+	BenchmarkContext context;
+	context.engine = engine;
+	context.corpus = &corpus;
+	context.repeats = repeats;
+	context.concurrentStreams = concurrentStreams;
+	context.failures = 0;
+	runSuite(json, "players", runPlayersSuite, context);
+	runSuite(json, "readAhead", runReadAheadSuite, context);
+	runSuite(json, "sourceModes", runSourceModesSuite, context);
+	runSuite(json, "seek", runSeekSuite, context);
+	runSuite(json, "open", runOpenSuite, context);
+	runSuite(json, "playhead", runPlayheadSuite, context);
+	runSuite(json, "multiPlay", runMultiPlaySuite, context);
+	runSuite(json, "resample", runResampleSuite, context);
+	runSuite(json, "mix", runMixSuite, context);
+	runSuite(json, "flac", runFlacSuite, context);
+	runSuite(json, "metrics", runMetricsSuite, context);
+	runSuite(json, "convert", runConvertSuite, context);
+	failures += context.failures;
+
+	//how much of the buffer pool the runs ended up using, and how often they got their buffers back out of it
+	WaveBufferPool::Stats pool;
+	engine->getBufferPool()->getStats(&pool);
+	json<<",\n\"bufferPool\": {\"arenas\": "<<pool.arenas<<", \"hugePageArenas\": "<<pool.hugePageArenas<<", \"reservedBytes\": "<<pool.reservedBytes
+		<<", \"totalLeases\": "<<pool.totalLeases<<", \"reusedLeases\": "<<pool.reusedLeases<<"},\n\"failures\": "<<failures<<"\n}\n";
+
+	engine = NULL;
+	ofXAudioEngine::release();
+
+	if (outPath == "-"){
+		cout<<json.str();
+	} else {
+		std::ofstream out(outPath.c_str());
+		out<<json.str();
+		if (!out.good()){
+			ofLogError()<<"benchmark: couldn't write "<<outPath;
+			failures++;
+		} else {
+			ofLogNotice()<<"benchmark: results in "<<outPath;
+		}
+	}
+
+	ofExit(failures > 0 ? 1 : 0);
+}
+
+//--------------------------------------------------------------
+bool ofApp::isSelected(const string& section){
+	return only.empty() || only.find("," + section + ",") != string::npos;
+}
+
+//--------------------------------------------------------------
+void ofApp::runSuite(std::ostringstream& json, const string& name, string (*suite)(BenchmarkContext&), BenchmarkContext& context){
+	if (isSelected(name)){
+		json<<",\n"<<quote(name)<<": "<<suite(context);
+	}
+}
+
+//--------------------------------------------------------------
+string ofApp::runCase(const WavCorpusFile& file, bool mapped, int numStreams){
+	ofLogNotice()<<"benchmark: "<<file.name<<(mapped ? " mapped" : " read")<<" x"<<numStreams;
+
+	vector<double> openMS, wallSeconds, memoryBytes, leasedBytes;
+	ofXAudioMetrics::Snapshot metrics;
+	int bufferBytes = 0;
+	int caseFailures = 0;
+
+	for (int r = 0; r < repeats; r++){
+		vector<ofXAudioSoundPlayer*> players(numStreams);
+		for (int i = 0; i < numStreams; i++){
+			players[i] = new ofXAudioSoundPlayer();
+			players[i]->setMemoryMapped(mapped);
+		}
+
+		//the time to open each stream and queue its first buffers, and the memory that took. preloading leaves them stopped,
+		//so they all start together below
+		UINT64 residentBefore = getResidentBytes();
+		WaveBufferPool::Stats poolBefore, poolAfter;
+		engine->getBufferPool()->getStats(&poolBefore);
+		INT64 start = ofXAudioNowNanos();
+		for (int i = 0; i < numStreams; i++){
+			if (!players[i]->preloadSound(file.path, true)){
+				caseFailures++;
+			}
+		}
+		openMS.push_back((ofXAudioNowNanos() - start) / 1e6 / numStreams);
+		UINT64 residentAfter = getResidentBytes();
+		engine->getBufferPool()->getStats(&poolAfter);
+		memoryBytes.push_back(residentAfter > residentBefore ? (double)(residentAfter - residentBefore) / numStreams : 0);
+		leasedBytes.push_back((double)(poolAfter.leasedBytes - poolBefore.leasedBytes) / numStreams);
+		bufferBytes = players[0]->getBufferSize();
+
+		//then play them all to the end
+		start = ofXAudioNowNanos();
+		int stalled = playToEnd(engine, players);
+		if (stalled > 0){
+			ofLogError()<<"benchmark: "<<file.name<<" stalled";
+			caseFailures += stalled;
+		}
+		wallSeconds.push_back((ofXAudioNowNanos() - start) / 1e9);
+
+		for (int i = 0; i < numStreams; i++){
+			ofXAudioMetrics::Snapshot s;
+			players[i]->getMetrics(&s);
+			metrics.add(s);
+			players[i]->unloadSound();
+			delete players[i];
+		}
+	}
+
+	caseFailures += (int)metrics.failures;
+	failures += caseFailures;
+
+	double wall = median(wallSeconds);
+	double bytes = (double)file.getDataBytes() * numStreams;
+	std::ostringstream json;
+	json.precision(10);
+	json<<"{\"file\": "<<quote(file.name)<<", \"layout\": "<<quote(file.layout)<<", \"sampleRate\": "<<file.sampleRate
+		<<", \"channels\": "<<file.channels<<", \"bitsPerSample\": "<<file.bitsPerSample<<", \"float\": "<<(file.isFloat ? "true" : "false")
+		<<", \"seconds\": "<<file.getSeconds()<<", \"dataBytes\": "<<file.getDataBytes()
+		<<",\n \"mode\": "<<quote(mapped ? "mapped" : "read")<<", \"streams\": "<<numStreams<<", \"bufferBytes\": "<<bufferBytes
+		<<",\n \"openMS\": "<<median(openMS)<<", \"wallSeconds\": "<<wall
+		<<", \"bytesPerSecond\": "<<(wall > 0 ? bytes / wall : 0)<<", \"realtimeFactor\": "<<(wall > 0 ? file.getSeconds() * numStreams / wall : 0)
+		<<", \"memoryBytesPerStream\": "<<median(memoryBytes)<<", \"bufferBytesPerStream\": "<<median(leasedBytes)
+		<<",\n \"readUS\": "<<histogramJson(metrics.readTime)
+		<<",\n \"resubmitUS\": "<<histogramJson(metrics.resubmitTime)
+		<<",\n \"queuedAtSubmit\": {\"p1\": "<<metrics.queuedAtSubmit.getPercentile(1)<<", \"p50\": "<<metrics.queuedAtSubmit.getPercentile(50)<<"}"
+		<<",\n \"buffers\": "<<metrics.buffers<<", \"bytesRead\": "<<metrics.bytesRead<<", \"underruns\": "<<metrics.underruns
+		<<", \"failures\": "<<caseFailures<<"}";
+	return json.str();
+}
@@ -0,0 +1,47 @@
+#pragma once
+#include "ofMain.h"
+
+#include "ofXAudioSoundPlayer.h"
+#include "wavCorpus.h"
+
+struct BenchmarkContext;
+
+//streams every file of a synthetic corpus through the null device, free-running so the audio timeline is the same every run,
+//and writes what each stream cost as json: throughput, refill latency percentiles, open time and memory per stream.
+//then runs the suites in suites.h, each adding a section of its own.
+//arguments:
+//  --corpus dir     where the corpus is written and reused from (bin/data/corpus)
+//  --out file       where the results go, or - for stdout (bin/data/benchmark.json)
+//  --large gb       adds an RF64 file of about this many gigabytes (none)
+//  --repeats n      runs of each case, reported by their median (3)
+//  --streams n      streams at once in the concurrent cases (8)
+//  --threads n      refill worker threads (the engine's default)
+//  --only a,b       runs just these sections: results, the per-file streaming cases, or any of the suites in
+//                   suites.h (all of them)
+class ofApp : public ofBaseApp{
+
+	public:
+		ofApp(const vector<string>& args);
+
+		void setup();
+
+	protected:
+		//whether --only left this section of the results in
+		bool isSelected(const string& section);
+		//runs the suite if it's selected, adding its section to the json
+		void runSuite(std::ostringstream& json, const string& name, string (*suite)(BenchmarkContext&), BenchmarkContext& context);
+		//streams the file on this many players at once, repeats times, and returns the json object for the case
+		string runCase(const WavCorpusFile& file, bool mapped, int numStreams);
+
+		string corpusDir;
+		string outPath;
+		double largeGB;
+		int repeats;
+		int concurrentStreams;
+		int streamingThreads;
+		string only;
+
+		WavCorpus corpus;
+		ofXAudioEngine* engine;
+		int failures;
+};
@@ -0,0 +1,69 @@
+#include "suites.h"
+#include "benchmarkUtils.h"
+
+namespace {
+
+	const int numOpens = 200;
+
+	//opens the file over and over: the header alone, parsed by WaveInfo, then a whole stream, loaded with its first buffers
+	//queued so it's ready to play
+	string runOpens(BenchmarkContext& context, const WavCorpusFile& file){
+		ofLogNotice()<<"benchmark: open "<<file.name;
+
+		ofXAudioFilePath path = ofXAudioToFilePath(file.path);
+		vector<double> parseUS, readyUS;
+		int caseFailures = 0;
+		for (int i = 0; i < numOpens * context.repeats; i++){
+			INT64 start = ofXAudioNowNanos();
+			WaveInfo info;
+			bool parsed = info.load(path.c_str());
+			parseUS.push_back((ofXAudioNowNanos() - start) / 1e3);
+			if (!parsed || info.getDataLength() != file.getDataBytes()){
+				caseFailures++;
+			}
+		}
+
+		ofXAudioSoundPlayer player;
+		for (int i = 0; i < numOpens * context.repeats; i++){
+			INT64 start = ofXAudioNowNanos();
+			bool loaded = player.preloadSound(file.path, true);
+			readyUS.push_back((ofXAudioNowNanos() - start) / 1e3);
+			if (!loaded){
+				caseFailures++;
+			}
+			player.unloadSound();
+		}
+		context.failures += caseFailures;
+
+		UINT64 fileBytes = WavCorpus::getFileBytes(file);
+		std::ostringstream json;
+		json.precision(10);
+		json<<"{\"file\": "<<quote(file.name)<<", \"layout\": "<<quote(file.layout)<<", \"headerBytes\": "<<fileBytes - file.getDataBytes()
+			<<",\n \"parseUS\": "<<percentilesJson(parseUS)
+			<<",\n \"openToReadyUS\": "<<percentilesJson(readyUS)
+			<<", \"failures\": "<<caseFailures<<"}";
+		return json.str();
+	}
+
+}
+
+//--------------------------------------------------------------
+string runOpenSuite(BenchmarkContext& context){
+	//the same format with a plain header, an extensible one, and the metadata of a broadcast wave
+	std::ostringstream json;
+	json<<"[";
+	bool first = true;
+	const char* layouts[] = { "pcm", "extensible", "broadcast" };
+	for (int i = 0; i < 3; i++){
+		const WavCorpusFile* file = context.corpus->findFile(layouts[i], 48000, 2, 24);
+		if (file == NULL){
+			ofLogError()<<"benchmark: the corpus has no 48kHz stereo 24 bit "<<layouts[i]<<" file for the open suite";
+			context.failures++;
+			continue;
+		}
+		json<<(first ? "\n" : ",\n")<<runOpens(context, *file);
+		first = false;
+	}
+	json<<"\n]";
+	return json.str();
+}
@@ -0,0 +1,95 @@
+#include "suites.h"
+#include "benchmarkUtils.h"
+
+namespace {
+
+	const int playerCounts[] = { 1, 16, 128, 512 };
+	const double audioSeconds = 30;
+
+	//loads numPlayers players of the file, all looping, then plays them together for audioSeconds; returns the json object
+	string runPlayers(BenchmarkContext& context, const WavCorpusFile& file, bool stream, int numPlayers){
+		ofLogNotice()<<"benchmark: players "<<(stream ? "stream" : "memory")<<" x"<<numPlayers;
+		ofXAudioEngine* engine = context.engine;
+
+		vector<double> loadMS, memoryBytes, cpuUS, wallSeconds;
+		int voices = 0;
+		int caseFailures = 0;
+		for (int r = 0; r < context.repeats; r++){
+			vector<ofXAudioSoundPlayer*> players(numPlayers);
+			for (int i = 0; i < numPlayers; i++){
+				players[i] = new ofXAudioSoundPlayer();
+				players[i]->setLoop(true);
+			}
+
+			//what each player costs to load, in time and memory, with the engine already running
+			UINT64 residentBefore = getResidentBytes();
+			INT64 start = ofXAudioNowNanos();
+			for (int i = 0; i < numPlayers; i++){
+				if (!players[i]->preloadSound(file.path, stream)){
+					caseFailures++;
+				}
+			}
+			loadMS.push_back((ofXAudioNowNanos() - start) / 1e6 / numPlayers);
+			UINT64 residentAfter = getResidentBytes();
+			memoryBytes.push_back(residentAfter > residentBefore ? (double)(residentAfter - residentBefore) / numPlayers : 0);
+
+			//and to play: the cpu time of every thread, the device's and the refill workers' included, for each
+			//second of audio each player plays
+			for (int i = 0; i < numPlayers; i++){
+				players[i]->play();
+			}
+			voices = engine->getVoiceCount();
+			double cpuBefore = getProcessCPUSeconds();
+			start = ofXAudioNowNanos();
+			if (!runForAudioSeconds(engine, audioSeconds)){
+				ofLogError()<<"benchmark: "<<numPlayers<<" players stalled";
+				caseFailures++;
+			}
+			wallSeconds.push_back((ofXAudioNowNanos() - start) / 1e9);
+			cpuUS.push_back((getProcessCPUSeconds() - cpuBefore) * 1e6 / audioSeconds / numPlayers);
+
+			for (int i = 0; i < numPlayers; i++){
+				players[i]->unloadSound();
+				delete players[i];
+			}
+		}
+		context.failures += caseFailures;
+
+		double wall = median(wallSeconds);
+		std::ostringstream json;
+		json.precision(10);
+		json<<"{\"file\": "<<quote(file.name)<<", \"mode\": "<<quote(stream ? "stream" : "memory")<<", \"players\": "<<numPlayers
+			<<", \"voices\": "<<voices<<", \"loadMSPerPlayer\": "<<median(loadMS)<<", \"memoryBytesPerPlayer\": "<<median(memoryBytes)
+			<<", \"cpuUSPerPlayerPerAudioSecond\": "<<median(cpuUS)<<", \"wallSeconds\": "<<wall
+			<<", \"realtimeFactor\": "<<(wall > 0 ? audioSeconds / wall : 0)<<", \"failures\": "<<caseFailures<<"}";
+		return json.str();
+	}
+
+}
+
+//--------------------------------------------------------------
+string runPlayersSuite(BenchmarkContext& context){
+	//the shortest file, so the sounds in memory are cheap to load and the streams loop through it
+	const WavCorpusFile* file = NULL;
+	const vector<WavCorpusFile>& files = context.corpus->getFiles();
+	for (size_t i = 0; i < files.size(); i++){
+		if (file == NULL || files[i].getSeconds() < file->getSeconds()){
+			file = &files[i];
+		}
+	}
+	if (file == NULL){
+		ofLogError()<<"benchmark: the corpus is empty";
+		context.failures++;
+		return "[]";
+	}
+
+	std::ostringstream json;
+	json<<"[";
+	for (int stream = 1; stream >= 0; stream--){
+		for (size_t n = 0; n < sizeof(playerCounts) / sizeof(playerCounts[0]); n++){
+			json<<(stream == 1 && n == 0 ? "\n" : ",\n")<<runPlayers(context, *file, stream != 0, playerCounts[n]);
+		}
+	}
+	json<<"\n]";
+	return json.str();
+}
@@ -0,0 +1,102 @@
+#include "suites.h"
+#include "benchmarkUtils.h"
+
+#include <atomic>
+#include <thread>
+
+namespace {
+
+	const int readerCounts[] = { 0, 1, 2, 4, 8 };
+	const double secondsPerRun = 0.5;
+	//reads timed together, since one read is about as quick as reading the clock
+	const int readsPerBatch = 100;
+
+	//readers hammering the playheads of streams the device is playing as fast as it can, so the playheads are written
+	//all the while: what a read costs as readers are added, and whether the writers slow down for them
+	string runReaders(BenchmarkContext& context, const vector<ofXAudioSoundPlayer*>& players, int numReaders){
+		ofLogNotice()<<"benchmark: playhead x"<<numReaders;
+		NullWaveDevice* device = context.engine->getNullDevice();
+
+		vector<double> batchNS, readsPerSecond, ticksPerSecond;
+		for (int r = 0; r < context.repeats; r++){
+			std::atomic<bool> reading(true);
+			std::atomic<UINT64> totalReads(0);
+			vector<vector<double> > readerBatches(numReaders);
+			vector<std::thread> readers;
+			for (int t = 0; t < numReaders; t++){
+				readers.push_back(std::thread([&, t](){
+					UINT64 reads = 0;
+					UINT64 sum = 0;
+					size_t p = t;
+					while (reading){
+						INT64 start = ofXAudioNowNanos();
+						for (int i = 0; i < readsPerBatch; i++){
+							const ofXAudioPlayhead& playhead = players[p++ % players.size()]->getPlayhead();
+							sum += playhead.getFrame() + playhead.isPlaying();
+						}
+						readerBatches[t].push_back((double)(ofXAudioNowNanos() - start) / readsPerBatch);
+						reads += readsPerBatch;
+					}
+					//so the reads can't be left out
+					totalReads += reads + (sum == 0x7fffffff);
+				}));
+			}
+
+			UINT64 ticksBefore = device->getTickCount();
+			INT64 start = ofXAudioNowNanos();
+			std::this_thread::sleep_for(std::chrono::milliseconds((int)(secondsPerRun * 1000)));
+			double seconds = (ofXAudioNowNanos() - start) / 1e9;
+			ticksPerSecond.push_back((device->getTickCount() - ticksBefore) / seconds);
+			reading = false;
+			for (int t = 0; t < numReaders; t++){
+				readers[t].join();
+				batchNS.insert(batchNS.end(), readerBatches[t].begin(), readerBatches[t].end());
+			}
+			readsPerSecond.push_back(totalReads / seconds);
+		}
+
+		std::ostringstream json;
+		json.precision(10);
+		json<<"{\"readers\": "<<numReaders<<", \"streams\": "<<players.size()<<", \"readsPerSecond\": "<<median(readsPerSecond)
+			<<", \"deviceTicksPerSecond\": "<<median(ticksPerSecond)
+			<<",\n \"readNS\": "<<percentilesJson(batchNS)<<"}";
+		return json.str();
+	}
+
+}
+
+//--------------------------------------------------------------
+string runPlayheadSuite(BenchmarkContext& context){
+	const WavCorpusFile* file = context.corpus->findFile("extensible", 48000, 2, 24);
+	if (file == NULL){
+		ofLogError()<<"benchmark: the corpus has no 48kHz stereo 24 bit file for the playhead suite";
+		context.failures++;
+		return "[]";
+	}
+
+	//looping, mapped so the refills are cheap and the playheads are written as often as they can be
+	vector<ofXAudioSoundPlayer*> players(context.concurrentStreams);
+	for (size_t i = 0; i < players.size(); i++){
+		players[i] = new ofXAudioSoundPlayer();
+		players[i]->setMemoryMapped(true);
+		players[i]->setLoop(true);
+		if (!players[i]->preloadSound(file->path, true)){
+			context.failures++;
+		}
+		players[i]->play();
+	}
+
+	//0 readers is how fast the device goes with nothing reading
+	std::ostringstream json;
+	json<<"[";
+	for (size_t n = 0; n < sizeof(readerCounts) / sizeof(readerCounts[0]); n++){
+		json<<(n == 0 ? "\n" : ",\n")<<runReaders(context, players, readerCounts[n]);
+	}
+	json<<"\n]";
+
+	for (size_t i = 0; i < players.size(); i++){
+		players[i]->unloadSound();
+		delete players[i];
+	}
+	return json.str();
+}
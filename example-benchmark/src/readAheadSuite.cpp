@@ -0,0 +1,85 @@
+#include "suites.h"
+#include "benchmarkUtils.h"
+
+namespace {
+
+	//0 is the synchronous read per buffer the rest are compared against
+	const int readAheads[] = { 0, 1, 2, 4, 8 };
+
+	//the synchronous run's rate and p99 are kept in synchronous for the runs after it to be compared against
+	string runReadAhead(BenchmarkContext& context, const WavCorpusFile& file, int readAhead, int numStreams, double synchronous[2]){
+		ofLogNotice()<<"benchmark: readAhead "<<readAhead<<" x"<<numStreams;
+
+		vector<double> wallSeconds;
+		ofXAudioMetrics::Snapshot metrics;
+		int caseFailures = 0;
+		for (int r = 0; r < context.repeats; r++){
+			vector<ofXAudioSoundPlayer*> players(numStreams);
+			for (int i = 0; i < numStreams; i++){
+				players[i] = new ofXAudioSoundPlayer();
+				players[i]->setReadAhead(readAhead);
+				if (!players[i]->preloadSound(file.path, true)){
+					caseFailures++;
+				}
+			}
+
+			INT64 start = ofXAudioNowNanos();
+			caseFailures += playToEnd(context.engine, players);
+			wallSeconds.push_back((ofXAudioNowNanos() - start) / 1e9);
+
+			for (int i = 0; i < numStreams; i++){
+				ofXAudioMetrics::Snapshot s;
+				players[i]->getMetrics(&s);
+				metrics.add(s);
+				players[i]->unloadSound();
+				delete players[i];
+			}
+		}
+		caseFailures += (int)metrics.failures;
+		context.failures += caseFailures;
+
+		//a buffer is ready when its read is done (or waited on) and it's decoded; the resubmit time is how long a voice
+		//that had finished a buffer then waited for the refill to queue the next
+		double wall = median(wallSeconds);
+		double rate = wall > 0 ? file.getDataBytes() * numStreams / wall / (1024 * 1024) : 0;
+		double p99 = (double)metrics.readTime.getPercentile(99);
+		if (readAhead == 0){
+			synchronous[0] = rate;
+			synchronous[1] = p99;
+		}
+		std::ostringstream json;
+		json.precision(10);
+		json<<"{\"file\": "<<quote(file.name)<<", \"readAhead\": "<<readAhead<<", \"mode\": "<<quote(readAhead > 0 ? "readAhead" : "synchronous")
+			<<", \"streams\": "<<numStreams<<", \"wallSeconds\": "<<wall
+			<<", \"MBPerSecond\": "<<rate<<", \"rateVsSynchronous\": "<<(synchronous[0] > 0 ? rate / synchronous[0] : 0)
+			<<", \"p99VsSynchronous\": "<<(synchronous[1] > 0 ? p99 / synchronous[1] : 0)
+			<<",\n \"bufferReadyUS\": "<<histogramJson(metrics.readTime)
+			<<",\n \"resubmitUS\": "<<histogramJson(metrics.resubmitTime)
+			<<", \"failures\": "<<caseFailures<<"}";
+		return json.str();
+	}
+
+}
+
+//--------------------------------------------------------------
+string runReadAheadSuite(BenchmarkContext& context){
+	//the long file, so each run reads enough to settle into a steady rate
+	const WavCorpusFile* file = context.corpus->findFile("pcm", 48000, 2, 24);
+	if (file == NULL){
+		ofLogError()<<"benchmark: the corpus has no 48kHz stereo 24 bit wave for the readAhead suite";
+		context.failures++;
+		return "[]";
+	}
+
+	std::ostringstream json;
+	json<<"[";
+	const int streamCounts[] = { 1, context.concurrentStreams };
+	for (int s = 0; s < 2; s++){
+		double synchronous[2] = { 0, 0 };
+		for (size_t r = 0; r < sizeof(readAheads) / sizeof(readAheads[0]); r++){
+			json<<(s == 0 && r == 0 ? "\n" : ",\n")<<runReadAhead(context, *file, readAheads[r], streamCounts[s], synchronous);
+		}
+	}
+	json<<"\n]";
+	return json.str();
+}
@@ -0,0 +1,80 @@
+#include "suites.h"
+#include "benchmarkUtils.h"
+#include "waveResample.h"
+
+#include <random>
+
+namespace {
+
+	const RESAMPLE_QUALITY qualities[] = { RQ_FAST, RQ_GOOD, RQ_HIGH, RQ_BEST };
+	const char* qualityNames[] = { "fast", "good", "high", "best" };
+	const DWORD channelCounts[] = { 1, 2, 6, 8 };
+	//the mismatches the material has: cd rate up to the output's, and high rate down to it
+	const DWORD inputRates[] = { 44100, 96000 };
+	const DWORD outputRate = 48000;
+	//a tenth of a second at a time, about what a stream's buffer holds
+	const double blockSeconds = 0.1;
+	const int sourceBlocks = 8;
+	const double secondsPerRun = 0.2;
+
+	//resamples blocks for about secondsPerRun, on one thread as a stream's worker does it; returns the microseconds of
+	//cpu each second of output took
+	double timeResampler(WaveResampler& resampler, const vector<float>& source, DWORD channels, DWORD blockFrames, vector<float>& dest){
+		UINT64 outFrames = 0;
+		INT64 start = ofXAudioNowNanos();
+		INT64 elapsed = 0;
+		do {
+			for (int b = 0; b < sourceBlocks; b++){
+				outFrames += resampler.process(&source[(size_t)b * blockFrames * channels], blockFrames, dest.data(), false);
+			}
+			elapsed = ofXAudioNowNanos() - start;
+		} while (elapsed < secondsPerRun * 1e9);
+		return outFrames > 0 ? elapsed / 1e3 / ((double)outFrames / outputRate) : 0;
+	}
+
+}
+
+//--------------------------------------------------------------
+string runResampleSuite(BenchmarkContext& context){
+	std::mt19937 random(0x5eed);
+	std::uniform_real_distribution<float> sample(-1, 1);
+
+	std::ostringstream json;
+	json.precision(10);
+	json<<"[";
+	bool first = true;
+	for (size_t r = 0; r < sizeof(inputRates) / sizeof(inputRates[0]); r++){
+		for (size_t c = 0; c < sizeof(channelCounts) / sizeof(channelCounts[0]); c++){
+			DWORD channels = channelCounts[c];
+			DWORD blockFrames = (DWORD)(inputRates[r] * blockSeconds);
+			vector<float> source((size_t)blockFrames * sourceBlocks * channels);
+			for (size_t i = 0; i < source.size(); i++){
+				source[i] = sample(random);
+			}
+
+			for (size_t q = 0; q < sizeof(qualities) / sizeof(qualities[0]); q++){
+				ofLogNotice()<<"benchmark: resample "<<inputRates[r]<<" "<<channels<<"ch "<<qualityNames[q];
+				WaveResampler resampler;
+				if (!resampler.setup(channels, inputRates[r], outputRate, qualities[q])){
+					ofLogError()<<"benchmark: couldn't set up the resampler";
+					context.failures++;
+					continue;
+				}
+				vector<float> dest((size_t)resampler.maxOutput(blockFrames) * channels);
+
+				vector<double> cpuUS;
+				for (int i = 0; i < context.repeats; i++){
+					cpuUS.push_back(timeResampler(resampler, source, channels, blockFrames, dest));
+				}
+				double us = median(cpuUS);
+				json<<(first ? "\n" : ",\n")<<"{\"quality\": "<<quote(qualityNames[q])<<", \"taps\": "<<resampler.getTaps()
+					<<", \"inputRate\": "<<inputRates[r]<<", \"outputRate\": "<<outputRate<<", \"channels\": "<<channels
+					<<", \"cpuUSPerAudioSecond\": "<<us<<", \"cpuUSPerChannelPerAudioSecond\": "<<us / channels
+					<<", \"voicesPerCore\": "<<(us > 0 ? 1e6 / us : 0)<<"}";
+				first = false;
+			}
+		}
+	}
+	json<<"\n]";
+	return json.str();
+}
@@ -0,0 +1,99 @@
+#include "suites.h"
+#include "benchmarkUtils.h"
+
+#include <random>
+#include <thread>
+
+namespace {
+
+	const int numSeeks = 200;
+
+	//seeks a looping stream to random places while it plays, timing the call, which only queues the seek for the refill
+	//worker, and how long it is until the device has played something from the new position. the device is free-running,
+	//so that's the seek's own cost, without the wait for a sound card's next period a real output would add. a tick only
+	//goes ahead once every voice has a tick's worth queued, so a slow refill after the seek shows up in it
+	string runSeeks(BenchmarkContext& context, const WavCorpusFile& file, bool mapped, int readAhead){
+		ofLogNotice()<<"benchmark: seek "<<file.name<<(mapped ? " mapped" : " read")<<" readAhead "<<readAhead;
+
+		vector<double> callUS, firstAudioUS;
+		int caseFailures = 0;
+		ofXAudioSoundPlayer player;
+		player.setMemoryMapped(mapped);
+		player.setReadAhead(readAhead);
+		player.setLoop(true);
+		if (!player.preloadSound(file.path, true)){
+			context.failures++;
+			return "{\"file\": " + quote(file.name) + ", \"failures\": 1}";
+		}
+		player.play();
+
+		//the same places every run, all at least a second from the end so the loop doesn't come into it
+		std::mt19937 random(0x5eed);
+		int lastMS = (std::max)((int)(file.getSeconds() * 1000) - 1000, 1);
+		for (int i = 0; i < numSeeks * context.repeats; i++){
+			int ms = std::uniform_int_distribution<int>(0, lastMS)(random);
+
+			INT64 start = ofXAudioNowNanos();
+			player.setPositionMS(ms);
+			INT64 returned = ofXAudioNowNanos();
+
+			//the call only queues the seek; the playhead reads as the new position until the worker has the buffers from there
+			//queued and the voice started, and moves on past it from then. the first tick the device starts after that
+			//plays from there; the tick under way then may have started before
+			const ofXAudioPlayhead& playhead = player.getPlayhead();
+			UINT64 target = (UINT64)ms * playhead.getSampleRate() / 1000;
+			NullWaveDevice* device = context.engine->getNullDevice();
+			bool queued = false, played = false;
+			UINT64 ticks = 0;
+			while (!played && ofXAudioNowNanos() - returned < (INT64)2000000000LL){
+				if (!queued && playhead.getFrame() > target){
+					queued = true;
+					ticks = device->getTickCount();
+				}
+				played = queued && device->getTickCount() >= ticks + 2;
+				if (!played){
+					std::this_thread::yield();
+				}
+			}
+			if (!played){
+				ofLogError()<<"benchmark: seek to "<<ms<<"ms in "<<file.name<<" never played";
+				caseFailures++;
+				continue;
+			}
+			callUS.push_back((returned - start) / 1e3);
+			firstAudioUS.push_back((ofXAudioNowNanos() - start) / 1e3);
+		}
+		player.unloadSound();
+		context.failures += caseFailures;
+
+		std::ostringstream json;
+		json.precision(10);
+		json<<"{\"file\": "<<quote(file.name)<<", \"mode\": "<<quote(mapped ? "mapped" : "read")<<", \"readAhead\": "<<readAhead
+			<<",\n \"callUS\": "<<percentilesJson(callUS)
+			<<",\n \"firstAudioUS\": "<<percentilesJson(firstAudioUS)
+			<<", \"failures\": "<<caseFailures<<"}";
+		return json.str();
+	}
+
+}
+
+//--------------------------------------------------------------
+string runSeekSuite(BenchmarkContext& context){
+	std::ostringstream json;
+	json<<"[";
+	bool first = true;
+	const WavCorpusFile* files[] = { context.corpus->findFile("pcm", 44100, 2, 16), context.corpus->findFile("extensible", 48000, 2, 24) };
+	for (int f = 0; f < 2; f++){
+		if (files[f] == NULL){
+			continue;
+		}
+		for (int mapped = 0; mapped < 2; mapped++){
+			for (int readAhead = 0; readAhead <= 4; readAhead += 4){
+				json<<(first ? "\n" : ",\n")<<runSeeks(context, *files[f], mapped != 0, readAhead);
+				first = false;
+			}
+		}
+	}
+	json<<"\n]";
+	return json.str();
+}
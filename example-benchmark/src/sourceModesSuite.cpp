@@ -0,0 +1,88 @@
+#include "suites.h"
+#include "benchmarkUtils.h"
+
+#include <fstream>
+
+namespace {
+
+	enum SourceMode {
+		SOURCE_UNBUFFERED = 0,
+		SOURCE_BUFFERED = 1,
+		SOURCE_MAPPED = 2,
+	};
+	const char* modeNames[] = { "unbuffered", "buffered", "mapped" };
+
+	//reads the whole file through the system cache, so the buffered and mapped runs find it there, as they would a loop
+	//that's played often
+	void warmCache(const string& path){
+		std::ifstream in(path.c_str(), std::ios::binary);
+		vector<char> block(1 << 20);
+		while (in.read(&block[0], block.size()) || in.gcount() > 0){
+		}
+	}
+
+	string runMode(BenchmarkContext& context, const WavCorpusFile& file, SourceMode mode, int numStreams){
+		ofLogNotice()<<"benchmark: sourceModes "<<modeNames[mode]<<" x"<<numStreams;
+
+		vector<double> cpuMS, wallSeconds;
+		int caseFailures = 0;
+		for (int r = 0; r < context.repeats; r++){
+			warmCache(file.path);
+			vector<ofXAudioSoundPlayer*> players(numStreams);
+			for (int i = 0; i < numStreams; i++){
+				players[i] = new ofXAudioSoundPlayer();
+				players[i]->setMemoryMapped(mode == SOURCE_MAPPED);
+				players[i]->setSystemCached(mode == SOURCE_BUFFERED);
+				if (!players[i]->preloadSound(file.path, true)){
+					caseFailures++;
+				}
+			}
+
+			//every thread's cpu time, the refill workers' and the device's, while the streams play to the end
+			double cpuBefore = getProcessCPUSeconds();
+			INT64 start = ofXAudioNowNanos();
+			caseFailures += playToEnd(context.engine, players);
+			wallSeconds.push_back((ofXAudioNowNanos() - start) / 1e9);
+			cpuMS.push_back((getProcessCPUSeconds() - cpuBefore) * 1000 / (file.getSeconds() * numStreams));
+
+			for (int i = 0; i < numStreams; i++){
+				ofXAudioMetrics::Snapshot s;
+				players[i]->getMetrics(&s);
+				caseFailures += (int)s.failures;
+				players[i]->unloadSound();
+				delete players[i];
+			}
+		}
+		context.failures += caseFailures;
+
+		double wall = median(wallSeconds);
+		std::ostringstream json;
+		json.precision(10);
+		json<<"{\"file\": "<<quote(file.name)<<", \"mode\": "<<quote(modeNames[mode])<<", \"streams\": "<<numStreams
+			<<", \"cpuMSPerAudioSecond\": "<<median(cpuMS)<<", \"wallSeconds\": "<<wall
+			<<", \"realtimeFactor\": "<<(wall > 0 ? file.getSeconds() * numStreams / wall : 0)<<", \"failures\": "<<caseFailures<<"}";
+		return json.str();
+	}
+
+}
+
+//--------------------------------------------------------------
+string runSourceModesSuite(BenchmarkContext& context){
+	const WavCorpusFile* file = context.corpus->findFile("extensible", 48000, 2, 24);
+	if (file == NULL){
+		ofLogError()<<"benchmark: the corpus has no 48kHz stereo 24 bit file for the sourceModes suite";
+		context.failures++;
+		return "[]";
+	}
+
+	std::ostringstream json;
+	json<<"[";
+	const int streamCounts[] = { 1, context.concurrentStreams };
+	for (int s = 0; s < 2; s++){
+		for (int mode = SOURCE_UNBUFFERED; mode <= SOURCE_MAPPED; mode++){
+			json<<(s == 0 && mode == 0 ? "\n" : ",\n")<<runMode(context, *file, (SourceMode)mode, streamCounts[s]);
+		}
+	}
+	json<<"\n]";
+	return json.str();
+}
@@ -0,0 +1,50 @@
+#pragma once
+#include "ofMain.h"
+
+#include "ofXAudioSoundPlayer.h"
+#include "wavCorpus.h"
+
+//what every suite runs with. each suite returns the json value for its section of the results, and adds to failures
+//anything that went wrong while it ran
+struct BenchmarkContext {
+	ofXAudioEngine* engine;
+	WavCorpus* corpus;
+	int repeats;
+	int concurrentStreams;
+	int failures;
+};
+
+//"convert": the samples per second each conversion kernel turns into float, for every sample type, against the plain version
+string runConvertSuite(BenchmarkContext& context);
+//"players": loading and playing 1, 16, 128 and 512 players at once, streamed and from memory, with what each player
+//costs to load and in cpu per second of audio; the one shared engine should keep that flat as the count grows
+string runPlayersSuite(BenchmarkContext& context);
+//"readAhead": one stream and several streaming a file to the end with 0 (a synchronous read per buffer), 1, 2, 4 and 8 reads
+//in flight, with the MB/s each sustains and the percentiles of the time to get a buffer ready
+string runReadAheadSuite(BenchmarkContext& context);
+//"sourceModes": a file in the system cache streamed with unbuffered reads, buffered reads through the cache, and from a
+//memory mapping, with the cpu time each takes per second of audio
+string runSourceModesSuite(BenchmarkContext& context);
+//"seek": a playing stream sought to random places, with the time setPositionMS() takes and the time to the first audio
+//from the new position, read and mapped, with and without read-ahead
+string runSeekSuite(BenchmarkContext& context);
+//"open": the time to parse a wave's header, and to load a stream of it ready to play, for the same format with a plain
+//header, an extensible one, and a broadcast wave's hundreds of kilobytes of metadata ahead of the samples
+string runOpenSuite(BenchmarkContext& context);
+//"playhead": 0, 1, 2, 4 and 8 threads reading the playheads of streams playing flat out, with the cost of a read, the reads a
+//second, and how fast the device gets on with them reading
+string runPlayheadSuite(BenchmarkContext& context);
+//"multiPlay": 1, 8 and 32 overlapping plays of a file, as retriggers of one multi-play player sharing the blocks it reads
+//and as separate players, with the memory they take and the bytes read from disk
+string runMultiPlaySuite(BenchmarkContext& context);
+//"resample": the resampler's cpu per second of output for each quality tier and channel count, from 44.1 and 96kHz to
+//48kHz, and so how many voices of each one core could keep resampled
+string runResampleSuite(BenchmarkContext& context);
+//"mix": voices mixed per millisecond of cpu at 128 frame blocks, by the mixer alone and by the null device's whole tick
+string runMixSuite(BenchmarkContext& context);
+//"flac": how many times realtime the FLAC decoder runs on one core and on every hardware thread, for each FLAC file in
+//the corpus, with how much smaller than pcm the files are
+string runFlacSuite(BenchmarkContext& context);
+//"metrics": what the per buffer metrics cost, timed on their own, set against the whole cpu cost of a buffer streamed at
+//a few buffer sizes, as a percentage
+string runMetricsSuite(BenchmarkContext& context);
@@ -0,0 +1,336 @@
+#include "wavCorpus.h"
+#include "flacEncoder.h"
+
+#include <cmath>
+#include <cstdio>
+#include <fstream>
+
+namespace {
+
+	const DWORD WAVE_FORMAT_PCM_TAG = 1;
+	const DWORD WAVE_FORMAT_IEEE_FLOAT_TAG = 3;
+	const DWORD WAVE_FORMAT_EXTENSIBLE_TAG = 0xfffe;
+
+	void putId(vector<BYTE>& b, const char* id){
+		b.insert(b.end(), id, id + 4);
+	}
+
+	void put16(vector<BYTE>& b, DWORD v){
+		b.push_back((BYTE)v);
+		b.push_back((BYTE)(v >> 8));
+	}
+
+	void put32(vector<BYTE>& b, DWORD v){
+		put16(b, v & 0xffff);
+		put16(b, v >> 16);
+	}
+
+	void put64(vector<BYTE>& b, UINT64 v){
+		put32(b, (DWORD)v);
+		put32(b, (DWORD)(v >> 32));
+	}
+
+	//a chunk of arbitrary bytes, padded to a WORD like the spec asks
+	void putChunk(vector<BYTE>& b, const char* id, const string& contents){
+		putId(b, id);
+		put32(b, (DWORD)contents.size());
+		b.insert(b.end(), contents.begin(), contents.end());
+		if (contents.size() & 1){
+			b.push_back(0);
+		}
+	}
+
+	void putFormat(vector<BYTE>& b, const WavCorpusFile& f, bool extensible){
+		DWORD blockAlign = f.channels * (f.bitsPerSample / 8);
+		putId(b, "fmt ");
+		put32(b, extensible ? 40 : (f.isFloat ? 18 : 16));
+		put16(b, extensible ? WAVE_FORMAT_EXTENSIBLE_TAG : (f.isFloat ? WAVE_FORMAT_IEEE_FLOAT_TAG : WAVE_FORMAT_PCM_TAG));
+		put16(b, f.channels);
+		put32(b, f.sampleRate);
+		put32(b, f.sampleRate * blockAlign);
+		put16(b, blockAlign);
+		put16(b, f.bitsPerSample);
+		if (extensible){
+			//valid bits, the speakers (mono, stereo, or 5.1 for anything wider), then the subformat guid
+			static const BYTE guidTail[14] = { 0x00, 0x00, 0x00, 0x00, 0x10, 0x00, 0x80, 0x00, 0x00, 0xaa, 0x00, 0x38, 0x9b, 0x71 };
+			put16(b, 22);
+			put16(b, f.bitsPerSample);
+			put32(b, f.channels == 1 ? 0x4 : (f.channels == 2 ? 0x3 : 0x3f));
+			put16(b, f.isFloat ? WAVE_FORMAT_IEEE_FLOAT_TAG : WAVE_FORMAT_PCM_TAG);
+			b.insert(b.end(), guidTail, guidTail + sizeof(guidTail));
+		} else if (f.isFloat){
+			put16(b, 0);
+		}
+	}
+
+	//text of about this many bytes, for metadata chunks: the same every time, and not all one byte
+	string filler(const string& line, size_t bytes){
+		string text;
+		while (text.size() < bytes){
+			text += line + ofToString(text.size()) + "\n";
+		}
+		text.resize(bytes);
+		return text;
+	}
+
+	//what a broadcast recorder or an editor puts ahead of the samples: a bext chunk with a long coding history, iXML and axml
+	//documents, XMP, an INFO list and padding, tens of kilobytes in all, with markers after the samples
+	void putBroadcastChunks(vector<BYTE>& b, vector<BYTE>& trailer){
+		//description, originator, reference, date, time, time reference, version, umid, loudness, reserved, then the history
+		string bext = filler("ofxXAudioSoundPlayer benchmark take ", 256) + filler("originator ", 32) + filler("reference ", 32)
+			+ "2024-01-01" + "12:00:00" + string(8, '\0') + string("\x02\0", 2) + string(64, '\0') + string(10, '\0') + string(180, '\0');
+		bext += filler("A=PCM,F=48000,W=24,M=stereo,T=ofxXAudioSoundPlayer;", 4096);
+		putChunk(b, "bext", bext);
+		putChunk(b, "JUNK", string(4000, '\0'));
+		putChunk(b, "iXML", "<?xml version=\"1.0\"?>\n<BWFXML>\n" + filler("<TRACK><NAME>track</NAME></TRACK>", 48 * 1024) + "</BWFXML>\n");
+		putChunk(b, "axml", filler("<ebucore:part partId=\"p\"/>", 128 * 1024 + 1));
+		putChunk(b, "_PMX", filler("<rdf:Description rdf:about=\"\"/>", 32 * 1024));
+		putChunk(b, "LIST", string("INFO") + "ISFT" + string("\x14\0\0\0", 4) + "ofxXAudioSoundPlayer" + "ICMT" + string("\0\x10\0\0", 4)
+			+ filler("comment ", 4096));
+		putChunk(trailer, "LIST", string("adtl") + filler("labl", 2048));
+	}
+
+	//everything before the samples, and anything after them
+	void buildHeader(const WavCorpusFile& f, vector<BYTE>& header, vector<BYTE>& trailer){
+		UINT64 dataBytes = f.getDataBytes();
+		UINT64 padding = dataBytes & 1;
+		header.clear();
+		trailer.clear();
+
+		vector<BYTE> body;
+		if (f.layout == "chunks"){
+			putChunk(body, "JUNK", string(27, '\0'));
+			putFormat(body, f, false);
+			putChunk(body, "LIST", string("INFO") + "ISFT" + string("\x14\0\0\0", 4) + "ofxXAudioSoundPlayer");
+			putChunk(trailer, "id3 ", string(11, '\0'));
+		} else if (f.layout == "broadcast"){
+			putBroadcastChunks(body, trailer);
+			putFormat(body, f, false);
+		} else {
+			putFormat(body, f, f.layout != "pcm");
+		}
+		if (f.isFloat && f.layout != "extensible" && f.layout != "rf64"){
+			putId(body, "fact");
+			put32(body, 4);
+			put32(body, (DWORD)f.frames);
+		}
+
+		UINT64 riffBytes = 4 + body.size() + 8 + dataBytes + padding + trailer.size();
+		if (f.layout == "rf64"){
+			//the RIFF and data sizes are in the ds64 chunk that has to come first
+			riffBytes += 8 + 28;
+			putId(header, "RF64");
+			put32(header, 0xffffffff);
+			putId(header, "WAVE");
+			putId(header, "ds64");
+			put32(header, 28);
+			put64(header, riffBytes);
+			put64(header, dataBytes);
+			put64(header, f.frames);
+			put32(header, 0);
+		} else {
+			putId(header, "RIFF");
+			put32(header, (DWORD)riffBytes);
+			putId(header, "WAVE");
+		}
+		header.insert(header.end(), body.begin(), body.end());
+		putId(header, "data");
+		put32(header, f.layout == "rf64" ? 0xffffffff : (DWORD)dataBytes);
+		if (padding){
+			trailer.insert(trailer.begin(), (BYTE)0);
+		}
+	}
+
+}
+
+UINT64 WavCorpusFile::getDataBytes() const{
+	return frames * channels * (bitsPerSample / 8);
+}
+
+double WavCorpusFile::getSeconds() const{
+	return (double)frames / sampleRate;
+}
+
+WavCorpus::WavCorpus(){
+}
+
+void WavCorpus::setup(const string& _dir, double largeGB){
+	dir = _dir;
+	files.clear();
+
+	//the common formats, each header layout, and the short and long ends of what gets streamed
+	add("pcm", 44100, 2, 16, false, 60);
+	add("pcm", 44100, 2, 16, false, 1);
+	add("pcm", 22050, 1, 8, false, 60);
+	add("pcm", 48000, 2, 32, true, 60);
+	add("pcm", 48000, 2, 24, false, 300);
+	add("extensible", 48000, 2, 24, false, 60);
+	add("extensible", 96000, 2, 24, false, 30);
+	add("extensible", 48000, 6, 24, false, 30);
+	add("chunks", 44100, 1, 16, false, 60);
+	add("chunks", 48000, 6, 16, false, 30);
+	add("rf64", 96000, 2, 32, true, 30);
+	add("broadcast", 48000, 2, 24, false, 60);
+	add("flac", 44100, 2, 16, false, 60);
+	add("flac", 48000, 2, 24, false, 60);
+	add("flac", 96000, 2, 24, false, 30);
+	add("flac", 48000, 6, 24, false, 30);
+
+	if (largeGB > 0){
+		//48kHz stereo 24 bit is 288000 bytes a second
+		add("rf64", 48000, 2, 24, false, largeGB * 1024 * 1024 * 1024 / 288000);
+	}
+}
+
+void WavCorpus::add(const string& layout, int sampleRate, int channels, int bitsPerSample, bool isFloat, double seconds){
+	WavCorpusFile f;
+	f.layout = layout;
+	f.sampleRate = sampleRate;
+	f.channels = channels;
+	f.bitsPerSample = bitsPerSample;
+	f.isFloat = isFloat;
+	f.frames = (UINT64)(seconds * sampleRate);
+	f.name = layout + "_" + ofToString(sampleRate) + "_" + ofToString(channels) + "ch_" + ofToString(bitsPerSample) + (isFloat ? "f" : "") + "_" + ofToString((UINT64)seconds) + "s";
+	f.path = ofFilePath::join(dir, f.name + (layout == "flac" ? ".flac" : ".wav"));
+	files.push_back(f);
+}
+
+bool WavCorpus::generate(){
+	ofDirectory::createDirectory(dir, false, true);
+
+	for (size_t i = 0; i < files.size(); i++){
+		//a FLAC file's size isn't known until it's encoded, but it's only there once it's whole
+		std::ifstream existing(files[i].path.c_str(), std::ios::binary | std::ios::ate);
+		if (existing.is_open() && (files[i].layout == "flac" || (UINT64)existing.tellg() == getFileBytes(files[i]))){
+			continue;
+		}
+		existing.close();
+
+		ofLogNotice()<<"WavCorpus: writing "<<files[i].path;
+		if (!write(files[i])){
+			ofLogError()<<"WavCorpus: couldn't write "<<files[i].path;
+			return false;
+		}
+	}
+	return true;
+}
+
+const vector<WavCorpusFile>& WavCorpus::getFiles(){
+	return files;
+}
+
+const WavCorpusFile* WavCorpus::findFile(const string& layout, int sampleRate, int channels, int bitsPerSample, bool isFloat){
+	for (size_t i = 0; i < files.size(); i++){
+		const WavCorpusFile& f = files[i];
+		if (f.layout == layout && f.sampleRate == sampleRate && f.channels == channels && f.bitsPerSample == bitsPerSample && f.isFloat == isFloat){
+			return &f;
+		}
+	}
+	return NULL;
+}
+
+UINT64 WavCorpus::getFileBytes(const WavCorpusFile& file){
+	if (file.layout == "flac"){
+		std::ifstream written(file.path.c_str(), std::ios::binary | std::ios::ate);
+		return written.is_open() ? (UINT64)written.tellg() : 0;
+	}
+	vector<BYTE> header, trailer;
+	buildHeader(file, header, trailer);
+	return header.size() + file.getDataBytes() + trailer.size();
+}
+
+bool WavCorpus::write(const WavCorpusFile& file){
+	if (file.layout == "flac"){
+		return writeFlac(file);
+	}
+
+	FILE* out = fopen(file.path.c_str(), "wb");
+	if (out == NULL){
+		return false;
+	}
+
+	vector<BYTE> header, trailer;
+	buildHeader(file, header, trailer);
+	bool ok = fwrite(&header[0], 1, header.size(), out) == header.size();
+
+	//noise from a xorshift generator seeded with the file's format: the same bytes every time, and nothing a
+	//reader could get for free from runs of zeroes. written a block at a time, so the big files don't need the memory
+	vector<BYTE> block(1 << 20);
+	DWORD state = 0x9e3779b9u ^ (file.sampleRate * 2654435761u) ^ (file.channels << 24) ^ file.bitsPerSample;
+	UINT64 remaining = file.getDataBytes();
+	while (ok && remaining > 0){
+		size_t bytes = (size_t)(std::min)((UINT64)block.size(), remaining);
+		for (size_t i = 0; i < bytes; i += 4){
+			state ^= state << 13;
+			state ^= state >> 17;
+			state ^= state << 5;
+			memcpy(&block[i], &state, (std::min)((size_t)4, bytes - i));
+		}
+		if (file.isFloat){
+			//keep float samples finite and within [-1, 1]
+			for (size_t i = 0; i + 4 <= bytes; i += 4){
+				float s = (INT32)(block[i] | (block[i + 1] << 8) | (block[i + 2] << 16) | ((DWORD)block[i + 3] << 24)) / 2147483648.0f;
+				memcpy(&block[i], &s, 4);
+			}
+		}
+		ok = fwrite(&block[0], 1, bytes, out) == bytes;
+		remaining -= bytes;
+	}
+
+	if (ok && !trailer.empty()){
+		ok = fwrite(&trailer[0], 1, trailer.size(), out) == trailer.size();
+	}
+	ok = fclose(out) == 0 && ok;
+	return ok;
+}
+
+void WavCorpus::getFlacSamples(const WavCorpusFile& file, UINT64 frame, INT32* samples, size_t frames){
+	//each channel a chord shared with the others, a tone of its own and a little noise, swelling and fading over a few
+	//seconds: predictable enough for the encoder to find, but not so much that the residual is nothing
+	const double pi = 3.14159265358979323846;
+	const double chord[] = { 110, 138.59, 164.81, 220 };
+	double fullScale = (1 << (file.bitsPerSample - 1)) - 1;
+	for (size_t i = 0; i < frames; i++){
+		UINT64 n = frame + i;
+		double t = (double)n / file.sampleRate;
+		double swell = 0.6 + 0.4 * sin(2 * pi * 0.25 * t);
+		double shared = 0;
+		for (int k = 0; k < 4; k++){
+			shared += sin(2 * pi * chord[k] * t + k) / 4;
+		}
+		for (int c = 0; c < file.channels; c++){
+			//noise from a hash of the sample's place, so any stretch can be made on its own
+			DWORD h = (DWORD)(n * 2654435761u) ^ (DWORD)(c * 0x9e3779b9u) ^ (DWORD)(n >> 32);
+			h ^= h >> 15;
+			h *= 0x2c1b3c6du;
+			h ^= h >> 12;
+			double noise = ((h & 0xffff) / 32768.0 - 1) * 0.001;
+			double own = sin(2 * pi * 330 * (c + 1) * t) * 0.2;
+			double v = swell * (0.5 * shared + own) * 0.7 + noise;
+			samples[i * file.channels + c] = (INT32)floor(v * fullScale + 0.5);
+		}
+	}
+}
+
+bool WavCorpus::writeFlac(const WavCorpusFile& file){
+	//written under another name and renamed once it's whole, so generate() can take one that's there as finished
+	string partial = file.path + ".part";
+	FlacEncoder encoder;
+	bool ok = encoder.open(partial, file.sampleRate, file.channels, file.bitsPerSample, file.frames);
+	vector<INT32> block((size_t)FlacEncoder::blockSize * 16 * file.channels);
+	for (UINT64 frame = 0; ok && frame < file.frames; ){
+		size_t frames = (size_t)(std::min)((UINT64)block.size() / file.channels, file.frames - frame);
+		getFlacSamples(file, frame, &block[0], frames);
+		ok = encoder.write(&block[0], frames);
+		frame += frames;
+	}
+	ok = encoder.close() && ok;
+	if (ok){
+		remove(file.path.c_str());
+		ok = rename(partial.c_str(), file.path.c_str()) == 0;
+	}
+	if (!ok){
+		remove(partial.c_str());
+	}
+	return ok;
+}
@@ -0,0 +1,59 @@
+#pragma once
+#include "ofMain.h"
+
+#include "waveTypes.h"
+
+//one synthetic wave file of the benchmark corpus. the layout is how its header is put together:
+//"pcm", a plain 16 byte format chunk (18 bytes and a fact chunk for float);
+//"extensible", a WAVEFORMATEXTENSIBLE format chunk;
+//"chunks", a plain format with odd-sized JUNK, LIST and trailing chunks around it that have to be skipped;
+//"rf64", an RF64 header whose sizes come from its ds64 chunk, the only way past 4GB;
+//"broadcast", a plain format behind the heavy metadata of a broadcast wave: bext, iXML, axml, XMP, INFO and JUNK chunks
+//over 200KB ahead of the samples, and markers after them;
+//"flac", not a wave at all but a FLAC file, of tones rather than noise so it compresses about as music does
+struct WavCorpusFile {
+	string name;
+	string layout;
+	int sampleRate;
+	int channels;
+	int bitsPerSample;
+	bool isFloat;
+	UINT64 frames;
+	string path;
+
+	//the samples' size as pcm, which for a FLAC file is what it decodes to
+	UINT64 getDataBytes() const;
+	double getSeconds() const;
+};
+
+//a fixed set of wave files covering the rates, channel counts, sample formats, header layouts and sizes the addon streams,
+//and FLAC files for the decoder, written once into a directory and reused. the samples come from a seeded generator, so
+//every run benchmarks the same bytes
+class WavCorpus {
+public:
+
+	WavCorpus();
+
+	//the standard set in dir, plus an RF64 file of about largeGB gigabytes if that's more than 0
+	void setup(const string& dir, double largeGB = 0);
+	//writes any files that are missing or the wrong size; returns false if one couldn't be written
+	bool generate();
+	const vector<WavCorpusFile>& getFiles();
+	//the first file with this layout and format, or NULL if the corpus has none
+	const WavCorpusFile* findFile(const string& layout, int sampleRate, int channels, int bitsPerSample, bool isFloat = false);
+
+	//the size of the whole file the layout gives, header and all; for a FLAC file, the size of the one written, or 0
+	static UINT64 getFileBytes(const WavCorpusFile& file);
+	static bool write(const WavCorpusFile& file);
+
+	//the FLAC layout's samples, from frame on, interleaved and right-justified in 32 bits
+	static void getFlacSamples(const WavCorpusFile& file, UINT64 frame, INT32* samples, size_t frames);
+
+protected:
+
+	void add(const string& layout, int sampleRate, int channels, int bitsPerSample, bool isFloat, double seconds);
+	static bool writeFlac(const WavCorpusFile& file);
+
+	string dir;
+	vector<WavCorpusFile> files;
+};
@@ -0,0 +1,211 @@
+#include "tests.h"
+#include "ofXAudioSoundPlayer.h"
+#include "ofXAudioCommandQueue.h"
+
+#include <atomic>
+#include <thread>
+
+namespace {
+
+	//an item whose halves have to agree, so one read while it was half written shows up
+	struct Item {
+		UINT64 sequence;
+		UINT64 check;
+	};
+
+	UINT64 checkFor(UINT64 sequence){
+		return sequence * 0x9e3779b97f4a7c15ULL ^ 0x5bd1e995;
+	}
+
+	//a stream the test can look inside, to see what its worker actually applied to the voice
+	class InspectedStream : public ofXAudioStream {
+	public:
+		//waits until every command sent has been applied; false if that takes too long
+		bool waitForCommands(){
+			for (int i = 0; i < 5000; i++){
+				if (commands.empty() && !commandsPending){
+					//a worker pops and applies under the mutex, so once it's free there's nothing half applied
+					std::lock_guard<std::mutex> lock(mutex);
+					return true;
+				}
+				std::this_thread::sleep_for(std::chrono::milliseconds(1));
+			}
+			return false;
+		}
+
+		//whether the worker has it playing and not paused; unlike isPlaying(), that doesn't depend on the voice being fed
+		bool isRunning(){
+			std::lock_guard<std::mutex> lock(mutex);
+			return playing && !paused;
+		}
+
+		NullWaveVoice* getVoice(){
+			std::lock_guard<std::mutex> lock(mutex);
+			return dynamic_cast<NullWaveVoice*>(voice);
+		}
+	};
+
+}
+
+int testCommandQueue(UINT64 numItems){
+	ofXAudioCommandQueue<Item, 256> queue;
+	int failed = 0;
+
+	std::thread producer([&](){
+		for (UINT64 i = 0; i < numItems; i++){
+			Item item;
+			item.sequence = i;
+			item.check = checkFor(i);
+			while (!queue.push(item)){
+				std::this_thread::yield();
+			}
+		}
+	});
+
+	//the consumer is this thread: every item once, in order, and whole
+	UINT64 expected = 0;
+	while (expected < numItems){
+		Item item;
+		if (!queue.pop(&item)){
+			std::this_thread::yield();
+			continue;
+		}
+		if (item.sequence != expected || item.check != checkFor(item.sequence)){
+			ofLogError()<<"commandQueue: got item "<<item.sequence<<" when expecting "<<expected;
+			failed++;
+			break;
+		}
+		expected++;
+	}
+	producer.join();
+
+	if (!queue.empty()){
+		ofLogError()<<"commandQueue: items left over";
+		failed++;
+	}
+	return failed;
+}
+
+int testStreamControls(const string& dataDir, int numControls){
+	string path = ofFilePath::join(dataDir, "controls.wav");
+	if (!writeTestWave(path, 44100, 2, 2)){
+		ofLogError()<<"streamControls: couldn't write "<<path;
+		return 1;
+	}
+
+	//real time, with small buffers, so the workers refill all the way through and the commands land between refills
+	ofXAudioEngine::setBackend(ofXAudioEngine::OFXAUDIO_BACKEND_NULL, NullWaveDevice::TIMING_REALTIME);
+	ofXAudioEngine* engine = ofXAudioEngine::acquire();
+	if (engine == NULL){
+		ofLogError()<<"streamControls: couldn't create the engine";
+		return 1;
+	}
+
+	int failed = 0;
+	const int numStreams = 4;
+	vector<InspectedStream*> streams;
+	for (int i = 0; i < numStreams; i++){
+		InspectedStream* s = new InspectedStream();
+		s->setBufferSize(4096, 4);
+		s->setLoop(true);
+		if (!s->load(path, engine)){
+			ofLogError()<<"streamControls: couldn't load "<<path;
+			failed++;
+		}
+		s->start();
+		streams.push_back(s);
+	}
+
+	//something reading the playheads all the while, as a render thread would
+	std::atomic<bool> sending(true);
+	std::atomic<int> readerFailures(0);
+	std::thread reader([&](){
+		while (sending){
+			for (int i = 0; i < numStreams; i++){
+				const ofXAudioPlayhead& playhead = streams[i]->getPlayhead();
+				if (playhead.getFrame() > playhead.getLength()){
+					readerFailures++;
+				}
+				playhead.isPlaying();
+			}
+			std::this_thread::yield();
+		}
+	});
+
+	//the controls, round the streams in turn: mostly mix changes, with pauses, restarts and seeks mixed in
+	for (int i = 0; i < numControls; i++){
+		InspectedStream* s = streams[i % numStreams];
+		int step = i / numStreams;
+		switch (step % 8){
+		case 0: case 1: case 2:
+			s->setVolume((step % 1000) / 1000.0f);
+			break;
+		case 3: case 4:
+			s->setPan((step % 200) / 100.0f - 1);
+			break;
+		case 5: case 6:
+			s->setSpeed(0.5f + (step % 150) / 100.0f);
+			break;
+		case 7:
+			if (step % 4000 == 7){
+				s->stop();
+				s->start();
+			} else if (step % 64 == 39){
+				s->setPositionMS(step % 1900);
+			} else {
+				s->setPaused(step % 16 == 15);
+			}
+			break;
+		}
+	}
+
+	//the last word on each: it has to be what the voice ends up with
+	for (int i = 0; i < numStreams; i++){
+		streams[i]->setVolume(0.25f);
+		streams[i]->setPan(-0.5f);
+		streams[i]->setSpeed(1.25f);
+		streams[i]->setPaused(false);
+		streams[i]->start();
+	}
+	for (int i = 0; i < numStreams; i++){
+		if (!streams[i]->waitForCommands()){
+			ofLogError()<<"streamControls: stream "<<i<<" never got through its commands";
+			failed++;
+			continue;
+		}
+		NullWaveVoice* voice = streams[i]->getVoice();
+		if (voice == NULL || voice->getVolume() != 0.25f || voice->getPan() != -0.5f || voice->getFrequencyRatio() != 1.25f){
+			ofLogError()<<"streamControls: stream "<<i<<" didn't end up with the last controls sent";
+			failed++;
+		}
+	}
+
+	//and they all still play
+	vector<UINT64> frames(numStreams);
+	for (int i = 0; i < numStreams; i++){
+		frames[i] = streams[i]->getPlayhead().getFrame();
+	}
+	std::this_thread::sleep_for(std::chrono::milliseconds(200));
+	sending = false;
+	reader.join();
+	if (readerFailures > 0){
+		ofLogError()<<"streamControls: a playhead ran past the end "<<readerFailures<<" times";
+		failed++;
+	}
+	for (int i = 0; i < numStreams; i++){
+		ofXAudioMetrics::Snapshot metrics;
+		streams[i]->getMetrics(&metrics);
+		if (!streams[i]->isRunning() || streams[i]->getPlayhead().getFrame() == frames[i] || metrics.failures > 0){
+			ofLogError()<<"streamControls: stream "<<i<<" stopped playing (frame "<<frames[i]<<" to "<<streams[i]->getPlayhead().getFrame()
+				<<", "<<metrics.failures<<" failed reads)";
+			failed++;
+		}
+	}
+
+	for (int i = 0; i < numStreams; i++){
+		streams[i]->unload();
+		delete streams[i];
+	}
+	ofXAudioEngine::release();
+	return failed;
+}
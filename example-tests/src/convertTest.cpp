@@ -0,0 +1,149 @@
+#include "tests.h"
+#include "waveConvert.h"
+
+#include <random>
+
+namespace {
+
+	const WAVE_SAMPLE_TYPE types[] = { WST_UINT8, WST_INT16, WST_INT24, WST_INT32, WST_FLOAT32, WST_FLOAT64 };
+	const char* typeNames[] = { "unknown", "uint8", "int16", "int24", "int32", "float32", "float64" };
+
+	//a vector kernel with the plain version finishing what it leaves, as waveConvertToFloat() does it
+	typedef size_t (*Kernel)(WAVE_SAMPLE_TYPE type, const BYTE* pSrc, float* pDest, size_t count);
+
+	struct NamedKernel {
+		const char* name;
+		Kernel kernel;
+	};
+
+	//what's written past the end of the output, so a kernel that stores too much shows up
+	const UINT32 guard = 0x7fc0dead;
+	const size_t guardFloats = 16;
+
+	//random samples of the type, with the extremes of its range at the start and end, where the vector loops
+	//hand over to the plain ones. floats stay finite: a nan's payload isn't something the kernels promise to keep
+	void fillSamples(WAVE_SAMPLE_TYPE type, BYTE* p, size_t count, std::mt19937& random){
+		size_t size = waveSampleSize(type);
+		for (size_t i = 0; i < count; i++){
+			BYTE* sample = p + i * size;
+			int extreme = i < 2 ? (int)i : (i + 2 >= count ? (int)(count - i) + 1 : -1);
+			if (type == WST_FLOAT32){
+				float f = extreme == 0 ? -1.0f : extreme == 1 ? 1.0f : extreme == 2 ? 1e-40f : extreme == 3 ? -0.0f
+					: std::uniform_real_distribution<float>(-2, 2)(random);
+				memcpy(sample, &f, sizeof(f));
+			} else if (type == WST_FLOAT64){
+				//doubles that fall between two floats, so the rounding has to agree as well
+				double d = extreme == 0 ? -1.0 : extreme == 1 ? 1.0 : extreme == 2 ? 1e-300 : extreme == 3 ? 1.0 + 1.0 / (1 << 24)
+					: std::uniform_real_distribution<double>(-2, 2)(random);
+				memcpy(sample, &d, sizeof(d));
+			} else if (extreme >= 0){
+				//the lowest value, then the highest; unsigned 8 bit has them the other way up
+				BYTE fill = (extreme & 1) ? 0xff : 0x00;
+				memset(sample, fill, size);
+				if (type != WST_UINT8){
+					sample[size - 1] ^= 0x80;
+				}
+			} else {
+				for (size_t b = 0; b < size; b++){
+					sample[b] = (BYTE)random();
+				}
+			}
+		}
+	}
+
+	//the plain version's output, then each kernel's, compared bit for bit, at every alignment of both buffers
+	int checkType(WAVE_SAMPLE_TYPE type, const vector<NamedKernel>& kernels, const vector<size_t>& lengths, std::mt19937& random){
+		size_t size = waveSampleSize(type);
+		int failed = 0;
+		for (size_t l = 0; l < lengths.size(); l++){
+			size_t count = lengths[l];
+			vector<BYTE> source(count * size + 16);
+			vector<float> expected(count + guardFloats), actual(count + 4 + guardFloats);
+			for (size_t srcOffset = 0; srcOffset < 4; srcOffset++){
+				BYTE* pSrc = &source[srcOffset];
+				fillSamples(type, pSrc, count, random);
+				waveConvertScalar(type, pSrc, expected.data(), 0, count);
+
+				for (size_t k = 0; k < kernels.size(); k++){
+					for (size_t destOffset = 0; destOffset < 2; destOffset++){
+						float* pDest = &actual[destOffset];
+						for (size_t i = 0; i < count + guardFloats; i++){
+							memcpy(&pDest[i], &guard, sizeof(guard));
+						}
+						size_t done = kernels[k].kernel(type, pSrc, pDest, count);
+						if (done > count){
+							ofLogError()<<"convert: "<<kernels[k].name<<" "<<typeNames[type]<<" claimed "<<done<<" of "<<count<<" samples";
+							failed++;
+							continue;
+						}
+						waveConvertScalar(type, pSrc, pDest, done, count);
+
+						size_t mismatch = count;
+						for (size_t i = 0; i < count && mismatch == count; i++){
+							if (memcmp(&pDest[i], &expected[i], sizeof(float)) != 0){
+								mismatch = i;
+							}
+						}
+						bool overran = false;
+						for (size_t i = count; i < count + guardFloats; i++){
+							overran = overran || memcmp(&pDest[i], &guard, sizeof(guard)) != 0;
+						}
+						if (mismatch < count || overran){
+							ofLogError()<<"convert: "<<kernels[k].name<<" "<<typeNames[type]<<" length "<<count<<", source offset "<<srcOffset
+								<<", dest offset "<<destOffset<<": "<<(overran ? "wrote past the end" : "sample " + ofToString(mismatch)
+								+ " is " + ofToString(pDest[mismatch]) + ", not " + ofToString(expected[mismatch]));
+							failed++;
+						}
+					}
+				}
+			}
+		}
+		return failed;
+	}
+
+	size_t convertDispatched(WAVE_SAMPLE_TYPE type, const BYTE* pSrc, float* pDest, size_t count){
+		waveConvertToFloat(type, pSrc, pDest, count);
+		return count;
+	}
+
+}
+
+int testConvert(){
+	vector<NamedKernel> kernels;
+#ifdef WAVECONVERT_SSE2
+	NamedKernel sse2 = { "sse2", waveConvertSSE2 };
+	kernels.push_back(sse2);
+#endif
+#ifdef WAVECONVERT_AVX2
+	if (waveHasAVX2()){
+		NamedKernel avx2 = { "avx2", waveConvertAVX2 };
+		kernels.push_back(avx2);
+	} else {
+		ofLogNotice()<<"convert: no avx2 on this processor, skipping it";
+	}
+#endif
+#ifdef WAVECONVERT_NEON
+	NamedKernel neon = { "neon", waveConvertNEON };
+	kernels.push_back(neon);
+#endif
+	NamedKernel dispatched = { "waveConvertToFloat", convertDispatched };
+	kernels.push_back(dispatched);
+
+	//every length up to a few of the widest vectors, so each kernel's tail is hit at every remainder, then some
+	//odd sizes in the thousands as a stream's buffers are
+	vector<size_t> lengths;
+	for (size_t i = 0; i <= 67; i++){
+		lengths.push_back(i);
+	}
+	lengths.push_back(1021);
+	lengths.push_back(4093);
+	lengths.push_back(4099);
+	lengths.push_back(44101);
+
+	std::mt19937 random(0x5eed);
+	int failed = 0;
+	for (size_t t = 0; t < sizeof(types) / sizeof(types[0]); t++){
+		failed += checkType(types[t], kernels, lengths, random);
+	}
+	return failed;
+}
@@ -0,0 +1,49 @@
+#include "ofApp.h"
+#include "tests.h"
+
+//--------------------------------------------------------------
+ofApp::ofApp(const vector<string>& args)
+	: scale(1)
+	, failures(0)
+{
+	for (size_t i = 0; i + 1 < args.size(); i += 2){
+		if (args[i] == "--only"){
+			only = args[i + 1];
+		} else if (args[i] == "--scale"){
+			scale = (std::max)(ofToDouble(args[i + 1]), 0.001);
+		} else {
+			ofLogWarning()<<"tests: unknown argument "<<args[i];
+		}
+	}
+}
+
+//--------------------------------------------------------------
+void ofApp::setup(){
+	string dataDir = ofToDataPath("", true);
+
+	run("commandQueue", [&](){ return testCommandQueue((UINT64)(4000000 * scale)); });
+	run("streamControls", [&](){ return testStreamControls(dataDir, (int)(4000000 * scale)); });
+	run("convert", [&](){ return testConvert(); });
+
+	if (failures > 0){
+		ofLogError()<<"tests: "<<failures<<" failed";
+	} else {
+		ofLogNotice()<<"tests: all passed";
+	}
+	ofExit(failures > 0 ? 1 : 0);
+}
+
+//--------------------------------------------------------------
+void ofApp::run(const string& name, std::function<int()> test){
+	if (!only.empty() && only != name){
+		return;
+	}
+	ofLogNotice()<<"tests: "<<name;
+	int failed = test();
+	if (failed > 0){
+		ofLogError()<<"tests: "<<name<<" FAILED "<<failed<<" checks";
+		failures++;
+	} else {
+		ofLogNotice()<<"tests: "<<name<<" ok";
+	}
+}
@@ -0,0 +1,23 @@
+#pragma once
+#include "ofMain.h"
+
+//runs the addon's tests and exits with the number that failed. config.make builds it with ThreadSanitizer, which makes
+//the process fail too if it saw a data race; the stress tests are there to give it the chance.
+//arguments:
+//  --only name      runs just this test (all of them)
+//  --scale x        multiplies the number of items and controls the stress tests send (1)
+class ofApp : public ofBaseApp{
+
+	public:
+		ofApp(const vector<string>& args);
+
+		void setup();
+
+	protected:
+		//runs the test if it's selected, logging how it went
+		void run(const string& name, std::function<int()> test);
+
+		string only;
+		double scale;
+		int failures;
+};
@@ -0,0 +1,27 @@
+#include "tests.h"
+
+#include <cstdio>
+
+bool writeTestWave(const string& path, int sampleRate, int channels, double seconds){
+	FILE* out = fopen(path.c_str(), "wb");
+	if (out == NULL){
+		return false;
+	}
+
+	DWORD frames = (DWORD)(seconds * sampleRate);
+	DWORD blockAlign = channels * 2;
+	DWORD dataBytes = frames * blockAlign;
+	DWORD header[11] = { MAKEFOURCC('R', 'I', 'F', 'F'), 36 + dataBytes, MAKEFOURCC('W', 'A', 'V', 'E'), MAKEFOURCC('f', 'm', 't', ' '), 16,
+		1 | ((DWORD)channels << 16), (DWORD)sampleRate, sampleRate * blockAlign, blockAlign | (16 << 16), MAKEFOURCC('d', 'a', 't', 'a'), dataBytes };
+	bool ok = fwrite(header, sizeof(header), 1, out) == 1;
+
+	vector<short> samples(frames * channels);
+	for (DWORD i = 0; i < frames; i++){
+		for (int c = 0; c < channels; c++){
+			samples[i * channels + c] = (short)((i * 7 + c * 1000) % 65536 - 32768);
+		}
+	}
+	ok = ok && fwrite(&samples[0], blockAlign, frames, out) == frames;
+	ok = fclose(out) == 0 && ok;
+	return ok;
+}
@@ -0,0 +1,19 @@
+#pragma once
+#include "ofMain.h"
+
+#include "waveTypes.h"
+
+//each test returns the number of its checks that failed, logging each one
+
+//millions of items through the lock-free command ring, one thread pushing and one popping, checking every item arrives
+//once, in order and whole
+int testCommandQueue(UINT64 numItems);
+//millions of transport and mix controls sent to streams that are playing, while the scheduler's workers apply them
+//and refill the streams, and another thread reads their playheads; then checks the last of them took effect
+int testStreamControls(const string& dataDir, int numControls);
+//every sample type through each vector kernel the processor has, at every length up to a few vectors and at odd
+//alignments, checking the results match the plain c++ version bit for bit and nothing is written past the end
+int testConvert();
+
+//a 16 bit wave of a slow ramp, for tests that need something to stream
+bool writeTestWave(const string& path, int sampleRate, int channels, double seconds);
@@ -10,6 +10,7 @@ void ofApp::setup(){
 	cout << p << endl;
 	test.play();*/
 	player = new ofXAudioSoundPlayer();
+	player->setLoop(true);
 	player->loadSound(ofToDataPath("F:/0280.wav", true), true);
 }
 
@@ -0,0 +1,433 @@
+//nullWaveVoice.h
+//a headless output device: its voices consume submitted buffers against a virtual clock
+//instead of audio hardware, so the refill path can be run and measured without a sound card.
+//with an output set, it also mixes what its voices play, at their volume, pan and speed, and hands on each tick's mix
+
+#ifndef NULLWAVEVOICE_H
+#define NULLWAVEVOICE_H
+
+#include "waveVoice.h"
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <deque>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+class NullWaveDevice;
+
+class NullWaveVoice : public WaveVoice
+{
+	friend class NullWaveDevice;
+
+private:
+	//a submitted buffer, with the byte range of it that is to be played, and the range looped over within that
+	struct QueuedBuffer
+	{
+		XAUDIO2_BUFFER buffer;
+		UINT32 begin;
+		UINT32 end;
+		UINT32 loopBegin;
+		UINT32 loopEnd;
+		UINT32 loopsLeft; //XAUDIO2_LOOP_INFINITE loops until exitLoop()
+
+		//where playback stops, or goes back to loopBegin
+		UINT32 stop() const { return loopsLeft > 0 ? loopEnd : end; }
+	};
+
+	NullWaveDevice* m_pDevice;
+	std::atomic<WaveVoiceCallback*> m_pCallback; //swapped by setCallback() while the device thread may be reading it
+	WAVEFORMATEX m_wf;
+	WAVE_SAMPLE_TYPE m_type; //WST_UNKNOWN if it can't be mixed
+
+	//the mix's working memory: the tick's frames as float, the same taken to the device's rate, and the last frame
+	//of the tick before, which the rate change interpolates from
+	std::vector<float> m_mixInput;
+	std::vector<float> m_mixResampled;
+	std::vector<float> m_mixLast;
+	WaveMixGains m_mixGains; //what the last tick was mixed at, for the next to ramp from
+	bool m_mixed;
+
+	std::mutex m_mutex;
+	std::deque<QueuedBuffer> m_queue;
+	UINT64 m_samplesPlayed;
+	double m_framesOwed; //fractional frames carried over between ticks
+	bool m_running;
+	float m_volume;
+	float m_pan;
+	float m_frequencyRatio; //scales how fast the queue is consumed, as a resampling voice would
+	float m_maxFrequencyRatio;
+	bool m_streamEnded; //the last buffer consumed carried XAUDIO2_END_OF_STREAM, so running dry isn't an underrun
+	bool m_starved; //whether the previous tick ran dry
+	UINT32 m_underruns;
+	UINT64 m_starvedFrames;
+
+	NullWaveVoice( NullWaveDevice* pDevice, const WAVEFORMATEX* wf, WaveVoiceCallback* pCallback, float maxFrequencyRatio ) : m_pDevice(pDevice), m_pCallback(pCallback),
+		m_mixed(false), m_samplesPlayed(0), m_framesOwed(0), m_running(false), m_volume(1), m_pan(0), m_frequencyRatio(1), m_maxFrequencyRatio(maxFrequencyRatio), m_streamEnded(false), m_starved(false), m_underruns(0), m_starvedFrames(0) {
+			m_type = waveSampleType( wf );
+			m_wf = *wf;
+			m_wf.cbSize = 0;
+			m_mixLast.assign( m_wf.nChannels, 0.0f );
+	}
+
+	//whether the frames due in the next tick of the given length are queued, or the stream ends within them;
+	//a running voice with nothing queued is never ready, since there's no telling if more is on the way
+	bool isReady( double seconds ) {
+		std::lock_guard<std::mutex> lock( m_mutex );
+		if( !m_running )
+			return true;
+
+		UINT64 bytesNeeded = (UINT64)( m_framesOwed + seconds * m_wf.nSamplesPerSec * m_frequencyRatio ) * m_wf.nBlockAlign;
+		UINT64 bytesQueued = 0;
+		for( size_t i = 0; i < m_queue.size(); i++ )
+		{
+			if( m_queue[i].loopsLeft == XAUDIO2_LOOP_INFINITE )
+				return true;
+			bytesQueued += m_queue[i].end - m_queue[i].begin + (UINT64)( m_queue[i].loopEnd - m_queue[i].loopBegin ) * m_queue[i].loopsLeft;
+			if( bytesQueued >= bytesNeeded || ( m_queue[i].buffer.Flags & XAUDIO2_END_OF_STREAM ) )
+				return true;
+		}
+		return !m_queue.empty() && bytesQueued >= bytesNeeded;
+	}
+
+	//consumes the frames due for a tick of the given length, mixing them into pMixer if there is one,
+	//collecting the contexts of the buffers that finished so the callbacks can be made outside the lock
+	void advance( double seconds, std::vector<void*>& ended, WaveMixer* pMixer = NULL ) {
+		std::lock_guard<std::mutex> lock( m_mutex );
+		if( !m_running )
+			return;
+
+		double frames = m_framesOwed + seconds * m_wf.nSamplesPerSec * m_frequencyRatio;
+		UINT64 wholeFrames = (UINT64)frames;
+		m_framesOwed = frames - wholeFrames;
+
+		//the frames consumed are gathered as float for the mix, with silence for any the queue is short of
+		bool mixing = pMixer != NULL && m_type != WST_UNKNOWN;
+		if( mixing )
+			m_mixInput.assign( (size_t)wholeFrames * m_wf.nChannels, 0.0f );
+		DWORD sampleSize = mixing ? waveSampleSize( m_type ) : 1;
+
+		UINT64 bytesWanted = wholeFrames * m_wf.nBlockAlign;
+		while( !m_queue.empty() && ( bytesWanted > 0 || m_queue.front().begin == m_queue.front().stop() ) )
+		{
+			QueuedBuffer& head = m_queue.front();
+			UINT32 take = (UINT32)(std::min)( (UINT64)( head.stop() - head.begin ), bytesWanted );
+			if( mixing && take > 0 )
+			{
+				size_t done = (size_t)( wholeFrames * m_wf.nBlockAlign - bytesWanted ) / sampleSize;
+				waveConvertToFloat( m_type, head.buffer.pAudioData + head.begin, &m_mixInput[ done ], take / sampleSize );
+			}
+			head.begin += take;
+			bytesWanted -= take;
+			m_samplesPlayed += take / m_wf.nBlockAlign;
+
+			if( head.loopsLeft > 0 && head.begin == head.loopEnd )
+			{
+				head.begin = head.loopBegin;
+				if( head.loopsLeft != XAUDIO2_LOOP_INFINITE )
+					head.loopsLeft--;
+			}
+			else if( head.begin == head.end )
+			{
+				m_streamEnded = ( head.buffer.Flags & XAUDIO2_END_OF_STREAM ) != 0;
+				ended.push_back( head.buffer.pContext );
+				m_queue.pop_front();
+			}
+		}
+
+		if( bytesWanted > 0 && !m_streamEnded )
+		{
+			if( !m_starved )
+				m_underruns++;
+			m_starved = true;
+			m_starvedFrames += bytesWanted / m_wf.nBlockAlign;
+		}
+		else
+		{
+			m_starved = false;
+		}
+
+		if( mixing )
+			mix( pMixer );
+	}
+
+	//mixes the frames gathered for this tick, taking them to the mixer's block length (its rate) by interpolating
+	//between them, and ramping from the last tick's gains to the current ones; call with the mutex held
+	void mix( WaveMixer* pMixer ) {
+		DWORD channels = m_wf.nChannels;
+		size_t inFrames = m_mixInput.size() / channels;
+		DWORD outFrames = pMixer->getFrames();
+		const float* pIn = m_mixInput.empty() ? NULL : &m_mixInput[0];
+		if( inFrames != outFrames )
+		{
+			//output frame j falls ( j + 1 ) * inFrames / outFrames - 1 frames in, the last tick's last frame being -1
+			m_mixResampled.resize( (size_t)outFrames * channels );
+			double step = (double)inFrames / outFrames;
+			for( DWORD j = 0; j < outFrames; j++ )
+			{
+				double t = ( j + 1 ) * step - 1;
+				long i = (long)std::floor( t );
+				float f = (float)( t - i );
+				for( DWORD c = 0; c < channels; c++ )
+				{
+					float a = i < 0 ? m_mixLast[c] : m_mixInput[ (size_t)i * channels + c ];
+					float b = i + 1 < 0 ? m_mixLast[c] : ( (size_t)( i + 1 ) < inFrames ? m_mixInput[ (size_t)( i + 1 ) * channels + c ] : a );
+					m_mixResampled[ (size_t)j * channels + c ] = a + f * ( b - a );
+				}
+			}
+			pIn = &m_mixResampled[0];
+		}
+		if( inFrames > 0 )
+			memcpy( &m_mixLast[0], &m_mixInput[ ( inFrames - 1 ) * channels ], channels * sizeof(float) );
+
+		WaveMixGains gains = waveMixGains( m_volume, m_pan, channels );
+		if( pIn != NULL )
+			pMixer->mix( pIn, channels, m_mixed ? m_mixGains : gains, gains );
+		m_mixGains = gains;
+		m_mixed = true;
+	}
+
+public:
+	bool submit( const XAUDIO2_BUFFER* pBuffer );
+
+	void getState( XAUDIO2_VOICE_STATE* pState ) {
+		std::lock_guard<std::mutex> lock( m_mutex );
+		pState->pCurrentBufferContext = m_queue.empty() ? NULL : m_queue.front().buffer.pContext;
+		pState->BuffersQueued = (UINT32)m_queue.size();
+		pState->SamplesPlayed = m_samplesPlayed;
+	}
+
+	void start();
+
+	void stop() {
+		std::lock_guard<std::mutex> lock( m_mutex );
+		m_running = false;
+	}
+
+	void flush() {
+		std::vector<void*> ended;
+		{
+			std::lock_guard<std::mutex> lock( m_mutex );
+			for( size_t i = 0; i < m_queue.size(); i++ )
+				ended.push_back( m_queue[i].buffer.pContext );
+			m_queue.clear();
+		}
+		WaveVoiceCallback* pCallback = m_pCallback;
+		if( pCallback != NULL )
+		{
+			for( size_t i = 0; i < ended.size(); i++ )
+				pCallback->OnBufferEnd( ended[i] );
+		}
+	}
+
+	void exitLoop() {
+		std::lock_guard<std::mutex> lock( m_mutex );
+		if( !m_queue.empty() )
+			m_queue.front().loopsLeft = 0;
+	}
+
+	void setVolume( float volume ) { std::lock_guard<std::mutex> lock( m_mutex ); m_volume = volume; }
+	void setPan( float pan ) { std::lock_guard<std::mutex> lock( m_mutex ); m_pan = (std::max)( -1.0f, (std::min)( pan, 1.0f ) ); }
+	float setFrequencyRatio( float ratio ) {
+		std::lock_guard<std::mutex> lock( m_mutex );
+		m_frequencyRatio = (std::max)( XAUDIO2_MIN_FREQ_RATIO, (std::min)( ratio, m_maxFrequencyRatio ) );
+		return m_frequencyRatio;
+	}
+	void setCallback( WaveVoiceCallback* pCallback ) { m_pCallback = pCallback; }
+	//the settings last applied, since there's no output to hear them in
+	float getVolume() { std::lock_guard<std::mutex> lock( m_mutex ); return m_volume; }
+	float getPan() { std::lock_guard<std::mutex> lock( m_mutex ); return m_pan; }
+	float getFrequencyRatio() { std::lock_guard<std::mutex> lock( m_mutex ); return m_frequencyRatio; }
+
+	//the number of times the queue ran dry while playing (not counting the end of a stream)
+	UINT32 getUnderrunCount() { std::lock_guard<std::mutex> lock( m_mutex ); return m_underruns; }
+	//the total number of frames the device wanted while the queue was dry
+	UINT64 getStarvedFrames() { std::lock_guard<std::mutex> lock( m_mutex ); return m_starvedFrames; }
+	const WAVEFORMATEX* wf() const { return &m_wf; }
+};
+
+//handed each tick's mix by a NullWaveDevice, from the device thread
+class NullWaveOutput
+{
+public:
+	virtual ~NullWaveOutput() {}
+
+	//frames of interleaved float audio with the device's channels, at its sample rate; only valid for the call
+	virtual void OnMix( const float* pBlock, DWORD frames, DWORD channels ) = 0;
+};
+
+class NullWaveDevice
+{
+public:
+	enum TIMING {
+		TIMING_REALTIME = 0, //ticks in step with the wall clock, like a sound card would; voices that run dry count underruns
+		TIMING_FREERUN = 1, //ticks as fast as the voices are fed, waiting on any that are short, so the virtual timeline is the same every run;
+		                    //stop() voices whose streams have ended, or the device will wait on them
+	};
+
+private:
+	TIMING m_timing;
+	double m_tickSeconds;
+	DWORD m_sampleRate;
+	WaveMixer m_mixer; //a tick's worth of frames at the sample rate
+	std::atomic<NullWaveOutput*> m_pOutput;
+
+	std::mutex m_mutex; //guards m_voices, and is held for the duration of a tick
+	std::condition_variable m_wake;
+	std::vector<NullWaveVoice*> m_voices;
+	std::atomic<bool> m_quitting;
+	std::atomic<UINT64> m_ticks;
+	std::thread m_thread;
+
+	bool voicesReady() {
+		bool anyRunning = false;
+		for( size_t i = 0; i < m_voices.size(); i++ )
+		{
+			if( !m_voices[i]->isReady( m_tickSeconds ) )
+				return false;
+			std::lock_guard<std::mutex> lock( m_voices[i]->m_mutex );
+			anyRunning = anyRunning || m_voices[i]->m_running;
+		}
+		return anyRunning;
+	}
+
+	void threadedFunction() {
+		std::chrono::steady_clock::time_point next = std::chrono::steady_clock::now();
+		const std::chrono::steady_clock::duration tick = std::chrono::duration_cast<std::chrono::steady_clock::duration>( std::chrono::duration<double>( m_tickSeconds ) );
+		std::vector<void*> ended;
+
+		while( !m_quitting )
+		{
+			if( m_timing == TIMING_REALTIME )
+			{
+				next += tick;
+				std::this_thread::sleep_until( next );
+
+				//if we fell badly behind (debugger, suspended vm), don't try to catch up in a burst
+				if( std::chrono::steady_clock::now() - next > tick * 10 )
+					next = std::chrono::steady_clock::now();
+			}
+
+			std::unique_lock<std::mutex> lock( m_mutex );
+			if( m_timing == TIMING_FREERUN )
+			{
+				while( !m_quitting && !voicesReady() )
+					m_wake.wait_for( lock, std::chrono::milliseconds( 10 ) );
+				if( m_quitting )
+					break;
+			}
+
+			//the voices are only mixed when there's somewhere for the mix to go
+			NullWaveOutput* pOutput = m_pOutput;
+			if( pOutput != NULL )
+				m_mixer.clear( m_mixer.getMaxFrames() );
+			for( size_t i = 0; i < m_voices.size(); i++ )
+			{
+				NullWaveVoice* v = m_voices[i];
+				ended.clear();
+				v->advance( m_tickSeconds, ended, pOutput != NULL ? &m_mixer : NULL );
+				WaveVoiceCallback* pCallback = v->m_pCallback;
+				if( pCallback != NULL )
+				{
+					for( size_t j = 0; j < ended.size(); j++ )
+						pCallback->OnBufferEnd( ended[j] );
+				}
+			}
+			if( pOutput != NULL )
+				pOutput->OnMix( m_mixer.block(), m_mixer.getFrames(), m_mixer.getChannels() );
+			m_ticks++;
+		}
+	}
+
+public:
+	NullWaveDevice( TIMING timing = TIMING_REALTIME, double tickSeconds = 0.01, DWORD sampleRate = 48000, DWORD channels = 2 ) : m_timing(timing), m_tickSeconds(tickSeconds), m_sampleRate(sampleRate), m_pOutput(NULL), m_quitting(false), m_ticks(0) {
+		m_mixer.setup( channels, (std::max)( (DWORD)( tickSeconds * sampleRate + 0.5 ), (DWORD)1 ) );
+		m_thread = std::thread( &NullWaveDevice::threadedFunction, this );
+	}
+
+	~NullWaveDevice() {
+		m_quitting = true;
+		m_wake.notify_all();
+		m_thread.join();
+
+		for( size_t i = 0; i < m_voices.size(); i++ )
+			delete m_voices[i];
+		m_voices.clear();
+	}
+
+	//creates a voice for buffers of the given format, which can play up to maxFrequencyRatio times as fast;
+	//callbacks come from the device thread
+	NullWaveVoice* createVoice( const WAVEFORMATEX* wf, WaveVoiceCallback* pCallback, float maxFrequencyRatio = 2.0f ) {
+		NullWaveVoice* v = new NullWaveVoice( this, wf, pCallback, (std::min)( maxFrequencyRatio, XAUDIO2_MAX_FREQ_RATIO ) );
+		std::lock_guard<std::mutex> lock( m_mutex );
+		m_voices.push_back( v );
+		return v;
+	}
+
+	//destroys a voice; waits for the current tick to finish, so must not be called from a voice callback
+	void destroyVoice( NullWaveVoice* v ) {
+		{
+			std::lock_guard<std::mutex> lock( m_mutex );
+			m_voices.erase( std::remove( m_voices.begin(), m_voices.end(), v ), m_voices.end() );
+		}
+		delete v;
+	}
+
+	//wakes a free-running device that is waiting on its voices
+	void notify() { m_wake.notify_all(); }
+
+	//mixes the voices from the next tick on and hands each tick's mix to output, or stops mixing with NULL;
+	//once it's set to something else, the old output is no longer called after the tick under way
+	void setOutput( NullWaveOutput* pOutput ) { m_pOutput = pOutput; }
+	NullWaveOutput* getOutput() const { return m_pOutput; }
+
+	TIMING getTiming() const { return m_timing; }
+	double getTickSeconds() const { return m_tickSeconds; }
+	//the rate and channels of the mix; voices are consumed at their own rates regardless, and the mix is taken from them
+	DWORD getSampleRate() const { return m_sampleRate; }
+	DWORD getChannels() const { return m_mixer.getChannels(); }
+	//the number of ticks processed so far
+	UINT64 getTickCount() const { return m_ticks; }
+	//the amount of audio time processed so far, in seconds
+	double getVirtualTime() const { return m_ticks * m_tickSeconds; }
+};
+
+inline bool NullWaveVoice::submit( const XAUDIO2_BUFFER* pBuffer ) {
+	QueuedBuffer q;
+	q.buffer = *pBuffer;
+	q.begin = pBuffer->PlayBegin * m_wf.nBlockAlign;
+	q.end = pBuffer->PlayLength > 0 ? q.begin + pBuffer->PlayLength * m_wf.nBlockAlign : pBuffer->AudioBytes;
+	if( q.begin > q.end || q.end > pBuffer->AudioBytes )
+		return false;
+
+	//a loop length of 0 runs to the end of the play region; as with xaudio2, the loop may start before the play region does,
+	//but has to end inside it
+	q.loopsLeft = pBuffer->LoopCount;
+	q.loopBegin = pBuffer->LoopBegin * m_wf.nBlockAlign;
+	q.loopEnd = pBuffer->LoopLength > 0 ? q.loopBegin + pBuffer->LoopLength * m_wf.nBlockAlign : q.end;
+	if( q.loopsLeft > 0 && ( q.loopEnd <= q.begin || q.loopEnd > q.end || q.loopBegin >= q.loopEnd ) )
+		return false;
+
+	{
+		//as many as xaudio2 will queue, so code that runs here doesn't overrun it there
+		std::lock_guard<std::mutex> lock( m_mutex );
+		if( m_queue.size() >= XAUDIO2_MAX_QUEUED_BUFFERS )
+			return false;
+		m_queue.push_back( q );
+		m_streamEnded = false;
+	}
+	m_pDevice->notify();
+	return true;
+}
+
+inline void NullWaveVoice::start() {
+	{
+		std::lock_guard<std::mutex> lock( m_mutex );
+		m_running = true;
+	}
+	m_pDevice->notify();
+}
+
+#endif
@@ -0,0 +1,61 @@
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+
+//a fixed-size ring passing items from one producer thread to one consumer thread without locks.
+//push() and pop() each touch only their own end's index, published with release and read with acquire,
+//so neither side ever waits on the other; capacity must be a power of two
+template<typename T, size_t capacity>
+class ofXAudioCommandQueue {
+public:
+
+	static_assert((capacity & (capacity - 1)) == 0, "ofXAudioCommandQueue capacity must be a power of two");
+
+	ofXAudioCommandQueue() : head(0), tail(0) {}
+
+	//producer only; returns false if the ring is full
+	bool push(const T& item){
+		size_t t = tail.load(std::memory_order_relaxed);
+		if (t - head.load(std::memory_order_acquire) == capacity){
+			return false;
+		}
+		items[t & (capacity - 1)] = item;
+		tail.store(t + 1, std::memory_order_release);
+		return true;
+	}
+
+	//consumer only; returns false if the ring is empty
+	bool pop(T* item){
+		size_t h = head.load(std::memory_order_relaxed);
+		if (h == tail.load(std::memory_order_acquire)){
+			return false;
+		}
+		*item = items[h & (capacity - 1)];
+		head.store(h + 1, std::memory_order_release);
+		return true;
+	}
+
+	//drops everything queued; only while neither side is using the ring
+	void clear(){
+		head.store(tail.load(std::memory_order_relaxed), std::memory_order_relaxed);
+	}
+
+	bool empty() const {
+		return head.load(std::memory_order_acquire) == tail.load(std::memory_order_acquire);
+	}
+
+protected:
+
+	//a cache line's worth of bytes between the items and each index keeps them on separate lines, so the two threads
+	//don't keep taking a line from each other. padding rather than alignas, which would over-align every class holding
+	//a queue, and plain new doesn't honour that before c++17
+	static const size_t cacheLine = 64;
+
+	T items[capacity];
+	char itemsPadding[cacheLine];
+	std::atomic<size_t> head; //the next item to pop; written by the consumer
+	char headPadding[cacheLine];
+	std::atomic<size_t> tail; //the next slot to push into; written by the producer
+	char tailPadding[cacheLine - sizeof(std::atomic<size_t>)];
+};
@@ -0,0 +1,221 @@
+#include "ofXAudioEngine.h"
+#include "ofMain.h"
+
+std::mutex ofXAudioEngine::instanceMutex;
+ofXAudioEngine* ofXAudioEngine::instance = NULL;
+int ofXAudioEngine::refCount = 0;
+#ifdef _WIN32
+ofXAudioEngine::Backend ofXAudioEngine::nextBackend = ofXAudioEngine::OFXAUDIO_BACKEND_XAUDIO2;
+#else
+ofXAudioEngine::Backend ofXAudioEngine::nextBackend = ofXAudioEngine::OFXAUDIO_BACKEND_NULL;
+#endif
+NullWaveDevice::TIMING ofXAudioEngine::nextNullTiming = NullWaveDevice::TIMING_REALTIME;
+int ofXAudioEngine::nextNumStreamingThreads = 2;
+std::atomic<ofXAudioHeaderIndex*> ofXAudioEngine::headerIndex(NULL);
+
+ofXAudioFilePath ofXAudioToFilePath(const std::string& path){
+#ifdef _WIN32
+	//the wave code wants a wide path
+	std::wstring filePath;
+	int pathLength = MultiByteToWideChar( CP_UTF8, 0, path.c_str(), -1, NULL, 0 );
+	filePath.assign( pathLength > 0 ? pathLength - 1 : 0, L'\0' );
+	if( pathLength > 1 )
+		MultiByteToWideChar( CP_UTF8, 0, path.c_str(), -1, &filePath[0], pathLength );
+	return filePath;
+#else
+	return path;
+#endif
+}
+
+ofXAudioEngine* ofXAudioEngine::acquire(){
+	std::lock_guard<std::mutex> lock(instanceMutex);
+	if (instance == NULL){
+		ofXAudioEngine* engine = new ofXAudioEngine();
+		if (!engine->setup(nextBackend, nextNullTiming, nextNumStreamingThreads)){
+			delete engine;
+			return NULL;
+		}
+		instance = engine;
+	}
+	refCount++;
+	return instance;
+}
+
+void ofXAudioEngine::release(){
+	std::lock_guard<std::mutex> lock(instanceMutex);
+	if (instance == NULL || refCount <= 0){
+		ofLogWarning()<<"ofXAudioEngine released more times than it was acquired";
+		return;
+	}
+	if (--refCount == 0){
+		delete instance;
+		instance = NULL;
+	}
+}
+
+void ofXAudioEngine::setBackend(Backend backend, NullWaveDevice::TIMING nullTiming){
+	std::lock_guard<std::mutex> lock(instanceMutex);
+#ifndef _WIN32
+	if (backend == OFXAUDIO_BACKEND_XAUDIO2){
+		ofLogWarning()<<"XAudio2 is only available on windows, using the null backend";
+		backend = OFXAUDIO_BACKEND_NULL;
+	}
+#endif
+	nextBackend = backend;
+	nextNullTiming = nullTiming;
+}
+
+void ofXAudioEngine::setNumStreamingThreads(int numThreads){
+	std::lock_guard<std::mutex> lock(instanceMutex);
+	nextNumStreamingThreads = numThreads;
+}
+
+void ofXAudioEngine::setHeaderIndex(ofXAudioHeaderIndex* index){
+	headerIndex = index;
+}
+
+ofXAudioHeaderIndex* ofXAudioEngine::getHeaderIndex(){
+	return headerIndex;
+}
+
+const WaveInfo* ofXAudioEngine::findHeader(const std::string& path, WaveInfo* header){
+	ofXAudioHeaderIndex* index = headerIndex;
+	return index != NULL && index->find(path, header) ? header : NULL;
+}
+
+ofXAudioEngine::Backend ofXAudioEngine::getBackend(){
+	std::lock_guard<std::mutex> lock(instanceMutex);
+	return instance != NULL ? instance->backend : nextBackend;
+}
+
+ofXAudioEngine::ofXAudioEngine()
+	: backend(OFXAUDIO_BACKEND_NULL)
+	, nullDevice(NULL)
+#ifdef _WIN32
+	, xaEngine(NULL)
+	, xaMaster(NULL)
+#endif
+{
+}
+
+bool ofXAudioEngine::setup(Backend _backend, NullWaveDevice::TIMING nullTiming, int numStreamingThreads){
+	backend = _backend;
+
+	if (backend == OFXAUDIO_BACKEND_NULL){
+		nullDevice = new NullWaveDevice(nullTiming);
+		scheduler.setup(numStreamingThreads);
+		voicePool.setup(this);
+		return true;
+	}
+
+#ifdef _WIN32
+	//required by XAudio2
+	CoInitializeEx( NULL, COINIT_MULTITHREADED );
+
+	//create the engine
+	if( FAILED( XAudio2Create( &xaEngine ) ) )
+	{
+		ofLogError()<<"Error init XAudio2 context!";
+		xaEngine = NULL;
+		CoUninitialize();
+		return false;
+	}
+
+	//create the one mastering voice every player's source voices feed into
+	if( FAILED( xaEngine->CreateMasteringVoice( &xaMaster ) ) )
+	{
+		ofLogError()<<"Error creating XAudio2 mastering voice!";
+		xaMaster = NULL;
+		xaEngine->Release();
+		xaEngine = NULL;
+		CoUninitialize();
+		return false;
+	}
+
+	scheduler.setup(numStreamingThreads);
+	voicePool.setup(this);
+	return true;
+#else
+	return false;
+#endif
+}
+
+ofXAudioEngine::~ofXAudioEngine(){
+	int voiceCount = voicePool.getNumActive();
+	if (voiceCount > 0){
+		ofLogWarning()<<"ofXAudioEngine destroyed with "<<voiceCount<<" voices still alive";
+	}
+
+	scheduler.close();
+	voicePool.close();
+
+	delete nullDevice;
+	nullDevice = NULL;
+
+#ifdef _WIN32
+	if (xaMaster != NULL){
+		xaMaster->DestroyVoice();
+		xaMaster = NULL;
+	}
+	if (xaEngine != NULL){
+		//release the engine, cleanup
+		xaEngine->Release();
+		xaEngine = NULL;
+		CoUninitialize();
+	}
+#endif
+}
+
+WaveVoice* ofXAudioEngine::createVoice(const WAVEFORMATEX* wf, WaveVoiceCallback* callback, float maxFrequencyRatio, ofXAudioVoiceOwner* owner){
+	return voicePool.acquire(wf, callback, maxFrequencyRatio, owner);
+}
+
+void ofXAudioEngine::destroyVoice(WaveVoice* voice){
+	if (voice == NULL){
+		return;
+	}
+
+	voicePool.release(voice);
+}
+
+WaveVoice* ofXAudioEngine::newVoice(const WAVEFORMATEX* wf, float maxFrequencyRatio){
+	//the pool sets the callback for each user it hands the voice to
+	WaveVoice* voice = NULL;
+	if (backend == OFXAUDIO_BACKEND_NULL){
+		voice = nullDevice->createVoice(wf, NULL, maxFrequencyRatio);
+	}
+#ifdef _WIN32
+	else {
+		//panning feeds the mastering voice's channels directly, so the voice needs to know how many there are
+		XAUDIO2_VOICE_DETAILS masterDetails;
+		xaMaster->GetVoiceDetails(&masterDetails);
+		voice = XAudio2WaveVoice::create(xaEngine, wf, NULL, maxFrequencyRatio, masterDetails.InputChannels);
+	}
+#endif
+	return voice;
+}
+
+void ofXAudioEngine::deleteVoice(WaveVoice* voice){
+	if (backend == OFXAUDIO_BACKEND_NULL){
+		nullDevice->destroyVoice((NullWaveVoice*)voice);
+	} else {
+		delete voice;
+	}
+}
+
+int ofXAudioEngine::getVoiceCount(){
+	return voicePool.getNumActive();
+}
+
+UINT32 ofXAudioEngine::getOutputSampleRate(){
+	if (backend == OFXAUDIO_BACKEND_NULL){
+		return nullDevice->getSampleRate();
+	}
+#ifdef _WIN32
+	XAUDIO2_VOICE_DETAILS masterDetails;
+	xaMaster->GetVoiceDetails(&masterDetails);
+	return masterDetails.InputSampleRate;
+#else
+	return 0;
+#endif
+}
@@ -0,0 +1,116 @@
+#pragma once
+
+#include "waveTypes.h"
+#include "waveVoice.h"
+#include "nullWaveVoice.h"
+#include "waveBufferPool.h"
+#include "ofXAudioStreamScheduler.h"
+#include "ofXAudioSampleCache.h"
+#include "ofXAudioStreamCache.h"
+#include "ofXAudioHeaderIndex.h"
+#include "ofXAudioVoicePool.h"
+#include "ofXAudioMetrics.h"
+
+#include <atomic>
+#include <mutex>
+#include <string>
+
+#ifdef _WIN32
+#pragma comment(lib,"xaudio2.lib")
+#endif
+
+#ifdef _WIN32
+typedef std::wstring ofXAudioFilePath;
+#else
+typedef std::string ofXAudioFilePath;
+#endif
+
+//converts a utf-8 path to the form the wave code opens files with
+ofXAudioFilePath ofXAudioToFilePath(const std::string& path);
+
+//the one output graph shared by every ofXAudioSoundPlayer: the XAudio2 engine and its mastering voice
+//(or a NullWaveDevice when running headless); players acquire it on load and release it when they're done,
+//and get their own source voices from it
+class ofXAudioEngine {
+public:
+
+	enum Backend {
+		OFXAUDIO_BACKEND_XAUDIO2 = 0, //real output through XAudio2; windows only
+		OFXAUDIO_BACKEND_NULL = 1, //no audio hardware; buffers are consumed by a NullWaveDevice in virtual time
+	};
+
+	//gets the shared engine, creating it on first use; returns NULL if it couldn't be created.
+	//every successful acquire() needs a matching release()
+	static ofXAudioEngine* acquire();
+	static void release();
+
+	//picks the output used the next time the engine is created; has no effect on a running engine
+	static void setBackend(Backend backend, NullWaveDevice::TIMING nullTiming = NullWaveDevice::TIMING_REALTIME);
+	static Backend getBackend();
+	//sets how many worker threads refill streams for engines created after this call
+	static void setNumStreamingThreads(int numThreads);
+	//has every load take its wave headers from the index rather than parsing them from the file, or stops it with NULL;
+	//the index is the caller's, and has to outlive any loads made while it's set
+	static void setHeaderIndex(ofXAudioHeaderIndex* index);
+	static ofXAudioHeaderIndex* getHeaderIndex();
+	//the file's header from the index into header, returning it; NULL without an index, or if the file couldn't be parsed
+	static const WaveInfo* findHeader(const std::string& path, WaveInfo* header);
+
+	//gets a source voice for the format from the voice pool, which creates one if it has none idle; callbacks come from
+	//the output's thread. with an owner, the pool may take the voice back for someone else when it's at its limit.
+	//returns NULL on failure
+	WaveVoice* createVoice(const WAVEFORMATEX* wf, WaveVoiceCallback* callback, float maxFrequencyRatio = 2.0f, ofXAudioVoiceOwner* owner = NULL);
+	//gives the voice back to the pool; it's stopped and flushed first
+	void destroyVoice(WaveVoice* voice);
+
+	//the number of source voices currently handed out
+	int getVoiceCount();
+	//the rate the output mixes at, which streams set to resample are taken to
+	UINT32 getOutputSampleRate();
+	//the null device, when that's the backend in use; NULL otherwise
+	NullWaveDevice* getNullDevice() { return nullDevice; }
+	//the workers that refill every stream playing on this engine
+	ofXAudioStreamScheduler* getScheduler() { return &scheduler; }
+	//the samples of every sound loaded into memory rather than streamed
+	ofXAudioSampleCache* getSampleCache() { return &sampleCache; }
+	//the blocks of every file being streamed by more than one player at once
+	ofXAudioStreamCache* getStreamCache() { return &streamCache; }
+	//the source voices not in use, kept for the next player of the same format
+	ofXAudioVoicePool* getVoicePool() { return &voicePool; }
+	//every stream's refill metrics added together, with an optional periodic dump to the log
+	ofXAudioMetricsTotals* getMetrics() { return &metrics; }
+	//the memory every stream's buffers are leased from, with its occupancy in getStats()
+	WaveBufferPool* getBufferPool() { return &bufferPool; }
+
+protected:
+
+	friend class ofXAudioVoicePool;
+
+	ofXAudioEngine();
+	~ofXAudioEngine();
+	bool setup(Backend backend, NullWaveDevice::TIMING nullTiming, int numStreamingThreads);
+	//actually creates and destroys source voices, for the pool
+	WaveVoice* newVoice(const WAVEFORMATEX* wf, float maxFrequencyRatio);
+	void deleteVoice(WaveVoice* voice);
+
+	Backend backend;
+	NullWaveDevice* nullDevice;
+#ifdef _WIN32
+	IXAudio2* xaEngine;
+	IXAudio2MasteringVoice* xaMaster;
+#endif
+	ofXAudioStreamScheduler scheduler;
+	ofXAudioSampleCache sampleCache;
+	ofXAudioStreamCache streamCache;
+	ofXAudioVoicePool voicePool;
+	ofXAudioMetricsTotals metrics;
+	WaveBufferPool bufferPool;
+
+	static std::mutex instanceMutex;
+	static ofXAudioEngine* instance;
+	static int refCount;
+	static Backend nextBackend;
+	static NullWaveDevice::TIMING nextNullTiming;
+	static int nextNumStreamingThreads;
+	static std::atomic<ofXAudioHeaderIndex*> headerIndex;
+};
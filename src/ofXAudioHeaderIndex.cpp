@@ -0,0 +1,237 @@
+#include "ofXAudioHeaderIndex.h"
+#include "ofXAudioEngine.h"
+#include "ofMain.h"
+
+#include <fstream>
+#include <thread>
+
+//the index file is a small header, then each entry in turn: the path, the file's size and modification time,
+//the format, the loop points and the chunk index. it's only ever read back on the machine that wrote it
+static const DWORD indexMagic = MAKEFOURCC( 'X', 'A', 'H', 'I' );
+static const DWORD indexVersion = 1;
+
+template<typename T>
+static bool readValue(std::istream& in, T* value){
+	return (bool)in.read((char*)value, sizeof(T));
+}
+
+template<typename T>
+static void writeValue(std::ostream& out, const T& value){
+	out.write((const char*)&value, sizeof(T));
+}
+
+ofXAudioHeaderIndex::ofXAudioHeaderIndex(){
+	changed = false;
+	hits = 0;
+	misses = 0;
+}
+
+bool ofXAudioHeaderIndex::load(const std::string& _indexPath){
+	std::lock_guard<std::mutex> lock(mutex);
+	indexPath = _indexPath;
+	entries.clear();
+	changed = false;
+
+	std::ifstream in(ofXAudioToFilePath(indexPath).c_str(), std::ios::binary);
+	DWORD magic = 0, version = 0, count = 0;
+	if (!readValue(in, &magic) || !readValue(in, &version) || !readValue(in, &count) || magic != indexMagic || version != indexVersion){
+		//no index yet, or one from another version; it's built up again as files are found
+		changed = true;
+		return false;
+	}
+
+	for (DWORD i = 0; i < count; i++){
+		DWORD pathLength = 0;
+		if (!readValue(in, &pathLength) || pathLength == 0 || pathLength > 32768){
+			break;
+		}
+		std::string path(pathLength, '\0');
+		if (!in.read(&path[0], pathLength)){
+			break;
+		}
+
+		Entry e;
+		WAVEFORMATEXTENSIBLE wf;
+		DWORD loopStart = 0, loopEnd = 0, numChunks = 0;
+		if (!readValue(in, &e.size) || !readValue(in, &e.modified) || !readValue(in, &wf)
+			|| !readValue(in, &loopStart) || !readValue(in, &loopEnd) || !readValue(in, &numChunks) || numChunks > 65536){
+			break;
+		}
+
+		std::vector<WaveInfo::Chunk> chunks(numChunks);
+		bool chunksRead = true;
+		for (DWORD c = 0; c < numChunks && chunksRead; c++){
+			chunksRead = readValue(in, &chunks[c].id) && readValue(in, &chunks[c].offset) && readValue(in, &chunks[c].size);
+		}
+		if (!chunksRead){
+			break;
+		}
+
+		if (e.header.assign(wf, loopStart, loopEnd, chunks)){
+			entries[path] = std::move(e);
+		}
+	}
+
+	//a truncated index keeps what it had, and is written out whole again on the next save()
+	if (entries.size() != count){
+		ofLogWarning()<<"ofXAudioHeaderIndex: read "<<entries.size()<<" of "<<count<<" entries from "<<indexPath;
+		changed = true;
+	}
+	return !entries.empty();
+}
+
+bool ofXAudioHeaderIndex::save(){
+	std::string path;
+	{
+		std::lock_guard<std::mutex> lock(mutex);
+		if (!changed){
+			return true;
+		}
+		path = indexPath;
+	}
+	if (path.empty()){
+		ofLogError()<<"ofXAudioHeaderIndex: no index file to save to";
+		return false;
+	}
+	return save(path);
+}
+
+bool ofXAudioHeaderIndex::save(const std::string& _indexPath){
+	std::lock_guard<std::mutex> lock(mutex);
+	std::ofstream out(ofXAudioToFilePath(_indexPath).c_str(), std::ios::binary | std::ios::trunc);
+	if (!out){
+		ofLogError()<<"ofXAudioHeaderIndex: couldn't write "<<_indexPath;
+		return false;
+	}
+
+	writeValue(out, indexMagic);
+	writeValue(out, indexVersion);
+	writeValue(out, (DWORD)entries.size());
+	for (std::map<std::string, Entry>::const_iterator it = entries.begin(); it != entries.end(); ++it){
+		const WaveInfo& header = it->second.header;
+		writeValue(out, (DWORD)it->first.size());
+		out.write(it->first.data(), it->first.size());
+		writeValue(out, it->second.size);
+		writeValue(out, it->second.modified);
+		writeValue(out, *header.wfex());
+		writeValue(out, header.getLoopStart());
+		writeValue(out, header.getLoopEnd());
+		writeValue(out, (DWORD)header.getNumChunks());
+		for (size_t c = 0; c < header.getNumChunks(); c++){
+			writeValue(out, header.getChunk(c).id);
+			writeValue(out, header.getChunk(c).offset);
+			writeValue(out, header.getChunk(c).size);
+		}
+	}
+
+	out.close();
+	if (!out){
+		ofLogError()<<"ofXAudioHeaderIndex: couldn't write "<<_indexPath;
+		return false;
+	}
+
+	indexPath = _indexPath;
+	changed = false;
+	return true;
+}
+
+int ofXAudioHeaderIndex::build(const std::vector<std::string>& paths, int numThreads){
+	if (numThreads <= 0){
+		numThreads = (std::max)((int)std::thread::hardware_concurrency(), 1);
+	}
+	numThreads = (std::min)(numThreads, (int)paths.size());
+
+	//each thread takes the next path in turn; the parsing is all done outside the lock
+	std::atomic<size_t> next(0);
+	std::atomic<int> failures(0);
+	auto work = [&](){
+		for (size_t i = next++; i < paths.size(); i = next++){
+			//files indexed already and unchanged since are only stat'd
+			UINT64 size = 0;
+			UINT64 modified = 0;
+			if (waveFileStat(ofXAudioToFilePath(paths[i]).c_str(), &size, &modified)){
+				std::lock_guard<std::mutex> lock(mutex);
+				std::map<std::string, Entry>::iterator it = entries.find(paths[i]);
+				if (it != entries.end() && it->second.size == size && it->second.modified == modified){
+					continue;
+				}
+			}
+
+			Entry e;
+			if (!parse(paths[i], &e)){
+				failures++;
+				continue;
+			}
+
+			std::lock_guard<std::mutex> lock(mutex);
+			std::map<std::string, Entry>::iterator it = entries.find(paths[i]);
+			if (it == entries.end() || it->second.size != e.size || it->second.modified != e.modified){
+				entries[paths[i]] = std::move(e);
+				changed = true;
+			}
+		}
+	};
+
+	std::vector<std::thread> threads;
+	for (int i = 1; i < numThreads; i++){
+		threads.push_back(std::thread(work));
+	}
+	work();
+	for (size_t i = 0; i < threads.size(); i++){
+		threads[i].join();
+	}
+
+	return failures;
+}
+
+bool ofXAudioHeaderIndex::find(const std::string& path, WaveInfo* header){
+	UINT64 size = 0;
+	UINT64 modified = 0;
+	if (!waveFileStat(ofXAudioToFilePath(path).c_str(), &size, &modified)){
+		return false;
+	}
+
+	{
+		std::lock_guard<std::mutex> lock(mutex);
+		std::map<std::string, Entry>::iterator it = entries.find(path);
+		if (it != entries.end() && it->second.size == size && it->second.modified == modified){
+			hits++;
+			return header->assign(it->second.header);
+		}
+	}
+
+	misses++;
+	Entry e;
+	bool parsed = parse(path, &e);
+
+	std::lock_guard<std::mutex> lock(mutex);
+	if (!parsed){
+		//a file that no longer parses shouldn't keep its old entry
+		if (entries.erase(path) > 0){
+			changed = true;
+		}
+		return false;
+	}
+	bool assigned = header->assign(e.header);
+	entries[path] = std::move(e);
+	changed = true;
+	return assigned;
+}
+
+int ofXAudioHeaderIndex::getNumEntries(){
+	std::lock_guard<std::mutex> lock(mutex);
+	return entries.size();
+}
+
+int ofXAudioHeaderIndex::getNumHits(){
+	return hits;
+}
+
+int ofXAudioHeaderIndex::getNumMisses(){
+	return misses;
+}
+
+bool ofXAudioHeaderIndex::parse(const std::string& path, Entry* e){
+	ofXAudioFilePath filePath = ofXAudioToFilePath(path);
+	return waveFileStat(filePath.c_str(), &e->size, &e->modified) && e->header.load(filePath.c_str());
+}
@@ -0,0 +1,67 @@
+#pragma once
+
+#include "waveInfo.h"
+
+#include <atomic>
+#include <map>
+#include <mutex>
+#include <string>
+#include <vector>
+
+//the parsed headers of a library of wave files (format, data offset and length, loop points and chunk index),
+//kept in a file between runs so a warm start opens sounds without reading their headers again.
+//entries are keyed by path and checked against the file's size and modification time only when they're looked up;
+//a file that changed is parsed again and its entry replaced
+class ofXAudioHeaderIndex {
+public:
+
+	ofXAudioHeaderIndex();
+
+	//reads the index file, replacing any entries held; a missing or damaged index just starts out empty (or with the
+	//entries that could be read). the path is remembered for save(). returns false if nothing could be read
+	bool load(const std::string& indexPath);
+	//writes the index back to the file it was loaded from, if anything has changed since
+	bool save();
+	bool save(const std::string& indexPath);
+
+	//parses every file in paths that isn't indexed yet or has changed, spread across numThreads threads
+	//(0 for one per core); returns the number of files that couldn't be parsed
+	int build(const std::vector<std::string>& paths, int numThreads = 0);
+
+	//fills header with the file's entry, parsing the file and adding it if there isn't one or the file has changed;
+	//returns false if the file couldn't be parsed
+	bool find(const std::string& path, WaveInfo* header);
+
+	int getNumEntries();
+	//lookups answered from the index, and those that had to parse the file
+	int getNumHits();
+	int getNumMisses();
+
+protected:
+
+	//moved into the index, never copied; visual studio 2013 doesn't generate the moves itself
+	struct Entry {
+		Entry() : size(0), modified(0) {}
+		Entry(Entry&& e) WAVE_NOEXCEPT : size(e.size), modified(e.modified), header(std::move(e.header)) {}
+		Entry& operator=(Entry&& e) WAVE_NOEXCEPT {
+			size = e.size;
+			modified = e.modified;
+			header = std::move(e.header);
+			return *this;
+		}
+
+		UINT64 size;
+		UINT64 modified;
+		WaveInfo header;
+	};
+
+	//stats and parses the file into e, without touching the index
+	static bool parse(const std::string& path, Entry* e);
+
+	std::mutex mutex;
+	std::map<std::string, Entry> entries;
+	std::string indexPath;
+	bool changed; //entries have been added or dropped since the last load() or save()
+	std::atomic<int> hits;
+	std::atomic<int> misses;
+};
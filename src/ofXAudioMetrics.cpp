@@ -0,0 +1,288 @@
+#include "ofXAudioMetrics.h"
+#include "ofMain.h"
+
+#include <chrono>
+#include <functional>
+#include <sstream>
+
+INT64 ofXAudioNowNanos(){
+	return std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+ofXAudioHistogram::Snapshot::Snapshot(){
+	clear();
+}
+
+void ofXAudioHistogram::Snapshot::clear(){
+	memset(counts, 0, sizeof(counts));
+	count = 0;
+	sum = 0;
+	max = 0;
+}
+
+void ofXAudioHistogram::Snapshot::add(const Snapshot& s){
+	for (int i = 0; i < OFXAUDIO_HISTOGRAM_BUCKETS; i++){
+		counts[i] += s.counts[i];
+	}
+	count += s.count;
+	sum += s.sum;
+	max = (std::max)(max, s.max);
+}
+
+UINT64 ofXAudioHistogram::Snapshot::getPercentile(double percentile) const{
+	if (count == 0){
+		return 0;
+	}
+
+	//the bucket holding the value ranked at the percentile; its top is the answer, but never past the largest value seen
+	UINT64 rank = (UINT64)(ofClamp(percentile, 0, 100) / 100.0 * count + 0.5);
+	rank = (std::max)(rank, (UINT64)1);
+	UINT64 seen = 0;
+	for (int i = 0; i < OFXAUDIO_HISTOGRAM_BUCKETS; i++){
+		seen += counts[i];
+		if (seen >= rank){
+			return (std::min)(bucketTop(i), max);
+		}
+	}
+	return max;
+}
+
+double ofXAudioHistogram::Snapshot::getMean() const{
+	return count > 0 ? (double)sum / count : 0;
+}
+
+ofXAudioHistogram::ofXAudioHistogram(){
+	reset();
+}
+
+int ofXAudioHistogram::bucketOf(UINT64 value){
+	if (value < OFXAUDIO_HISTOGRAM_SUB_BUCKETS){
+		return (int)value;
+	}
+	if (value >> OFXAUDIO_HISTOGRAM_BITS){
+		return OFXAUDIO_HISTOGRAM_BUCKETS - 1;
+	}
+
+	//the power of two, then the sixteenth of it
+	int bit = 63 - (int)waveLeadingZeros64(value);
+	int sub = (int)(value >> (bit - 4)) & (OFXAUDIO_HISTOGRAM_SUB_BUCKETS - 1);
+	return (bit - 3) * OFXAUDIO_HISTOGRAM_SUB_BUCKETS + sub;
+}
+
+UINT64 ofXAudioHistogram::bucketTop(int bucket){
+	if (bucket < OFXAUDIO_HISTOGRAM_SUB_BUCKETS){
+		return bucket;
+	}
+	int bit = bucket / OFXAUDIO_HISTOGRAM_SUB_BUCKETS + 3;
+	UINT64 sub = bucket % OFXAUDIO_HISTOGRAM_SUB_BUCKETS;
+	return ((OFXAUDIO_HISTOGRAM_SUB_BUCKETS + sub + 1) << (bit - 4)) - 1;
+}
+
+void ofXAudioHistogram::record(UINT64 value){
+	counts[bucketOf(value)].fetch_add(1, std::memory_order_relaxed);
+	count.fetch_add(1, std::memory_order_relaxed);
+	sum.fetch_add(value, std::memory_order_relaxed);
+
+	//a new worst is rare, so this hardly ever loops
+	UINT64 worst = max.load(std::memory_order_relaxed);
+	while (value > worst && !max.compare_exchange_weak(worst, value, std::memory_order_relaxed)){
+	}
+}
+
+void ofXAudioHistogram::addTo(Snapshot* snapshot) const{
+	for (int i = 0; i < OFXAUDIO_HISTOGRAM_BUCKETS; i++){
+		snapshot->counts[i] += counts[i].load(std::memory_order_relaxed);
+	}
+	snapshot->count += count.load(std::memory_order_relaxed);
+	snapshot->sum += sum.load(std::memory_order_relaxed);
+	snapshot->max = (std::max)(snapshot->max, max.load(std::memory_order_relaxed));
+}
+
+void ofXAudioHistogram::reset(){
+	for (int i = 0; i < OFXAUDIO_HISTOGRAM_BUCKETS; i++){
+		counts[i].store(0, std::memory_order_relaxed);
+	}
+	count.store(0, std::memory_order_relaxed);
+	sum.store(0, std::memory_order_relaxed);
+	max.store(0, std::memory_order_relaxed);
+}
+
+ofXAudioMetrics::Snapshot::Snapshot(){
+	clear();
+}
+
+void ofXAudioMetrics::Snapshot::clear(){
+	readTime.clear();
+	resubmitTime.clear();
+	queuedAtSubmit.clear();
+	buffers = 0;
+	bytesRead = 0;
+	underruns = 0;
+	failures = 0;
+}
+
+void ofXAudioMetrics::Snapshot::add(const Snapshot& s){
+	readTime.add(s.readTime);
+	resubmitTime.add(s.resubmitTime);
+	queuedAtSubmit.add(s.queuedAtSubmit);
+	buffers += s.buffers;
+	bytesRead += s.bytesRead;
+	underruns += s.underruns;
+	failures += s.failures;
+}
+
+std::string ofXAudioMetrics::Snapshot::toString() const{
+	std::ostringstream s;
+	s<<"buffers "<<buffers<<", "<<bytesRead<<" bytes, underruns "<<underruns<<", failures "<<failures
+		<<"; read us p50 "<<readTime.getPercentile(50)<<" p99 "<<readTime.getPercentile(99)<<" max "<<readTime.max
+		<<"; resubmit us p50 "<<resubmitTime.getPercentile(50)<<" p99 "<<resubmitTime.getPercentile(99)<<" max "<<resubmitTime.max
+		<<"; queued at submit p1 "<<queuedAtSubmit.getPercentile(1)<<" p50 "<<queuedAtSubmit.getPercentile(50);
+	return s.str();
+}
+
+ofXAudioMetrics::ofXAudioMetrics()
+	: buffers(0)
+	, bytesRead(0)
+	, underruns(0)
+	, failures(0)
+	, totals(NULL)
+{
+}
+
+void ofXAudioMetrics::setTotals(ofXAudioMetricsTotals* _totals){
+	totals.store(_totals, std::memory_order_relaxed);
+}
+
+void ofXAudioMetrics::recordRead(UINT64 micros, UINT64 bytes){
+	readTime.record(micros);
+	buffers.fetch_add(1, std::memory_order_relaxed);
+	bytesRead.fetch_add(bytes, std::memory_order_relaxed);
+	ofXAudioMetricsTotals* t = totals.load(std::memory_order_relaxed);
+	if (t != NULL){
+		t->local()->recordRead(micros, bytes);
+	}
+}
+
+void ofXAudioMetrics::recordResubmit(UINT64 micros){
+	resubmitTime.record(micros);
+	ofXAudioMetricsTotals* t = totals.load(std::memory_order_relaxed);
+	if (t != NULL){
+		t->local()->recordResubmit(micros);
+	}
+}
+
+void ofXAudioMetrics::recordSubmit(UINT32 queued){
+	queuedAtSubmit.record(queued);
+	ofXAudioMetricsTotals* t = totals.load(std::memory_order_relaxed);
+	if (t != NULL){
+		t->local()->recordSubmit(queued);
+	}
+}
+
+void ofXAudioMetrics::recordUnderrun(){
+	underruns.fetch_add(1, std::memory_order_relaxed);
+	ofXAudioMetricsTotals* t = totals.load(std::memory_order_relaxed);
+	if (t != NULL){
+		t->local()->recordUnderrun();
+	}
+}
+
+void ofXAudioMetrics::recordFailure(){
+	failures.fetch_add(1, std::memory_order_relaxed);
+	ofXAudioMetricsTotals* t = totals.load(std::memory_order_relaxed);
+	if (t != NULL){
+		t->local()->recordFailure();
+	}
+}
+
+void ofXAudioMetrics::addTo(Snapshot* snapshot) const{
+	readTime.addTo(&snapshot->readTime);
+	resubmitTime.addTo(&snapshot->resubmitTime);
+	queuedAtSubmit.addTo(&snapshot->queuedAtSubmit);
+	snapshot->buffers += buffers.load(std::memory_order_relaxed);
+	snapshot->bytesRead += bytesRead.load(std::memory_order_relaxed);
+	snapshot->underruns += underruns.load(std::memory_order_relaxed);
+	snapshot->failures += failures.load(std::memory_order_relaxed);
+}
+
+void ofXAudioMetrics::reset(){
+	readTime.reset();
+	resubmitTime.reset();
+	queuedAtSubmit.reset();
+	buffers.store(0, std::memory_order_relaxed);
+	bytesRead.store(0, std::memory_order_relaxed);
+	underruns.store(0, std::memory_order_relaxed);
+	failures.store(0, std::memory_order_relaxed);
+}
+
+ofXAudioMetricsTotals::ofXAudioMetricsTotals()
+	: dumpInterval(0)
+{
+}
+
+ofXAudioMetricsTotals::~ofXAudioMetricsTotals(){
+	setDumpInterval(0);
+}
+
+ofXAudioMetrics* ofXAudioMetricsTotals::local(){
+	//the thread's id picks its part; the few threads that record (the refill workers and the output's) rarely collide.
+	//ids are often addresses, aligned to a page or more, so the hash is mixed before the low bits are used
+	UINT64 h = std::hash<std::thread::id>()(std::this_thread::get_id());
+	h ^= h >> 33;
+	h *= 0xff51afd7ed558ccdULL;
+	h ^= h >> 33;
+	return &shards[h % OFXAUDIO_METRICS_SHARDS];
+}
+
+void ofXAudioMetricsTotals::getSnapshot(ofXAudioMetrics::Snapshot* snapshot){
+	snapshot->clear();
+	for (int i = 0; i < OFXAUDIO_METRICS_SHARDS; i++){
+		shards[i].addTo(snapshot);
+	}
+}
+
+void ofXAudioMetricsTotals::reset(){
+	for (int i = 0; i < OFXAUDIO_METRICS_SHARDS; i++){
+		shards[i].reset();
+	}
+}
+
+void ofXAudioMetricsTotals::setDumpInterval(int intervalMS){
+	std::thread finished;
+	{
+		std::lock_guard<std::mutex> lock(dumpMutex);
+		dumpInterval = (std::max)(intervalMS, 0);
+		if (dumpInterval > 0 && !dumpThread.joinable()){
+			dumpThread = std::thread(&ofXAudioMetricsTotals::dumpThreadedFunction, this);
+		} else if (dumpInterval == 0 && dumpThread.joinable()){
+			finished.swap(dumpThread);
+		}
+	}
+	dumpWake.notify_all();
+
+	if (finished.joinable()){
+		finished.join();
+	}
+}
+
+int ofXAudioMetricsTotals::getDumpInterval(){
+	std::lock_guard<std::mutex> lock(dumpMutex);
+	return dumpInterval;
+}
+
+void ofXAudioMetricsTotals::dumpThreadedFunction(){
+	std::unique_lock<std::mutex> lock(dumpMutex);
+	while (dumpInterval > 0){
+		//a changed interval starts the wait over
+		int interval = dumpInterval;
+		if (dumpWake.wait_for(lock, std::chrono::milliseconds(interval)) == std::cv_status::no_timeout){
+			continue;
+		}
+
+		lock.unlock();
+		ofXAudioMetrics::Snapshot snapshot;
+		getSnapshot(&snapshot);
+		ofLogNotice()<<"ofXAudio metrics: "<<snapshot.toString();
+		lock.lock();
+	}
+}
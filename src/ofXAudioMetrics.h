@@ -0,0 +1,145 @@
+#pragma once
+
+#include "waveTypes.h"
+
+#include <atomic>
+#include <condition_variable>
+#include <mutex>
+#include <string>
+#include <thread>
+
+//values below this are counted exactly; above it, each power of two is split into this many buckets,
+//so a bucket is never wider than 1/16th of the values in it
+#define OFXAUDIO_HISTOGRAM_SUB_BUCKETS 16
+//values from 2^32 up all land in the last bucket
+#define OFXAUDIO_HISTOGRAM_BITS 32
+#define OFXAUDIO_HISTOGRAM_BUCKETS (OFXAUDIO_HISTOGRAM_SUB_BUCKETS * (OFXAUDIO_HISTOGRAM_BITS - 3))
+//how many parts the engine's totals are split into; threads recording at once only share a part past this many
+#define OFXAUDIO_METRICS_SHARDS 8
+
+//the steady clock in nanoseconds, for timing the stream's hot path
+INT64 ofXAudioNowNanos();
+
+//counts values into buckets of a fixed relative width, HDR histogram style: recording is a few relaxed atomic adds,
+//with no locks and no allocation, so it's cheap enough for every buffer. reading it takes a snapshot
+class ofXAudioHistogram {
+public:
+
+	//the counts at one moment, to be queried at leisure
+	struct Snapshot {
+		UINT64 counts[OFXAUDIO_HISTOGRAM_BUCKETS];
+		UINT64 count;
+		UINT64 sum;
+		UINT64 max;
+
+		Snapshot();
+		void clear();
+		void add(const Snapshot& s);
+		//the value percentile percent (0 to 100) of the values recorded are at or below, to within its bucket; 0 if empty
+		UINT64 getPercentile(double percentile) const;
+		double getMean() const;
+	};
+
+	ofXAudioHistogram();
+
+	void record(UINT64 value);
+	//adds the counts so far to snapshot; recording can carry on meanwhile, so the counts might straddle a record()
+	void addTo(Snapshot* snapshot) const;
+	void reset();
+
+	static int bucketOf(UINT64 value);
+	//the largest value that lands in the bucket
+	static UINT64 bucketTop(int bucket);
+
+protected:
+
+	std::atomic<UINT64> counts[OFXAUDIO_HISTOGRAM_BUCKETS];
+	std::atomic<UINT64> count;
+	std::atomic<UINT64> sum;
+	std::atomic<UINT64> max;
+};
+
+//what a stream's refills have been through: how long each buffer took, how long the voice waited for it, how full the queue
+//was when it went out, and what went wrong. each stream keeps its own; the engine's ofXAudioMetricsTotals adds up all of them
+class ofXAudioMetrics {
+public:
+
+	struct Snapshot {
+		ofXAudioHistogram::Snapshot readTime; //microseconds
+		ofXAudioHistogram::Snapshot resubmitTime; //microseconds
+		ofXAudioHistogram::Snapshot queuedAtSubmit; //buffers
+		UINT64 buffers;
+		UINT64 bytesRead;
+		UINT64 underruns;
+		UINT64 failures;
+
+		Snapshot();
+		void clear();
+		void add(const Snapshot& s);
+		//a line of the counts and the times' median, 99th percentile and worst, for the log
+		std::string toString() const;
+	};
+
+	ofXAudioMetrics();
+
+	//everything recorded here from now on is added to totals too, to the part of them kept for the recording thread;
+	//NULL for none. the totals have to outlive this
+	void setTotals(class ofXAudioMetricsTotals* totals);
+
+	//a buffer of bytes bytes of the file's data was prepared in this many microseconds: read (or its read-ahead waited on),
+	//decoded and converted
+	void recordRead(UINT64 micros, UINT64 bytes);
+	//the voice finished a buffer this many microseconds before the refill submitted the next
+	void recordResubmit(UINT64 micros);
+	//a buffer was submitted with this many already queued ahead of it on the voice
+	void recordSubmit(UINT32 queued);
+	//the voice ran out of buffers while playing
+	void recordUnderrun();
+	//a buffer couldn't be read or decoded, and the stream gave up
+	void recordFailure();
+
+	void addTo(Snapshot* snapshot) const;
+	void reset();
+
+protected:
+
+	ofXAudioHistogram readTime;
+	ofXAudioHistogram resubmitTime;
+	ofXAudioHistogram queuedAtSubmit;
+	std::atomic<UINT64> buffers;
+	std::atomic<UINT64> bytesRead;
+	std::atomic<UINT64> underruns;
+	std::atomic<UINT64> failures;
+	std::atomic<class ofXAudioMetricsTotals*> totals;
+};
+
+//every stream's metrics added up, for the whole engine. each thread records into a part of its own (or one it shares with
+//few others), so the refill workers and the output's thread never contend; a snapshot adds the parts together.
+//it can also log a snapshot every so often
+class ofXAudioMetricsTotals {
+public:
+
+	ofXAudioMetricsTotals();
+	~ofXAudioMetricsTotals();
+
+	//the part the calling thread records into
+	ofXAudioMetrics* local();
+
+	void getSnapshot(ofXAudioMetrics::Snapshot* snapshot);
+	void reset();
+
+	//logs a snapshot every intervalMS milliseconds on a thread of its own, or stops with 0
+	void setDumpInterval(int intervalMS);
+	int getDumpInterval();
+
+protected:
+
+	void dumpThreadedFunction();
+
+	ofXAudioMetrics shards[OFXAUDIO_METRICS_SHARDS];
+
+	std::mutex dumpMutex;
+	std::condition_variable dumpWake; //signalled when the interval changes
+	std::thread dumpThread;
+	int dumpInterval;
+};
@@ -0,0 +1,247 @@
+#include "ofXAudioPlayhead.h"
+
+#include <chrono>
+
+//the steady clock reads from user space on the platforms we run on, so readers stay out of the kernel
+static INT64 nowNanos(){
+	return std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+ofXAudioPlayhead::ofXAudioPlayhead()
+	: sequence(0)
+	, sampleRate(0)
+	, voiceRate(0)
+	, length(0)
+	, samples(0)
+	, time(0)
+	, playing(false)
+	, running(false)
+	, speed(1)
+	, queuedEnd(0)
+	, numSubmitted(0)
+	, firstValid(0)
+	, restartFrame(0)
+	, sampleOffset(0)
+	, lastSamplesPlayed(0)
+	, seekPending(false){
+	writing.clear();
+	for (int i = 0; i < numSegments; i++){
+		segmentStart[i] = 0;
+		segmentFrame[i] = 0;
+		segmentFrames[i] = 0;
+		segmentSamples[i] = 0;
+		segmentWrapBegin[i] = 0;
+		segmentWrapEnd[i] = 0;
+		segmentEndOfStream[i] = false;
+	}
+}
+
+void ofXAudioPlayhead::beginWrite(){
+	while (writing.test_and_set(std::memory_order_acquire)){
+	}
+	sequence.fetch_add(1, std::memory_order_acq_rel);
+}
+
+void ofXAudioPlayhead::endWrite(){
+	sequence.fetch_add(1, std::memory_order_release);
+	writing.clear(std::memory_order_release);
+}
+
+void ofXAudioPlayhead::reset(UINT32 _sampleRate, UINT64 _length, UINT32 _voiceRate){
+	beginWrite();
+	sampleRate.store(_sampleRate, std::memory_order_release);
+	voiceRate.store(_voiceRate > 0 ? _voiceRate : _sampleRate, std::memory_order_release);
+	length.store(_length, std::memory_order_release);
+	samples.store(0, std::memory_order_release);
+	time.store(nowNanos(), std::memory_order_release);
+	playing.store(false, std::memory_order_release);
+	running.store(false, std::memory_order_release);
+	speed.store(1, std::memory_order_release);
+	queuedEnd.store(0, std::memory_order_release);
+	numSubmitted.store(0, std::memory_order_release);
+	firstValid.store(0, std::memory_order_release);
+	restartFrame.store(0, std::memory_order_release);
+	sampleOffset = 0;
+	lastSamplesPlayed = 0;
+	seekPending = false;
+	endWrite();
+}
+
+void ofXAudioPlayhead::restart(UINT64 samplesPlayed, UINT64 frame){
+	beginWrite();
+	restartLocked(unwrap(samplesPlayed), frame);
+	endWrite();
+}
+
+void ofXAudioPlayhead::seek(UINT64 frame){
+	beginWrite();
+	firstValid.store(numSubmitted.load(std::memory_order_acquire), std::memory_order_release);
+	restartFrame.store(frame, std::memory_order_release);
+	seekPending = true;
+	endWrite();
+}
+
+void ofXAudioPlayhead::submit(UINT64 frame, UINT64 frames, UINT64 wrapBegin, UINT64 wrapEnd, bool endOfStream){
+	beginWrite();
+	submitLocked(frame, frames, frames, wrapBegin, wrapEnd, endOfStream);
+	endWrite();
+}
+
+void ofXAudioPlayhead::submitResampled(UINT64 frame, UINT64 frames, UINT64 samples, UINT64 wrapBegin, UINT64 wrapEnd, bool endOfStream){
+	beginWrite();
+	submitLocked(frame, frames, samples, wrapBegin, wrapEnd, endOfStream);
+	endWrite();
+}
+
+void ofXAudioPlayhead::update(UINT64 samplesPlayed){
+	beginWrite();
+	samples.store(unwrap(samplesPlayed), std::memory_order_release);
+	time.store(nowNanos(), std::memory_order_release);
+	endWrite();
+}
+
+void ofXAudioPlayhead::setState(UINT64 samplesPlayed, bool _playing, bool paused){
+	beginWrite();
+	samples.store(unwrap(samplesPlayed), std::memory_order_release);
+	time.store(nowNanos(), std::memory_order_release);
+	playing.store(_playing, std::memory_order_release);
+	running.store(_playing && !paused, std::memory_order_release);
+	endWrite();
+}
+
+void ofXAudioPlayhead::setSpeed(float _speed){
+	beginWrite();
+	samples.store(estimate(), std::memory_order_release);
+	time.store(nowNanos(), std::memory_order_release);
+	speed.store(_speed, std::memory_order_release);
+	endWrite();
+}
+
+void ofXAudioPlayhead::exitLoop(UINT64 samplesPlayed, UINT64 endFrame){
+	beginWrite();
+	UINT64 s = unwrap(samplesPlayed);
+	UINT64 frame = frameAt(s);
+	restartLocked(s, frame);
+	UINT64 frames = endFrame > frame ? endFrame - frame : 0;
+	submitLocked(frame, frames, frames, 0, 0, false);
+	endWrite();
+}
+
+UINT64 ofXAudioPlayhead::getFrame() const {
+	while (true){
+		UINT32 s = sequence.load(std::memory_order_acquire);
+		if ((s & 1) == 0){
+			UINT64 frame = frameAt(estimate());
+			if (sequence.load(std::memory_order_acquire) == s){
+				return frame;
+			}
+		}
+	}
+}
+
+UINT64 ofXAudioPlayhead::getLength() const {
+	return length.load(std::memory_order_relaxed);
+}
+
+UINT32 ofXAudioPlayhead::getSampleRate() const {
+	return sampleRate.load(std::memory_order_relaxed);
+}
+
+bool ofXAudioPlayhead::isPlaying() const {
+	while (true){
+		UINT32 s = sequence.load(std::memory_order_acquire);
+		if ((s & 1) == 0){
+			bool result = playing.load(std::memory_order_acquire) && estimate() < queuedEnd.load(std::memory_order_acquire);
+			if (sequence.load(std::memory_order_acquire) == s){
+				return result;
+			}
+		}
+	}
+}
+
+UINT64 ofXAudioPlayhead::estimate() const {
+	UINT64 s = samples.load(std::memory_order_acquire);
+	if (running.load(std::memory_order_acquire)){
+		INT64 elapsed = nowNanos() - time.load(std::memory_order_acquire);
+		if (elapsed > 0){
+			s += (UINT64)(elapsed * 1e-9 * voiceRate.load(std::memory_order_acquire) * speed.load(std::memory_order_acquire));
+		}
+	}
+	return (std::min)(s, queuedEnd.load(std::memory_order_acquire));
+}
+
+UINT64 ofXAudioPlayhead::frameAt(UINT64 s) const {
+	//the newest buffer starting at or before the count is the one playing
+	UINT64 count = numSubmitted.load(std::memory_order_acquire);
+	UINT64 first = (std::max)(firstValid.load(std::memory_order_acquire), count > (UINT64)numSegments ? count - numSegments : 0);
+	for (UINT64 i = count; i > first; i--){
+		int k = (int)((i - 1) % numSegments);
+		UINT64 start = segmentStart[k].load(std::memory_order_acquire);
+		if (start > s){
+			continue;
+		}
+
+		//a resampled buffer's frames are spread over its samples; otherwise they're one to one
+		UINT64 frames = segmentFrames[k].load(std::memory_order_acquire);
+		UINT64 samples = segmentSamples[k].load(std::memory_order_acquire);
+		UINT64 played = (std::min)(s - start, samples);
+		UINT64 frame = segmentFrame[k].load(std::memory_order_acquire) + (samples == frames || samples == 0 ? played : played * frames / samples);
+		UINT64 wrapBegin = segmentWrapBegin[k].load(std::memory_order_acquire);
+		UINT64 wrapEnd = segmentWrapEnd[k].load(std::memory_order_acquire);
+		if (wrapEnd > wrapBegin && frame >= wrapEnd){
+			frame = wrapBegin + (frame - wrapBegin) % (wrapEnd - wrapBegin);
+		}
+		return frame;
+	}
+	return restartFrame.load(std::memory_order_acquire);
+}
+
+UINT64 ofXAudioPlayhead::unwrap(UINT64 samplesPlayed){
+	if (samplesPlayed < lastSamplesPlayed){
+		//xaudio2 counts from 0 again once a buffer flagged XAUDIO2_END_OF_STREAM finishes; that's the first such buffer
+		//that hadn't finished by the last count
+		UINT64 was = lastSamplesPlayed + sampleOffset;
+		UINT64 at = was;
+		UINT64 count = numSubmitted.load(std::memory_order_acquire);
+		UINT64 first = (std::max)(firstValid.load(std::memory_order_acquire), count > (UINT64)numSegments ? count - numSegments : 0);
+		for (UINT64 i = first; i < count; i++){
+			int k = (int)(i % numSegments);
+			UINT64 end = segmentStart[k].load(std::memory_order_acquire) + segmentSamples[k].load(std::memory_order_acquire);
+			if (segmentEndOfStream[k].load(std::memory_order_acquire) && end >= was){
+				at = end;
+				break;
+			}
+		}
+		sampleOffset = at;
+	}
+	lastSamplesPlayed = samplesPlayed;
+	return samplesPlayed + sampleOffset;
+}
+
+void ofXAudioPlayhead::restartLocked(UINT64 s, UINT64 frame){
+	seekPending = false;
+	firstValid.store(numSubmitted.load(std::memory_order_acquire), std::memory_order_release);
+	restartFrame.store(frame, std::memory_order_release);
+	samples.store(s, std::memory_order_release);
+	time.store(nowNanos(), std::memory_order_release);
+	queuedEnd.store(s, std::memory_order_release);
+}
+
+void ofXAudioPlayhead::submitLocked(UINT64 frame, UINT64 frames, UINT64 samples, UINT64 wrapBegin, UINT64 wrapEnd, bool endOfStream){
+	UINT64 count = numSubmitted.load(std::memory_order_acquire);
+	UINT64 start = queuedEnd.load(std::memory_order_acquire);
+	int k = (int)(count % numSegments);
+	segmentStart[k].store(start, std::memory_order_release);
+	segmentFrame[k].store(frame, std::memory_order_release);
+	segmentFrames[k].store(frames, std::memory_order_release);
+	segmentSamples[k].store(samples, std::memory_order_release);
+	segmentWrapBegin[k].store(wrapBegin, std::memory_order_release);
+	segmentWrapEnd[k].store(wrapEnd, std::memory_order_release);
+	segmentEndOfStream[k].store(endOfStream, std::memory_order_release);
+	numSubmitted.store(count + 1, std::memory_order_release);
+	//a buffer from before a seek still plays, but the position stays where the seek is headed
+	if (seekPending){
+		firstValid.store(count + 1, std::memory_order_release);
+	}
+	queuedEnd.store(samples >= unbounded - start ? unbounded : start + samples, std::memory_order_release);
+}
@@ -0,0 +1,99 @@
+#pragma once
+
+#include "waveTypes.h"
+
+#include <atomic>
+
+//where a voice is in its sound, readable from any thread without a lock or a system call.
+//the writers record each buffer as it's submitted (the frames of the sound it holds, and the voice's sample count
+//when it starts playing) and the voice's SamplesPlayed as buffers end; a reader carries that count forward by the
+//time since, at the sample rate and speed, then maps it back through the buffers to a frame of the sound.
+//it's a seqlock: writes bump the sequence to odd and back to even, and a reader that saw it change tries again,
+//so readers never hold up the voice thread. the fields are stored with release and loaded with acquire, so a reader that
+//sees anything a write stored also sees the sequence it bumped, with no fences (which ThreadSanitizer can't follow).
+//writers take turns through a spin flag, held for a handful of stores
+class ofXAudioPlayhead {
+public:
+
+	ofXAudioPlayhead();
+
+	//the frames to submit() for a buffer that loops until it's told not to
+	static const UINT64 unbounded = ~(UINT64)0;
+
+	//starts over for a sound of this many frames at this rate, with nothing submitted and not running;
+	//a sample rate of 0 means nothing is loaded. voiceRate is the rate the voice's sample count runs at,
+	//when the sound is resampled on its way to the voice; 0 is the sound's own rate
+	void reset(UINT32 sampleRate, UINT64 length, UINT32 voiceRate = 0);
+	//drops the buffers submitted so far, as after a flush: the position is frame until the voice
+	//plays something submitted from here on, which starts at its sample count of samplesPlayed
+	void restart(UINT64 samplesPlayed, UINT64 frame);
+	//a seek to frame is on its way to the voice: the position is frame from now until the restart() that carries it out,
+	//and buffers submitted before then, from the old position, aren't counted. it plays on as it was meanwhile
+	void seek(UINT64 frame);
+	//records a buffer about to be submitted, holding frames of the sound from frame on; if wrapEnd is past wrapBegin,
+	//the frames from wrapEnd on are really from wrapBegin on, round and round. endOfStream marks a buffer flagged
+	//XAUDIO2_END_OF_STREAM, after which xaudio2 starts its sample count over
+	void submit(UINT64 frame, UINT64 frames, UINT64 wrapBegin = 0, UINT64 wrapEnd = 0, bool endOfStream = false);
+	//the same, for a buffer resampled to samples frames at the voice's rate; the frames of the sound are spread evenly over them
+	void submitResampled(UINT64 frame, UINT64 frames, UINT64 samples, UINT64 wrapBegin = 0, UINT64 wrapEnd = 0, bool endOfStream = false);
+	//the voice's sample count now, from its state
+	void update(UINT64 samplesPlayed);
+	//the same, along with whether it's playing (paused or not) from here; only a voice that's playing and not paused counts on
+	void setState(UINT64 samplesPlayed, bool playing, bool paused);
+	//the playback rate; the position carries on from where it's reckoned to be now
+	void setSpeed(float speed);
+	//the voice was told to stop looping at samplesPlayed: whatever buffer it's in plays on to endFrame instead of wrapping
+	void exitLoop(UINT64 samplesPlayed, UINT64 endFrame);
+
+	//the frame of the sound playing now
+	UINT64 getFrame() const;
+	//the sound's length in frames, and its sample rate; 0 when nothing is loaded
+	UINT64 getLength() const;
+	UINT32 getSampleRate() const;
+	//playing (paused or not) with something submitted still left to play
+	bool isPlaying() const;
+
+protected:
+
+	//the buffers remembered; as many as any voice can have queued at once
+	static const int numSegments = XAUDIO2_MAX_QUEUED_BUFFERS;
+	void beginWrite();
+	void endWrite();
+	//the voice's sample count the reader reckons it's at now, capped at the end of what's submitted
+	UINT64 estimate() const;
+	//the frame of the sound at a sample count; call inside a read or a write
+	UINT64 frameAt(UINT64 samples) const;
+	//the voice's raw sample count, made monotonic across xaudio2 starting it over at the end of a stream
+	UINT64 unwrap(UINT64 samplesPlayed);
+	void restartLocked(UINT64 samples, UINT64 frame);
+	void submitLocked(UINT64 frame, UINT64 frames, UINT64 samples, UINT64 wrapBegin, UINT64 wrapEnd, bool endOfStream);
+
+	std::atomic<UINT32> sequence; //odd while a write is under way
+	std::atomic_flag writing;
+
+	//read by readers, inside the sequence
+	std::atomic<UINT32> sampleRate;
+	std::atomic<UINT32> voiceRate;
+	std::atomic<UINT64> length;
+	std::atomic<UINT64> samples; //the voice's sample count when last published
+	std::atomic<INT64> time; //the steady clock, in nanoseconds, when it was
+	std::atomic<bool> playing;
+	std::atomic<bool> running; //playing and not paused, so the count carries on with the clock
+	std::atomic<float> speed;
+	std::atomic<UINT64> queuedEnd; //the sample count the submitted buffers run out at
+	std::atomic<UINT64> numSubmitted; //buffers recorded since reset(); the last numSegments are kept
+	std::atomic<UINT64> firstValid; //the first recorded buffer that hasn't been dropped by restart()
+	std::atomic<UINT64> restartFrame; //the position until a buffer after a restart() starts playing
+	std::atomic<UINT64> segmentStart[numSegments];
+	std::atomic<UINT64> segmentFrame[numSegments];
+	std::atomic<UINT64> segmentFrames[numSegments];
+	std::atomic<UINT64> segmentSamples[numSegments]; //the voice's samples the frames take up
+	std::atomic<UINT64> segmentWrapBegin[numSegments];
+	std::atomic<UINT64> segmentWrapEnd[numSegments];
+	std::atomic<bool> segmentEndOfStream[numSegments];
+
+	//only touched by writers
+	UINT64 sampleOffset; //added to the voice's count, for each time xaudio2 started it over
+	UINT64 lastSamplesPlayed;
+	bool seekPending; //seek() was called and restart() hasn't been since
+};
@@ -0,0 +1,187 @@
+#include "ofXAudioPreloader.h"
+#include "ofXAudioSoundPlayer.h"
+
+ofXAudioPreloader::ofXAudioPreloader(){
+	numRunning = 0;
+	concurrency = 8;
+	numDone = 0;
+	numFailed = 0;
+	numTotal = 0;
+	listening = false;
+}
+
+ofXAudioPreloader::~ofXAudioPreloader(){
+	cancel();
+	if (listening){
+		ofRemoveListener(ofEvents().update, this, &ofXAudioPreloader::update);
+	}
+}
+
+void ofXAudioPreloader::setConcurrency(int numLoads){
+	std::lock_guard<std::mutex> lock(mutex);
+	concurrency = (std::max)(numLoads, 1);
+}
+
+int ofXAudioPreloader::getConcurrency(){
+	std::lock_guard<std::mutex> lock(mutex);
+	return concurrency;
+}
+
+void ofXAudioPreloader::add(ofXAudioSoundPlayer* player, const std::string& fileName, bool stream){
+	if (player == NULL){
+		return;
+	}
+
+	//the data path is resolved here, since the loader threads shouldn't be the ones asking openFrameworks for it;
+	//preloadSound() takes the absolute path as it is
+	Load l;
+	l.player = player;
+	l.path = ofToDataPath(fileName, true);
+	l.stream = stream;
+	l.loaded = false;
+
+	std::lock_guard<std::mutex> lock(mutex);
+	added.push_back(l);
+}
+
+void ofXAudioPreloader::start(){
+	if (!listening){
+		ofAddListener(ofEvents().update, this, &ofXAudioPreloader::update);
+		listening = true;
+	}
+	joinIdle();
+
+	std::lock_guard<std::mutex> lock(mutex);
+	if (added.empty()){
+		return;
+	}
+
+	//a batch that has been reported finished gives way to the new one; one still loading grows instead
+	if (numDone == numTotal){
+		numDone = 0;
+		numFailed = 0;
+		numTotal = 0;
+	}
+	numTotal += added.size();
+	pending.insert(pending.end(), added.begin(), added.end());
+	added.clear();
+
+	while (numRunning < concurrency && numRunning < (int)pending.size()){
+		numRunning++;
+		loaders.push_back(std::thread(&ofXAudioPreloader::threadedFunction, this));
+	}
+}
+
+void ofXAudioPreloader::cancel(){
+	{
+		std::lock_guard<std::mutex> lock(mutex);
+		added.clear();
+		pending.clear();
+	}
+
+	//with nothing pending the loaders stop after the load they're on
+	std::vector<std::thread> running;
+	{
+		std::lock_guard<std::mutex> lock(mutex);
+		running.swap(loaders);
+	}
+	for (size_t i = 0; i < running.size(); i++){
+		running[i].join();
+	}
+
+	std::lock_guard<std::mutex> lock(mutex);
+	done.clear();
+	numTotal = numDone;
+}
+
+bool ofXAudioPreloader::isLoading(){
+	std::lock_guard<std::mutex> lock(mutex);
+	return numDone < numTotal;
+}
+
+int ofXAudioPreloader::getNumDone(){
+	std::lock_guard<std::mutex> lock(mutex);
+	return numDone;
+}
+
+int ofXAudioPreloader::getNumTotal(){
+	std::lock_guard<std::mutex> lock(mutex);
+	return numTotal;
+}
+
+void ofXAudioPreloader::threadedFunction(){
+	while (true){
+		Load l;
+		{
+			std::lock_guard<std::mutex> lock(mutex);
+			if (pending.empty()){
+				numRunning--;
+				return;
+			}
+			l = pending.front();
+			pending.pop_front();
+		}
+
+		l.loaded = l.player->preloadSound(l.path, l.stream);
+
+		std::lock_guard<std::mutex> lock(mutex);
+		done.push_back(l);
+	}
+}
+
+void ofXAudioPreloader::update(ofEventArgs&){
+	std::deque<Load> finished;
+	{
+		std::lock_guard<std::mutex> lock(mutex);
+		finished.swap(done);
+	}
+
+	//the listeners are called without the mutex held, so they're free to start() another batch
+	for (size_t i = 0; i < finished.size(); i++){
+		ofXAudioPreloadEventArgs e;
+		e.player = finished[i].player;
+		e.path = finished[i].path;
+		e.loaded = finished[i].loaded;
+		{
+			//a listener cancelled the batch
+			std::lock_guard<std::mutex> lock(mutex);
+			if (numDone >= numTotal){
+				break;
+			}
+			numDone++;
+			if (!e.loaded){
+				numFailed++;
+			}
+			e.numDone = numDone;
+			e.numFailed = numFailed;
+			e.numTotal = numTotal;
+		}
+		if (!e.loaded){
+			ofLogError()<<"ofXAudioPreloader: couldn't load "<<e.path;
+		}
+		ofNotifyEvent(progressEvent, e, this);
+
+		if (e.numDone == e.numTotal){
+			ofXAudioPreloadEventArgs c = e;
+			c.player = NULL;
+			c.path.clear();
+			c.loaded = e.numFailed == 0;
+			ofNotifyEvent(completeEvent, c, this);
+		}
+	}
+
+	joinIdle();
+}
+
+void ofXAudioPreloader::joinIdle(){
+	std::vector<std::thread> idle;
+	{
+		std::lock_guard<std::mutex> lock(mutex);
+		if (numRunning == 0){
+			idle.swap(loaders);
+		}
+	}
+	for (size_t i = 0; i < idle.size(); i++){
+		idle[i].join();
+	}
+}
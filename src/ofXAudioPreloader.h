@@ -0,0 +1,79 @@
+#pragma once
+
+#include "ofMain.h"
+
+#include <deque>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+class ofXAudioSoundPlayer;
+
+//what progressEvent and completeEvent pass their listeners
+class ofXAudioPreloadEventArgs : public ofEventArgs {
+public:
+	ofXAudioSoundPlayer* player; //the player that finished loading; NULL for completeEvent
+	std::string path;
+	bool loaded; //whether this player's load succeeded; for completeEvent, whether every load did
+	int numDone; //loads finished so far, including failures
+	int numFailed;
+	int numTotal;
+};
+
+//loads a batch of players at once, for swapping one scene's cues for another's. each load (the header, the samples
+//or a stream's first buffers) runs on one of a few loader threads, so the batch takes about as long as its slowest
+//reads rather than the sum of them; the events fire from ofEvents().update, on the main thread
+class ofXAudioPreloader {
+public:
+
+	ofXAudioPreloader();
+	~ofXAudioPreloader();
+
+	//how many files are loaded at once (default 8); more keeps more reads in flight on fast or networked storage,
+	//fewer stops a spinning disk from seeking between them. takes effect on the next start()
+	void setConcurrency(int numLoads);
+	int getConcurrency();
+
+	//adds a player to the next batch, to be loaded as with preloadSound(); nothing else may use the player
+	//until its progressEvent has fired
+	void add(ofXAudioSoundPlayer* player, const std::string& fileName, bool stream = false);
+	//starts loading everything added since the last start(); an earlier batch still loading is added to
+	void start();
+	//drops the loads that haven't started, waits for those that have and fires no more events for the batch;
+	//the players already loaded stay loaded
+	void cancel();
+
+	bool isLoading();
+	int getNumDone();
+	int getNumTotal();
+
+	ofEvent<ofXAudioPreloadEventArgs> progressEvent; //each time a player has loaded, or failed to
+	ofEvent<ofXAudioPreloadEventArgs> completeEvent; //once the last player of the batch has
+
+protected:
+
+	struct Load {
+		ofXAudioSoundPlayer* player;
+		std::string path;
+		bool stream;
+		bool loaded;
+	};
+
+	void threadedFunction();
+	void update(ofEventArgs& args);
+	//joins loader threads that have run out of work; call without the mutex held
+	void joinIdle();
+
+	std::mutex mutex;
+	std::vector<Load> added; //waiting for start()
+	std::deque<Load> pending; //started, waiting for a loader thread
+	std::deque<Load> done; //loaded or failed, waiting for update() to report them
+	std::vector<std::thread> loaders;
+	int numRunning; //loader threads still taking work
+	int concurrency;
+	int numDone;
+	int numFailed;
+	int numTotal;
+	bool listening; //whether update() is registered with ofEvents()
+};
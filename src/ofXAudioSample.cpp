@@ -0,0 +1,246 @@
+#include "ofXAudioSample.h"
+#include "ofXAudioEngine.h"
+#include "ofMain.h"
+
+ofXAudioSample::ofXAudioSample(){
+	engine = NULL;
+	wave = NULL;
+	voice = NULL;
+	loop = false;
+	paused = false;
+	volume = 1;
+	pan = 0;
+	speed = 1;
+	maxSpeed = 2;
+}
+
+ofXAudioSample::~ofXAudioSample(){
+	unload();
+}
+
+bool ofXAudioSample::load(const std::string& path, ofXAudioEngine* _engine){
+	unload();
+
+	std::lock_guard<std::mutex> lock(mutex);
+	engine = _engine;
+
+	wave = engine->getSampleCache()->acquire(path);
+	if (wave == NULL){
+		ofLogError()<<"Error in file load "<<path;
+		return false;
+	}
+
+	paused = false;
+	if (!openVoice()){
+		ofLogError()<<"Error in voice create "<<path;
+		engine->getSampleCache()->release(wave);
+		wave = NULL;
+		return false;
+	}
+	return true;
+}
+
+bool ofXAudioSample::openVoice(){
+	//nothing to refill, so there's no need to hear about buffers ending
+	voice = engine->createVoice(wave->wf(), NULL, maxSpeed, this);
+	if (voice == NULL){
+		return false;
+	}
+
+	voice->setVolume(volume);
+	voice->setPan(pan);
+	playhead.reset(wave->wf()->nSamplesPerSec, wave->getDataLength() / (std::max)(wave->wf()->nBlockAlign, (WORD)1));
+	playhead.setSpeed(voice->setFrequencyRatio(speed));
+	return true;
+}
+
+bool ofXAudioSample::OnVoiceSteal(WaveVoice* _voice){
+	//whoever holds the mutex is using the voice; the pool will look for another
+	std::unique_lock<std::mutex> lock(mutex, std::try_to_lock);
+	if (!lock.owns_lock() || voice != _voice){
+		return false;
+	}
+
+	voice->stop();
+	voice->flush();
+	voice = NULL;
+	paused = false;
+	playhead.reset(wave->wf()->nSamplesPerSec, wave->getDataLength() / (std::max)(wave->wf()->nBlockAlign, (WORD)1));
+	return true;
+}
+
+void ofXAudioSample::unload(){
+	std::lock_guard<std::mutex> lock(mutex);
+	if (voice != NULL){
+		voice->stop();
+		engine->destroyVoice(voice);
+		voice = NULL;
+	}
+	if (wave != NULL){
+		engine->getSampleCache()->release(wave);
+		wave = NULL;
+	}
+	playhead.reset(0, 0);
+	engine = NULL;
+}
+
+void ofXAudioSample::play(){
+	std::lock_guard<std::mutex> lock(mutex);
+	if (wave == NULL){
+		return;
+	}
+	if (voice == NULL && !openVoice()){
+		ofLogError()<<"Error in voice create";
+		return;
+	}
+
+	voice->stop();
+	voice->flush();
+	submit(0);
+	paused = false;
+	voice->start();
+	publishState(true);
+}
+
+void ofXAudioSample::setPositionMS(int ms){
+	std::lock_guard<std::mutex> lock(mutex);
+	if (voice == NULL){
+		return;
+	}
+
+	XAUDIO2_VOICE_STATE voiceState = {0};
+	voice->getState(&voiceState);
+	if (voiceState.BuffersQueued == 0){
+		return;
+	}
+
+	//the whole sound is already in memory, so it's just resubmitted starting further in
+	voice->stop();
+	voice->flush();
+	submit(wave->getDataPositionAtMS(ms > 0 ? ms : 0) / (std::max)(wave->wf()->nBlockAlign, (WORD)1));
+	if (!paused){
+		voice->start();
+	}
+}
+
+int ofXAudioSample::getDurationMS(){
+	std::lock_guard<std::mutex> lock(mutex);
+	return wave != NULL ? wave->getDurationMS() : 0;
+}
+
+void ofXAudioSample::submit(UINT32 frame){
+	//the cached buffer is shared, so the start and the loop go on a copy of it
+	XAUDIO2_BUFFER buffer = *wave->buffer();
+	UINT32 frames = buffer.AudioBytes / (std::max)(wave->wf()->nBlockAlign, (WORD)1);
+	XAUDIO2_VOICE_STATE voiceState = {0};
+	voice->getState(&voiceState);
+	playhead.restart(voiceState.SamplesPlayed, (std::min)(frame, frames));
+	if (frame >= frames){
+		return;
+	}
+	buffer.PlayBegin = frame;
+
+	//xaudio2 lets the loop start before the play region, but not end before it; past a file's loop, it just plays out
+	if (loop){
+		buffer.LoopCount = XAUDIO2_LOOP_INFINITE;
+		if (wave->hasLoopPoints() && wave->getLoopEnd() <= frames){
+			buffer.LoopBegin = wave->getLoopStart();
+			buffer.LoopLength = wave->getLoopEnd() - wave->getLoopStart();
+			if (wave->getLoopEnd() <= frame){
+				buffer.LoopCount = 0;
+				buffer.LoopBegin = 0;
+				buffer.LoopLength = 0;
+			}
+		}
+	}
+
+	//an infinite loop with no length of its own goes round the whole buffer
+	UINT32 wrapBegin = buffer.LoopBegin;
+	UINT32 wrapEnd = buffer.LoopLength > 0 ? buffer.LoopBegin + buffer.LoopLength : frames;
+	bool looping = buffer.LoopCount == XAUDIO2_LOOP_INFINITE;
+	playhead.submit(frame, looping ? ofXAudioPlayhead::unbounded : frames - frame, looping ? wrapBegin : 0, looping ? wrapEnd : 0,
+		(buffer.Flags & XAUDIO2_END_OF_STREAM) != 0);
+	voice->submit(&buffer);
+}
+
+void ofXAudioSample::publishState(bool playing){
+	XAUDIO2_VOICE_STATE voiceState = {0};
+	voice->getState(&voiceState);
+	playhead.setState(voiceState.SamplesPlayed, playing, paused);
+}
+
+void ofXAudioSample::setLoop(bool _loop){
+	std::lock_guard<std::mutex> lock(mutex);
+	loop = _loop;
+	if (!loop && voice != NULL){
+		voice->exitLoop();
+		XAUDIO2_VOICE_STATE voiceState = {0};
+		voice->getState(&voiceState);
+		playhead.exitLoop(voiceState.SamplesPlayed, wave->buffer()->AudioBytes / (std::max)(wave->wf()->nBlockAlign, (WORD)1));
+	}
+}
+
+bool ofXAudioSample::getLoop(){
+	std::lock_guard<std::mutex> lock(mutex);
+	return loop;
+}
+
+void ofXAudioSample::stop(){
+	std::lock_guard<std::mutex> lock(mutex);
+	paused = false;
+	if (voice != NULL){
+		voice->stop();
+		voice->flush();
+		publishState(false);
+	}
+}
+
+void ofXAudioSample::setPaused(bool _paused){
+	std::lock_guard<std::mutex> lock(mutex);
+	if (voice == NULL || paused == _paused){
+		return;
+	}
+
+	//stopping the voice keeps its place in the buffer
+	paused = _paused;
+	if (paused){
+		voice->stop();
+	} else {
+		voice->start();
+	}
+	publishState(true);
+}
+
+void ofXAudioSample::setVolume(float _volume){
+	std::lock_guard<std::mutex> lock(mutex);
+	volume = _volume;
+	if (voice != NULL){
+		voice->setVolume(volume);
+	}
+}
+
+void ofXAudioSample::setPan(float _pan){
+	std::lock_guard<std::mutex> lock(mutex);
+	pan = _pan;
+	if (voice != NULL){
+		voice->setPan(pan);
+	}
+}
+
+void ofXAudioSample::setSpeed(float _speed){
+	std::lock_guard<std::mutex> lock(mutex);
+	speed = _speed;
+	if (voice != NULL){
+		playhead.setSpeed(voice->setFrequencyRatio(speed));
+	}
+}
+
+void ofXAudioSample::setMaxSpeed(float _maxSpeed){
+	std::lock_guard<std::mutex> lock(mutex);
+	maxSpeed = ofClamp(_maxSpeed, 1, XAUDIO2_MAX_FREQ_RATIO);
+}
+
+bool ofXAudioSample::isLoaded(){
+	std::lock_guard<std::mutex> lock(mutex);
+	return wave != NULL;
+}
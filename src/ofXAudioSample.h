@@ -0,0 +1,76 @@
+#pragma once
+
+#include "waveInfo.h"
+#include "waveVoice.h"
+#include "ofXAudioPlayhead.h"
+#include "ofXAudioVoicePool.h"
+
+#include <mutex>
+#include <string>
+
+class ofXAudioEngine;
+
+//a sound loaded into memory, playing on its own voice; the samples come from the engine's
+//sample cache, so every player of the same file submits the same memory. the voice comes from the engine's voice pool,
+//which can take it back when it's short of voices; the next play() gets another
+class ofXAudioSample : public ofXAudioVoiceOwner {
+public:
+
+	ofXAudioSample();
+	~ofXAudioSample();
+
+	//gets the samples from the engine's cache and creates the voice; doesn't start playback
+	bool load(const std::string& path, ofXAudioEngine* engine);
+	void unload();
+
+	//plays from the start, cutting off the previous play if it's still going
+	void play();
+	void stop();
+	//holds the current play where it is; play() starts over instead
+	void setPaused(bool paused);
+	//the voice's gain, left/right placement (-1 to 1) and playback rate; kept for the next load() as well.
+	//there's no refill worker here, so these go straight to the voice
+	void setVolume(float volume);
+	void setPan(float pan);
+	void setSpeed(float speed);
+	//the fastest setSpeed() can play, from the next load() (default 2)
+	void setMaxSpeed(float maxSpeed);
+
+	//loops over the file's 'smpl' loop points, or the whole sound, from the next play(); turning it off lets the current play finish
+	void setLoop(bool loop);
+	bool getLoop();
+
+	//jumps a play that's under way to this many milliseconds in, landing on the exact sample frame;
+	//does nothing while stopped, since play() always starts from the beginning
+	void setPositionMS(int ms);
+	//the length of the loaded sound
+	int getDurationMS();
+
+	bool isLoaded();
+	//where playback is, and whether it's playing; safe to read from any thread at any time
+	const ofXAudioPlayhead& getPlayhead() { return playhead; }
+
+	//ofXAudioVoiceOwner
+	bool OnVoiceSteal(WaveVoice* voice);
+
+protected:
+
+	ofXAudioEngine* engine;
+	const LoadedWave* wave;
+	WaveVoice* voice;
+	ofXAudioPlayhead playhead;
+	std::mutex mutex;
+	bool loop;
+	bool paused;
+	float volume;
+	float pan;
+	float speed;
+	float maxSpeed;
+
+	//gets a voice from the pool and applies the settings to it; call with the mutex held
+	bool openVoice();
+	//submits the sound to the voice to play from the given frame; call with the mutex held
+	void submit(UINT32 frame);
+	//tells the playhead where the voice has got to and whether it's playing; call with the mutex held
+	void publishState(bool playing);
+};
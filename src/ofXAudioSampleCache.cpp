@@ -0,0 +1,103 @@
+#include "ofXAudioSampleCache.h"
+#include "ofXAudioEngine.h"
+#include "ofMain.h"
+
+ofXAudioSampleCache::ofXAudioSampleCache(){
+}
+
+ofXAudioSampleCache::~ofXAudioSampleCache(){
+	if (!entries.empty()){
+		ofLogWarning()<<"ofXAudioSampleCache destroyed with "<<entries.size()<<" samples still in use";
+	}
+	for (std::map<const LoadedWave*, Entry*>::iterator it = entries.begin(); it != entries.end(); ++it){
+		delete it->second->wave;
+		delete it->second;
+	}
+}
+
+const LoadedWave* ofXAudioSampleCache::acquire(const std::string& path){
+	ofXAudioFilePath filePath = ofXAudioToFilePath(path);
+	UINT64 size = 0;
+	UINT64 modified = 0;
+	if (!waveFileStat(filePath.c_str(), &size, &modified)){
+		return NULL;
+	}
+
+	{
+		std::lock_guard<std::mutex> lock(mutex);
+		std::map<std::string, Entry*>::iterator it = current.find(path);
+		if (it != current.end() && it->second->size == size && it->second->modified == modified){
+			it->second->refCount++;
+			return it->second->wave;
+		}
+	}
+
+	//read the file without holding up everyone else's lookups
+	WaveInfo header;
+	LoadedWave* wave = new LoadedWave();
+	if (!wave->load(filePath.c_str(), ofXAudioEngine::findHeader(path, &header))){
+		delete wave;
+		return NULL;
+	}
+
+	std::lock_guard<std::mutex> lock(mutex);
+
+	//someone else may have loaded the same version while we were reading
+	std::map<std::string, Entry*>::iterator it = current.find(path);
+	if (it != current.end() && it->second->size == size && it->second->modified == modified){
+		delete wave;
+		it->second->refCount++;
+		return it->second->wave;
+	}
+
+	//any older version stays alive in entries until its users let go of it
+	Entry* e = new Entry();
+	e->path = path;
+	e->size = size;
+	e->modified = modified;
+	e->refCount = 1;
+	e->wave = wave;
+	current[path] = e;
+	entries[wave] = e;
+	return wave;
+}
+
+void ofXAudioSampleCache::release(const LoadedWave* wave){
+	if (wave == NULL){
+		return;
+	}
+
+	std::lock_guard<std::mutex> lock(mutex);
+	std::map<const LoadedWave*, Entry*>::iterator it = entries.find(wave);
+	if (it == entries.end()){
+		ofLogWarning()<<"ofXAudioSampleCache released a sample it doesn't hold";
+		return;
+	}
+
+	Entry* e = it->second;
+	if (--e->refCount > 0){
+		return;
+	}
+
+	std::map<std::string, Entry*>::iterator c = current.find(e->path);
+	if (c != current.end() && c->second == e){
+		current.erase(c);
+	}
+	entries.erase(it);
+	delete e->wave;
+	delete e;
+}
+
+int ofXAudioSampleCache::getNumSamples(){
+	std::lock_guard<std::mutex> lock(mutex);
+	return entries.size();
+}
+
+UINT64 ofXAudioSampleCache::getNumBytes(){
+	std::lock_guard<std::mutex> lock(mutex);
+	UINT64 bytes = 0;
+	for (std::map<const LoadedWave*, Entry*>::iterator it = entries.begin(); it != entries.end(); ++it){
+		bytes += it->second->wave->buffer()->AudioBytes;
+	}
+	return bytes;
+}
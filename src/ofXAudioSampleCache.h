@@ -0,0 +1,40 @@
+#pragma once
+
+#include "waveInfo.h"
+
+#include <map>
+#include <mutex>
+#include <string>
+
+//the samples of sounds loaded into memory, shared by every player of the same file.
+//entries are keyed by path and checked against the file's size and modification time,
+//so a file that changed on disk is loaded again; an entry is freed when its last user releases it
+class ofXAudioSampleCache {
+public:
+
+	ofXAudioSampleCache();
+	~ofXAudioSampleCache();
+
+	//gets the file's samples, loading them if they aren't cached (or the file has changed); returns NULL on failure.
+	//every successful acquire() needs a matching release()
+	const LoadedWave* acquire(const std::string& path);
+	void release(const LoadedWave* wave);
+
+	//the number of files held in memory, and the bytes of sample data they take up
+	int getNumSamples();
+	UINT64 getNumBytes();
+
+protected:
+
+	struct Entry {
+		std::string path;
+		UINT64 size;
+		UINT64 modified;
+		int refCount;
+		LoadedWave* wave;
+	};
+
+	std::mutex mutex;
+	std::map<std::string, Entry*> current; //the latest version of each file
+	std::map<const LoadedWave*, Entry*> entries; //every entry still in use, including versions a changed file has replaced
+};
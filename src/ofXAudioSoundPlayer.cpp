@@ -1,327 +1,367 @@
 #include "ofXAudioSoundPlayer.h"
-#include <synchapi.h>
 
-//tells all threads it's time to quit
-HANDLE g_hAbortEvent;
+ofXAudioSoundPlayer::ofXAudioSoundPlayer(){
+	engine = NULL;
+	currentStream = &stream;
+	currentSample = &sample;
+	streaming = false;
+	multiPlay = false;
+	loop = false;
+	volume = 1;
+	pan = 0;
+	speed = 1;
+	maxSpeed = 2;
+}
 
-//XAudio2 objects
-IXAudio2* g_engine = NULL;
-IXAudio2MasteringVoice* g_master = NULL;
+ofXAudioSoundPlayer::~ofXAudioSoundPlayer(){
+	unloadSound();
+}
 
-//the context to send to the StreamProc
-struct StreamContext
-{
-	IXAudio2SourceVoice** pVoice; //the source voice that is created on the thread
-	LPCTSTR szFile; //name of the file to stream
-	HANDLE hVoiceLoadEvent; //lets us know the thread is set up for streaming, or encountered an error
-};
+bool ofXAudioSoundPlayer::loadSound(string fileName, bool stream){
+	ofLogWarning()<<"LOADING "<<fileName<<endl;
+	if (!preloadSound(fileName, stream)){
+		return false;
+	}
 
-// stream thread
-StreamContext streamContext;
-HANDLE hStreamingVoiceThread;
+	if (stream){
+		ofLogWarning()<<"All good, starting stream!";
+		this->stream.start();
+	}
+	return true;
+};
 
-//the streaming thread
-DWORD WINAPI StreamProc( LPVOID pContext );
+bool ofXAudioSoundPlayer::preloadSound(string fileName, bool stream){
+	unloadSound();
 
-//the streaming thread procedure
-DWORD WINAPI StreamProc( LPVOID pContext )
-{
-	//required by XAudio2
-	CoInitializeEx( NULL, COINIT_MULTITHREADED );
+	//every player shares the one engine and mastering voice
+	engine = ofXAudioEngine::acquire();
+	if (engine == NULL){
+		ofLogError()<<"Error init XAudio2 context!";
+		return false;
+	}
 
-	if( pContext == NULL )
-	{
-		CoUninitialize();
-		return -1;
+	this->streaming = stream;
+	//an absolute path is used as it is, so a loader thread handing one in never asks openFrameworks for the data path
+	loadedPath = ofFilePath::isAbsolute(fileName) ? fileName : ofToDataPath(fileName, true);
+	if (!stream){
+		//reads the whole file into memory, or shares the copy another player already has; play() starts it
+		if (!sample.load(loadedPath, engine)){
+			unloadSound();
+			return false;
+		}
+		return true;
 	}
 
-	StreamContext* sc = (StreamContext*)pContext;
+	//opens the file and queues the first buffers; from here on the engine's scheduler keeps it fed
+	if (!this->stream.load(loadedPath, engine)){
+		unloadSound();
+		return false;
+	}
 
-	//instantiate the voice's callback class
-	StreamingVoiceCallback callback;
+	return true;
+};
 
-	//load a file for streaming, non-buffered disk reads (no system cacheing)
-	StreamingWave inFile;
-	if( !inFile.load( sc->szFile ) )
-	{
-		ofLogError()<<"Error in file load "<<sc->szFile;
-		SetEvent( sc->hVoiceLoadEvent );
-		CoUninitialize();
-		return -3;
+void ofXAudioSoundPlayer::unloadSound(){
+	currentStream = &stream;
+	currentSample = &sample;
+	for (size_t i = 0; i < extraStreams.size(); i++){
+		delete extraStreams[i];
 	}
+	extraStreams.clear();
+	for (size_t i = 0; i < extraSamples.size(); i++){
+		delete extraSamples[i];
+	}
+	extraSamples.clear();
+	loadedPath.clear();
 
-	//create the voice
-	IXAudio2SourceVoice* source = NULL;
-	if( FAILED( g_engine->CreateSourceVoice( &source, inFile.wf(), 0, 2.0f, &callback ) ) )
-	{
-		ofLogError()<<"Error in voice create "<<sc->szFile;
-		SetEvent( sc->hVoiceLoadEvent );
-		CoUninitialize();
-		return -5;
-	} else {
-		ofLogWarning()<<"Created source voice";
+	stream.unload();
+	sample.unload();
+
+	if( engine != NULL )
+		ofXAudioEngine::release();
+	engine = NULL;
+};
+
+void ofXAudioSoundPlayer::play(){
+	if (!multiPlay || engine == NULL){
+		if (streaming){
+			stream.start();
+		} else {
+			sample.play();
+		}
+		return;
 	}
 
-	//fill and queue the maximum number of buffers (except the one needed for reading new wave data)
-	bool somethingsWrong = false;
-	XAUDIO2_VOICE_STATE voiceState = {0};
-	source->GetState( &voiceState );
-	while( voiceState.BuffersQueued < STREAMINGWAVE_BUFFER_COUNT - 1 && !somethingsWrong )
-	{
-		//read and fill the next buffer to present
-		switch( inFile.prepare() )
-		{
-		case StreamingWave::PR_EOF:
-			//if end-of-file (or end-of-data), loop the file read
-			inFile.resetFile(); //intentionally fall-through to loop sound
-		case StreamingWave::PR_SUCCESS:
-			//present the next available buffer
-			inFile.swap();
-			//submit another buffer
-			source->SubmitSourceBuffer( inFile.buffer() );
-			source->GetState( &voiceState );
-			break;
-		case StreamingWave::PR_FAILURE:
-			somethingsWrong = true;
-			ofLogError()<<"Something went wrong";
-			break;
+	if (streaming){
+		ofXAudioStream* s = nextStream();
+		if (s != NULL){
+			s->start();
+			currentStream = s;
+		}
+	} else {
+		ofXAudioSample* s = nextSample();
+		if (s != NULL){
+			s->play();
+			currentSample = s;
 		}
 	}
+};
 
-	//return the created voice through the context pointer
-	sc->pVoice = &source;
-
-	ofLogWarning()<<"Loaded";
-
-	//signal that the voice has prepared for streaming, and ready to start
-	SetEvent( sc->hVoiceLoadEvent );
-
-	//group the events for the Wait function
-	HANDLE hEvents[2] = { callback.m_hBufferEndEvent, g_hAbortEvent };
-
-	bool quitting = false;
-	while( !quitting )
-	{
-		//wait until either the source voice is ready for another buffer, or the abort signal is set
-		DWORD eventFired = WaitForMultipleObjects( 2, hEvents, FALSE, INFINITE );
-		switch( eventFired )
-		{
-		case 0: //buffer ended event for source voice
-			//reset the event manually; why Manually? well why not?!
-			ResetEvent( hEvents[0] );
-
-			//make sure there's a full number of buffers
-			source->GetState( &voiceState );
-			while( voiceState.BuffersQueued < STREAMINGWAVE_BUFFER_COUNT - 1 && !somethingsWrong )
-			{
-				//read and fill the next buffer to present
-				switch( inFile.prepare() )
-				{
-				case StreamingWave::PR_EOF:
-					//if end-of-file (or end-of-data), loop the file read
-					inFile.resetFile(); //intentionally fall-through to loop sound
-
-					//todo: don't loop!
-
-				case StreamingWave::PR_SUCCESS:
-					//present the next available buffer
-					inFile.swap();
-					//submit another buffer
-					source->SubmitSourceBuffer( inFile.buffer() );
-					source->GetState( &voiceState );
-					
-					//ofLogError()<<"Error in file load "<<sc->szFile;
-					break;
-				case StreamingWave::PR_FAILURE:
-					somethingsWrong = true;
-					break;
-				}
+ofXAudioStream* ofXAudioSoundPlayer::nextStream(){
+	for (size_t i = 0; i <= extraStreams.size(); i++){
+		ofXAudioStream* s = i == 0 ? &stream : extraStreams[i - 1];
+		if (!s->isPlaying()){
+			//a play that was stopped part way through would otherwise pick up where it left off
+			if (s->getPlayhead().getFrame() > 0){
+				s->setPositionMS(0);
 			}
-
-			break;
-		case 1: //abort event
-			quitting = true;
-			break;
-		default: //something's wrong...
-			quitting = true;
+			return s;
 		}
 	}
 
-	ofLogError()<<"Stopping and destroying?";
-
-	//stop and destroy the voice
-	source->Stop();
-	source->FlushSourceBuffers();
-	source->DestroyVoice();
-
-	//close the streaming wave file;
-	//this is done automatically in the class destructor,
-	//so this is redundant
-	inFile.close();
-
-	//cleanup
-	CoUninitialize();
-	return 0;
-}
-
-bool initializeXAudioContext(){
-	//required by XAudio2
-	CoInitializeEx( NULL, COINIT_MULTITHREADED );
-
-	//create the engine
-	if( FAILED( XAudio2Create( &g_engine ) ) )
-	{
-		CoUninitialize();
-		return false;
+	//a new stream shares the first one's blocks through the stream cache when that's how the first was loaded
+	ofXAudioStream* s = new ofXAudioStream();
+	s->copySettings(stream);
+	if (!s->load(loadedPath, engine)){
+		delete s;
+		return NULL;
 	}
-	return true;
+	extraStreams.push_back(s);
+	return s;
 }
 
-void closeXAudioContext(){
-	//release the engine, cleanup
-	g_engine->Release();
-	CoUninitialize();
-}
-
-ofXAudioSoundPlayer::~ofXAudioSoundPlayer(){
-	//signal all threads to end
-	SetEvent( g_hAbortEvent );
-
-	//wait for that thread to end
-	WaitForSingleObject( hStreamingVoiceThread, INFINITE );
+ofXAudioSample* ofXAudioSoundPlayer::nextSample(){
+	for (size_t i = 0; i <= extraSamples.size(); i++){
+		ofXAudioSample* s = i == 0 ? &sample : extraSamples[i - 1];
+		if (!s->getPlayhead().isPlaying()){
+			return s;
+		}
+	}
 
-	//close all handles we opened
-	CloseHandle( hStreamingVoiceThread );
-	CloseHandle( g_hAbortEvent );
-	closeXAudioContext();
+	//the samples come from the engine's cache, so this only costs a voice
+	ofXAudioSample* s = new ofXAudioSample();
+	s->setVolume(volume);
+	s->setPan(pan);
+	s->setSpeed(speed);
+	s->setMaxSpeed(maxSpeed);
+	s->setLoop(loop);
+	if (!s->load(loadedPath, engine)){
+		delete s;
+		return NULL;
+	}
+	extraSamples.push_back(s);
+	return s;
 }
 
-bool ofXAudioSoundPlayer::loadSound(string fileName, bool stream){
-	unloadSound();
-	ofLogWarning()<<"LOADING "<<fileName<<endl;
-	static bool bContextInit = false;
-	if (!bContextInit ){
-		bContextInit = initializeXAudioContext();
+void ofXAudioSoundPlayer::stop(){
+	if (streaming){
+		stream.stop();
+		for (size_t i = 0; i < extraStreams.size(); i++){
+			extraStreams[i]->stop();
+		}
+	} else {
+		sample.stop();
+		for (size_t i = 0; i < extraSamples.size(); i++){
+			extraSamples[i]->stop();
+		}
 	}
-
-	if (!bContextInit){
-		ofLogError()<<"Error init XAudio2 context!";
-		return false;
+};
+	
+//like the loop setting, these carry over to whichever the next loadSound() uses, and apply to every play
+void ofXAudioSoundPlayer::setVolume(float vol){
+	volume = vol;
+	stream.setVolume(vol);
+	sample.setVolume(vol);
+	for (size_t i = 0; i < extraStreams.size(); i++){
+		extraStreams[i]->setVolume(vol);
 	}
-
-	//create the mastering voice
-	if( FAILED( g_engine->CreateMasteringVoice( &g_master ) ) )
-	{
-		ofLogError()<<"Error creating XAudio2 masering voice!";
-		g_engine->Release();
-		CoUninitialize();
-		return false;
+	for (size_t i = 0; i < extraSamples.size(); i++){
+		extraSamples[i]->setVolume(vol);
+	}
+};
+void ofXAudioSoundPlayer::setPan(float vol){ // -1 = left, 1 = right
+	pan = ofClamp(vol, -1, 1);
+	stream.setPan(pan);
+	sample.setPan(pan);
+	for (size_t i = 0; i < extraStreams.size(); i++){
+		extraStreams[i]->setPan(pan);
+	}
+	for (size_t i = 0; i < extraSamples.size(); i++){
+		extraSamples[i]->setPan(pan);
+	}
+};
+void ofXAudioSoundPlayer::setSpeed(float spd){
+	speed = spd;
+	stream.setSpeed(spd);
+	sample.setSpeed(spd);
+	for (size_t i = 0; i < extraStreams.size(); i++){
+		extraStreams[i]->setSpeed(spd);
+	}
+	for (size_t i = 0; i < extraSamples.size(); i++){
+		extraSamples[i]->setSpeed(spd);
+	}
+};
+void ofXAudioSoundPlayer::setPaused(bool bP){
+	if (streaming){
+		stream.setPaused(bP);
+		for (size_t i = 0; i < extraStreams.size(); i++){
+			extraStreams[i]->setPaused(bP);
+		}
 	} else {
-		ofLogWarning()<<"Created mastering voice";
+		sample.setPaused(bP);
+		for (size_t i = 0; i < extraSamples.size(); i++){
+			extraSamples[i]->setPaused(bP);
+		}
 	}
-
-	// right now, this only streams, doesn't load
-
-	//prepare the context to send to the new thread
-	streamContext.pVoice = NULL;
-	streamContext.szFile = TEXT("F:/0280.wav");//LPCTSTR( fileName.c_str() );
-	streamContext.hVoiceLoadEvent = CreateEventW(NULL, FALSE, FALSE, NULL);
-
-	//create the abort event to end all threads
-	g_hAbortEvent = CreateEventW( NULL, TRUE, FALSE, NULL );
-
-	//create the streaming voice thread
-	DWORD dwThreadId = 0;
-
-	// to do: OF thread, man!
-	hStreamingVoiceThread = CreateThread( NULL, 0, StreamProc, &streamContext, 0, &dwThreadId );
-
-	if( hStreamingVoiceThread == NULL )
-	{
-		ofLogError()<<"Error creating streaming voice thread!";
-		CloseHandle( g_hAbortEvent );
-		closeXAudioContext(); // should we really do this each time?
-		return false;
+};
+//kept by both, so it carries over to whichever the next loadSound() uses
+void ofXAudioSoundPlayer::setLoop(bool bLp){
+	loop = bLp;
+	stream.setLoop(bLp);
+	sample.setLoop(bLp);
+	for (size_t i = 0; i < extraStreams.size(); i++){
+		extraStreams[i]->setLoop(bLp);
+	}
+	for (size_t i = 0; i < extraSamples.size(); i++){
+		extraSamples[i]->setLoop(bLp);
 	}
-
-	//main loop
-	startThread();
-
-	return true;
 };
-
-void ofXAudioSoundPlayer::unloadSound(){
-	if ( streamContext.pVoice != NULL (*streamContext.pVoice) != NULL){
-		
-		SetEvent( g_hAbortEvent );
-		(*streamContext.pVoice)->Stop();
-		(*streamContext.pVoice)->DestroyVoice();
+//has streams read through the stream cache from the next loadSound(); turning it off leaves any extra plays to finish
+void ofXAudioSoundPlayer::setMultiPlay(bool bMp){
+	multiPlay = bMp;
+	stream.setShared(bMp);
+	if (!multiPlay){
+		currentStream = &stream;
+		currentSample = &sample;
 	}
 };
+void ofXAudioSoundPlayer::setPosition(float pct){ // 0 = start, 1 = end
+	int duration = streaming ? stream.getDurationMS() : sample.getDurationMS();
+	setPositionMS((int)(ofClamp(pct, 0, 1) * duration));
+};
 
-void ofXAudioSoundPlayer::play(){};
-void ofXAudioSoundPlayer::stop(){};
-	
-void ofXAudioSoundPlayer::setVolume(float vol){};
-void ofXAudioSoundPlayer::setPan(float vol){}; // -1 = left, 1 = right
-void ofXAudioSoundPlayer::setSpeed(float spd){};
-void ofXAudioSoundPlayer::setPaused(bool bP){};
-void ofXAudioSoundPlayer::setLoop(bool bLp){};
-void ofXAudioSoundPlayer::setMultiPlay(bool bMp){};
-void ofXAudioSoundPlayer::setPosition(float pct){}; // 0 = start, 1 = end{};
-void ofXAudioSoundPlayer::setPositionMS(int ms){};
+void ofXAudioSoundPlayer::setPositionMS(int ms){
+	if (streaming){
+		currentStream.load()->setPositionMS(ms);
+	} else {
+		currentSample.load()->setPositionMS(ms);
+	}
+};
 
+//these read the playhead, which takes no lock, so they're cheap enough to call every frame from any thread
 float ofXAudioSoundPlayer::getPosition(){
-	return 0.;
+	const ofXAudioPlayhead& playhead = getPlayhead();
+	UINT64 length = playhead.getLength();
+	return length > 0 ? (float)((double)playhead.getFrame() / length) : 0;
 };
 int ofXAudioSoundPlayer::getPositionMS(){
-	return 0.;
+	const ofXAudioPlayhead& playhead = getPlayhead();
+	UINT32 sampleRate = playhead.getSampleRate();
+	return sampleRate > 0 ? (int)(playhead.getFrame() * 1000 / sampleRate) : 0;
 };
 bool ofXAudioSoundPlayer::getIsPlaying(){
-	return true;
+	return getPlayhead().isPlaying();
 };
 
 float ofXAudioSoundPlayer::getSpeed(){
-	return 1.0;
+	return speed;
 };
 float ofXAudioSoundPlayer::getPan(){
-	return 0.;
+	return pan;
 };
 bool ofXAudioSoundPlayer::isLoaded(){
-	return true;
+	return getPlayhead().getSampleRate() > 0;
 };
 float ofXAudioSoundPlayer::getVolume(){
-	return 1.0;
+	return volume;
 };
 
-void ofXAudioSoundPlayer::threadedFunction(){
-	ofLogWarning()<<"Waiting for load event";
-	//while(isThreadRunning()){
-		//wait for the streaming voice thread to signal that it's either
-		//prepared the streaming, or that it's encountered an error
-		WaitForSingleObject( streamContext.hVoiceLoadEvent, INFINITE );
-		if( streamContext.pVoice == NULL || (*streamContext.pVoice) == NULL )
-		{
-			ofLogError()<<"Error loading stream!";
-			SetEvent( g_hAbortEvent );
-			WaitForSingleObject( hStreamingVoiceThread, INFINITE );
-
-			CloseHandle( hStreamingVoiceThread );
-			CloseHandle( g_hAbortEvent );
-			closeXAudioContext();
-			stopThread();
-			return;
-		}
-		
-		ofLogWarning()<<"All good, starting stream!";
+const ofXAudioPlayhead& ofXAudioSoundPlayer::getPlayhead(){
+	return streaming ? currentStream.load()->getPlayhead() : currentSample.load()->getPlayhead();
+}
 
-		//start the streaming voice, which was created on the other thread
-		if( streamContext.pVoice != NULL )
-			(*streamContext.pVoice)->Start();
-		else 
-			ofLogError()<<"Why are we getting here? Stream still null?";
-	//}
+int ofXAudioSoundPlayer::getNumPlays(){
+	return 1 + (streaming ? extraStreams.size() : extraSamples.size());
 }
 
+int ofXAudioSoundPlayer::getUnderrunCount(){
+	int underruns = stream.getUnderrunCount();
+	for (size_t i = 0; i < extraStreams.size(); i++){
+		underruns += extraStreams[i]->getUnderrunCount();
+	}
+	return underruns;
+}
 
+void ofXAudioSoundPlayer::getMetrics(ofXAudioMetrics::Snapshot* snapshot){
+	snapshot->clear();
+	stream.getMetrics(snapshot);
+	for (size_t i = 0; i < extraStreams.size(); i++){
+		extraStreams[i]->getMetrics(snapshot);
+	}
+}
+
+void ofXAudioSoundPlayer::setReadAhead(int numReads){
+	stream.setReadAhead(numReads);
+}
+
+int ofXAudioSoundPlayer::getReadAhead(){
+	return stream.getReadAhead();
+}
+
+void ofXAudioSoundPlayer::setBufferSize(int bytes, int numBuffers){
+	stream.setBufferSize(bytes, numBuffers);
+}
+
+void ofXAudioSoundPlayer::setTargetLatency(int latencyMS, int numBuffers){
+	stream.setTargetLatency(latencyMS, numBuffers);
+}
+
+void ofXAudioSoundPlayer::setAdaptiveBuffering(bool adaptive, int maxBuffers){
+	stream.setAdaptiveBuffering(adaptive, maxBuffers);
+}
+
+void ofXAudioSoundPlayer::setMemoryMapped(bool mapped){
+	stream.setMemoryMapped(mapped);
+}
+
+bool ofXAudioSoundPlayer::isMemoryMapped(){
+	return stream.isMemoryMapped();
+}
+
+void ofXAudioSoundPlayer::setSystemCached(bool cached){
+	stream.setSystemCached(cached);
+}
+
+bool ofXAudioSoundPlayer::isSystemCached(){
+	return stream.isSystemCached();
+}
+
+void ofXAudioSoundPlayer::setConvertToFloat(bool convert){
+	stream.setConvertToFloat(convert);
+}
+
+bool ofXAudioSoundPlayer::getConvertToFloat(){
+	return stream.getConvertToFloat();
+}
+
+void ofXAudioSoundPlayer::setResampling(bool resample, RESAMPLE_QUALITY quality){
+	stream.setResampling(resample, quality);
+}
+
+bool ofXAudioSoundPlayer::getResampling(){
+	return stream.getResampling();
+}
+
+void ofXAudioSoundPlayer::setMaxSpeed(float _maxSpeed){
+	maxSpeed = _maxSpeed;
+	stream.setMaxSpeed(maxSpeed);
+	sample.setMaxSpeed(maxSpeed);
+}
+
+int ofXAudioSoundPlayer::getBufferSize(){
+	return stream.getBufferSize();
+}
 
+int ofXAudioSoundPlayer::getQueueDepth(){
+	return currentStream.load()->getQueueDepth();
+}
@@ -1,12 +1,6 @@
 #pragma once
 
 #include "ofMain.h"
-#include <windows.h>
-#include <xaudio2.h>
-// this is a dope hack that forces the load of xaudio2 library!
-// "lean-and-mean" windows doesn't include xaudio2.
-#pragma comment(lib,"xaudio2.lib")
-#include <synchapi.h>
 
 //by Jay Tennant 3/8/12
 //A Brief Look at XAudio2: Playing a Stream
@@ -14,25 +8,35 @@
 //win32developer.com
 //this code provided free, as in public domain; score!
 
-#include "waveInfo.h"
+#include "ofXAudioEngine.h"
+#include "ofXAudioStream.h"
+#include "ofXAudioSample.h"
 
-class ofXAudioSoundPlayer : public ofBaseSoundPlayer, protected ofThread {
+class ofXAudioSoundPlayer : public ofBaseSoundPlayer {
 public:
 
-	ofXAudioSoundPlayer(){};
+	ofXAudioSoundPlayer();
 	~ofXAudioSoundPlayer();
 	
+	//loads a wave file, or a FLAC file, which a stream decodes as it plays and a sample decodes up front
 	bool loadSound(string fileName, bool stream = false);
+	//loads like loadSound(), but leaves a stream stopped until play(); safe to call from any thread,
+	//as long as nothing else uses this player until it returns
+	bool preloadSound(string fileName, bool stream = false);
 	void unloadSound();
 	void play();
 	void stop();
 	
+	//play, stop and these controls never wait on a stream being refilled: for streams they're queued for the refill
+	//worker and take effect at the next buffer boundary, or as soon as a worker is free for a seek. the one exception is
+	//a multi-play play() that finds every play so far still sounding, which loads another stream of the file, reading
+	//its first buffers. call them from one thread, usually the app's
 	void setVolume(float vol);
 	void setPan(float vol); // -1 = left, 1 = right
-	void setSpeed(float spd);
+	void setSpeed(float spd); // up to the maximum speed, 2 unless it's raised with setMaxSpeed()
 	void setPaused(bool bP);
-	void setLoop(bool bLp);
-	void setMultiPlay(bool bMp);
+	void setLoop(bool bLp); // loops the file's 'smpl' loop points if it has them, otherwise the whole file
+	void setMultiPlay(bool bMp); // play() while it's still sounding starts another play over the top; see below
 	void setPosition(float pct); // 0 = start, 1 = end;
 	void setPositionMS(int ms);
 
@@ -44,41 +48,78 @@ public:
 	bool isLoaded();
 	float getVolume();
 
-protected:
+	//where the loaded sound is playing and whether it is, for reading from any thread (an audio or render thread,
+	//say) without taking a lock; getPosition(), getPositionMS() and getIsPlaying() read it.
+	//with multi-play it's the latest play's, and stays valid until unloadSound()
+	const ofXAudioPlayhead& getPlayhead();
 
-	void threadedFunction();
-};
+	//with multi-play on, each play() that finds every play so far still sounding starts another on its own voice,
+	//rather than cutting the last one off. the controls apply to them all, the position to the latest.
+	//a stream loaded with it on reads its file through the engine's stream cache, so the plays share each block
+	//read from disk instead of streaming the file once apiece; sounds in memory share the one copy regardless.
+	//the plays past the first are kept for reuse until unloadSound()
+	int getNumPlays();
 
-//the voice callback to let us know when the submitted buffer of the stream has finished
-struct StreamingVoiceCallback : public IXAudio2VoiceCallback
-{
-public:
-	HANDLE m_hBufferEndEvent;
+	//the number of times this player's voice ran out of buffers while playing
+	int getUnderrunCount();
+	//what this player's streams have been through since they were loaded, added together into snapshot: read times,
+	//how long voices waited on refills, queue depths, underruns and failed reads. empty for sounds in memory
+	void getMetrics(ofXAudioMetrics::Snapshot* snapshot);
+
+	//how many disk reads to keep in flight ahead of playback (default 0, one read per buffer as it's needed);
+	//more hides slow disks and network shares at the cost of a buffer each, getBufferSize() bytes (the stream cache's
+	//block size with multi-play). takes effect on the next loadSound()
+	void setReadAhead(int numReads);
+	int getReadAhead();
 
-	StreamingVoiceCallback() : m_hBufferEndEvent( CreateEventW( NULL, TRUE, FALSE, NULL ) ) {}
-	virtual ~StreamingVoiceCallback() { CloseHandle( m_hBufferEndEvent ); }
+	//stream buffering for the next loadSound(): fixed-size buffers, or buffers sized from the file's format
+	//so that about latencyMS of audio is queued ahead of playback. numBuffers is from 3 to 65; all but one are queued
+	void setBufferSize(int bytes, int numBuffers = STREAMINGWAVE_BUFFER_COUNT);
+	void setTargetLatency(int latencyMS, int numBuffers = STREAMINGWAVE_BUFFER_COUNT);
+	//lets a stream queue more buffers, up to maxBuffers - 1 (at most 64), when its refills run late
+	void setAdaptiveBuffering(bool adaptive, int maxBuffers = 8);
+	int getBufferSize();
+	//streams the next loadSound() from a memory mapping of the file, submitting buffers that point straight into it;
+	//cheaper than unbuffered reads for files that are usually in the system cache, like frequently played loops
+	void setMemoryMapped(bool mapped);
+	bool isMemoryMapped();
+	//streams the next loadSound() with reads through the system cache, instead of the unbuffered reads that go around it;
+	//copies each buffer out of the cache, where a mapping doesn't, but still only holds a few buffers of the file at once
+	void setSystemCached(bool cached);
+	bool isSystemCached();
+	//has the next loadSound() stream convert its samples to float as it refills, so 24 bit and other integer files reach
+	//the output in the format it mixes in; the conversion runs on the refill worker instead of the audio thread
+	void setConvertToFloat(bool convert);
+	bool getConvertToFloat();
+	//has the next loadSound() stream resample a file at another rate than the output's as it refills, with a windowed-sinc
+	//filter of the given quality (RQ_FAST, 8 taps, to RQ_BEST, 64), so mixed 44.1/48/96kHz material all reaches the
+	//output at its rate; the buffers go to the voice as float
+	void setResampling(bool resample, RESAMPLE_QUALITY quality = RQ_GOOD);
+	bool getResampling();
+	//how fast setSpeed() can go from the next loadSound(), up to 1024; each voice's cost in the output grows with it
+	void setMaxSpeed(float maxSpeed);
+	//the number of buffers currently queued ahead of playback
+	int getQueueDepth();
 
-	//overrides
-    STDMETHOD_( void, OnVoiceProcessingPassStart )( UINT32 bytesRequired )
-    {
-    }
-    STDMETHOD_( void, OnVoiceProcessingPassEnd )()
-    {
-    }
-    STDMETHOD_( void, OnStreamEnd )()
-    {
-    }
-    STDMETHOD_( void, OnBufferStart )( void* pContext )
-    {
-    }
-    STDMETHOD_( void, OnBufferEnd )( void* pContext )
-    {
-        SetEvent( m_hBufferEndEvent );
-    }
-    STDMETHOD_( void, OnLoopEnd )( void* pContext )
-    {
-    }
-    STDMETHOD_( void, OnVoiceError )( void* pContext, HRESULT error )
-    {
-    }
-};
\ No newline at end of file
+protected:
+
+	ofXAudioEngine* engine;
+	ofXAudioStream stream;
+	ofXAudioSample sample;
+	std::vector<ofXAudioStream*> extraStreams; //the plays multi-play started beside the first
+	std::vector<ofXAudioSample*> extraSamples;
+	std::atomic<ofXAudioStream*> currentStream; //the latest play, for the position and playhead
+	std::atomic<ofXAudioSample*> currentSample;
+	string loadedPath;
+	bool streaming;
+	bool multiPlay;
+	bool loop;
+	float volume;
+	float pan;
+	float speed;
+	float maxSpeed;
+
+	//a play to start: the first one not sounding, or a new one beside the rest; NULL if one couldn't be loaded
+	ofXAudioStream* nextStream();
+	ofXAudioSample* nextSample();
+};
@@ -0,0 +1,630 @@
+#include "ofXAudioStream.h"
+#include "ofXAudioEngine.h"
+#include "ofXAudioStreamScheduler.h"
+#include "ofMain.h"
+
+#include <chrono>
+#include <thread>
+
+ofXAudioStream::ofXAudioStream(){
+	engine = NULL;
+	voice = NULL;
+	blocks = NULL;
+	shared = false;
+	convertToFloat = false;
+	resample = false;
+	resampleQuality = RQ_GOOD;
+	maxSpeed = 2;
+	accepting = false;
+	playing = false;
+	starting = false;
+	underruns = 0;
+	durationMS = 0;
+	submitMark = 0;
+	bufferEnded = 0;
+	queueDepth = STREAMINGWAVE_BUFFER_COUNT - 1;
+	maxQueueDepth = STREAMINGWAVE_BUFFER_COUNT - 1;
+	refillPending = false;
+	commandsPending = false;
+	finished = false;
+	flushing = false;
+	failed = false;
+	paused = false;
+	volume = 1;
+	pan = 0;
+	speed = 1;
+	loop = false;
+	numBuffers = STREAMINGWAVE_BUFFER_COUNT;
+	adaptive = false;
+	maxBuffers = STREAMINGWAVE_BUFFER_COUNT;
+}
+
+ofXAudioStream::~ofXAudioStream(){
+	unload();
+}
+
+bool ofXAudioStream::load(const std::string& path, ofXAudioEngine* _engine){
+	unload();
+
+	std::lock_guard<std::mutex> lock(mutex);
+	engine = _engine;
+	underruns = 0;
+	metrics.reset();
+	metrics.setTotals(engine->getMetrics());
+	bufferEnded = 0;
+	refillPending = false;
+	finished = false;
+	failed = false;
+
+	//with adaptive buffering every buffer the queue might grow into is allocated now, since they can't move once queued.
+	//they're leased from the engine's pool, and go back to it when the stream is unloaded
+	wave.setBufferCount( adaptive ? (std::max)( numBuffers, maxBuffers ) : numBuffers );
+	wave.setBufferPool( engine->getBufferPool() );
+	wave.setLooping( loop );
+	queueDepth = numBuffers - 1;
+
+	//load a file for streaming, non-buffered disk reads (no system cacheing); the header comes from the index if there is one.
+	//a shared stream takes its data from the blocks every other shared stream of the file is reading too.
+	//only wave data can be shared, so a compressed file streams (and decodes) on its own either way
+	bool loaded = false;
+	if( shared )
+	{
+		blocks = engine->getStreamCache()->acquire( path );
+		loaded = blocks != NULL && wave.load( blocks );
+	}
+	if( !loaded && blocks == NULL )
+	{
+		WaveInfo header;
+		loaded = wave.load( ofXAudioToFilePath( path ).c_str(), ofXAudioEngine::findHeader( path, &header ) );
+	}
+	if( !loaded )
+	{
+		ofLogError()<<"Error in file load "<<path;
+		releaseBlocks();
+		return false;
+	}
+
+	//the voice is created for whichever format it'll be handed
+	DWORD outRate = resample && WaveFormatConverter::needsResampling( wave.wf(), engine->getOutputSampleRate() ) ? engine->getOutputSampleRate() : 0;
+	if( ( outRate != 0 || ( convertToFloat && WaveFormatConverter::needsConversion( wave.wf() ) ) ) &&
+		!converter.setup( wave.wf(), wave.getBufferSize(), wave.getBufferCount(), outRate, resampleQuality ) )
+	{
+		ofLogError()<<"Error setting up conversion "<<path;
+		wave.close();
+		releaseBlocks();
+		return false;
+	}
+
+	//create the voice
+	voice = engine->createVoice( converter.isActive() ? converter.wf() : wave.wf(), this, maxSpeed );
+	if( voice == NULL )
+	{
+		ofLogError()<<"Error in voice create "<<path;
+		wave.close();
+		converter.close();
+		releaseBlocks();
+		return false;
+	}
+
+	maxQueueDepth = adaptive ? (int)wave.getBufferCount() - 1 : numBuffers - 1;
+
+	//no worker can be looking at the commands yet; anything sent before now is covered by the settings it left
+	commands.clear();
+	commandsPending = false;
+	paused = false;
+	voice->setVolume(volume);
+	voice->setPan(pan);
+
+	//the buffers about to be queued are the first the voice will play
+	XAUDIO2_VOICE_STATE voiceState = {0};
+	voice->getState(&voiceState);
+	playhead.reset(wave.wf()->nSamplesPerSec, wave.getDataLength() / (std::max)(wave.wf()->nBlockAlign, (WORD)1), outRate);
+	playhead.restart(voiceState.SamplesPlayed, 0);
+	playhead.setSpeed(voice->setFrequencyRatio(speed));
+
+	//fill and queue the starting number of buffers
+	submitMark = ofXAudioNowNanos();
+	if( !queueStreamingBuffers( wave, voice, queueDepth, this, &converter ) )
+	{
+		playhead.reset(0, 0);
+		ofLogError()<<"Error reading "<<path;
+		engine->destroyVoice( voice );
+		voice = NULL;
+		wave.close();
+		converter.close();
+		releaseBlocks();
+		return false;
+	}
+	finished = wave.isFinished();
+	durationMS = wave.getDurationMS();
+
+	accepting = true;
+	return true;
+}
+
+void ofXAudioStream::unload(){
+	//stop asking for refills, then take the voice away from under any worker
+	accepting = false;
+	{
+		std::lock_guard<std::mutex> lock(mutex);
+		if (voice != NULL){
+			voice->stop();
+			engine->destroyVoice(voice);
+			voice = NULL;
+		}
+		playing = false;
+		starting = false;
+		paused = false;
+		durationMS = 0;
+		playhead.reset(0, 0);
+	}
+
+	//drop refills asked for by callbacks that were already on their way, and wait out any worker still in service()
+	if (engine != NULL){
+		engine->getScheduler()->cancel(this);
+	}
+
+	std::lock_guard<std::mutex> lock(mutex);
+	wave.close();
+	converter.close();
+	releaseBlocks();
+	metrics.setTotals(NULL);
+	engine = NULL;
+}
+
+void ofXAudioStream::releaseBlocks(){
+	if (blocks != NULL){
+		engine->getStreamCache()->release(blocks);
+		blocks = NULL;
+	}
+}
+
+void ofXAudioStream::start(){
+	starting = accepting.load();
+	send(Command::START);
+}
+
+void ofXAudioStream::stop(){
+	send(Command::STOP);
+}
+
+void ofXAudioStream::setPaused(bool _paused){
+	send(Command::PAUSE, _paused ? 1 : 0);
+}
+
+void ofXAudioStream::setVolume(float _volume){
+	volume = _volume;
+	send(Command::VOLUME, volume);
+}
+
+void ofXAudioStream::setPan(float _pan){
+	pan = _pan;
+	send(Command::PAN, pan);
+}
+
+void ofXAudioStream::setSpeed(float _speed){
+	speed = _speed;
+	send(Command::SPEED, speed);
+}
+
+void ofXAudioStream::send(Command::Type type, float value, int ms){
+	Command c;
+	c.type = type;
+	c.value = value;
+	c.ms = ms;
+
+	//the ring only fills if the worker has fallen a long way behind; wait for it to catch up rather than lose a command,
+	//unless nothing is loaded to apply it to
+	while (!commands.push(c)){
+		if (!accepting){
+			return;
+		}
+		std::this_thread::yield();
+	}
+
+	//a stopped voice has no buffers ending to bring a worker round, so ask for one, unless one's already on its way;
+	//it ranks behind any stream that's running low. a seek is about to leave the voice with nothing queued, so it's
+	//asked for again regardless, ranked with the streams that have run dry
+	if (accepting && (!commandsPending.exchange(true) || type == Command::SEEK)){
+		engine->getScheduler()->schedule(this, type == Command::SEEK ? 0 : queueDepth.load());
+	}
+}
+
+void ofXAudioStream::setLoop(bool _loop){
+	loop = _loop;
+	send(Command::LOOP, loop ? 1 : 0);
+}
+
+bool ofXAudioStream::getLoop(){
+	return loop;
+}
+
+void ofXAudioStream::setPositionMS(int ms){
+	if (!accepting){
+		return;
+	}
+
+	//the worker works out exactly where the file's data picks up, but the playhead can say where it's headed now
+	ms = ms > 0 ? ms : 0;
+	UINT64 frame = (UINT64)ms * playhead.getSampleRate() / 1000;
+	playhead.seek((std::min)(frame, playhead.getLength()));
+	send(Command::SEEK, 0, ms);
+}
+
+int ofXAudioStream::getDurationMS(){
+	return durationMS;
+}
+
+void ofXAudioStream::setReadAhead(int numReads){
+	std::lock_guard<std::mutex> lock(mutex);
+	wave.setReadAhead(numReads > 0 ? numReads : 0);
+}
+
+int ofXAudioStream::getReadAhead(){
+	std::lock_guard<std::mutex> lock(mutex);
+	return wave.getReadAhead();
+}
+
+int ofXAudioStream::clampBufferCount(int n){
+	//xaudio2 turns away a buffer past the most it will queue, and the stream would keep trying to fill a queue it can't
+	return (std::min)((std::max)(n, 3), XAUDIO2_MAX_QUEUED_BUFFERS + 1);
+}
+
+void ofXAudioStream::setBufferSize(int bytes, int _numBuffers){
+	std::lock_guard<std::mutex> lock(mutex);
+	numBuffers = clampBufferCount(_numBuffers);
+	wave.setBufferSize(bytes > 0 ? bytes : STREAMINGWAVE_BUFFER_SIZE);
+	wave.setBufferDuration(0);
+}
+
+void ofXAudioStream::setTargetLatency(int latencyMS, int _numBuffers){
+	std::lock_guard<std::mutex> lock(mutex);
+	numBuffers = clampBufferCount(_numBuffers);
+	//the latency is the audio queued on the voice, which is every buffer but the one being read into
+	wave.setBufferDuration(latencyMS > 0 ? (std::max)(latencyMS / (numBuffers - 1), 1) : 0);
+}
+
+void ofXAudioStream::setAdaptiveBuffering(bool _adaptive, int _maxBuffers){
+	std::lock_guard<std::mutex> lock(mutex);
+	adaptive = _adaptive;
+	maxBuffers = clampBufferCount(_maxBuffers);
+}
+
+void ofXAudioStream::setMemoryMapped(bool mapped){
+	std::lock_guard<std::mutex> lock(mutex);
+	wave.setMemoryMapped(mapped);
+}
+
+bool ofXAudioStream::isMemoryMapped(){
+	std::lock_guard<std::mutex> lock(mutex);
+	return wave.isMemoryMapped();
+}
+
+void ofXAudioStream::setSystemCached(bool cached){
+	std::lock_guard<std::mutex> lock(mutex);
+	wave.setSystemCached(cached);
+}
+
+bool ofXAudioStream::isSystemCached(){
+	std::lock_guard<std::mutex> lock(mutex);
+	return wave.isSystemCached();
+}
+
+void ofXAudioStream::setShared(bool _shared){
+	shared = _shared;
+}
+
+bool ofXAudioStream::isShared(){
+	return shared;
+}
+
+void ofXAudioStream::copySettings(ofXAudioStream& from){
+	if (&from == this){
+		return;
+	}
+
+	//the two locks are never held together, so there's no order to get wrong
+	int fromNumBuffers, fromMaxBuffers, fromReadAhead;
+	bool fromAdaptive, fromShared, fromMapped, fromCached, fromLoop, fromConvert, fromResample;
+	RESAMPLE_QUALITY fromQuality;
+	DWORD fromBufferSize, fromBufferDuration;
+	float fromVolume, fromPan, fromSpeed, fromMaxSpeed;
+	{
+		std::lock_guard<std::mutex> lock(from.mutex);
+		fromNumBuffers = from.numBuffers;
+		fromAdaptive = from.adaptive;
+		fromMaxBuffers = from.maxBuffers;
+		fromShared = from.shared;
+		fromConvert = from.convertToFloat;
+		fromResample = from.resample;
+		fromQuality = from.resampleQuality;
+		fromMaxSpeed = from.maxSpeed;
+		fromMapped = from.wave.isMemoryMapped();
+		fromCached = from.wave.isSystemCached();
+		fromLoop = from.loop;
+		fromReadAhead = from.wave.getReadAhead();
+		fromBufferSize = from.wave.getRequestedBufferSize();
+		fromBufferDuration = from.wave.getBufferDuration();
+		fromVolume = from.volume;
+		fromPan = from.pan;
+		fromSpeed = from.speed;
+	}
+
+	std::lock_guard<std::mutex> lock(mutex);
+	numBuffers = fromNumBuffers;
+	adaptive = fromAdaptive;
+	maxBuffers = fromMaxBuffers;
+	shared = fromShared;
+	convertToFloat = fromConvert;
+	resample = fromResample;
+	resampleQuality = fromQuality;
+	maxSpeed = fromMaxSpeed;
+	wave.setMemoryMapped(fromMapped);
+	wave.setSystemCached(fromCached);
+	loop = fromLoop;
+	wave.setReadAhead(fromReadAhead);
+	wave.setBufferSize(fromBufferSize);
+	wave.setBufferDuration(fromBufferDuration);
+	volume = fromVolume;
+	pan = fromPan;
+	speed = fromSpeed;
+}
+
+void ofXAudioStream::setConvertToFloat(bool convert){
+	std::lock_guard<std::mutex> lock(mutex);
+	convertToFloat = convert;
+}
+
+bool ofXAudioStream::getConvertToFloat(){
+	std::lock_guard<std::mutex> lock(mutex);
+	return convertToFloat;
+}
+
+void ofXAudioStream::setResampling(bool _resample, RESAMPLE_QUALITY quality){
+	std::lock_guard<std::mutex> lock(mutex);
+	resample = _resample;
+	resampleQuality = quality;
+}
+
+bool ofXAudioStream::getResampling(){
+	std::lock_guard<std::mutex> lock(mutex);
+	return resample;
+}
+
+void ofXAudioStream::setMaxSpeed(float _maxSpeed){
+	std::lock_guard<std::mutex> lock(mutex);
+	maxSpeed = ofClamp(_maxSpeed, 1, XAUDIO2_MAX_FREQ_RATIO);
+}
+
+float ofXAudioStream::getMaxSpeed(){
+	std::lock_guard<std::mutex> lock(mutex);
+	return maxSpeed;
+}
+
+int ofXAudioStream::getBufferSize(){
+	std::lock_guard<std::mutex> lock(mutex);
+	return wave.getBufferSize();
+}
+
+int ofXAudioStream::getQueueDepth(){
+	return queueDepth;
+}
+
+bool ofXAudioStream::isLoaded(){
+	std::lock_guard<std::mutex> lock(mutex);
+	return voice != NULL;
+}
+
+bool ofXAudioStream::isPlaying(){
+	//a voice that ran through its buffers while the refill was on its way looks stopped to the playhead, but there's more to come
+	return starting || playhead.isPlaying() || (playing && refillPending && !finished);
+}
+
+int ofXAudioStream::getUnderrunCount(){
+	return underruns;
+}
+
+void ofXAudioStream::getMetrics(ofXAudioMetrics::Snapshot* snapshot){
+	metrics.addTo(snapshot);
+}
+
+void ofXAudioStream::service(){
+	std::lock_guard<std::mutex> lock(mutex);
+	if (voice == NULL){
+		return;
+	}
+
+	//whatever was sent since the last buffer ended takes effect before the next refill;
+	//anything sent from here on asks for another pass
+	commandsPending = false;
+	bool sought = applyCommands();
+
+	//make sure there's a full number of buffers
+	refill();
+	refillPending = false;
+
+	//a seek stopped the voice until the buffers from the new position were queued
+	if (sought && playing && !paused){
+		voice->start();
+	}
+}
+
+bool ofXAudioStream::applyCommands(){
+	//only the last of a run of parameter changes is worth passing to the voice
+	bool setVolume = false, setPan = false, setSpeed = false;
+	float newVolume = 0, newPan = 0, newSpeed = 0;
+	bool sought = false;
+
+	Command c;
+	while (commands.pop(&c)){
+		switch (c.type){
+		case Command::START:
+			applyStart();
+			break;
+		case Command::STOP:
+			playing = false;
+			paused = false;
+			voice->stop();
+			publishState();
+			break;
+		case Command::PAUSE:
+			paused = c.value != 0;
+			if (playing){
+				if (paused){
+					voice->stop();
+				} else {
+					voice->start();
+				}
+			}
+			publishState();
+			break;
+		case Command::VOLUME:
+			setVolume = true;
+			newVolume = c.value;
+			break;
+		case Command::PAN:
+			setPan = true;
+			newPan = c.value;
+			break;
+		case Command::SPEED:
+			setSpeed = true;
+			newSpeed = c.value;
+			break;
+		case Command::LOOP:
+			//reads the start of the loop in the first time it's turned on; a stream that had already run out has more
+			//to play, which the refill after the commands queues
+			if (!wave.setLooping(c.value != 0)){
+				ofLogError()<<"Error reading the loop start, playing to the end instead";
+			}
+			break;
+		case Command::SEEK:
+			applySeek(c.ms);
+			sought = true;
+			break;
+		}
+	}
+
+	if (setVolume){
+		voice->setVolume(newVolume);
+	}
+	if (setPan){
+		voice->setPan(newPan);
+	}
+	if (setSpeed){
+		playhead.setSpeed(voice->setFrequencyRatio(newSpeed));
+	}
+	return sought;
+}
+
+void ofXAudioStream::publishState(){
+	XAUDIO2_VOICE_STATE voiceState = {0};
+	voice->getState(&voiceState);
+	playhead.setState(voiceState.SamplesPlayed, playing, paused);
+}
+
+void ofXAudioStream::OnBufferSubmit(const StreamingWave& inFile, const XAUDIO2_BUFFER* pSubmitted, UINT32 buffersQueued){
+	const XAUDIO2_BUFFER* b = inFile.buffer();
+
+	//the time since the last submit (or the start of the refill) went on reading, decoding and converting this buffer
+	INT64 now = ofXAudioNowNanos();
+	metrics.recordRead((UINT64)(now - submitMark) / 1000, b->AudioBytes);
+	metrics.recordSubmit(buffersQueued);
+	submitMark = now;
+	INT64 ended = bufferEnded.exchange(0, std::memory_order_relaxed);
+	if (ended != 0 && now > ended){
+		metrics.recordResubmit((UINT64)(now - ended) / 1000);
+	}
+
+	UINT64 blockAlign = (std::max)(inFile.wf()->nBlockAlign, (WORD)1);
+	UINT64 frames = b->AudioBytes / blockAlign;
+	//a resampled buffer holds a different number of the voice's samples than the file frames it came from
+	UINT64 samples = converter.isResampling() ? pSubmitted->AudioBytes / (std::max)(converter.wf()->nBlockAlign, (WORD)1) : frames;
+	playhead.submitResampled(inFile.getBufferPosition() / blockAlign, frames, samples, inFile.getWrapBegin() / blockAlign, inFile.getWrapEnd() / blockAlign,
+		(b->Flags & XAUDIO2_END_OF_STREAM) != 0);
+}
+
+void ofXAudioStream::applyStart(){
+	if (wave.isFinished()){
+		wave.resetFile();
+		converter.reset();
+		refill();
+	}
+	playing = true;
+	paused = false;
+	voice->start();
+	publishState();
+	starting = false;
+}
+
+void ofXAudioStream::applySeek(int ms){
+	flushing = true;
+	voice->stop();
+	voice->flush();
+
+	//the voice can hang on to a flushed buffer until its next processing pass, and their memory is about to be read over
+	XAUDIO2_VOICE_STATE voiceState = {0};
+	voice->getState(&voiceState);
+	for (int i = 0; voiceState.BuffersQueued > 0 && i < 100; i++){
+		std::this_thread::sleep_for(std::chrono::milliseconds(1));
+		voice->getState(&voiceState);
+	}
+	flushing = false;
+
+	//a seek starts the stream afresh, so a read that failed before gets another go. the read from the new position goes
+	//ahead of any others in flight, and the refill after the commands queues it
+	UINT64 position = wave.getDataPositionAtMS(ms);
+	playhead.restart(voiceState.SamplesPlayed, position / (std::max)(wave.wf()->nBlockAlign, (WORD)1));
+	wave.seek(position);
+	converter.reset();
+	failed = false;
+	bufferEnded = 0;
+}
+
+void ofXAudioStream::refill(){
+	if (failed){
+		return;
+	}
+	submitMark = ofXAudioNowNanos();
+	if (!queueStreamingBuffers(wave, voice, queueDepth, this, &converter)){
+		failed = true;
+		metrics.recordFailure();
+		ofLogError()<<"Error refilling stream, giving up on it";
+	}
+	finished = wave.isFinished();
+}
+
+void ofXAudioStream::OnBufferEnd(void* pContext){
+	if (!accepting || flushing){
+		return;
+	}
+
+	//a buffer boundary is where the voice's count is known to line up with the buffers; readers carry it on from here
+	XAUDIO2_VOICE_STATE voiceState = {0};
+	voice->getState( &voiceState );
+	playhead.update(voiceState.SamplesPlayed);
+
+	//the last buffer of a stream that isn't looping; there's nothing to refill
+	if (pContext == &wave){
+		return;
+	}
+
+	//nothing left queued behind the buffer that just finished: the voice is starving
+	if (playing && voiceState.BuffersQueued == 0 && !finished){
+		underruns++;
+		metrics.recordUnderrun();
+	}
+
+	//the refill's first submit says how long the voice went a buffer short; only the earliest end it hasn't caught up with counts
+	INT64 none = 0;
+	bufferEnded.compare_exchange_strong(none, ofXAudioNowNanos(), std::memory_order_relaxed);
+
+	//another buffer ended before the last refill was done: the refills are running late, so give them more slack
+	if (refillPending.exchange(true) && playing){
+		int depth = queueDepth;
+		if (depth < maxQueueDepth){
+			queueDepth = depth + 1;
+		}
+	}
+
+	engine->getScheduler()->schedule(this, voiceState.BuffersQueued);
+}
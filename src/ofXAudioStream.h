@@ -0,0 +1,188 @@
+#pragma once
+
+#include "waveInfo.h"
+#include "waveVoice.h"
+#include "ofXAudioCommandQueue.h"
+#include "ofXAudioMetrics.h"
+#include "ofXAudioPlayhead.h"
+
+#include <atomic>
+#include <mutex>
+#include <string>
+
+class ofXAudioEngine;
+
+//one streamed file playing on one voice; whenever the voice finishes a buffer,
+//the stream asks the engine's scheduler to have a worker refill it.
+//the transport and mix controls (start, stop, pause, volume, pan, speed, loop and seek) are queued as commands for that
+//worker, which applies them between buffers, so the app thread never waits on a refill; they're meant to be called from
+//a single thread. the settings for the next load() and load() itself do take the mutex a refill holds
+class ofXAudioStream : public WaveVoiceCallback, public WaveSubmitListener {
+public:
+
+	ofXAudioStream();
+	~ofXAudioStream();
+
+	//opens the file, creates the voice on the engine and queues the first buffers; doesn't start playback
+	bool load(const std::string& path, ofXAudioEngine* engine);
+	void unload();
+
+	//starts or resumes playback; a stream that played to its end starts over
+	void start();
+	void stop();
+	//holds playback where it is without stopping the stream; start() or setPaused(false) resumes it
+	void setPaused(bool paused);
+	//the voice's gain, left/right placement (-1 to 1) and playback rate; kept for the next load() as well
+	void setVolume(float volume);
+	void setPan(float pan);
+	void setSpeed(float speed);
+
+	//loops over the file's 'smpl' loop points, or the whole file, with no gap at the seam; applies from the next buffer refilled.
+	//queued for the worker like the other controls, which also refills a stream that had already run out; kept for the next load()
+	void setLoop(bool loop);
+	bool getLoop();
+
+	//jumps to this many milliseconds into the file. queued for the worker, ahead of streams that aren't running dry, which
+	//flushes the voice and reads the first buffer from the new position ahead of anything else waiting, so the voice picks
+	//up again within about a buffer's read. the playhead reads as the new position straight away
+	void setPositionMS(int ms);
+	//the length of the loaded file; kept from load(), so it doesn't wait on a refill
+	int getDurationMS();
+
+	//how many reads to keep in flight ahead of the buffer being refilled; 0 reads each buffer as it's needed.
+	//takes effect on the next load()
+	void setReadAhead(int numReads);
+	int getReadAhead();
+
+	//buffer geometry for the next load(): either a fixed size in bytes, or sized from the file's byte rate so the
+	//buffers queued on the voice hold about latencyMS of audio. numBuffers is kept between 3 and XAUDIO2_MAX_QUEUED_BUFFERS + 1,
+	//one fewer are kept queued
+	void setBufferSize(int bytes, int numBuffers);
+	void setTargetLatency(int latencyMS, int numBuffers);
+	//lets the queue grow, up to maxBuffers - 1 queued, each time a refill is still outstanding when the next buffer ends.
+	//the buffers are allocated up front, so this costs maxBuffers of memory from the next load()
+	void setAdaptiveBuffering(bool adaptive, int maxBuffers);
+	//streams from a memory mapping of the file from the next load(), with buffers pointing straight into it,
+	//instead of copying it through unbuffered reads
+	void setMemoryMapped(bool mapped);
+	bool isMemoryMapped();
+	//reads the file through the system cache from the next load(), rather than around it with unbuffered reads
+	void setSystemCached(bool cached);
+	bool isSystemCached();
+	//converts the file's samples to float on the refill worker from the next load(), so the voice is handed the format
+	//the output mixes in rather than converting on the audio thread; costs a float copy of every buffer.
+	//files that are float already, or not plain samples, go to the voice as they are
+	void setConvertToFloat(bool convert);
+	bool getConvertToFloat();
+	//resamples a file at another rate than the output's to the output's rate on the refill worker from the next load(),
+	//with a windowed-sinc filter of the given quality, instead of leaving it to the voice; the voice then gets float buffers.
+	//speed changes stay on the voice, so they take effect at once rather than after the buffers already queued
+	void setResampling(bool resample, RESAMPLE_QUALITY quality = RQ_GOOD);
+	bool getResampling();
+	//the fastest setSpeed() can play, from the next load() (default 2); higher costs the voice more of the output's time
+	void setMaxSpeed(float maxSpeed);
+	float getMaxSpeed();
+	//reads the file through the engine's stream cache from the next load(), sharing its blocks with every other shared
+	//stream of the same file, so overlapping plays read it from disk once; the buffers are the cache's block size.
+	//doesn't wait on a refill
+	void setShared(bool shared);
+	bool isShared();
+	//takes another stream's buffering, loop and mix settings, ready for the next load()
+	void copySettings(ofXAudioStream& from);
+	//the size of each buffer for the loaded file
+	int getBufferSize();
+	//the number of buffers currently kept queued on the voice
+	int getQueueDepth();
+
+	bool isLoaded();
+	//whether it's playing, counting a start() the worker hasn't got to yet and a refill it's running short on
+	bool isPlaying();
+	//where playback is, and whether it's playing; safe to read from any thread at any time
+	const ofXAudioPlayhead& getPlayhead() { return playhead; }
+	//the number of times the voice ran out of buffers while playing
+	int getUnderrunCount();
+	//adds what the refills since the last load() have been through to snapshot: how long each buffer took to read,
+	//how long the voice waited for each one, how many were queued as each went out, underruns and failed reads.
+	//safe to call from any thread; the engine keeps the same for every stream together
+	void getMetrics(ofXAudioMetrics::Snapshot* snapshot);
+
+	//applies the queued commands and refills the voice's queue; called from the scheduler's workers, one at a time
+	void service();
+
+	//WaveVoiceCallback
+	void OnBufferEnd(void* pContext);
+	//WaveSubmitListener
+	void OnBufferSubmit(const StreamingWave& inFile, const XAUDIO2_BUFFER* pSubmitted, UINT32 buffersQueued);
+
+protected:
+
+	ofXAudioEngine* engine;
+	StreamingWave wave;
+	WaveBlockCache* blocks; //the stream cache's blocks of the file when it's shared; NULL otherwise
+	std::atomic<bool> shared;
+	WaveFormatConverter converter; //set up when the loaded file's buffers are converted to float or resampled
+	bool convertToFloat;
+	bool resample;
+	RESAMPLE_QUALITY resampleQuality;
+	float maxSpeed;
+	WaveVoice* voice;
+	ofXAudioPlayhead playhead;
+	std::mutex mutex; //guards wave and voice between the workers and load/unload
+	std::atomic<bool> accepting; //whether buffer-end callbacks may ask for refills
+	std::atomic<bool> playing;
+	std::atomic<bool> starting; //a start() has been sent and the worker hasn't applied it yet
+	std::atomic<int> underruns;
+	std::atomic<int> durationMS; //the loaded file's length; 0 when nothing is loaded
+	ofXAudioMetrics metrics;
+	INT64 submitMark; //when the refill started on the buffer it's about to submit; only used with the mutex held
+	std::atomic<INT64> bufferEnded; //when the first buffer the refills haven't caught up with yet ended on the voice; 0 if none
+	std::atomic<int> queueDepth; //how many buffers service() keeps queued
+	std::atomic<int> maxQueueDepth; //how far queueDepth may grow
+	std::atomic<bool> refillPending; //a refill has been asked for and service() hasn't finished it
+	std::atomic<bool> finished; //the last buffer of the data is queued, so the voice running dry is the end rather than an underrun
+	std::atomic<bool> flushing; //a seek is flushing the voice, so the buffers ending are neither refills nor underruns
+	bool failed;
+	bool paused; //applied by the worker; the voice is stopped while playing stays set
+	int numBuffers;
+	bool adaptive;
+	int maxBuffers;
+
+	struct Command {
+		enum Type {
+			START,
+			STOP,
+			PAUSE, //value is 1 to pause, 0 to resume
+			VOLUME,
+			PAN,
+			SPEED,
+			LOOP, //value is 1 to loop, 0 to play on to the end
+			SEEK, //ms is where to
+		};
+		Type type;
+		float value;
+		int ms;
+	};
+
+	ofXAudioCommandQueue<Command, 256> commands; //from the app thread to whichever worker services the stream
+	std::atomic<bool> commandsPending; //a worker has been asked to apply the commands and hasn't started on them yet
+	float volume; //the latest settings sent, for the next load()
+	float pan;
+	float speed;
+	bool loop;
+
+	//queues buffers up to queueDepth, noting whether the end of the data went out; call with the mutex held
+	void refill();
+	//queues a command and has a worker pick it up
+	void send(Command::Type type, float value = 0, int ms = 0);
+	//carries out the commands queued since the last call, returning whether a seek left the voice stopped for the
+	//refill to start again; call with the mutex held
+	bool applyCommands();
+	void applyStart();
+	void applySeek(int ms);
+	//tells the playhead where the voice has got to and whether it's playing; call with the mutex held
+	void publishState();
+	//gives the shared blocks back to the stream cache; call with the mutex held
+	void releaseBlocks();
+	//a buffer count within what a voice can have queued, with one more being refilled
+	static int clampBufferCount(int n);
+};
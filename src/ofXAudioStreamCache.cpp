@@ -0,0 +1,140 @@
+#include "ofXAudioStreamCache.h"
+#include "ofXAudioEngine.h"
+#include "ofMain.h"
+
+ofXAudioStreamCache::ofXAudioStreamCache(){
+	maxBytesPerFile = 16 * 1024 * 1024;
+	readAhead = 2;
+}
+
+ofXAudioStreamCache::~ofXAudioStreamCache(){
+	if (!entries.empty()){
+		ofLogWarning()<<"ofXAudioStreamCache destroyed with "<<entries.size()<<" files still streaming";
+	}
+	for (std::map<const WaveBlockCache*, Entry*>::iterator it = entries.begin(); it != entries.end(); ++it){
+		delete it->second->cache;
+		delete it->second;
+	}
+}
+
+WaveBlockCache* ofXAudioStreamCache::acquire(const std::string& path){
+	ofXAudioFilePath filePath = ofXAudioToFilePath(path);
+	UINT64 size = 0;
+	UINT64 modified = 0;
+	if (!waveFileStat(filePath.c_str(), &size, &modified)){
+		return NULL;
+	}
+
+	UINT64 maxBytes;
+	int numBlocks;
+	{
+		std::lock_guard<std::mutex> lock(mutex);
+		std::map<std::string, Entry*>::iterator it = current.find(path);
+		if (it != current.end() && it->second->size == size && it->second->modified == modified){
+			it->second->refCount++;
+			return it->second->cache;
+		}
+		maxBytes = maxBytesPerFile;
+		numBlocks = readAhead;
+	}
+
+	//only the header is read here, without holding up everyone else's lookups
+	WaveInfo header;
+	WaveBlockCache* cache = new WaveBlockCache();
+	if (!cache->open(filePath.c_str(), ofXAudioEngine::findHeader(path, &header))){
+		delete cache;
+		return NULL;
+	}
+	cache->setMaxBytes(maxBytes);
+	cache->setReadAhead(numBlocks);
+
+	std::lock_guard<std::mutex> lock(mutex);
+
+	//someone else may have opened the same version in the meantime
+	std::map<std::string, Entry*>::iterator it = current.find(path);
+	if (it != current.end() && it->second->size == size && it->second->modified == modified){
+		delete cache;
+		it->second->refCount++;
+		return it->second->cache;
+	}
+
+	//any older version stays open in entries until its streams let go of it
+	Entry* e = new Entry();
+	e->path = path;
+	e->size = size;
+	e->modified = modified;
+	e->refCount = 1;
+	e->cache = cache;
+	current[path] = e;
+	entries[cache] = e;
+	return cache;
+}
+
+void ofXAudioStreamCache::release(WaveBlockCache* cache){
+	if (cache == NULL){
+		return;
+	}
+
+	std::lock_guard<std::mutex> lock(mutex);
+	std::map<const WaveBlockCache*, Entry*>::iterator it = entries.find(cache);
+	if (it == entries.end()){
+		ofLogWarning()<<"ofXAudioStreamCache released a file it doesn't hold";
+		return;
+	}
+
+	Entry* e = it->second;
+	if (--e->refCount > 0){
+		return;
+	}
+
+	std::map<std::string, Entry*>::iterator c = current.find(e->path);
+	if (c != current.end() && c->second == e){
+		current.erase(c);
+	}
+	entries.erase(it);
+	delete e->cache;
+	delete e;
+}
+
+void ofXAudioStreamCache::setMaxBytesPerFile(UINT64 bytes){
+	std::lock_guard<std::mutex> lock(mutex);
+	maxBytesPerFile = bytes;
+}
+
+UINT64 ofXAudioStreamCache::getMaxBytesPerFile(){
+	std::lock_guard<std::mutex> lock(mutex);
+	return maxBytesPerFile;
+}
+
+void ofXAudioStreamCache::setReadAhead(int numBlocks){
+	std::lock_guard<std::mutex> lock(mutex);
+	readAhead = (std::max)(numBlocks, 0);
+}
+
+int ofXAudioStreamCache::getReadAhead(){
+	std::lock_guard<std::mutex> lock(mutex);
+	return readAhead;
+}
+
+int ofXAudioStreamCache::getNumFiles(){
+	std::lock_guard<std::mutex> lock(mutex);
+	return entries.size();
+}
+
+UINT64 ofXAudioStreamCache::getNumBytes(){
+	std::lock_guard<std::mutex> lock(mutex);
+	UINT64 bytes = 0;
+	for (std::map<const WaveBlockCache*, Entry*>::iterator it = entries.begin(); it != entries.end(); ++it){
+		bytes += it->second->cache->getCachedBytes();
+	}
+	return bytes;
+}
+
+UINT64 ofXAudioStreamCache::getBytesRead(){
+	std::lock_guard<std::mutex> lock(mutex);
+	UINT64 bytes = 0;
+	for (std::map<const WaveBlockCache*, Entry*>::iterator it = entries.begin(); it != entries.end(); ++it){
+		bytes += it->second->cache->getBytesRead();
+	}
+	return bytes;
+}
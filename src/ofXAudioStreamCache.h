@@ -0,0 +1,51 @@
+#pragma once
+
+#include "waveInfo.h"
+
+#include <map>
+#include <mutex>
+#include <string>
+
+//the block caches of files streamed by several players at once, one per file, so that overlapping plays
+//(a multi-play player retriggered while it's still sounding) read each stretch of the file from disk once.
+//entries are keyed by path and checked against the file's size and modification time like the sample cache's,
+//and a cache is closed when its last stream releases it
+class ofXAudioStreamCache {
+public:
+
+	ofXAudioStreamCache();
+	~ofXAudioStreamCache();
+
+	//gets the file's block cache, opening it if there isn't one (or the file has changed); returns NULL on failure.
+	//every successful acquire() needs a matching release()
+	WaveBlockCache* acquire(const std::string& path);
+	void release(WaveBlockCache* cache);
+
+	//the memory each file's cache may keep in blocks no stream is using, from the next acquire() of a file (default 16MB)
+	void setMaxBytesPerFile(UINT64 bytes);
+	UINT64 getMaxBytesPerFile();
+	//how many blocks each file's cache reads ahead of the streams, from the next acquire() of a file (default 2)
+	void setReadAhead(int numBlocks);
+	int getReadAhead();
+
+	//the number of files open, the memory their blocks take up and the bytes read from them so far
+	int getNumFiles();
+	UINT64 getNumBytes();
+	UINT64 getBytesRead();
+
+protected:
+
+	struct Entry {
+		std::string path;
+		UINT64 size;
+		UINT64 modified;
+		int refCount;
+		WaveBlockCache* cache;
+	};
+
+	std::mutex mutex;
+	std::map<std::string, Entry*> current; //the latest version of each file
+	std::map<const WaveBlockCache*, Entry*> entries; //every entry still in use, including versions a changed file has replaced
+	UINT64 maxBytesPerFile;
+	int readAhead;
+};
@@ -0,0 +1,143 @@
+#include "ofXAudioStreamScheduler.h"
+#include "ofXAudioStream.h"
+
+#include <algorithm>
+
+ofXAudioStreamScheduler::ofXAudioStreamScheduler(){
+	sequence = 0;
+	quitting = false;
+}
+
+ofXAudioStreamScheduler::~ofXAudioStreamScheduler(){
+	close();
+}
+
+void ofXAudioStreamScheduler::setup(int numWorkers){
+	if (numWorkers < 1){
+		numWorkers = 1;
+	}
+
+	std::lock_guard<std::mutex> lock(mutex);
+	quitting = false;
+	servicing.assign(numWorkers, NULL);
+	rerun.assign(numWorkers, false);
+	for (int i = 0; i < numWorkers; i++){
+		workers.push_back(std::thread(&ofXAudioStreamScheduler::threadedFunction, this, i));
+	}
+}
+
+void ofXAudioStreamScheduler::close(){
+	{
+		std::lock_guard<std::mutex> lock(mutex);
+		quitting = true;
+		requests.clear();
+	}
+	wake.notify_all();
+
+	for (size_t i = 0; i < workers.size(); i++){
+		workers[i].join();
+	}
+	workers.clear();
+	servicing.clear();
+	rerun.clear();
+}
+
+void ofXAudioStreamScheduler::schedule(ofXAudioStream* stream, UINT32 buffersQueued){
+	{
+		std::lock_guard<std::mutex> lock(mutex);
+		if (quitting){
+			return;
+		}
+		Request r;
+		r.buffersQueued = buffersQueued;
+		r.sequence = sequence++;
+		r.stream = stream;
+		requests.push_back(r);
+		std::push_heap(requests.begin(), requests.end());
+	}
+	wake.notify_one();
+}
+
+void ofXAudioStreamScheduler::cancel(ofXAudioStream* stream){
+	std::unique_lock<std::mutex> lock(mutex);
+
+	size_t before = requests.size();
+	for (size_t i = 0; i < requests.size(); ){
+		if (requests[i].stream == stream){
+			requests[i] = requests.back();
+			requests.pop_back();
+		} else {
+			i++;
+		}
+	}
+	if (requests.size() != before){
+		std::make_heap(requests.begin(), requests.end());
+	}
+	for (size_t i = 0; i < servicing.size(); i++){
+		if (servicing[i] == stream){
+			rerun[i] = false;
+		}
+	}
+
+	while (std::find(servicing.begin(), servicing.end(), stream) != servicing.end()){
+		idle.wait(lock);
+	}
+}
+
+int ofXAudioStreamScheduler::getNumWorkers(){
+	std::lock_guard<std::mutex> lock(mutex);
+	return workers.size();
+}
+
+int ofXAudioStreamScheduler::getNumPending(){
+	std::lock_guard<std::mutex> lock(mutex);
+	return requests.size();
+}
+
+void ofXAudioStreamScheduler::threadedFunction(int worker){
+#ifdef _WIN32
+	//the workers submit to XAudio2 voices
+	CoInitializeEx( NULL, COINIT_MULTITHREADED );
+#endif
+
+	std::unique_lock<std::mutex> lock(mutex);
+	while (true){
+		while (!quitting && requests.empty()){
+			wake.wait(lock);
+		}
+		if (quitting){
+			break;
+		}
+
+		//take the stream closest to starving
+		std::pop_heap(requests.begin(), requests.end());
+		ofXAudioStream* stream = requests.back().stream;
+		requests.pop_back();
+
+		//a stream can only be serviced by one worker at a time; if another has it,
+		//have that worker go around again once it's done instead
+		std::vector<ofXAudioStream*>::iterator owner = std::find(servicing.begin(), servicing.end(), stream);
+		if (owner != servicing.end()){
+			rerun[owner - servicing.begin()] = true;
+			continue;
+		}
+
+		servicing[worker] = stream;
+		do {
+			rerun[worker] = false;
+			lock.unlock();
+
+			stream->service();
+
+			lock.lock();
+		} while (rerun[worker] && !quitting);
+
+		servicing[worker] = NULL;
+		idle.notify_all();
+	}
+
+#ifdef _WIN32
+	lock.unlock();
+	CoUninitialize();
+#endif
+}
@@ -0,0 +1,62 @@
+#pragma once
+
+#include "waveTypes.h"
+
+#include <condition_variable>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+class ofXAudioStream;
+
+//a small pool of worker threads that refills every streaming voice.
+//streams ask to be serviced when one of their buffers ends, and the workers
+//take them closest-to-starving first, i.e. fewest buffers still queued
+class ofXAudioStreamScheduler {
+public:
+
+	ofXAudioStreamScheduler();
+	~ofXAudioStreamScheduler();
+
+	//starts the workers; call once
+	void setup(int numWorkers);
+	//stops and joins the workers; pending requests are dropped
+	void close();
+
+	//asks for the stream to be refilled, given how many buffers it has left queued.
+	//cheap and non-blocking enough to call from a voice callback
+	void schedule(ofXAudioStream* stream, UINT32 buffersQueued);
+	//drops any pending requests for the stream and waits until no worker is servicing it;
+	//the stream must already be refusing new schedule() calls
+	void cancel(ofXAudioStream* stream);
+
+	int getNumWorkers();
+	//the number of refill requests waiting for a worker
+	int getNumPending();
+
+protected:
+
+	struct Request {
+		UINT32 buffersQueued;
+		UINT64 sequence;
+		ofXAudioStream* stream;
+
+		//the heap keeps the "largest" on top, so order by fewest buffers queued, then oldest request
+		bool operator<(const Request& r) const {
+			if (buffersQueued != r.buffersQueued) return buffersQueued > r.buffersQueued;
+			return sequence > r.sequence;
+		}
+	};
+
+	void threadedFunction(int worker);
+
+	std::mutex mutex;
+	std::condition_variable wake; //signalled when a request is queued
+	std::condition_variable idle; //signalled when a worker finishes servicing a stream
+	std::vector<Request> requests; //a heap
+	std::vector<ofXAudioStream*> servicing; //what each worker is working on, NULL if nothing
+	std::vector<bool> rerun; //whether each worker was asked to service its stream again while it was busy
+	std::vector<std::thread> workers;
+	UINT64 sequence;
+	bool quitting;
+};
@@ -0,0 +1,288 @@
+#include "ofXAudioVoicePool.h"
+#include "ofXAudioEngine.h"
+#include "ofMain.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cstring>
+#include <thread>
+
+ofXAudioVoicePool::ofXAudioVoicePool(){
+	engine = NULL;
+	maxVoices = 0;
+	maxIdle = 32;
+	policy = STEAL_OLDEST;
+	numRequests = 0;
+	numHits = 0;
+	numMisses = 0;
+	numSteals = 0;
+}
+
+ofXAudioVoicePool::~ofXAudioVoicePool(){
+	close();
+}
+
+void ofXAudioVoicePool::setup(ofXAudioEngine* _engine){
+	std::lock_guard<std::mutex> lock(mutex);
+	engine = _engine;
+}
+
+void ofXAudioVoicePool::close(){
+	std::lock_guard<std::mutex> lock(mutex);
+	if (engine == NULL){
+		return;
+	}
+	if (!active.empty()){
+		ofLogWarning()<<"ofXAudioVoicePool closed with "<<active.size()<<" voices still in use";
+	}
+	for (size_t i = 0; i < idle.size(); i++){
+		engine->deleteVoice(idle[i].voice);
+	}
+	idle.clear();
+	engine = NULL;
+}
+
+WaveVoice* ofXAudioVoicePool::acquire(const WAVEFORMATEX* wf, WaveVoiceCallback* callback, float maxFrequencyRatio, ofXAudioVoiceOwner* owner){
+	std::lock_guard<std::mutex> lock(mutex);
+	if (engine == NULL || wf == NULL){
+		return NULL;
+	}
+	numRequests++;
+
+	WaveVoice* voice = NULL;
+	for (size_t i = 0; i < idle.size(); i++){
+		if (matches(idle[i], wf, maxFrequencyRatio)){
+			voice = idle[i].voice;
+			idle.erase(idle.begin() + i);
+			break;
+		}
+	}
+
+	if (voice == NULL && maxVoices > 0 && (int)(active.size() + idle.size()) >= maxVoices){
+		if (!idle.empty()){
+			//make room by letting go of the voice that has been idle longest
+			engine->deleteVoice(idle.back().voice);
+			idle.pop_back();
+		} else if (!steal(wf, maxFrequencyRatio, &voice)){
+			ofLogWarning()<<"ofXAudioVoicePool: all "<<maxVoices<<" voices are in use and none could be stolen";
+			return NULL;
+		}
+	}
+
+	if (voice != NULL){
+		numHits++;
+	} else {
+		voice = engine->newVoice(wf, maxFrequencyRatio);
+		if (voice == NULL){
+			return NULL;
+		}
+		numMisses++;
+	}
+	voice->setCallback(callback);
+
+	Entry e;
+	e.voice = voice;
+	memset(&e.format, 0, sizeof(e.format));
+	memcpy(&e.format, wf, sizeof(WAVEFORMATEX) + (std::min)((size_t)wf->cbSize, sizeof(WAVEFORMATEXTENSIBLE) - sizeof(WAVEFORMATEX)));
+	e.maxFrequencyRatio = maxFrequencyRatio;
+	e.owner = owner;
+	e.acquired = numRequests;
+	active.push_back(e);
+	return voice;
+}
+
+void ofXAudioVoicePool::release(WaveVoice* voice){
+	if (voice == NULL){
+		return;
+	}
+
+	//the voice is still the caller's until it's out of active, so this doesn't need the lock
+	bool reusable = recycle(voice);
+
+	std::lock_guard<std::mutex> lock(mutex);
+	size_t i = 0;
+	while (i < active.size() && active[i].voice != voice){
+		i++;
+	}
+	if (i == active.size()){
+		ofLogWarning()<<"ofXAudioVoicePool released a voice it didn't hand out";
+		return;
+	}
+	Entry e = active[i];
+	active.erase(active.begin() + i);
+
+	if (engine == NULL){
+		return;
+	}
+	if (!reusable || maxIdle <= 0){
+		engine->deleteVoice(voice);
+		return;
+	}
+
+	e.owner = NULL;
+	idle.push_front(e);
+	while ((int)idle.size() > maxIdle){
+		engine->deleteVoice(idle.back().voice);
+		idle.pop_back();
+	}
+}
+
+void ofXAudioVoicePool::setMaxVoices(int _maxVoices){
+	std::lock_guard<std::mutex> lock(mutex);
+	maxVoices = (std::max)(_maxVoices, 0);
+}
+
+int ofXAudioVoicePool::getMaxVoices(){
+	std::lock_guard<std::mutex> lock(mutex);
+	return maxVoices;
+}
+
+void ofXAudioVoicePool::setMaxIdleVoices(int _maxIdle){
+	std::lock_guard<std::mutex> lock(mutex);
+	maxIdle = (std::max)(_maxIdle, 0);
+	while ((int)idle.size() > maxIdle && engine != NULL){
+		engine->deleteVoice(idle.back().voice);
+		idle.pop_back();
+	}
+}
+
+int ofXAudioVoicePool::getMaxIdleVoices(){
+	std::lock_guard<std::mutex> lock(mutex);
+	return maxIdle;
+}
+
+void ofXAudioVoicePool::setStealPolicy(StealPolicy _policy){
+	std::lock_guard<std::mutex> lock(mutex);
+	policy = _policy;
+}
+
+ofXAudioVoicePool::StealPolicy ofXAudioVoicePool::getStealPolicy(){
+	std::lock_guard<std::mutex> lock(mutex);
+	return policy;
+}
+
+int ofXAudioVoicePool::getNumActive(){
+	std::lock_guard<std::mutex> lock(mutex);
+	return active.size();
+}
+
+int ofXAudioVoicePool::getNumIdle(){
+	std::lock_guard<std::mutex> lock(mutex);
+	return idle.size();
+}
+
+UINT64 ofXAudioVoicePool::getNumHits(){
+	std::lock_guard<std::mutex> lock(mutex);
+	return numHits;
+}
+
+UINT64 ofXAudioVoicePool::getNumMisses(){
+	std::lock_guard<std::mutex> lock(mutex);
+	return numMisses;
+}
+
+UINT64 ofXAudioVoicePool::getNumSteals(){
+	std::lock_guard<std::mutex> lock(mutex);
+	return numSteals;
+}
+
+void ofXAudioVoicePool::resetCounters(){
+	std::lock_guard<std::mutex> lock(mutex);
+	numHits = 0;
+	numMisses = 0;
+	numSteals = 0;
+}
+
+bool ofXAudioVoicePool::matches(const Entry& e, const WAVEFORMATEX* wf, float maxFrequencyRatio){
+	//xaudio2 fixes a voice's maximum ratio when it's created, so that's part of the format here
+	const WAVEFORMATEX& f = e.format.Format;
+	if (e.maxFrequencyRatio != maxFrequencyRatio || f.wFormatTag != wf->wFormatTag || f.nChannels != wf->nChannels
+		|| f.nSamplesPerSec != wf->nSamplesPerSec || f.wBitsPerSample != wf->wBitsPerSample || f.nBlockAlign != wf->nBlockAlign
+		|| f.cbSize != wf->cbSize){
+		return false;
+	}
+
+	//the extension (the sample type and speaker layout of an extensible format) has to match too; one too big to keep never does
+	if (wf->cbSize > sizeof(WAVEFORMATEXTENSIBLE) - sizeof(WAVEFORMATEX)){
+		return false;
+	}
+	return memcmp((const BYTE*)&e.format + sizeof(WAVEFORMATEX), (const BYTE*)wf + sizeof(WAVEFORMATEX), wf->cbSize) == 0;
+}
+
+bool ofXAudioVoicePool::recycle(WaveVoice* voice){
+	voice->stop();
+	voice->flush();
+
+	//xaudio2 ends flushed buffers on its next processing pass; until then they could call back into the next user
+	XAUDIO2_VOICE_STATE voiceState = {0};
+	voice->getState(&voiceState);
+	for (int i = 0; voiceState.BuffersQueued > 0 && i < 100; i++){
+		std::this_thread::sleep_for(std::chrono::milliseconds(1));
+		voice->getState(&voiceState);
+	}
+	if (voiceState.BuffersQueued > 0){
+		return false;
+	}
+
+	voice->setCallback(NULL);
+	voice->setVolume(1);
+	voice->setPan(0);
+	voice->setFrequencyRatio(1);
+	return true;
+}
+
+bool ofXAudioVoicePool::steal(const WAVEFORMATEX* wf, float maxFrequencyRatio, WaveVoice** reuse){
+	if (policy == STEAL_NONE){
+		return false;
+	}
+
+	//voices that have played out everything they were given go first, then the policy decides, then age
+	struct Candidate {
+		size_t index;
+		bool playing;
+		float volume;
+		UINT64 acquired;
+		bool operator<(const Candidate& c) const {
+			if (playing != c.playing){
+				return !playing;
+			}
+			if (volume != c.volume){
+				return volume < c.volume;
+			}
+			return acquired < c.acquired;
+		}
+	};
+	std::vector<Candidate> candidates;
+	for (size_t i = 0; i < active.size(); i++){
+		if (active[i].owner == NULL){
+			continue;
+		}
+		XAUDIO2_VOICE_STATE voiceState = {0};
+		active[i].voice->getState(&voiceState);
+		Candidate c;
+		c.index = i;
+		c.playing = voiceState.BuffersQueued > 0;
+		c.volume = policy == STEAL_QUIETEST ? active[i].voice->getVolume() : 0;
+		c.acquired = active[i].acquired;
+		candidates.push_back(c);
+	}
+	std::sort(candidates.begin(), candidates.end());
+
+	for (size_t i = 0; i < candidates.size(); i++){
+		Entry e = active[candidates[i].index];
+		if (!e.owner->OnVoiceSteal(e.voice)){
+			continue;
+		}
+		active.erase(active.begin() + candidates[i].index);
+		numSteals++;
+
+		//one that's the right format goes straight to the new user, saving a create
+		if (recycle(e.voice) && matches(e, wf, maxFrequencyRatio)){
+			*reuse = e.voice;
+		} else {
+			engine->deleteVoice(e.voice);
+		}
+		return true;
+	}
+	return false;
+}
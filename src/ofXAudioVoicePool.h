@@ -0,0 +1,99 @@
+#pragma once
+
+#include "waveTypes.h"
+#include "waveVoice.h"
+
+#include <deque>
+#include <mutex>
+#include <vector>
+
+class ofXAudioEngine;
+
+//a user of a voice that's willing to have it taken back for someone else when the pool is at its limit
+class ofXAudioVoiceOwner {
+public:
+	virtual ~ofXAudioVoiceOwner() {}
+
+	//asked, from whichever thread wants a voice, to give up voice: stop and flush it and forget it.
+	//returns false if that can't be done right now (the owner is busy with it), and the pool looks elsewhere;
+	//it's called with the pool locked, so it mustn't call back into the pool
+	virtual bool OnVoiceSteal(WaveVoice* voice) = 0;
+};
+
+//the source voices of one engine, kept for reuse: a voice given back goes idle rather than being destroyed,
+//and the next request for the same format (channels, rate, sample type and maximum frequency ratio) gets it back
+//without creating one. with a limit on the number of voices, a request that would go over it first destroys the
+//longest idle voice, then takes one from a user that's willing to give it up (see ofXAudioVoiceOwner)
+class ofXAudioVoicePool {
+public:
+
+	enum StealPolicy {
+		STEAL_NONE = 0, //never take a voice from its user; requests over the limit fail
+		STEAL_OLDEST = 1, //take the voice handed out longest ago
+		STEAL_QUIETEST = 2, //take the voice with the lowest volume, the oldest of those on a tie
+	};
+
+	ofXAudioVoicePool();
+	~ofXAudioVoicePool();
+
+	void setup(ofXAudioEngine* engine);
+	//destroys the idle voices; the engine calls it before its output goes away
+	void close();
+
+	//a voice for the format, from the idle voices if there's one that matches; callbacks come from the output's thread.
+	//with an owner the voice may be stolen back later. returns NULL on failure, or if it's at the limit with nothing to steal
+	WaveVoice* acquire(const WAVEFORMATEX* wf, WaveVoiceCallback* callback, float maxFrequencyRatio, ofXAudioVoiceOwner* owner = NULL);
+	//stops the voice, waits for its buffers to end and keeps it for reuse; call without holding anything its callback takes
+	void release(WaveVoice* voice);
+
+	//the most voices there can be at once, in use or idle (default 0, no limit)
+	void setMaxVoices(int maxVoices);
+	int getMaxVoices();
+	//the most voices kept idle; the ones idle longest are destroyed to stay within it (default 32)
+	void setMaxIdleVoices(int maxIdle);
+	int getMaxIdleVoices();
+	//which voice to take back when a request is over the limit; voices that have played out everything they were
+	//given are always taken first (default STEAL_OLDEST)
+	void setStealPolicy(StealPolicy policy);
+	StealPolicy getStealPolicy();
+
+	int getNumActive();
+	int getNumIdle();
+	//requests served without creating a voice (from the idle voices, or by stealing one of the same format),
+	//requests that created one, and requests that took a voice from its user
+	UINT64 getNumHits();
+	UINT64 getNumMisses();
+	UINT64 getNumSteals();
+	void resetCounters();
+
+protected:
+
+	struct Entry {
+		WaveVoice* voice;
+		WAVEFORMATEXTENSIBLE format;
+		float maxFrequencyRatio;
+		ofXAudioVoiceOwner* owner; //NULL if it can't be stolen
+		UINT64 acquired; //when it was handed out, in requests
+	};
+
+	//whether the entry's voice can play the format
+	static bool matches(const Entry& e, const WAVEFORMATEX* wf, float maxFrequencyRatio);
+	//stops the voice, waits for the output to finish with its buffers and puts its settings back, ready for someone else;
+	//false if the buffers didn't end in time
+	static bool recycle(WaveVoice* voice);
+	//takes a voice from its owner to make room, handing it back in reuse if it's the right format and destroying it
+	//otherwise; false if there was none to take. call with the mutex held
+	bool steal(const WAVEFORMATEX* wf, float maxFrequencyRatio, WaveVoice** reuse);
+
+	ofXAudioEngine* engine;
+	std::mutex mutex;
+	std::vector<Entry> active;
+	std::deque<Entry> idle; //the most recently released at the front
+	int maxVoices;
+	int maxIdle;
+	StealPolicy policy;
+	UINT64 numRequests;
+	UINT64 numHits;
+	UINT64 numMisses;
+	UINT64 numSteals;
+};
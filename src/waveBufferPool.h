@@ -0,0 +1,252 @@
+//waveBufferPool.h
+//sector-aligned memory for stream buffers, leased out of large arenas instead of allocated per stream.
+//a lease is rounded up to one of a set of size classes, and goes back on its class's free list when it's returned,
+//unzeroed, for the next stream that wants that size; so streams loading and unloading by the hundred reuse the same
+//memory rather than fragmenting the heap. arenas are backed by huge pages where the system gives them out
+
+#ifndef WAVEBUFFERPOOL_H
+#define WAVEBUFFERPOOL_H
+
+#include "waveTypes.h"
+
+#ifndef _WIN32
+#include <sys/mman.h>
+#endif
+
+#include <map>
+#include <mutex>
+#include <vector>
+
+//the size of an arena; a lease bigger than this gets an arena of its own
+#define WAVEBUFFERPOOL_ARENA_SIZE ( 4 * 1024 * 1024 )
+//leases are carved out in multiples of this, so every lease is aligned to it; more alignment than this isn't pooled
+#define WAVEBUFFERPOOL_GRANULE 4096
+//the size arenas are aligned and rounded to, so they can be backed by huge pages
+#define WAVEBUFFERPOOL_HUGE_PAGE ( 2 * 1024 * 1024 )
+
+class WaveBufferPool
+{
+public:
+	//what the pool holds, for watching its occupancy
+	struct Stats {
+		DWORD arenas; //arenas allocated
+		DWORD hugePageArenas; //those of them backed by huge pages
+		UINT64 reservedBytes; //the memory the arenas take
+		UINT64 leasedBytes; //the memory leased out right now, by size class
+		UINT64 freeBytes; //returned leases waiting on the free lists
+		DWORD leases; //leases out right now
+		UINT64 totalLeases; //leases made since the pool was created
+		UINT64 reusedLeases; //those of them served from a free list
+		UINT64 unpooledLeases; //those of them too strictly aligned to pool, which went to the heap instead
+	};
+
+private:
+	struct Arena {
+		BYTE* memory;
+		size_t size;
+		size_t used; //leases are carved from the front; the rest has never been handed out
+		DWORD leases; //leases out of this arena right now
+		bool hugePages;
+	};
+
+	std::mutex m_mutex;
+	size_t m_arenaSize;
+	std::vector<Arena> m_arenas;
+	std::map<size_t, std::vector<BYTE*> > m_free; //returned leases, by size class
+	Stats m_stats;
+
+	//sizes are rounded to a quarter of their power of two, or to the granule for small ones, so no lease wastes more than a quarter
+	static size_t sizeClass( size_t size ) {
+		size_t granules = ( (std::max)( size, (size_t)1 ) + WAVEBUFFERPOOL_GRANULE - 1 ) / WAVEBUFFERPOOL_GRANULE;
+		if( granules > 4 )
+		{
+			size_t step = (size_t)1 << ( 61 - waveLeadingZeros64( granules - 1 ) );
+			granules = ( granules + step - 1 ) / step * step;
+		}
+		return granules * WAVEBUFFERPOOL_GRANULE;
+	}
+
+	//maps a fresh arena, aligned to a huge page and advised onto them where possible
+	static BYTE* mapArena( size_t size, bool* pHugePages ) {
+		*pHugePages = false;
+#ifdef _WIN32
+		//large pages need the lock pages privilege; without it this fails and the arena uses ordinary pages
+		SIZE_T largePage = GetLargePageMinimum();
+		if( largePage > 0 && size % largePage == 0 )
+		{
+			void* p = VirtualAlloc( NULL, size, MEM_RESERVE | MEM_COMMIT | MEM_LARGE_PAGES, PAGE_READWRITE );
+			if( p != NULL )
+			{
+				*pHugePages = true;
+				return (BYTE*)p;
+			}
+		}
+		return (BYTE*)VirtualAlloc( NULL, size, MEM_RESERVE | MEM_COMMIT, PAGE_READWRITE );
+#else
+		//map a huge page more than needed, then trim it down to an aligned run
+		size_t mapped = size + WAVEBUFFERPOOL_HUGE_PAGE;
+		void* p = mmap( NULL, mapped, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0 );
+		if( p == MAP_FAILED )
+			return NULL;
+		BYTE* begin = (BYTE*)p;
+		BYTE* aligned = begin + ( WAVEBUFFERPOOL_HUGE_PAGE - (size_t)begin % WAVEBUFFERPOOL_HUGE_PAGE ) % WAVEBUFFERPOOL_HUGE_PAGE;
+		if( aligned > begin )
+			munmap( begin, aligned - begin );
+		if( begin + mapped > aligned + size )
+			munmap( aligned + size, begin + mapped - ( aligned + size ) );
+#ifdef MADV_HUGEPAGE
+		*pHugePages = madvise( aligned, size, MADV_HUGEPAGE ) == 0;
+#endif
+		return aligned;
+#endif
+	}
+
+	static void unmapArena( const Arena& a ) {
+#ifdef _WIN32
+		VirtualFree( a.memory, 0, MEM_RELEASE );
+#else
+		munmap( a.memory, a.size );
+#endif
+	}
+
+	//the arena p was leased from, or NULL if it came from the heap
+	Arena* findArena( const BYTE* p ) {
+		for( size_t i = 0; i < m_arenas.size(); i++ )
+		{
+			if( p >= m_arenas[i].memory && p < m_arenas[i].memory + m_arenas[i].size )
+				return &m_arenas[i];
+		}
+		return NULL;
+	}
+
+	//not copyable; streams share the engine's
+	WaveBufferPool( const WaveBufferPool& );
+	WaveBufferPool& operator =( const WaveBufferPool& );
+
+public:
+	WaveBufferPool( size_t arenaSize = WAVEBUFFERPOOL_ARENA_SIZE ) : m_arenaSize( ( (std::max)( arenaSize, (size_t)1 ) + WAVEBUFFERPOOL_HUGE_PAGE - 1 ) / WAVEBUFFERPOOL_HUGE_PAGE * WAVEBUFFERPOOL_HUGE_PAGE ) {
+		memset( &m_stats, 0, sizeof(m_stats) );
+	}
+	//every lease must have been returned by now
+	~WaveBufferPool() {
+		for( size_t i = 0; i < m_arenas.size(); i++ )
+			unmapArena( m_arenas[i] );
+	}
+
+	//leases at least size bytes aligned to alignment; the contents are whatever the last lease left there.
+	//returns NULL if there's no memory for it
+	BYTE* lease( size_t size, size_t alignment ) {
+		std::lock_guard<std::mutex> lock( m_mutex );
+		m_stats.totalLeases++;
+		if( alignment > WAVEBUFFERPOOL_GRANULE || WAVEBUFFERPOOL_GRANULE % (std::max)( alignment, (size_t)1 ) != 0 )
+		{
+			m_stats.unpooledLeases++;
+			return (BYTE*)waveAlignedAlloc( size, alignment );
+		}
+
+		size_t s = sizeClass( size );
+		BYTE* p = NULL;
+		std::vector<BYTE*>& freeList = m_free[s];
+		if( !freeList.empty() )
+		{
+			p = freeList.back();
+			freeList.pop_back();
+			m_stats.freeBytes -= s;
+			m_stats.reusedLeases++;
+		}
+		else
+		{
+			//carve it from the first arena with room, or a new one
+			Arena* a = NULL;
+			for( size_t i = 0; i < m_arenas.size() && a == NULL; i++ )
+			{
+				if( m_arenas[i].size - m_arenas[i].used >= s )
+					a = &m_arenas[i];
+			}
+			if( a == NULL )
+			{
+				Arena n;
+				n.size = (std::max)( m_arenaSize, ( s + WAVEBUFFERPOOL_HUGE_PAGE - 1 ) / WAVEBUFFERPOOL_HUGE_PAGE * WAVEBUFFERPOOL_HUGE_PAGE );
+				n.used = 0;
+				n.leases = 0;
+				n.memory = mapArena( n.size, &n.hugePages );
+				if( n.memory == NULL )
+					return NULL;
+				m_arenas.push_back( n );
+				a = &m_arenas.back();
+				m_stats.arenas++;
+				m_stats.hugePageArenas += n.hugePages ? 1 : 0;
+				m_stats.reservedBytes += n.size;
+			}
+			p = a->memory + a->used;
+			a->used += s;
+		}
+
+		findArena( p )->leases++;
+		m_stats.leases++;
+		m_stats.leasedBytes += s;
+		return p;
+	}
+
+	//gives back a lease of size bytes, as asked for from lease(); NULL is ignored
+	void release( BYTE* p, size_t size ) {
+		if( p == NULL )
+			return;
+		std::lock_guard<std::mutex> lock( m_mutex );
+		Arena* a = findArena( p );
+		if( a == NULL )
+		{
+			waveAlignedFree( p );
+			return;
+		}
+
+		size_t s = sizeClass( size );
+		a->leases--;
+		m_free[s].push_back( p );
+		m_stats.leases--;
+		m_stats.leasedBytes -= s;
+		m_stats.freeBytes += s;
+	}
+
+	//hands the arenas with nothing leased out of them back to the system, returning the bytes freed
+	UINT64 trim() {
+		std::lock_guard<std::mutex> lock( m_mutex );
+		UINT64 freed = 0;
+		for( size_t i = m_arenas.size(); i-- > 0; )
+		{
+			Arena a = m_arenas[i];
+			if( a.leases > 0 )
+				continue;
+
+			//its returned leases go with it
+			for( std::map<size_t, std::vector<BYTE*> >::iterator it = m_free.begin(); it != m_free.end(); ++it )
+			{
+				std::vector<BYTE*>& freeList = it->second;
+				for( size_t j = freeList.size(); j-- > 0; )
+				{
+					if( freeList[j] >= a.memory && freeList[j] < a.memory + a.size )
+					{
+						freeList[j] = freeList.back();
+						freeList.pop_back();
+						m_stats.freeBytes -= it->first;
+					}
+				}
+			}
+
+			unmapArena( a );
+			m_arenas.erase( m_arenas.begin() + i );
+			m_stats.arenas--;
+			m_stats.hugePageArenas -= a.hugePages ? 1 : 0;
+			m_stats.reservedBytes -= a.size;
+			freed += a.size;
+		}
+		return freed;
+	}
+
+	void getStats( Stats* pStats ) {
+		std::lock_guard<std::mutex> lock( m_mutex );
+		*pStats = m_stats;
+	}
+};
+
+#endif
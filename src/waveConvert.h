@@ -0,0 +1,370 @@
+//waveConvert.h
+//turns wave data of any of the common sample types into 32 bit float, the format the output mixes in,
+//so a stream can hand the voice float buffers instead of leaving the conversion to the engine's audio thread.
+//every kernel has a plain c++ version; sse2, avx2 and neon versions give exactly the same results, just faster
+
+#ifndef WAVECONVERT_H
+#define WAVECONVERT_H
+
+#include "waveTypes.h"
+
+#if defined(_M_X64) || defined(__x86_64__) || ( defined(_M_IX86_FP) && _M_IX86_FP >= 2 ) || defined(__SSE2__)
+#define WAVECONVERT_SSE2
+#include <emmintrin.h>
+//avx2 is chosen at run time, so it's only compiled where the compiler can be told to target it per function
+#if defined(_MSC_VER) || defined(__GNUC__) || defined(__clang__)
+#define WAVECONVERT_AVX2
+#include <immintrin.h>
+#ifdef _MSC_VER
+#include <intrin.h>
+#define WAVECONVERT_AVX2_TARGET
+#else
+#define WAVECONVERT_AVX2_TARGET __attribute__((target("avx2")))
+#endif
+#endif
+#endif
+
+#if defined(__ARM_NEON) || defined(__ARM_NEON__) || defined(_M_ARM64)
+#define WAVECONVERT_NEON
+#include <arm_neon.h>
+#endif
+
+//the sample types a wave's data can be in
+enum WAVE_SAMPLE_TYPE {
+	WST_UNKNOWN = 0,
+	WST_UINT8 = 1, //unsigned, centred on 128
+	WST_INT16 = 2,
+	WST_INT24 = 3, //packed into three bytes
+	WST_INT32 = 4,
+	WST_FLOAT32 = 5,
+	WST_FLOAT64 = 6,
+};
+
+//works out the sample type from the format tag (or an extensible format's sub format) and the container size;
+//WST_UNKNOWN for compressed formats and anything else without a plain sample per channel
+inline WAVE_SAMPLE_TYPE waveSampleType( const WAVEFORMATEX* wf ) {
+	if( wf == NULL || wf->nChannels == 0 || wf->nBlockAlign != wf->nChannels * ( wf->wBitsPerSample / 8 ) || wf->wBitsPerSample % 8 != 0 )
+		return WST_UNKNOWN;
+
+	//the KSDATAFORMAT_SUBTYPE guids carry the matching format tag in their first field
+	DWORD tag = wf->wFormatTag;
+	if( tag == WAVE_FORMAT_EXTENSIBLE )
+	{
+		if( wf->cbSize < sizeof(WAVEFORMATEXTENSIBLE) - sizeof(WAVEFORMATEX) )
+			return WST_UNKNOWN;
+		tag = ( (const WAVEFORMATEXTENSIBLE*)wf )->SubFormat.Data1;
+	}
+
+	if( tag == WAVE_FORMAT_PCM )
+	{
+		switch( wf->wBitsPerSample )
+		{
+		case 8: return WST_UINT8;
+		case 16: return WST_INT16;
+		case 24: return WST_INT24;
+		case 32: return WST_INT32;
+		}
+	}
+	else if( tag == WAVE_FORMAT_IEEE_FLOAT )
+	{
+		switch( wf->wBitsPerSample )
+		{
+		case 32: return WST_FLOAT32;
+		case 64: return WST_FLOAT64;
+		}
+	}
+	return WST_UNKNOWN;
+}
+
+//the bytes one sample of the type takes up
+inline DWORD waveSampleSize( WAVE_SAMPLE_TYPE type ) {
+	static const DWORD sizes[] = { 0, 1, 2, 3, 4, 4, 8 };
+	return sizes[ type ];
+}
+
+//the plain versions; the scale factors are powers of two, so the vector versions, converting to float the same way
+//and multiplying by the same factor, land on the same bits
+inline void waveConvertScalar( WAVE_SAMPLE_TYPE type, const BYTE* pSrc, float* pDest, size_t begin, size_t count ) {
+	switch( type )
+	{
+	case WST_UINT8:
+		for( size_t i = begin; i < count; i++ )
+			pDest[i] = (float)( (int)pSrc[i] - 128 ) * ( 1.0f / 128 );
+		break;
+	case WST_INT16:
+		for( size_t i = begin; i < count; i++ )
+		{
+			short s;
+			memcpy( &s, pSrc + i * 2, sizeof(s) );
+			pDest[i] = (float)s * ( 1.0f / 32768 );
+		}
+		break;
+	case WST_INT24:
+		for( size_t i = begin; i < count; i++ )
+		{
+			const BYTE* p = pSrc + i * 3;
+			int s = (int)( ( (DWORD)p[0] << 8 ) | ( (DWORD)p[1] << 16 ) | ( (DWORD)p[2] << 24 ) ) >> 8;
+			pDest[i] = (float)s * ( 1.0f / 8388608 );
+		}
+		break;
+	case WST_INT32:
+		for( size_t i = begin; i < count; i++ )
+		{
+			int s;
+			memcpy( &s, pSrc + i * 4, sizeof(s) );
+			pDest[i] = (float)s * ( 1.0f / 2147483648.0f );
+		}
+		break;
+	case WST_FLOAT32:
+		memcpy( pDest + begin, pSrc + begin * 4, ( count - begin ) * 4 );
+		break;
+	case WST_FLOAT64:
+		for( size_t i = begin; i < count; i++ )
+		{
+			double d;
+			memcpy( &d, pSrc + i * 8, sizeof(d) );
+			pDest[i] = (float)d;
+		}
+		break;
+	default:
+		break;
+	}
+}
+
+#ifdef WAVECONVERT_SSE2
+//converts as many whole vectors as fit, returning where the plain version has to pick up
+inline size_t waveConvertSSE2( WAVE_SAMPLE_TYPE type, const BYTE* pSrc, float* pDest, size_t count ) {
+	size_t i = 0;
+	switch( type )
+	{
+	case WST_UINT8:
+	{
+		const __m128i bias = _mm_set1_epi16( 128 );
+		const __m128 scale = _mm_set1_ps( 1.0f / 128 );
+		const __m128i zero = _mm_setzero_si128();
+		for( ; i + 16 <= count; i += 16 )
+		{
+			__m128i v = _mm_loadu_si128( (const __m128i*)( pSrc + i ) );
+			__m128i lo = _mm_sub_epi16( _mm_unpacklo_epi8( v, zero ), bias );
+			__m128i hi = _mm_sub_epi16( _mm_unpackhi_epi8( v, zero ), bias );
+			//sign extend by putting each 16 bit value in the top half and shifting it back down
+			_mm_storeu_ps( pDest + i, _mm_mul_ps( _mm_cvtepi32_ps( _mm_srai_epi32( _mm_unpacklo_epi16( lo, lo ), 16 ) ), scale ) );
+			_mm_storeu_ps( pDest + i + 4, _mm_mul_ps( _mm_cvtepi32_ps( _mm_srai_epi32( _mm_unpackhi_epi16( lo, lo ), 16 ) ), scale ) );
+			_mm_storeu_ps( pDest + i + 8, _mm_mul_ps( _mm_cvtepi32_ps( _mm_srai_epi32( _mm_unpacklo_epi16( hi, hi ), 16 ) ), scale ) );
+			_mm_storeu_ps( pDest + i + 12, _mm_mul_ps( _mm_cvtepi32_ps( _mm_srai_epi32( _mm_unpackhi_epi16( hi, hi ), 16 ) ), scale ) );
+		}
+		break;
+	}
+	case WST_INT16:
+	{
+		const __m128 scale = _mm_set1_ps( 1.0f / 32768 );
+		for( ; i + 8 <= count; i += 8 )
+		{
+			__m128i v = _mm_loadu_si128( (const __m128i*)( pSrc + i * 2 ) );
+			_mm_storeu_ps( pDest + i, _mm_mul_ps( _mm_cvtepi32_ps( _mm_srai_epi32( _mm_unpacklo_epi16( v, v ), 16 ) ), scale ) );
+			_mm_storeu_ps( pDest + i + 4, _mm_mul_ps( _mm_cvtepi32_ps( _mm_srai_epi32( _mm_unpackhi_epi16( v, v ), 16 ) ), scale ) );
+		}
+		break;
+	}
+	case WST_INT24:
+	{
+		//four samples are twelve bytes; the load takes sixteen, so it stops a vector short of the end
+		const __m128 scale = _mm_set1_ps( 1.0f / 8388608 );
+		for( ; i + 6 <= count; i += 4 )
+		{
+			__m128i v = _mm_loadu_si128( (const __m128i*)( pSrc + i * 3 ) );
+			//line each sample up in the low dword of its own register, then gather the four low dwords
+			__m128i s01 = _mm_unpacklo_epi32( v, _mm_srli_si128( v, 3 ) );
+			__m128i s23 = _mm_unpacklo_epi32( _mm_srli_si128( v, 6 ), _mm_srli_si128( v, 9 ) );
+			__m128i s = _mm_unpacklo_epi64( s01, s23 );
+			s = _mm_srai_epi32( _mm_slli_epi32( s, 8 ), 8 );
+			_mm_storeu_ps( pDest + i, _mm_mul_ps( _mm_cvtepi32_ps( s ), scale ) );
+		}
+		break;
+	}
+	case WST_INT32:
+	{
+		const __m128 scale = _mm_set1_ps( 1.0f / 2147483648.0f );
+		for( ; i + 4 <= count; i += 4 )
+			_mm_storeu_ps( pDest + i, _mm_mul_ps( _mm_cvtepi32_ps( _mm_loadu_si128( (const __m128i*)( pSrc + i * 4 ) ) ), scale ) );
+		break;
+	}
+	case WST_FLOAT64:
+	{
+		for( ; i + 4 <= count; i += 4 )
+		{
+			__m128 lo = _mm_cvtpd_ps( _mm_loadu_pd( (const double*)( pSrc + i * 8 ) ) );
+			__m128 hi = _mm_cvtpd_ps( _mm_loadu_pd( (const double*)( pSrc + i * 8 + 16 ) ) );
+			_mm_storeu_ps( pDest + i, _mm_movelh_ps( lo, hi ) );
+		}
+		break;
+	}
+	default:
+		break;
+	}
+	return i;
+}
+#endif
+
+#ifdef WAVECONVERT_AVX2
+//whether the processor and the os both support avx2
+inline bool waveHasAVX2() {
+#ifdef _MSC_VER
+	int info[4];
+	__cpuid( info, 0 );
+	if( info[0] < 7 )
+		return false;
+	__cpuid( info, 1 );
+	//the os has to save the ymm registers as well as the processor having them
+	if( ( info[2] & ( 1 << 27 ) ) == 0 || ( info[2] & ( 1 << 28 ) ) == 0 || ( _xgetbv( 0 ) & 6 ) != 6 )
+		return false;
+	__cpuidex( info, 7, 0 );
+	return ( info[1] & ( 1 << 5 ) ) != 0;
+#else
+	__builtin_cpu_init();
+	return __builtin_cpu_supports( "avx2" ) != 0;
+#endif
+}
+
+WAVECONVERT_AVX2_TARGET inline size_t waveConvertAVX2( WAVE_SAMPLE_TYPE type, const BYTE* pSrc, float* pDest, size_t count ) {
+	size_t i = 0;
+	switch( type )
+	{
+	case WST_UINT8:
+	{
+		const __m256i bias = _mm256_set1_epi32( 128 );
+		const __m256 scale = _mm256_set1_ps( 1.0f / 128 );
+		for( ; i + 16 <= count; i += 16 )
+		{
+			__m128i v = _mm_loadu_si128( (const __m128i*)( pSrc + i ) );
+			_mm256_storeu_ps( pDest + i, _mm256_mul_ps( _mm256_cvtepi32_ps( _mm256_sub_epi32( _mm256_cvtepu8_epi32( v ), bias ) ), scale ) );
+			_mm256_storeu_ps( pDest + i + 8, _mm256_mul_ps( _mm256_cvtepi32_ps( _mm256_sub_epi32( _mm256_cvtepu8_epi32( _mm_srli_si128( v, 8 ) ), bias ) ), scale ) );
+		}
+		break;
+	}
+	case WST_INT16:
+	{
+		const __m256 scale = _mm256_set1_ps( 1.0f / 32768 );
+		for( ; i + 16 <= count; i += 16 )
+		{
+			__m128i lo = _mm_loadu_si128( (const __m128i*)( pSrc + i * 2 ) );
+			__m128i hi = _mm_loadu_si128( (const __m128i*)( pSrc + i * 2 + 16 ) );
+			_mm256_storeu_ps( pDest + i, _mm256_mul_ps( _mm256_cvtepi32_ps( _mm256_cvtepi16_epi32( lo ) ), scale ) );
+			_mm256_storeu_ps( pDest + i + 8, _mm256_mul_ps( _mm256_cvtepi32_ps( _mm256_cvtepi16_epi32( hi ) ), scale ) );
+		}
+		break;
+	}
+	case WST_INT24:
+	{
+		//eight samples are 24 bytes; the load takes 32, so it stops three samples short of the end.
+		//the permute gives each lane twelve bytes, four samples, and the shuffle puts every sample in the top of a dword
+		const __m256i lanes = _mm256_setr_epi32( 0, 1, 2, 3, 3, 4, 5, 6 );
+		const __m256i spread = _mm256_setr_epi8( -1, 0, 1, 2, -1, 3, 4, 5, -1, 6, 7, 8, -1, 9, 10, 11,
+			-1, 0, 1, 2, -1, 3, 4, 5, -1, 6, 7, 8, -1, 9, 10, 11 );
+		const __m256 scale = _mm256_set1_ps( 1.0f / 8388608 );
+		for( ; i + 11 <= count; i += 8 )
+		{
+			__m256i v = _mm256_loadu_si256( (const __m256i*)( pSrc + i * 3 ) );
+			__m256i s = _mm256_srai_epi32( _mm256_shuffle_epi8( _mm256_permutevar8x32_epi32( v, lanes ), spread ), 8 );
+			_mm256_storeu_ps( pDest + i, _mm256_mul_ps( _mm256_cvtepi32_ps( s ), scale ) );
+		}
+		break;
+	}
+	case WST_INT32:
+	{
+		const __m256 scale = _mm256_set1_ps( 1.0f / 2147483648.0f );
+		for( ; i + 8 <= count; i += 8 )
+			_mm256_storeu_ps( pDest + i, _mm256_mul_ps( _mm256_cvtepi32_ps( _mm256_loadu_si256( (const __m256i*)( pSrc + i * 4 ) ) ), scale ) );
+		break;
+	}
+	case WST_FLOAT64:
+	{
+		for( ; i + 8 <= count; i += 8 )
+		{
+			__m128 lo = _mm256_cvtpd_ps( _mm256_loadu_pd( (const double*)( pSrc + i * 8 ) ) );
+			__m128 hi = _mm256_cvtpd_ps( _mm256_loadu_pd( (const double*)( pSrc + i * 8 + 32 ) ) );
+			_mm256_storeu_ps( pDest + i, _mm256_insertf128_ps( _mm256_castps128_ps256( lo ), hi, 1 ) );
+		}
+		break;
+	}
+	default:
+		break;
+	}
+	return i;
+}
+#endif
+
+#ifdef WAVECONVERT_NEON
+inline size_t waveConvertNEON( WAVE_SAMPLE_TYPE type, const BYTE* pSrc, float* pDest, size_t count ) {
+	size_t i = 0;
+	switch( type )
+	{
+	case WST_UINT8:
+	{
+		const int16x8_t bias = vdupq_n_s16( 128 );
+		for( ; i + 8 <= count; i += 8 )
+		{
+			int16x8_t v = vsubq_s16( vreinterpretq_s16_u16( vmovl_u8( vld1_u8( pSrc + i ) ) ), bias );
+			vst1q_f32( pDest + i, vmulq_n_f32( vcvtq_f32_s32( vmovl_s16( vget_low_s16( v ) ) ), 1.0f / 128 ) );
+			vst1q_f32( pDest + i + 4, vmulq_n_f32( vcvtq_f32_s32( vmovl_s16( vget_high_s16( v ) ) ), 1.0f / 128 ) );
+		}
+		break;
+	}
+	case WST_INT16:
+	{
+		for( ; i + 8 <= count; i += 8 )
+		{
+			int16x8_t v = vreinterpretq_s16_u8( vld1q_u8( pSrc + i * 2 ) );
+			vst1q_f32( pDest + i, vmulq_n_f32( vcvtq_f32_s32( vmovl_s16( vget_low_s16( v ) ) ), 1.0f / 32768 ) );
+			vst1q_f32( pDest + i + 4, vmulq_n_f32( vcvtq_f32_s32( vmovl_s16( vget_high_s16( v ) ) ), 1.0f / 32768 ) );
+		}
+		break;
+	}
+	case WST_INT24:
+	{
+		//the structure load splits eight samples into their low, middle and high bytes
+		for( ; i + 8 <= count; i += 8 )
+		{
+			uint8x8x3_t b = vld3_u8( pSrc + i * 3 );
+			uint16x8_t lo = vorrq_u16( vmovl_u8( b.val[0] ), vshll_n_u8( b.val[1], 8 ) );
+			uint16x8_t hi = vshll_n_u8( b.val[2], 8 );
+			//each sample in the top 24 bits of a dword, then shifted down with its sign
+			int32x4_t s0 = vreinterpretq_s32_u32( vorrq_u32( vshll_n_u16( vget_low_u16( lo ), 8 ), vshll_n_u16( vget_low_u16( hi ), 16 ) ) );
+			int32x4_t s1 = vreinterpretq_s32_u32( vorrq_u32( vshll_n_u16( vget_high_u16( lo ), 8 ), vshll_n_u16( vget_high_u16( hi ), 16 ) ) );
+			vst1q_f32( pDest + i, vmulq_n_f32( vcvtq_f32_s32( vshrq_n_s32( s0, 8 ) ), 1.0f / 8388608 ) );
+			vst1q_f32( pDest + i + 4, vmulq_n_f32( vcvtq_f32_s32( vshrq_n_s32( s1, 8 ) ), 1.0f / 8388608 ) );
+		}
+		break;
+	}
+	case WST_INT32:
+	{
+		for( ; i + 4 <= count; i += 4 )
+			vst1q_f32( pDest + i, vmulq_n_f32( vcvtq_f32_s32( vreinterpretq_s32_u8( vld1q_u8( pSrc + i * 4 ) ) ), 1.0f / 2147483648.0f ) );
+		break;
+	}
+	default:
+		break;
+	}
+	return i;
+}
+#endif
+
+//converts count samples of the type to float, with the fastest kernel the processor has;
+//the source needn't be aligned, and the two mustn't overlap
+inline void waveConvertToFloat( WAVE_SAMPLE_TYPE type, const BYTE* pSrc, float* pDest, size_t count ) {
+	size_t done = 0;
+	if( type != WST_FLOAT32 )
+	{
+#if defined(WAVECONVERT_AVX2)
+		static const bool avx2 = waveHasAVX2();
+		done = avx2 ? waveConvertAVX2( type, pSrc, pDest, count ) : waveConvertSSE2( type, pSrc, pDest, count );
+#elif defined(WAVECONVERT_SSE2)
+		done = waveConvertSSE2( type, pSrc, pDest, count );
+#elif defined(WAVECONVERT_NEON)
+		done = waveConvertNEON( type, pSrc, pDest, count );
+#endif
+	}
+	waveConvertScalar( type, pSrc, pDest, done, count );
+}
+
+#endif
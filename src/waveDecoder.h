@@ -0,0 +1,770 @@
+//waveDecoder.h
+//decodes compressed audio files to pcm a stretch at a time, so StreamingWave can stream them through the same buffers
+//it streams wave data through. WaveDecoder is the interface the streaming code sees; WaveFlacDecoder implements it for
+//native FLAC files, reading them through a WaveFileSource like everything else. other formats plug in the same way
+
+#ifndef WAVEDECODER_H
+#define WAVEDECODER_H
+
+#include "waveTypes.h"
+#include "waveFileSource.h"
+
+#include <vector>
+
+//a compressed file, decoded to pcm of the format it describes. decoding goes forward from the current position;
+//seek() moves it, which costs more than carrying on
+class WaveDecoder
+{
+public:
+	virtual ~WaveDecoder() {}
+
+	//reads the file's header from source, which stays the caller's and must outlive this decoder;
+	//returns false if the file isn't in this decoder's format, or can't be decoded
+	virtual bool open( WaveFileSource* source ) = 0;
+	virtual void close() = 0;
+
+	//the pcm the file decodes to
+	virtual const WAVEFORMATEXTENSIBLE* wfex() const = 0;
+	//the length of the decoded audio, in sample frames
+	virtual UINT64 getLength() const = 0;
+	//the sample frame the next decode() starts at
+	virtual UINT64 getPosition() const = 0;
+	//moves to a sample frame, clamped to the length; returns false if the file couldn't be read or decoded there
+	virtual bool seek( UINT64 frame ) = 0;
+	//decodes up to frames sample frames into pDest, setting *pDecoded to how many there were, which is short only
+	//at the end of the audio; returns false if the file couldn't be read, or is damaged
+	virtual bool decode( BYTE* pDest, DWORD frames, DWORD* pDecoded ) = 0;
+
+	//a decoder for the file open in source, trying each format there's a decoder for; NULL if none of them take it
+	static WaveDecoder* create( WaveFileSource* source );
+};
+
+//native FLAC, of up to 8 channels and 24 bits. it decodes a frame at a time, keeping the one it's part way through;
+//seeks go through the file's seek table where it has one, and skip whole frames from there without decoding them
+class WaveFlacDecoder : public WaveDecoder
+{
+private:
+	//a place in the file that's known to start a frame
+	struct SeekPoint
+	{
+		UINT64 sample;
+		UINT64 offset; //from the start of the file
+	};
+
+	//what a frame header says about the frame
+	struct FrameHeader
+	{
+		UINT64 sample; //the first sample frame in it
+		DWORD blockSize; //the sample frames in it
+		DWORD channelAssignment; //0 to 7 independent channels, 8 left/side, 9 side/right, 10 mid/side
+		DWORD bitsPerSample;
+		DWORD size; //of the header, in bytes
+	};
+
+	//reads bits from the top down out of a frame's bytes
+	struct BitReader
+	{
+		const BYTE* p;
+		const BYTE* end;
+		UINT64 cache; //the next bits, from the top
+		DWORD bits; //how many of cache's bits are valid
+		bool overrun; //a read went past the end
+
+		void refill() {
+			while( bits <= 56 && p < end )
+			{
+				cache |= (UINT64)*p++ << ( 56 - bits );
+				bits += 8;
+			}
+		}
+		//n is at most 32
+		DWORD read( DWORD n ) {
+			if( n == 0 )
+				return 0;
+			if( bits < n )
+			{
+				refill();
+				if( bits < n )
+				{
+					overrun = true;
+					return 0;
+				}
+			}
+			DWORD v = (DWORD)( cache >> ( 64 - n ) );
+			cache <<= n;
+			bits -= n;
+			return v;
+		}
+		INT32 readSigned( DWORD n ) {
+			if( n == 0 )
+				return 0;
+			DWORD v = read( n );
+			return n < 32 ? (INT32)( v << ( 32 - n ) ) >> ( 32 - n ) : (INT32)v;
+		}
+		//the number of zeros before the next one, which is read as well
+		DWORD readUnary() {
+			DWORD zeros = 0;
+			while( true )
+			{
+				if( cache != 0 )
+				{
+					DWORD lz = waveLeadingZeros64( cache );
+					if( lz < bits )
+					{
+						zeros += lz;
+						cache = lz < 63 ? cache << ( lz + 1 ) : 0;
+						bits -= lz + 1;
+						return zeros;
+					}
+				}
+				zeros += bits;
+				cache = 0;
+				bits = 0;
+				refill();
+				if( bits == 0 )
+				{
+					overrun = true;
+					return zeros;
+				}
+			}
+		}
+		//skips to the next byte boundary
+		void align() { read( bits % 8 ); }
+		//the bytes read so far, from start
+		size_t consumed( const BYTE* start ) const { return ( p - start ) - bits / 8; }
+	};
+
+	WaveFileSource* m_source;
+	WAVEFORMATEXTENSIBLE m_wf;
+	DWORD m_minBlockSize;
+	DWORD m_maxBlockSize;
+	DWORD m_channels;
+	DWORD m_bitsPerSample;
+	DWORD m_sampleRate;
+	UINT64 m_length;
+	UINT64 m_firstFrame; //the file offset of the first frame, just past the metadata
+	std::vector<SeekPoint> m_seekTable; //from the file, then added to every second or so as frames are found
+	UINT64 m_nextIndexSample; //where the next point goes into m_seekTable
+
+	//a sector-aligned stretch of the file; frames are decoded straight out of it
+	BYTE* m_window;
+	DWORD m_windowSize;
+	DWORD m_sectorAlignment;
+	UINT64 m_windowOffset; //~0 when nothing's been read into it
+	DWORD m_windowBytes;
+	DWORD m_maxFrameBytes; //the most a frame (and its header) can take up
+
+	//the frame decoded last, one run of samples per channel
+	std::vector<INT32> m_samples;
+	UINT64 m_frameSample; //its first sample frame
+	DWORD m_frameLength; //the sample frames in it
+	DWORD m_frameRead; //how many of them have been handed out
+	UINT64 m_nextOffset; //the file offset of the frame after it
+	UINT64 m_nextSample; //and its first sample frame
+
+	//not copyable; open another on a duplicate of the source
+	WaveFlacDecoder( const WaveFlacDecoder& );
+	WaveFlacDecoder& operator=( const WaveFlacDecoder& );
+
+	static BYTE crc8( const BYTE* p, DWORD n ) {
+		BYTE crc = 0;
+		for( DWORD i = 0; i < n; i++ )
+		{
+			crc ^= p[i];
+			for( int b = 0; b < 8; b++ )
+				crc = (BYTE)( crc & 0x80 ? ( crc << 1 ) ^ 0x07 : crc << 1 );
+		}
+		return crc;
+	}
+
+	//points at length bytes of the file from offset, reading them into the window if they aren't there already;
+	//*pAvailable is short of length at the end of the file. NULL if the read failed
+	const BYTE* peek( UINT64 offset, DWORD length, DWORD* pAvailable ) {
+		*pAvailable = 0;
+		if( offset < m_windowOffset || offset + length > m_windowOffset + m_windowBytes )
+		{
+			//a window that stopped short of its size reached the end of the file, and already has everything there is
+			bool atEnd = m_windowBytes < m_windowSize && offset >= m_windowOffset && offset <= m_windowOffset + m_windowBytes;
+			if( !atEnd )
+			{
+				m_windowOffset = offset - offset % m_sectorAlignment;
+				if( !m_source->read( m_windowOffset, m_window, m_windowSize, &m_windowBytes ) )
+				{
+					m_windowOffset = ~(UINT64)0;
+					m_windowBytes = 0;
+					return NULL;
+				}
+			}
+		}
+		UINT64 end = m_windowOffset + m_windowBytes;
+		*pAvailable = offset < end ? (DWORD)(std::min)( (UINT64)length, end - offset ) : 0;
+		return m_window + ( offset - m_windowOffset );
+	}
+
+	//reads the frame header at offset; false if there isn't a valid one there
+	bool readFrameHeader( UINT64 offset, FrameHeader* h ) {
+		DWORD available = 0;
+		const BYTE* p = peek( offset, 16, &available );
+		if( p == NULL || available < 6 || p[0] != 0xFF || ( p[1] & 0xFE ) != 0xF8 )
+			return false;
+
+		bool variable = ( p[1] & 1 ) != 0;
+		DWORD blockCode = p[2] >> 4, rateCode = p[2] & 15;
+		DWORD channelCode = p[3] >> 4, sizeCode = ( p[3] >> 1 ) & 7;
+		if( blockCode == 0 || rateCode == 15 || channelCode > 10 || sizeCode == 3 || ( p[3] & 1 ) != 0 )
+			return false;
+
+		//the frame or sample number, utf-8 style
+		DWORD n = 4;
+		DWORD lead = 0;
+		while( lead < 8 && ( p[n] & ( 0x80 >> lead ) ) )
+			lead++;
+		if( lead == 1 || lead > 7 )
+			return false;
+		UINT64 number = lead == 0 ? p[n] : p[n] & ( 0x7F >> lead );
+		DWORD extra = lead == 0 ? 0 : lead - 1;
+		if( n + 1 + extra > available )
+			return false;
+		for( DWORD i = 1; i <= extra; i++ )
+		{
+			if( ( p[n + i] & 0xC0 ) != 0x80 )
+				return false;
+			number = ( number << 6 ) | ( p[n + i] & 0x3F );
+		}
+		n += 1 + extra;
+
+		if( blockCode == 1 )
+			h->blockSize = 192;
+		else if( blockCode <= 5 )
+			h->blockSize = 576 << ( blockCode - 2 );
+		else if( blockCode == 6 )
+			h->blockSize = ( n < available ? p[n] : 0 ) + 1, n += 1;
+		else if( blockCode == 7 )
+			h->blockSize = ( n + 1 < available ? ( p[n] << 8 | p[n + 1] ) : 0 ) + 1, n += 2;
+		else
+			h->blockSize = 256 << ( blockCode - 8 );
+		if( rateCode == 12 )
+			n += 1;
+		else if( rateCode == 13 || rateCode == 14 )
+			n += 2;
+		if( n >= available || crc8( p, n ) != p[n] )
+			return false;
+
+		static const DWORD sizes[] = { 0, 8, 12, 0, 16, 20, 24, 32 };
+		h->bitsPerSample = sizeCode == 0 ? m_bitsPerSample : sizes[sizeCode];
+		h->channelAssignment = channelCode;
+		h->sample = variable ? number : number * m_minBlockSize;
+		h->size = n + 1;
+
+		//a frame that doesn't fit the stream is taken for data that happens to look like a header
+		DWORD channels = channelCode < 8 ? channelCode + 1 : 2;
+		return channels == m_channels && h->bitsPerSample == m_bitsPerSample && h->blockSize <= m_maxBlockSize;
+	}
+
+	//finds the next frame header from offset on that starts at expectedSample; false if there's none before the end of the file
+	bool findFrame( UINT64 offset, UINT64 expectedSample, UINT64* pOffset, FrameHeader* h ) {
+		DWORD chunk = m_windowSize - m_sectorAlignment;
+		while( true )
+		{
+			DWORD available = 0;
+			const BYTE* p = peek( offset, chunk, &available );
+			if( p == NULL || available < 2 )
+				return false;
+			for( DWORD i = 0; i + 1 < available; i++ )
+			{
+				if( p[i] != 0xFF || ( p[i + 1] & 0xFE ) != 0xF8 )
+					continue;
+				if( readFrameHeader( offset + i, h ) && h->sample == expectedSample )
+				{
+					*pOffset = offset + i;
+					return true;
+				}
+				//reading the header may have moved the window
+				p = peek( offset, chunk, &available );
+				if( p == NULL )
+					return false;
+			}
+			offset += available - 1;
+		}
+	}
+
+	//the residual of a subframe, added in place to the warm-up already in pOut
+	bool decodeResidual( BitReader& br, DWORD blockSize, DWORD order, INT32* pOut ) {
+		DWORD method = br.read( 2 );
+		if( method > 1 )
+			return false;
+		DWORD paramBits = method == 0 ? 4 : 5, escape = method == 0 ? 15 : 31;
+		DWORD partitionOrder = br.read( 4 );
+		DWORD partitions = 1u << partitionOrder;
+		if( ( blockSize >> partitionOrder ) < order || ( blockSize & ( partitions - 1 ) ) != 0 )
+			return false;
+
+		DWORD i = order;
+		for( DWORD part = 0; part < partitions; part++ )
+		{
+			DWORD end = ( part + 1 ) * ( blockSize >> partitionOrder );
+			DWORD param = br.read( paramBits );
+			if( param == escape )
+			{
+				DWORD bits = br.read( 5 );
+				for( ; i < end; i++ )
+					pOut[i] = br.readSigned( bits );
+			}
+			else
+			{
+				for( ; i < end; i++ )
+				{
+					DWORD q = br.readUnary();
+					DWORD v = ( q << param ) | br.read( param );
+					pOut[i] = (INT32)( v >> 1 ) ^ -(INT32)( v & 1 );
+				}
+			}
+			if( br.overrun )
+				return false;
+		}
+		return true;
+	}
+
+	//one channel's subframe into pOut
+	bool decodeSubframe( BitReader& br, DWORD blockSize, DWORD bitsPerSample, INT32* pOut ) {
+		if( br.read( 1 ) != 0 )
+			return false;
+		DWORD type = br.read( 6 );
+		DWORD wasted = 0;
+		if( br.read( 1 ) )
+			wasted = br.readUnary() + 1;
+		if( wasted >= bitsPerSample )
+			return false;
+		bitsPerSample -= wasted;
+
+		if( type == 0 )
+		{
+			INT32 v = br.readSigned( bitsPerSample );
+			for( DWORD i = 0; i < blockSize; i++ )
+				pOut[i] = v;
+		}
+		else if( type == 1 )
+		{
+			for( DWORD i = 0; i < blockSize; i++ )
+				pOut[i] = br.readSigned( bitsPerSample );
+		}
+		else if( type >= 8 && type <= 12 )
+		{
+			DWORD order = type - 8;
+			if( order > blockSize )
+				return false;
+			for( DWORD i = 0; i < order; i++ )
+				pOut[i] = br.readSigned( bitsPerSample );
+			if( !decodeResidual( br, blockSize, order, pOut ) )
+				return false;
+			switch( order )
+			{
+			case 1: for( DWORD i = 1; i < blockSize; i++ ) pOut[i] += pOut[i - 1]; break;
+			case 2: for( DWORD i = 2; i < blockSize; i++ ) pOut[i] += 2 * pOut[i - 1] - pOut[i - 2]; break;
+			case 3: for( DWORD i = 3; i < blockSize; i++ ) pOut[i] += 3 * pOut[i - 1] - 3 * pOut[i - 2] + pOut[i - 3]; break;
+			case 4: for( DWORD i = 4; i < blockSize; i++ ) pOut[i] += 4 * pOut[i - 1] - 6 * pOut[i - 2] + 4 * pOut[i - 3] - pOut[i - 4]; break;
+			}
+		}
+		else if( type >= 32 )
+		{
+			DWORD order = type - 31;
+			if( order > blockSize )
+				return false;
+			for( DWORD i = 0; i < order; i++ )
+				pOut[i] = br.readSigned( bitsPerSample );
+			DWORD precision = br.read( 4 ) + 1;
+			INT32 shift = br.readSigned( 5 );
+			if( precision == 16 || shift < 0 )
+				return false;
+			INT32 coefficients[32];
+			for( DWORD j = 0; j < order; j++ )
+				coefficients[j] = br.readSigned( precision );
+			if( !decodeResidual( br, blockSize, order, pOut ) )
+				return false;
+			//the sum fits 32 bits unless the samples, coefficients and order are all wide
+			DWORD orderBits = 0;
+			while( ( 1u << orderBits ) < order )
+				orderBits++;
+			if( bitsPerSample + precision + orderBits <= 32 )
+			{
+				for( DWORD i = order; i < blockSize; i++ )
+				{
+					INT32 sum = 0;
+					for( DWORD j = 0; j < order; j++ )
+						sum += coefficients[j] * pOut[i - 1 - j];
+					pOut[i] += sum >> shift;
+				}
+			}
+			else
+			{
+				for( DWORD i = order; i < blockSize; i++ )
+				{
+					INT64 sum = 0;
+					for( DWORD j = 0; j < order; j++ )
+						sum += (INT64)coefficients[j] * pOut[i - 1 - j];
+					pOut[i] += (INT32)( sum >> shift );
+				}
+			}
+		}
+		else
+		{
+			return false;
+		}
+
+		if( wasted > 0 )
+		{
+			for( DWORD i = 0; i < blockSize; i++ )
+				pOut[i] = (INT32)( (DWORD)pOut[i] << wasted );
+		}
+		return !br.overrun;
+	}
+
+	//decodes the frame at offset, whose header is h, into m_samples; false if it's damaged or cut short
+	bool decodeFrame( UINT64 offset, const FrameHeader& h ) {
+		DWORD available = 0;
+		const BYTE* p = peek( offset, m_maxFrameBytes, &available );
+		if( p == NULL || available <= h.size )
+			return false;
+
+		BitReader br;
+		br.p = p + h.size;
+		br.end = p + available;
+		br.cache = 0;
+		br.bits = 0;
+		br.overrun = false;
+
+		//the side channel of a stereo pair takes an extra bit
+		for( DWORD c = 0; c < m_channels; c++ )
+		{
+			bool side = ( h.channelAssignment == 8 && c == 1 ) || ( h.channelAssignment == 9 && c == 0 ) || ( h.channelAssignment == 10 && c == 1 );
+			if( !decodeSubframe( br, h.blockSize, h.bitsPerSample + ( side ? 1 : 0 ), &m_samples[ (size_t)c * m_maxBlockSize ] ) )
+				return false;
+		}
+		br.align();
+		br.read( 16 ); //the frame's crc
+		if( br.overrun )
+			return false;
+
+		INT32* a = &m_samples[0];
+		INT32* b = &m_samples[ m_maxBlockSize ];
+		switch( h.channelAssignment )
+		{
+		case 8: //left, side
+			for( DWORD i = 0; i < h.blockSize; i++ ) b[i] = a[i] - b[i];
+			break;
+		case 9: //side, right
+			for( DWORD i = 0; i < h.blockSize; i++ ) a[i] += b[i];
+			break;
+		case 10: //mid, side
+			for( DWORD i = 0; i < h.blockSize; i++ )
+			{
+				INT32 mid = (INT32)( (DWORD)a[i] << 1 ) | ( b[i] & 1 );
+				INT32 s = b[i];
+				a[i] = ( mid + s ) >> 1;
+				b[i] = ( mid - s ) >> 1;
+			}
+			break;
+		}
+
+		m_frameSample = h.sample;
+		m_frameLength = (DWORD)(std::min)( (UINT64)h.blockSize, m_length > h.sample ? m_length - h.sample : 0 );
+		m_frameRead = 0;
+		m_nextOffset = offset + br.consumed( p );
+		m_nextSample = h.sample + h.blockSize;
+
+		//remember where frames are, for seeking back to them
+		if( h.sample >= m_nextIndexSample && ( m_seekTable.empty() || h.sample > m_seekTable.back().sample ) )
+		{
+			SeekPoint s = { h.sample, offset };
+			m_seekTable.push_back( s );
+			m_nextIndexSample = h.sample + m_sampleRate;
+		}
+		return true;
+	}
+
+	//decodes the next frame after the current one
+	bool nextFrame() {
+		FrameHeader h;
+		if( !readFrameHeader( m_nextOffset, &h ) || h.sample != m_nextSample )
+		{
+			//something other than a frame in the way; skip to the frame that should come next
+			UINT64 offset = 0;
+			if( !findFrame( m_nextOffset, m_nextSample, &offset, &h ) )
+				return false;
+			m_nextOffset = offset;
+		}
+		return decodeFrame( m_nextOffset, h );
+	}
+
+	//writes frames sample frames from the current frame as interleaved pcm
+	void output( BYTE* pDest, DWORD frames ) {
+		DWORD container = m_wf.Format.wBitsPerSample;
+		DWORD shift = container - m_bitsPerSample;
+		for( DWORD i = 0; i < frames; i++ )
+		{
+			for( DWORD c = 0; c < m_channels; c++ )
+			{
+				INT32 s = m_samples[ (size_t)c * m_maxBlockSize + m_frameRead + i ];
+				DWORD v = (DWORD)s << shift;
+				if( container == 8 )
+				{
+					*pDest++ = (BYTE)( v + 128 );
+				}
+				else if( container == 16 )
+				{
+					WORD w = (WORD)v;
+					memcpy( pDest, &w, 2 );
+					pDest += 2;
+				}
+				else
+				{
+					pDest[0] = (BYTE)v;
+					pDest[1] = (BYTE)( v >> 8 );
+					pDest[2] = (BYTE)( v >> 16 );
+					pDest += 3;
+				}
+			}
+		}
+		m_frameRead += frames;
+	}
+
+public:
+	WaveFlacDecoder() : m_source(NULL), m_minBlockSize(0), m_maxBlockSize(0), m_channels(0), m_bitsPerSample(0), m_sampleRate(0), m_length(0), m_firstFrame(0), m_nextIndexSample(0),
+		m_window(NULL), m_windowSize(0), m_sectorAlignment(0), m_windowOffset(~(UINT64)0), m_windowBytes(0), m_maxFrameBytes(0),
+		m_frameSample(0), m_frameLength(0), m_frameRead(0), m_nextOffset(0), m_nextSample(0) {
+		memset( &m_wf, 0, sizeof(m_wf) );
+	}
+	~WaveFlacDecoder() { close(); }
+
+	bool open( WaveFileSource* source ) {
+		close();
+		if( source == NULL || !source->isOpen() )
+			return false;
+		m_source = source;
+		m_sectorAlignment = source->sectorSize();
+		m_windowSize = ( 65536 + m_sectorAlignment - 1 ) / m_sectorAlignment * m_sectorAlignment + m_sectorAlignment;
+		m_window = (BYTE*)waveAlignedAlloc( m_windowSize, m_sectorAlignment );
+		m_windowOffset = ~(UINT64)0;
+		m_windowBytes = 0;
+		if( m_window == NULL )
+		{
+			close();
+			return false;
+		}
+
+		//an id3v2 tag can come before the stream
+		UINT64 offset = 0;
+		DWORD available = 0;
+		const BYTE* p = peek( 0, 10, &available );
+		if( p != NULL && available == 10 && p[0] == 'I' && p[1] == 'D' && p[2] == '3' )
+			offset = 10 + ( (UINT64)( p[6] & 0x7F ) << 21 | ( p[7] & 0x7F ) << 14 | ( p[8] & 0x7F ) << 7 | ( p[9] & 0x7F ) ) + ( p[5] & 0x10 ? 10 : 0 );
+		p = peek( offset, 4, &available );
+		if( p == NULL || available < 4 || memcmp( p, "fLaC", 4 ) != 0 )
+		{
+			close();
+			return false;
+		}
+		offset += 4;
+
+		//the metadata blocks; the stream info comes first, and the seek table is the only other one that matters here
+		bool last = false, haveInfo = false;
+		while( !last )
+		{
+			p = peek( offset, 4, &available );
+			if( p == NULL || available < 4 )
+			{
+				close();
+				return false;
+			}
+			last = ( p[0] & 0x80 ) != 0;
+			DWORD type = p[0] & 0x7F;
+			DWORD length = (DWORD)p[1] << 16 | (DWORD)p[2] << 8 | p[3];
+			offset += 4;
+
+			if( type == 0 && length >= 34 )
+			{
+				p = peek( offset, 34, &available );
+				if( p == NULL || available < 34 )
+				{
+					close();
+					return false;
+				}
+				m_minBlockSize = (DWORD)p[0] << 8 | p[1];
+				m_maxBlockSize = (DWORD)p[2] << 8 | p[3];
+				DWORD maxFrameSize = (DWORD)p[7] << 16 | (DWORD)p[8] << 8 | p[9];
+				m_sampleRate = (DWORD)p[10] << 12 | (DWORD)p[11] << 4 | p[12] >> 4;
+				m_channels = ( ( p[12] >> 1 ) & 7 ) + 1;
+				m_bitsPerSample = ( ( (DWORD)( p[12] & 1 ) << 4 ) | p[13] >> 4 ) + 1;
+				m_length = (UINT64)( p[13] & 15 ) << 32 | (UINT64)p[14] << 24 | (UINT64)p[15] << 16 | (UINT64)p[16] << 8 | p[17];
+				//the worst a frame can be is every subframe verbatim, with a side channel's extra bit
+				m_maxFrameBytes = maxFrameSize > 0 ? maxFrameSize : m_maxBlockSize * m_channels * ( m_bitsPerSample + 1 ) / 8 + 64;
+				haveInfo = true;
+			}
+			else if( type == 3 )
+			{
+				for( DWORD i = 0; i + 18 <= length; i += 18 )
+				{
+					p = peek( offset + i, 18, &available );
+					if( p == NULL || available < 18 )
+						break;
+					SeekPoint s = { 0, 0 };
+					for( int b = 0; b < 8; b++ )
+					{
+						s.sample = s.sample << 8 | p[b];
+						s.offset = s.offset << 8 | p[8 + b];
+					}
+					if( s.sample != ~(UINT64)0 ) //a placeholder
+						m_seekTable.push_back( s );
+				}
+			}
+			offset += length;
+		}
+
+		//a stream of unknown length can't be streamed with a known duration; nor can more than this plays
+		if( !haveInfo || m_length == 0 || m_sampleRate == 0 || m_channels > 8 || m_bitsPerSample < 4 || m_bitsPerSample > 24 || m_minBlockSize < 16 || m_maxBlockSize < m_minBlockSize )
+		{
+			close();
+			return false;
+		}
+		m_firstFrame = offset;
+		for( size_t i = 0; i < m_seekTable.size(); i++ )
+			m_seekTable[i].offset += m_firstFrame;
+
+		//the window holds a few of the largest frames, so one is rarely split across a read
+		DWORD windowSize = (std::max)( (DWORD)262144, m_maxFrameBytes * 4 );
+		windowSize = ( windowSize + m_sectorAlignment - 1 ) / m_sectorAlignment * m_sectorAlignment + m_sectorAlignment;
+		waveAlignedFree( m_window );
+		m_windowSize = windowSize;
+		m_window = (BYTE*)waveAlignedAlloc( m_windowSize, m_sectorAlignment );
+		m_windowOffset = ~(UINT64)0;
+		m_windowBytes = 0;
+		m_samples.assign( (size_t)m_maxBlockSize * m_channels, 0 );
+		if( m_window == NULL )
+		{
+			close();
+			return false;
+		}
+
+		//the decoded format: whole bytes per sample, with the samples in the top bits; past stereo or 16 bits it has to be extensible
+		DWORD container = ( m_bitsPerSample + 7 ) / 8 * 8;
+		static const DWORD masks[] = { 0x4, 0x3, 0x7, 0x33, 0x37, 0x3F, 0x70F, 0x63F };
+		m_wf.Format.wFormatTag = m_channels > 2 || container > 16 ? WAVE_FORMAT_EXTENSIBLE : WAVE_FORMAT_PCM;
+		m_wf.Format.nChannels = (WORD)m_channels;
+		m_wf.Format.nSamplesPerSec = m_sampleRate;
+		m_wf.Format.wBitsPerSample = (WORD)container;
+		m_wf.Format.nBlockAlign = (WORD)( m_channels * container / 8 );
+		m_wf.Format.nAvgBytesPerSec = m_sampleRate * m_wf.Format.nBlockAlign;
+		if( m_wf.Format.wFormatTag == WAVE_FORMAT_EXTENSIBLE )
+		{
+			static const GUID pcm = { WAVE_FORMAT_PCM, 0x0000, 0x0010, { 0x80, 0x00, 0x00, 0xaa, 0x00, 0x38, 0x9b, 0x71 } };
+			m_wf.Format.cbSize = sizeof(m_wf) - sizeof(m_wf.Format);
+			m_wf.Samples.wValidBitsPerSample = (WORD)m_bitsPerSample;
+			m_wf.dwChannelMask = masks[ m_channels - 1 ];
+			m_wf.SubFormat = pcm;
+		}
+
+		m_frameSample = 0;
+		m_frameLength = 0;
+		m_frameRead = 0;
+		m_nextOffset = m_firstFrame;
+		m_nextSample = 0;
+		m_nextIndexSample = 0;
+		return true;
+	}
+
+	void close() {
+		if( m_window != NULL )
+			waveAlignedFree( m_window );
+		m_window = NULL;
+		m_windowSize = 0;
+		m_windowBytes = 0;
+		m_source = NULL;
+		m_seekTable.clear();
+		m_samples.clear();
+		m_length = 0;
+		m_channels = 0;
+		m_frameLength = 0;
+		m_frameRead = 0;
+		memset( &m_wf, 0, sizeof(m_wf) );
+	}
+
+	const WAVEFORMATEXTENSIBLE* wfex() const { return &m_wf; }
+	UINT64 getLength() const { return m_length; }
+	UINT64 getPosition() const { return m_frameSample + m_frameRead; }
+
+	bool seek( UINT64 frame ) {
+		if( m_window == NULL )
+			return false;
+		frame = (std::min)( frame, m_length );
+
+		//within the frame already decoded
+		if( frame >= m_frameSample && frame < m_frameSample + m_frameLength )
+		{
+			m_frameRead = (DWORD)( frame - m_frameSample );
+			return true;
+		}
+
+		//start from the nearest known frame before it: the first, a seek point, or the one after the current frame
+		UINT64 offset = m_firstFrame, sample = 0;
+		for( size_t i = 0; i < m_seekTable.size(); i++ )
+		{
+			if( m_seekTable[i].sample <= frame && m_seekTable[i].sample >= sample )
+			{
+				offset = m_seekTable[i].offset;
+				sample = m_seekTable[i].sample;
+			}
+		}
+		if( m_nextSample <= frame && m_nextSample > sample && m_nextSample < m_length && m_frameLength > 0 )
+		{
+			offset = m_nextOffset;
+			sample = m_nextSample;
+		}
+
+		//hop from frame header to frame header until the frame holding it, then decode that one
+		m_frameLength = 0;
+		m_frameRead = 0;
+		FrameHeader h;
+		if( !findFrame( offset, sample, &offset, &h ) )
+			return false;
+		while( frame >= h.sample + h.blockSize && h.sample + h.blockSize < m_length )
+		{
+			if( !findFrame( offset + h.size, h.sample + h.blockSize, &offset, &h ) )
+				return false;
+		}
+		if( !decodeFrame( offset, h ) )
+			return false;
+		m_frameRead = (DWORD)(std::min)( frame - m_frameSample, (UINT64)m_frameLength );
+		return true;
+	}
+
+	bool decode( BYTE* pDest, DWORD frames, DWORD* pDecoded ) {
+		*pDecoded = 0;
+		if( m_window == NULL )
+			return false;
+		while( *pDecoded < frames )
+		{
+			if( m_frameRead == m_frameLength )
+			{
+				if( m_nextSample >= m_length )
+					break;
+				if( !nextFrame() )
+					return false;
+				continue;
+			}
+			DWORD n = (std::min)( frames - *pDecoded, m_frameLength - m_frameRead );
+			output( pDest + (size_t)*pDecoded * m_wf.Format.nBlockAlign, n );
+			*pDecoded += n;
+		}
+		return true;
+	}
+};
+
+inline WaveDecoder* WaveDecoder::create( WaveFileSource* source ) {
+	WaveFlacDecoder* flac = new WaveFlacDecoder();
+	if( flac->open( source ) )
+		return flac;
+	delete flac;
+	return NULL;
+}
+
+#endif
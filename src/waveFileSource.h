@@ -0,0 +1,635 @@
+//waveFileSource.h
+//unbuffered, sector-aligned file reads for the wave streaming code;
+//CreateFileW/FILE_FLAG_NO_BUFFERING on windows, O_DIRECT/pread everywhere else.
+//reads can also be issued asynchronously: overlapped i/o on windows, a small pread thread pool elsewhere.
+//a source can be made to read through the system cache instead, with the same alignment rules.
+//WaveFileMapping is the exception: it maps the whole file through the system cache instead
+
+#ifndef WAVEFILESOURCE_H
+#define WAVEFILESOURCE_H
+
+#include "waveTypes.h"
+
+#ifndef _WIN32
+#include <errno.h>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <condition_variable>
+#include <deque>
+#include <mutex>
+#include <thread>
+#include <vector>
+#endif
+
+//an asynchronous read; the same alignment rules as WaveFileSource::read() apply.
+//must not be moved, reused or destroyed while it is pending
+struct WaveReadRequest
+{
+	UINT64 offset;
+	void* pDest;
+	DWORD bytesToRead;
+	DWORD bytesRead; //valid once complete
+	bool pending; //issued and not yet waited on
+	bool succeeded; //valid once complete
+	bool priority; //goes ahead of reads queued before it, for a read that playback is waiting on
+#ifdef _WIN32
+	OVERLAPPED overlapped;
+#else
+	bool done; //set by the read pool
+	int fd;
+#endif
+
+	WaveReadRequest() : offset(0), pDest(NULL), bytesToRead(0), bytesRead(0), pending(false), succeeded(false), priority(false) {
+#ifdef _WIN32
+		memset( &overlapped, 0, sizeof(overlapped) );
+#else
+		done = false;
+		fd = -1;
+#endif
+	}
+};
+
+class WaveFileSource
+{
+public:
+	virtual ~WaveFileSource() {}
+
+	//opens the file for reading, without system cacheing unless the source was created cached; returns true on success
+	virtual bool open( LPCTSTR szFile ) = 0;
+	//closes the file; safe to call when nothing is open
+	virtual void close() = 0;
+	//whether a file is currently open
+	virtual bool isOpen() const = 0;
+	//the alignment that read offsets, read sizes and destination memory must respect; only valid while open
+	virtual DWORD sectorSize() const = 0;
+	//reads bytesToRead bytes at the file offset into pDest, returning false on failure;
+	//*pBytesRead is only less than bytesToRead when the end of the file was reached. safe to call from several threads at once
+	virtual bool read( UINT64 offset, void* pDest, DWORD bytesToRead, DWORD* pBytesRead ) = 0;
+	//opens a second handle onto the same file at the OS level; returns NULL on failure
+	virtual WaveFileSource* duplicate() const = 0;
+
+	//starts reading pRequest->bytesToRead bytes at pRequest->offset into pRequest->pDest, without waiting;
+	//returns false if the read couldn't be issued. sources without real asynchronous i/o just read here
+	virtual bool beginRead( WaveReadRequest* pRequest ) {
+		pRequest->succeeded = read( pRequest->offset, pRequest->pDest, pRequest->bytesToRead, &pRequest->bytesRead );
+		pRequest->pending = true;
+		return true;
+	}
+	//waits for a read started with beginRead() to complete; returns whether it succeeded
+	virtual bool waitRead( WaveReadRequest* pRequest ) {
+		pRequest->pending = false;
+		return pRequest->succeeded;
+	}
+	//abandons a read started with beginRead(): one that hasn't started yet never will, one under way is waited out.
+	//either way the destination is free to reuse afterwards
+	virtual void cancelRead( WaveReadRequest* pRequest ) {
+		waitRead( pRequest );
+	}
+
+	//creates the native source for this platform; a cached one reads through the system cache like any buffered read,
+	//which is cheaper for files that are usually in it already, at the cost of the copy out of it
+	static WaveFileSource* create( bool cached = false );
+};
+
+#ifdef _WIN32
+
+//opened for overlapped i/o, so any number of reads can be in flight on one handle
+class Win32WaveFileSource : public WaveFileSource
+{
+private:
+	HANDLE m_hFile;
+	DWORD m_sectorSize;
+	bool m_cached;
+
+	//collects the result of an overlapped ReadFile, waiting for it to complete
+	bool finishRead( BOOL issued, OVERLAPPED* pOverlapped, DWORD* pBytesRead ) {
+		if( FALSE == issued )
+		{
+			DWORD error = GetLastError();
+			//reading at or past the end of the file is not an error, it just reads nothing
+			if( error == ERROR_HANDLE_EOF )
+				return true;
+			if( error != ERROR_IO_PENDING )
+				return false;
+		}
+		if( FALSE == GetOverlappedResult( m_hFile, pOverlapped, pBytesRead, TRUE ) )
+			return GetLastError() == ERROR_HANDLE_EOF;
+		return true;
+	}
+
+public:
+	Win32WaveFileSource( bool cached = false ) : m_hFile(INVALID_HANDLE_VALUE), m_sectorSize(0), m_cached(cached) {}
+	~Win32WaveFileSource() { close(); }
+
+	bool open( LPCTSTR szFile ) {
+		close();
+
+		m_hFile = CreateFileW( szFile, GENERIC_READ, FILE_SHARE_READ, NULL, OPEN_EXISTING, m_cached ? FILE_FLAG_OVERLAPPED : FILE_FLAG_NO_BUFFERING | FILE_FLAG_OVERLAPPED, NULL );
+		if( m_hFile == INVALID_HANDLE_VALUE )
+			return false;
+
+		//figure the sector size of the volume the file lives on, not the current directory's
+		DWORD dw1, dw2, dw3;
+		WCHAR szRoot[MAX_PATH];
+		if( GetVolumePathNameW( szFile, szRoot, MAX_PATH ) )
+			GetDiskFreeSpaceW( szRoot, &dw1, &m_sectorSize, &dw2, &dw3 );
+		else
+			GetDiskFreeSpaceW( NULL, &dw1, &m_sectorSize, &dw2, &dw3 );
+
+		if( m_sectorSize == 0 )
+		{
+			close();
+			return false;
+		}
+		return true;
+	}
+
+	void close() {
+		if( m_hFile != INVALID_HANDLE_VALUE )
+			CloseHandle( m_hFile );
+		m_hFile = INVALID_HANDLE_VALUE;
+		m_sectorSize = 0;
+	}
+
+	bool isOpen() const { return m_hFile != INVALID_HANDLE_VALUE; }
+	DWORD sectorSize() const { return m_sectorSize; }
+
+	bool read( UINT64 offset, void* pDest, DWORD bytesToRead, DWORD* pBytesRead ) {
+		*pBytesRead = 0;
+
+		//an event of its own, like beginRead(); a shared block cache has several workers reading one source at once,
+		//and with a shared event one read's reset could swallow another's completion
+		OVERLAPPED overlapped = {0};
+		overlapped.Offset = (DWORD)offset;
+		overlapped.OffsetHigh = (DWORD)(offset >> 32);
+		overlapped.hEvent = CreateEventW( NULL, TRUE, FALSE, NULL );
+		if( overlapped.hEvent == NULL )
+			return false;
+		bool result = finishRead( ReadFile( m_hFile, pDest, bytesToRead, NULL, &overlapped ), &overlapped, pBytesRead );
+		CloseHandle( overlapped.hEvent );
+		return result;
+	}
+
+	bool beginRead( WaveReadRequest* pRequest ) {
+		pRequest->bytesRead = 0;
+		pRequest->succeeded = false;
+		if( pRequest->overlapped.hEvent == NULL )
+			pRequest->overlapped.hEvent = CreateEventW( NULL, TRUE, FALSE, NULL );
+		pRequest->overlapped.Offset = (DWORD)pRequest->offset;
+		pRequest->overlapped.OffsetHigh = (DWORD)(pRequest->offset >> 32);
+		ResetEvent( pRequest->overlapped.hEvent );
+
+		if( FALSE == ReadFile( m_hFile, pRequest->pDest, pRequest->bytesToRead, NULL, &pRequest->overlapped ) )
+		{
+			DWORD error = GetLastError();
+			if( error != ERROR_IO_PENDING && error != ERROR_HANDLE_EOF )
+				return false;
+		}
+		pRequest->pending = true;
+		return true;
+	}
+
+	bool waitRead( WaveReadRequest* pRequest ) {
+		pRequest->pending = false;
+		if( FALSE == GetOverlappedResult( m_hFile, &pRequest->overlapped, &pRequest->bytesRead, TRUE ) )
+			pRequest->succeeded = GetLastError() == ERROR_HANDLE_EOF;
+		else
+			pRequest->succeeded = true;
+
+		CloseHandle( pRequest->overlapped.hEvent );
+		pRequest->overlapped.hEvent = NULL;
+		return pRequest->succeeded;
+	}
+
+	void cancelRead( WaveReadRequest* pRequest ) {
+		//the read still completes (as ERROR_OPERATION_ABORTED if it hadn't got far), so it has to be waited on all the same
+		CancelIoEx( m_hFile, &pRequest->overlapped );
+		waitRead( pRequest );
+	}
+
+	WaveFileSource* duplicate() const {
+		if( m_hFile == INVALID_HANDLE_VALUE )
+			return NULL;
+
+		Win32WaveFileSource* c = new Win32WaveFileSource( m_cached );
+		if( FALSE == DuplicateHandle( GetCurrentProcess(), m_hFile, GetCurrentProcess(), &c->m_hFile, 0, FALSE, DUPLICATE_SAME_ACCESS ) )
+		{
+			c->m_hFile = INVALID_HANDLE_VALUE;
+			delete c;
+			return NULL;
+		}
+		c->m_sectorSize = m_sectorSize;
+		return c;
+	}
+};
+
+inline WaveFileSource* WaveFileSource::create( bool cached ) { return new Win32WaveFileSource( cached ); }
+
+//gets a file's size and last write time (in 100ns FILETIME units) without opening it; returns false if it can't be found
+inline bool waveFileStat( LPCTSTR szFile, UINT64* pSize, UINT64* pModified ) {
+	WIN32_FILE_ATTRIBUTE_DATA data;
+	if( FALSE == GetFileAttributesExW( szFile, GetFileExInfoStandard, &data ) )
+		return false;
+	*pSize = ((UINT64)data.nFileSizeHigh << 32) | data.nFileSizeLow;
+	*pModified = ((UINT64)data.ftLastWriteTime.dwHighDateTime << 32) | data.ftLastWriteTime.dwLowDateTime;
+	return true;
+}
+
+#else
+
+//a few threads doing blocking preads on behalf of beginRead(), so several reads can be in flight at once;
+//shared by every PosixWaveFileSource in the process
+class WaveReadPool
+{
+private:
+	std::mutex m_mutex;
+	std::condition_variable m_work; //signalled when a request is queued
+	std::condition_variable m_done; //signalled when a request completes
+	std::deque<WaveReadRequest*> m_queue;
+	std::vector<std::thread> m_threads;
+	bool m_quitting;
+
+	void threadedFunction() {
+		std::unique_lock<std::mutex> lock( m_mutex );
+		while( true )
+		{
+			while( !m_quitting && m_queue.empty() )
+				m_work.wait( lock );
+			if( m_quitting )
+				break;
+
+			WaveReadRequest* r = m_queue.front();
+			m_queue.pop_front();
+			lock.unlock();
+
+			ssize_t n;
+			do
+			{
+				n = pread( r->fd, r->pDest, r->bytesToRead, (off_t)r->offset );
+			} while( n < 0 && errno == EINTR );
+
+			lock.lock();
+			r->succeeded = n >= 0;
+			r->bytesRead = n >= 0 ? (DWORD)n : 0;
+			r->done = true;
+			m_done.notify_all();
+		}
+	}
+
+public:
+	WaveReadPool( int numThreads = 4 ) : m_quitting(false) {
+		for( int i = 0; i < numThreads; i++ )
+			m_threads.push_back( std::thread( &WaveReadPool::threadedFunction, this ) );
+	}
+
+	~WaveReadPool() {
+		{
+			std::lock_guard<std::mutex> lock( m_mutex );
+			m_quitting = true;
+		}
+		m_work.notify_all();
+		for( size_t i = 0; i < m_threads.size(); i++ )
+			m_threads[i].join();
+	}
+
+	void submit( WaveReadRequest* pRequest ) {
+		{
+			std::lock_guard<std::mutex> lock( m_mutex );
+			pRequest->done = false;
+			if( pRequest->priority )
+				m_queue.push_front( pRequest );
+			else
+				m_queue.push_back( pRequest );
+		}
+		m_work.notify_one();
+	}
+
+	void wait( WaveReadRequest* pRequest ) {
+		std::unique_lock<std::mutex> lock( m_mutex );
+		while( !pRequest->done )
+			m_done.wait( lock );
+	}
+
+	//takes the request off the queue if no thread has picked it up yet, otherwise waits for it
+	void cancel( WaveReadRequest* pRequest ) {
+		std::unique_lock<std::mutex> lock( m_mutex );
+		std::deque<WaveReadRequest*>::iterator it = std::find( m_queue.begin(), m_queue.end(), pRequest );
+		if( it != m_queue.end() )
+		{
+			m_queue.erase( it );
+			pRequest->succeeded = false;
+			pRequest->bytesRead = 0;
+			pRequest->done = true;
+			return;
+		}
+		while( !pRequest->done )
+			m_done.wait( lock );
+	}
+
+	static WaveReadPool& get() {
+		static WaveReadPool pool;
+		return pool;
+	}
+};
+
+class PosixWaveFileSource : public WaveFileSource
+{
+private:
+	int m_fd;
+	DWORD m_sectorSize;
+	bool m_cached;
+
+public:
+	PosixWaveFileSource( bool cached = false ) : m_fd(-1), m_sectorSize(0), m_cached(cached) {}
+	~PosixWaveFileSource() { close(); }
+
+	bool open( LPCTSTR szFile ) {
+		close();
+
+#if defined(O_DIRECT)
+		m_fd = ::open( szFile, m_cached ? O_RDONLY : O_RDONLY | O_DIRECT );
+		//some filesystems (tmpfs, certain network mounts) refuse O_DIRECT;
+		//fall back to cached reads there, the alignment rules still apply so the behaviour is the same
+		if( m_fd < 0 && errno == EINVAL )
+			m_fd = ::open( szFile, O_RDONLY );
+#else
+		m_fd = ::open( szFile, O_RDONLY );
+#if defined(F_NOCACHE)
+		if( m_fd >= 0 && !m_cached )
+			fcntl( m_fd, F_NOCACHE, 1 );
+#endif
+#endif
+		if( m_fd < 0 )
+			return false;
+
+		//st_blksize is the preferred i/o size, always a multiple of the logical sector size
+		struct stat st;
+		if( fstat( m_fd, &st ) != 0 )
+		{
+			close();
+			return false;
+		}
+		m_sectorSize = st.st_blksize < 512 ? 512 : (DWORD)st.st_blksize;
+		return true;
+	}
+
+	void close() {
+		if( m_fd >= 0 )
+			::close( m_fd );
+		m_fd = -1;
+		m_sectorSize = 0;
+	}
+
+	bool isOpen() const { return m_fd >= 0; }
+	DWORD sectorSize() const { return m_sectorSize; }
+
+	bool read( UINT64 offset, void* pDest, DWORD bytesToRead, DWORD* pBytesRead ) {
+		*pBytesRead = 0;
+
+		//regular files only come up short at the end of the file; don't retry past that,
+		//since the follow-up offset would no longer be sector aligned
+		ssize_t n;
+		do
+		{
+			n = pread( m_fd, pDest, bytesToRead, (off_t)offset );
+		} while( n < 0 && errno == EINTR );
+
+		if( n < 0 )
+			return false;
+		*pBytesRead = (DWORD)n;
+		return true;
+	}
+
+	bool beginRead( WaveReadRequest* pRequest ) {
+		pRequest->fd = m_fd;
+		pRequest->bytesRead = 0;
+		pRequest->succeeded = false;
+		pRequest->pending = true;
+		WaveReadPool::get().submit( pRequest );
+		return true;
+	}
+
+	bool waitRead( WaveReadRequest* pRequest ) {
+		WaveReadPool::get().wait( pRequest );
+		pRequest->pending = false;
+		return pRequest->succeeded;
+	}
+
+	void cancelRead( WaveReadRequest* pRequest ) {
+		WaveReadPool::get().cancel( pRequest );
+		pRequest->pending = false;
+	}
+
+	WaveFileSource* duplicate() const {
+		if( m_fd < 0 )
+			return NULL;
+
+		//pread never touches the shared file offset, so a dup'd descriptor is fully independent
+		int fd = dup( m_fd );
+		if( fd < 0 )
+			return NULL;
+
+		PosixWaveFileSource* c = new PosixWaveFileSource( m_cached );
+		c->m_fd = fd;
+		c->m_sectorSize = m_sectorSize;
+		return c;
+	}
+};
+
+inline WaveFileSource* WaveFileSource::create( bool cached ) { return new PosixWaveFileSource( cached ); }
+
+//gets a file's size and last modification time (in nanoseconds) without opening it; returns false if it can't be found
+inline bool waveFileStat( LPCTSTR szFile, UINT64* pSize, UINT64* pModified ) {
+	struct stat st;
+	if( stat( szFile, &st ) != 0 )
+		return false;
+	*pSize = (UINT64)st.st_size;
+#if defined(__APPLE__)
+	*pModified = (UINT64)st.st_mtimespec.tv_sec * 1000000000 + st.st_mtimespec.tv_nsec;
+#else
+	*pModified = (UINT64)st.st_mtim.tv_sec * 1000000000 + st.st_mtim.tv_nsec;
+#endif
+	return true;
+}
+
+#endif
+
+//the whole file mapped read-only into memory, going through the system cache rather than around it;
+//read() copies out of the mapping, so the wave parsing code works on it unchanged, while data() lets
+//the streaming code point buffers straight at the file's bytes
+class WaveFileMapping : public WaveFileSource
+{
+private:
+	const BYTE* m_pData;
+	UINT64 m_size;
+	DWORD m_pageSize;
+#ifdef _WIN32
+	HANDLE m_hMapping;
+#else
+	int m_fd;
+#endif
+
+	//maps the view once the mapping handle or descriptor is set up
+	bool mapView() {
+#ifdef _WIN32
+		SYSTEM_INFO info;
+		GetSystemInfo( &info );
+		m_pageSize = info.dwPageSize;
+		m_pData = (const BYTE*)MapViewOfFile( m_hMapping, FILE_MAP_READ, 0, 0, 0 );
+		return m_pData != NULL;
+#else
+		m_pageSize = (DWORD)sysconf( _SC_PAGESIZE );
+		void* p = mmap( NULL, (size_t)m_size, PROT_READ, MAP_SHARED, m_fd, 0 );
+		if( p == MAP_FAILED )
+			return false;
+		m_pData = (const BYTE*)p;
+		return true;
+#endif
+	}
+
+public:
+#ifdef _WIN32
+	WaveFileMapping() : m_pData(NULL), m_size(0), m_pageSize(0), m_hMapping(NULL) {}
+#else
+	WaveFileMapping() : m_pData(NULL), m_size(0), m_pageSize(0), m_fd(-1) {}
+#endif
+	~WaveFileMapping() { close(); }
+
+	bool open( LPCTSTR szFile ) {
+		close();
+
+#ifdef _WIN32
+		HANDLE hFile = CreateFileW( szFile, GENERIC_READ, FILE_SHARE_READ, NULL, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, NULL );
+		if( hFile == INVALID_HANDLE_VALUE )
+			return false;
+
+		LARGE_INTEGER size;
+		if( FALSE == GetFileSizeEx( hFile, &size ) || size.QuadPart == 0 || (UINT64)size.QuadPart > (SIZE_T)-1 )
+		{
+			CloseHandle( hFile );
+			return false;
+		}
+		m_size = size.QuadPart;
+
+		//the mapping keeps the file open by itself
+		m_hMapping = CreateFileMappingW( hFile, NULL, PAGE_READONLY, 0, 0, NULL );
+		CloseHandle( hFile );
+		if( m_hMapping == NULL )
+			return false;
+#else
+		m_fd = ::open( szFile, O_RDONLY );
+		if( m_fd < 0 )
+			return false;
+
+		struct stat st;
+		if( fstat( m_fd, &st ) != 0 || st.st_size == 0 || (UINT64)st.st_size > (size_t)-1 )
+		{
+			close();
+			return false;
+		}
+		m_size = st.st_size;
+#endif
+
+		if( !mapView() )
+		{
+			close();
+			return false;
+		}
+		return true;
+	}
+
+	void close() {
+#ifdef _WIN32
+		if( m_pData != NULL )
+			UnmapViewOfFile( m_pData );
+		if( m_hMapping != NULL )
+			CloseHandle( m_hMapping );
+		m_hMapping = NULL;
+#else
+		if( m_pData != NULL )
+			munmap( (void*)m_pData, (size_t)m_size );
+		if( m_fd >= 0 )
+			::close( m_fd );
+		m_fd = -1;
+#endif
+		m_pData = NULL;
+		m_size = 0;
+	}
+
+	bool isOpen() const { return m_pData != NULL; }
+	//reads needn't be aligned at all, but page-sized reads keep the parsing code's sector walk cheap
+	DWORD sectorSize() const { return m_pageSize; }
+
+	bool read( UINT64 offset, void* pDest, DWORD bytesToRead, DWORD* pBytesRead ) {
+		*pBytesRead = 0;
+		if( offset >= m_size )
+			return true;
+		*pBytesRead = (DWORD)(std::min)( (UINT64)bytesToRead, m_size - offset );
+		memcpy( pDest, m_pData + offset, *pBytesRead );
+		return true;
+	}
+
+	WaveFileSource* duplicate() const {
+		if( m_pData == NULL )
+			return NULL;
+
+		WaveFileMapping* c = new WaveFileMapping();
+		c->m_size = m_size;
+#ifdef _WIN32
+		if( FALSE == DuplicateHandle( GetCurrentProcess(), m_hMapping, GetCurrentProcess(), &c->m_hMapping, 0, FALSE, DUPLICATE_SAME_ACCESS ) )
+			c->m_hMapping = NULL;
+		if( c->m_hMapping == NULL || !c->mapView() )
+#else
+		c->m_fd = dup( m_fd );
+		if( c->m_fd < 0 || !c->mapView() )
+#endif
+		{
+			delete c;
+			return NULL;
+		}
+		return c;
+	}
+
+	//the file's bytes; valid until close()
+	const BYTE* data() const { return m_pData; }
+	UINT64 size() const { return m_size; }
+
+	//asks the system to start paging in a range ahead of it being touched; returns straight away
+	void prefetch( UINT64 offset, UINT64 length ) const {
+		if( m_pData == NULL || offset >= m_size )
+			return;
+		length = (std::min)( length, m_size - offset );
+
+		//the hints work on whole pages
+		UINT64 begin = offset - offset % m_pageSize;
+		length += offset - begin;
+#ifdef _WIN32
+#if _WIN32_WINNT >= 0x0602
+		WIN32_MEMORY_RANGE_ENTRY range;
+		range.VirtualAddress = (PVOID)(m_pData + begin);
+		range.NumberOfBytes = (SIZE_T)length;
+		PrefetchVirtualMemory( GetCurrentProcess(), 1, &range, 0 );
+#endif
+#else
+		madvise( (void*)(m_pData + begin), (size_t)length, MADV_WILLNEED );
+#endif
+	}
+
+	//reads a byte from every page in the range, so whoever calls this takes the page faults
+	//rather than whoever reads the range later (such as the audio thread)
+	void touch( UINT64 offset, UINT64 length ) const {
+		if( m_pData == NULL || offset >= m_size || length == 0 )
+			return;
+		UINT64 end = (std::min)( offset + length, m_size );
+
+		volatile BYTE sink = 0;
+		for( UINT64 i = offset; i < end; i += m_pageSize - i % m_pageSize )
+			sink = sink ^ m_pData[i];
+		sink = sink ^ m_pData[end - 1];
+	}
+};
+
+#endif
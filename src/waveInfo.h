@@ -7,399 +7,1398 @@
 #ifndef STREAMINGWAVE_H
 #define STREAMINGWAVE_H
 
-#include <windows.h>
-#include <mmiscapi.h>
-#include <xaudio2.h>
+#include "waveTypes.h"
+#include "waveFileSource.h"
+#include "waveDecoder.h"
+#include "waveBufferPool.h"
+
+#include <condition_variable>
+#include <map>
+#include <mutex>
+#include <utility>
+#include <vector>
+
+//the amount of the file read at a time while indexing its chunks; chunks smaller than this cost no extra reads to skip
+#define WAVEINFO_INDEX_WINDOW 65536
 
 class WaveInfo
 {
+public:
+	//where a chunk sits in the file
+	struct Chunk
+	{
+		FOURCC id;
+		UINT64 offset; //the file offset of the chunk's header; its data starts 8 bytes on
+		UINT64 size; //the size of the chunk's data; taken from the ds64 chunk when an RF64 header can't hold it
+	};
+
 private:
 	WAVEFORMATEXTENSIBLE m_wf;
-	DWORD m_dataOffset;
-	DWORD m_dataLength;
+	UINT64 m_dataOffset;
+	UINT64 m_dataLength;
+	DWORD m_loopStart; //the first sample frame of the 'smpl' chunk's first loop
+	DWORD m_loopEnd; //the sample frame just past that loop; 0 if the file has no loop points
+	std::vector<Chunk> m_chunks; //every chunk in the file, in file order
+
+	//not copyable; assign() copies a header where that's wanted
+	WaveInfo( const WaveInfo& );
+	WaveInfo& operator =( const WaveInfo& );
+
+	//forgets the header
+	void clear() {
+		memset( &m_wf, 0, sizeof(m_wf) );
+		m_dataOffset = 0;
+		m_dataLength = 0;
+		m_loopStart = 0;
+		m_loopEnd = 0;
+		m_chunks.clear();
+	}
 
 protected:
-	//looks for the FOURCC chunk, returning -1 on failure
-	DWORD findChunk( HANDLE hFile, FOURCC cc, BYTE* memBuffer, DWORD sectorAlignment ) {
-		DWORD dwChunkId = 0;
-		DWORD dwChunkSize = 0;
-		DWORD i = 0; //guaranteed to be always aligned with the sectors, except when done searching
-		OVERLAPPED overlapped = {0};
-		DWORD sectorOffset = 0;
-		DWORD bytesRead = 0;
-
-		bool searching = true;
-		while( searching )
-		{
-			sectorOffset = 0;
-			overlapped.Offset = i;
-			if( FALSE == ReadFile( hFile, memBuffer, sectorAlignment, &bytesRead, &overlapped ) )
-			{
-				return -1;
-			}
-
-			bool needAnotherRead = false;
-			while( searching && !needAnotherRead )
-			{
-				if( 8 + sectorOffset > sectorAlignment ) //reached the end of our memory buffer
-				{
-					needAnotherRead = true;
-				}
-				else if( 8 + sectorOffset > bytesRead ) //reached EOF, and not found a match
-				{
-					return -1;
-				}
-				else //looking through the read memory
-				{
-					dwChunkId = *reinterpret_cast<DWORD*>( memBuffer + sectorOffset );
-					dwChunkSize = *reinterpret_cast<DWORD*>( memBuffer + sectorOffset + 4 );
-
-					if( dwChunkId == cc ) //found a match
-					{
-						searching = false;
-						i += sectorOffset;
-					}
-					else //no match found, add to offset
-					{
-						dwChunkSize += 8; //add offsets of the chunk id, and chunk size data entries
-						dwChunkSize += 1;
-						dwChunkSize &= 0xfffffffe; //guarantees WORD padding alignment
-
-						if( i == 0 && sectorOffset == 0 ) //just in case we're at the 'RIFF' chunk; the dwChunkSize here means the entire file size
-							sectorOffset += 12;
-						else
-							sectorOffset += dwChunkSize;
-					}
-				}
-			}
+	//a sector-aligned stretch of the file held in memory while parsing, so neighbouring chunk headers come from one read
+	struct ReadWindow
+	{
+		BYTE* memory;
+		DWORD size; //a multiple of the sector size
+		DWORD sectorAlignment;
+		UINT64 offset; //the file offset of memory's contents
+		DWORD bytes; //how much of memory holds file data; less than size only at the end of the file
+	};
 
-			//if still searching, search the next sector
-			if( searching )
+	//makes sure the window holds the length bytes at the file offset, reading them in if not; length must be no more
+	//than the window size less a sector. returns how many of those bytes there are, which is short at the end of the file
+	DWORD fetch( WaveFileSource* source, ReadWindow& w, UINT64 offset, DWORD length ) {
+		bool inWindow = w.bytes > 0 && offset >= w.offset && offset + length <= w.offset + w.bytes;
+		bool atEnd = w.bytes > 0 && w.bytes < w.size && offset >= w.offset; //the window already reaches the end of the file
+		if( !inWindow && !atEnd )
+		{
+			w.offset = offset - offset % w.sectorAlignment;
+			if( !source->read( w.offset, w.memory, w.size, &w.bytes ) )
 			{
-				i += sectorAlignment;
+				w.bytes = 0;
+				return 0;
 			}
 		}
 
-		return i;
+		UINT64 end = w.offset + w.bytes;
+		return offset < end ? (DWORD)(std::min)( (UINT64)length, end - offset ) : 0;
 	}
 
-	//reads a certain amount of data in, returning the number of bytes copied
-	DWORD readData( HANDLE hFile, DWORD bytesToRead, DWORD fileOffset, void* pDest, BYTE* memBuffer, DWORD sectorAlignment ) {
-		if( bytesToRead == 0 )
-			return 0;
-
-		DWORD totalAmountCopied = 0;
-		DWORD copyBeginOffset = fileOffset % sectorAlignment;
-		OVERLAPPED overlapped = {0};
-		bool fetchingData = true;
-		DWORD pass = 0;
-		DWORD dwNumberBytesRead = 0;
+	//copies up to bytesToRead bytes at the file offset into pDest, returning the number of bytes copied
+	DWORD readData( WaveFileSource* source, ReadWindow& w, UINT64 fileOffset, DWORD bytesToRead, void* pDest ) {
+		DWORD available = fetch( source, w, fileOffset, bytesToRead );
+		if( available > 0 )
+			memcpy( pDest, w.memory + (fileOffset - w.offset), available );
+		return available;
+	}
 
-		//while fetching data
-		while( fetchingData )
-		{
-			//calculate the sector to read
-			overlapped.Offset = fileOffset - (fileOffset % sectorAlignment) + pass * sectorAlignment;
+	//walks the chunk table once, from the RIFF header to the end of the file, recording where every chunk is;
+	//RF64 and BW64 files take the sizes too big for a DWORD from their ds64 chunk. returns false if this isn't a wave file
+	bool indexChunks( WaveFileSource* source, ReadWindow& w ) {
+		m_chunks.clear();
 
-			//read the amount in; if the read failed, return 0
-			if( FALSE == ReadFile( hFile, memBuffer, sectorAlignment, &dwNumberBytesRead, &overlapped ) )
-				return 0;
+		DWORD header[3];
+		if( sizeof(header) != readData( source, w, 0, sizeof(header), header ) || header[2] != MAKEFOURCC( 'W', 'A', 'V', 'E' ) )
+			return false;
+		bool rf64 = header[0] == MAKEFOURCC( 'R', 'F', '6', '4' ) || header[0] == MAKEFOURCC( 'B', 'W', '6', '4' );
+		if( !rf64 && header[0] != MAKEFOURCC( 'R', 'I', 'F', 'F' ) )
+			return false;
 
-			//if the full buffer was not filled (ie. EOF)
-			if( dwNumberBytesRead < sectorAlignment )
-			{
-				//calculate how much can be copied
-				DWORD amountToCopy = 0;
-				if( dwNumberBytesRead > copyBeginOffset )
-					amountToCopy = dwNumberBytesRead - copyBeginOffset;
-				if( totalAmountCopied + amountToCopy > bytesToRead )
-					amountToCopy = bytesToRead - totalAmountCopied;
+		//from the ds64 chunk: the data size, and a table of any other sizes that didn't fit
+		UINT64 dataSize64 = 0;
+		std::vector<Chunk> sizeTable;
 
-				//copy that amount over
-				memcpy( ((BYTE*)pDest) + totalAmountCopied, memBuffer + copyBeginOffset, amountToCopy );
+		UINT64 offset = 12;
+		while( true )
+		{
+			DWORD chunkHeader[2];
+			if( sizeof(chunkHeader) != readData( source, w, offset, sizeof(chunkHeader), chunkHeader ) ) //reached the end of the file
+				break;
 
-				//add to the total amount copied
-				totalAmountCopied += amountToCopy;
+			Chunk c;
+			c.id = chunkHeader[0];
+			c.offset = offset;
+			c.size = chunkHeader[1];
 
-				//end the fetching data loop
-				fetchingData = false;
+			if( rf64 && m_chunks.empty() && c.id == MAKEFOURCC( 'd', 's', '6', '4' ) )
+			{
+				//the RIFF size, data size and sample count as 64 bit values, then the table length and its entries of an id and a 64 bit size
+				BYTE ds64[28];
+				if( sizeof(ds64) == readData( source, w, offset + 8, sizeof(ds64), ds64 ) )
+				{
+					DWORD tableLength = 0;
+					memcpy( &dataSize64, ds64 + 8, sizeof(dataSize64) );
+					memcpy( &tableLength, ds64 + 24, sizeof(tableLength) );
+					for( DWORD i = 0; i < tableLength && sizeof(ds64) + (UINT64)( i + 1 ) * 12 <= c.size; i++ )
+					{
+						BYTE entry[12];
+						if( sizeof(entry) != readData( source, w, offset + 8 + sizeof(ds64) + i * 12, sizeof(entry), entry ) )
+							break;
+						Chunk t;
+						memcpy( &t.id, entry, sizeof(t.id) );
+						memcpy( &t.size, entry + 4, sizeof(t.size) );
+						t.offset = 0;
+						sizeTable.push_back( t );
+					}
+				}
 			}
-			//else
-			else
+			else if( rf64 && c.size == 0xffffffff )
 			{
-				//calculate how much can be copied
-				DWORD amountToCopy = sectorAlignment - copyBeginOffset;
-				if( totalAmountCopied + amountToCopy > bytesToRead )
-					amountToCopy = bytesToRead - totalAmountCopied;
-
-				//copy that amount over
-				memcpy( ((BYTE*)pDest) + totalAmountCopied, memBuffer + copyBeginOffset, amountToCopy );
-
-				//add to the total amount copied
-				totalAmountCopied += amountToCopy;
-
-				//set the copyBeginOffset to 0
-				copyBeginOffset = 0;
+				if( c.id == MAKEFOURCC( 'd', 'a', 't', 'a' ) )
+					c.size = dataSize64;
+				for( size_t i = 0; i < sizeTable.size(); i++ )
+				{
+					if( sizeTable[i].id == c.id )
+					{
+						c.size = sizeTable[i].size;
+						break;
+					}
+				}
 			}
 
-			//if the total amount equals the bytesToRead, end the fetching data loop
-			if( totalAmountCopied == bytesToRead )
-				fetchingData = false;
+			//the chunks parse() wants the contents of are read while they're in the window, rather than gone back for
+			m_chunks.push_back( c );
+			if( c.id == MAKEFOURCC( 'f', 'm', 't', ' ' ) && findChunk( c.id ) == &m_chunks.back() && !parseFormat( source, w, c ) )
+				return false;
+			if( c.id == MAKEFOURCC( 's', 'm', 'p', 'l' ) && findChunk( c.id ) == &m_chunks.back() )
+				parseLoopPoints( source, w, c );
 
-			//increment the pass
-			pass++;
+			offset += 8 + c.size + ( c.size & 1 ); //guarantees WORD padding alignment
 		}
 
-		//return the total amount copied
-		return totalAmountCopied;
+		return true;
 	}
 
 public:
-	WaveInfo( LPCTSTR szFile = NULL ) : m_dataOffset(0), m_dataLength(0) {
+	WaveInfo( LPCTSTR szFile = NULL ) : m_dataOffset(0), m_dataLength(0), m_loopStart(0), m_loopEnd(0) {
 		memset( &m_wf, 0, sizeof(m_wf) );
 		load( szFile );
 	}
-	WaveInfo( const WaveInfo& c ) : m_wf(c.m_wf), m_dataOffset(c.m_dataOffset), m_dataLength(c.m_dataLength) {}
+	//move-only; a header is copied on purpose with assign(). the moved-from one is left empty
+	WaveInfo( WaveInfo&& c ) WAVE_NOEXCEPT : m_wf(c.m_wf), m_dataOffset(c.m_dataOffset), m_dataLength(c.m_dataLength), m_loopStart(c.m_loopStart), m_loopEnd(c.m_loopEnd) {
+		m_chunks.swap( c.m_chunks );
+		c.clear();
+	}
+	WaveInfo& operator =( WaveInfo&& c ) WAVE_NOEXCEPT {
+		if( this != &c )
+		{
+			m_wf = c.m_wf;
+			m_dataOffset = c.m_dataOffset;
+			m_dataLength = c.m_dataLength;
+			m_loopStart = c.m_loopStart;
+			m_loopEnd = c.m_loopEnd;
+			m_chunks.swap( c.m_chunks );
+			c.clear();
+		}
+		return *this;
+	}
 
 	//loads the wave format, offset to the wave data, and length of the wave data;
 	//returns true on success, false on failure
 	bool load( LPCTSTR szFile ) {
-		memset( &m_wf, 0, sizeof(m_wf) );
-		m_dataOffset = 0;
-		m_dataLength = 0;
+		clear();
 
 		if( szFile == NULL )
 			return false;
 
-		cout << "LOADING FILE" << endl;
-
 		//load the file without system cacheing
-		HANDLE hFile = CreateFileW( szFile, GENERIC_READ, FILE_SHARE_READ, NULL, OPEN_EXISTING, FILE_FLAG_NO_BUFFERING, NULL );
+		WaveFileSource* source = WaveFileSource::create();
+		if( !source->open( szFile ) )
+		{
+			delete source;
+			return false;
+		}
+
+		bool result = parse( source );
+
+		delete source;
+		return result;
+	}
 
-		if( hFile == INVALID_HANDLE_VALUE )
+	//same as load(), but reads from a source that is already open
+	bool parse( WaveFileSource* source ) {
+		clear();
+
+		if( source == NULL || !source->isOpen() )
+			return false;
+
+		//the window for reading the chunk headers; the first read usually takes in the format and the start of the data
+		ReadWindow w;
+		w.sectorAlignment = source->sectorSize();
+		w.size = (std::max)( ( WAVEINFO_INDEX_WINDOW + w.sectorAlignment - 1 ) / w.sectorAlignment * w.sectorAlignment, 2 * w.sectorAlignment );
+		w.offset = 0;
+		w.bytes = 0;
+		w.memory = (BYTE*)waveAlignedAlloc( w.size, w.sectorAlignment );
+		if( w.memory == NULL )
 			return false;
 
-		
-		cout << "SECTOR SIZE" << endl;
+		bool result = indexChunks( source, w ) && parseChunks();
+
+		waveAlignedFree( w.memory );
+
+		return result;
+	}
+
+	//reads in the WAVEFORMATEX structure, and the rest of WAVEFORMATEXTENSIBLE if that's what it is
+	bool parseFormat( WaveFileSource* source, ReadWindow& w, const Chunk& fmt ) {
+		DWORD fmtSize = (DWORD)(std::min)( fmt.size, (UINT64)sizeof(m_wf) );
+		if( fmtSize < 16 || fmtSize != readData( source, w, fmt.offset + 8, fmtSize, &m_wf ) ) //16 bytes is a PCMWAVEFORMAT, the smallest there is
+			return false;
+		if( fmtSize < sizeof(m_wf.Format) )
+			m_wf.Format.cbSize = 0;
+		if( m_wf.Format.cbSize != (sizeof(m_wf) - sizeof(m_wf.Format)) || fmtSize < sizeof(m_wf) )
+			memset( (BYTE*)&m_wf + sizeof(m_wf.Format), 0, sizeof(m_wf) - sizeof(m_wf.Format) );
+		return true;
+	}
 
-		//figure the sector size for reading
-		DWORD dwSectorSize = 0;
+	//reads the first loop of the 'smpl' chunk; the loop's end frame is inclusive in the file.
+	//a sampler chunk that can't be read is just ignored, the loop points being optional
+	void parseLoopPoints( WaveFileSource* source, ReadWindow& w, const Chunk& smpl ) {
+		//the sampler header is nine DWORDs, the eighth being the loop count; each loop is six DWORDs: id, type, start, end, fraction, play count
+		DWORD header[9];
+		DWORD loop[6];
+		if( sizeof(header) != readData( source, w, smpl.offset + 8, sizeof(header), header ) || header[7] == 0 )
+			return;
+		if( sizeof(loop) != readData( source, w, smpl.offset + 8 + sizeof(header), sizeof(loop), loop ) )
+			return;
+
+		if( loop[2] <= loop[3] && loop[3] < 0xffffffff )
 		{
-			DWORD dw1, dw2, dw3;
-			GetDiskFreeSpace( NULL, &dw1, &dwSectorSize, &dw2, &dw3 );
+			m_loopStart = loop[2];
+			m_loopEnd = loop[3] + 1;
 		}
+	}
 
-		//allocate the aligned memory buffer, used in finding and reading the chunks in the file
-		BYTE *memBuffer = (BYTE*)_aligned_malloc( dwSectorSize, dwSectorSize );
-		if( memBuffer == NULL )
-		{
-			CloseHandle( hFile );
+	//takes the header from one parsed before, like a copy kept in an index of files, instead of reading the file again;
+	//returns false if it doesn't describe any wave data
+	bool assign( const WaveInfo& header ) {
+		return assign( header.m_wf, header.m_loopStart, header.m_loopEnd, header.m_chunks );
+	}
+	//same, from the format, the loop points and the chunk index as stored elsewhere; the data's place comes from the index
+	bool assign( const WAVEFORMATEXTENSIBLE& wf, DWORD loopStart, DWORD loopEnd, const std::vector<Chunk>& chunks ) {
+		m_wf = wf;
+		m_loopStart = loopStart;
+		m_loopEnd = loopEnd;
+		m_chunks = chunks;
+		return parseChunks();
+	}
+
+	//describes the pcm a decoder turns a compressed file into: dataLength bytes of it, with no chunks and no loop points.
+	//the data offset is 0, being an offset into the decoded data rather than the file
+	bool assignDecoded( const WAVEFORMATEXTENSIBLE& wf, UINT64 dataLength ) {
+		m_wf = wf;
+		m_dataOffset = 0;
+		m_dataLength = dataLength;
+		m_loopStart = 0;
+		m_loopEnd = 0;
+		m_chunks.clear();
+		return dataLength > 0;
+	}
+
+protected:
+	//checks the index has what's needed to play the file, taking the data's place from it
+	bool parseChunks() {
+		if( findChunk( MAKEFOURCC( 'f', 'm', 't', ' ' ) ) == NULL )
+			return false;
+
+		//set the offset to the wave data, and its length
+		const Chunk* data = findChunk( MAKEFOURCC( 'd', 'a', 't', 'a' ) );
+		if( data == NULL )
 			return false;
+		m_dataOffset = data->offset + 8;
+		m_dataLength = data->size;
+
+		//the sampler chunk can come before the data, so its loop is only checked against the data now
+		UINT64 frames = m_wf.Format.nBlockAlign > 0 ? m_dataLength / m_wf.Format.nBlockAlign : 0;
+		if( m_loopEnd > frames )
+		{
+			m_loopStart = 0;
+			m_loopEnd = 0;
 		}
 
-		//look for 'RIFF' chunk
-		DWORD dwChunkOffset = findChunk( hFile, MAKEFOURCC( 'R', 'I', 'F', 'F' ), memBuffer, dwSectorSize );
-		if(dwChunkOffset == -1)
+		return true;
+	}
+
+public:
+	//returns true if the format is WAVEFORMATEXTENSIBLE; false if WAVEFORMATEX
+	bool isExtensible() const { return (m_wf.Format.cbSize > 0); }
+	//retrieves the WAVEFORMATEX structure
+	const WAVEFORMATEX* wf() const { return &m_wf.Format; }
+	//retrieves the WAVEFORMATEXTENSIBLE structure; meaningless if the wave is not WAVEFORMATEXTENSIBLE
+	const WAVEFORMATEXTENSIBLE* wfex() const { return &m_wf; }
+	//gets the offset from the beginning of the file to the actual wave data
+	UINT64 getDataOffset() const { return m_dataOffset; }
+	//gets the length of the wave data
+	UINT64 getDataLength() const { return m_dataLength; }
+	//the byte offset into the wave data that is this many milliseconds in, from the average byte rate;
+	//rounded down to a whole sample frame and kept within the data
+	UINT64 getDataPositionAtMS( UINT64 milliseconds ) const {
+		DWORD blockAlign = m_wf.Format.nBlockAlign > 0 ? m_wf.Format.nBlockAlign : 1;
+		UINT64 position = (std::min)( milliseconds * m_wf.Format.nAvgBytesPerSec / 1000, m_dataLength );
+		return position / blockAlign * blockAlign;
+	}
+	//the length of the wave data in milliseconds
+	DWORD getDurationMS() const { return m_wf.Format.nAvgBytesPerSec > 0 ? (DWORD)( m_dataLength * 1000 / m_wf.Format.nAvgBytesPerSec ) : 0; }
+	//whether the file carries loop points in a 'smpl' chunk
+	bool hasLoopPoints() const { return m_loopEnd > m_loopStart; }
+	//gets the first sample frame of the loop
+	DWORD getLoopStart() const { return m_loopStart; }
+	//gets the sample frame just past the end of the loop
+	DWORD getLoopEnd() const { return m_loopEnd; }
+
+	//the chunks found in the file, in file order
+	size_t getNumChunks() const { return m_chunks.size(); }
+	const Chunk& getChunk( size_t i ) const { return m_chunks[i]; }
+	//the first chunk with the FOURCC id; NULL if there isn't one
+	const Chunk* findChunk( FOURCC id ) const {
+		for( size_t i = 0; i < m_chunks.size(); i++ )
 		{
-			_aligned_free( memBuffer );
-			CloseHandle( hFile );
+			if( m_chunks[i].id == id )
+				return &m_chunks[i];
+		}
+		return NULL;
+	}
+};
+
+
+//loads a wave's data chunk into memory in one go, for sounds short enough not to stream;
+//buffer() is a single XAUDIO2_BUFFER covering all of it, which any number of voices can submit at once
+class LoadedWave : public WaveInfo
+{
+private:
+	BYTE *m_memory; //the sectors the data chunk spans, read straight in; or the decoded data of a compressed file
+	XAUDIO2_BUFFER m_xaBuffer; //points into m_memory at the start of the data
+
+	//not copyable; share it instead
+	LoadedWave( const LoadedWave& );
+	LoadedWave& operator=( const LoadedWave& );
+
+	//decodes all of a compressed file into memory
+	bool loadDecoded( WaveFileSource* source ) {
+		WaveDecoder* decoder = WaveDecoder::create( source );
+		if( decoder == NULL )
 			return false;
+
+		DWORD blockAlign = decoder->wfex()->Format.nBlockAlign;
+		UINT64 length = decoder->getLength() * blockAlign;
+		DWORD decoded = 0;
+		bool result = length <= XAUDIO2_MAX_BUFFER_BYTES && WaveInfo::assignDecoded( *decoder->wfex(), length );
+		if( result )
+		{
+			m_memory = (BYTE*)waveAlignedAlloc( (size_t)length, 16 );
+			result = m_memory != NULL && decoder->decode( m_memory, (DWORD)decoder->getLength(), &decoded );
 		}
+		delete decoder;
+		if( !result )
+			return false;
+
+		m_xaBuffer.pAudioData = m_memory;
+		m_xaBuffer.AudioBytes = decoded * blockAlign;
+		m_xaBuffer.Flags = XAUDIO2_END_OF_STREAM;
+		return true;
+	}
 
-		DWORD riffFormat = 0;
-		//inFile.seekg( dwChunkOffset + 8, std::ios::beg );
-		//inFile.read( reinterpret_cast<char*>(&riffFormat), sizeof(riffFormat) );
-		if( sizeof(DWORD) != readData( hFile, sizeof(riffFormat), dwChunkOffset + 8, &riffFormat, memBuffer, dwSectorSize ) )
+public:
+	LoadedWave( LPCTSTR szFile = NULL ) : WaveInfo( NULL ), m_memory(NULL) {
+		memset( &m_xaBuffer, 0, sizeof(m_xaBuffer) );
+		load( szFile );
+	}
+	~LoadedWave() { close(); }
+
+	//loads the format and reads the whole of the wave data; returns true on success.
+	//a header parsed earlier from the same file can be passed in to skip reading it again.
+	//a compressed file there's a WaveDecoder for is decoded into memory whole instead
+	bool load( LPCTSTR szFile, const WaveInfo* header = NULL ) {
+		close();
+
+		if( szFile == NULL )
+			return false;
+
+		WaveFileSource* source = WaveFileSource::create();
+		if( !source->open( szFile ) )
 		{
-			_aligned_free( memBuffer );
-			CloseHandle( hFile );
+			delete source;
+			close();
 			return false;
 		}
-		if(riffFormat != MAKEFOURCC('W', 'A', 'V', 'E'))
+		if( header == NULL && !WaveInfo::parse( source ) )
 		{
-			_aligned_free( memBuffer );
-			CloseHandle( hFile );
-			return false;
+			bool decoded = loadDecoded( source );
+			delete source;
+			if( !decoded )
+				close();
+			return decoded;
 		}
 
-		//look for 'fmt ' chunk
-		dwChunkOffset = findChunk( hFile, MAKEFOURCC( 'f', 'm', 't', ' ' ), memBuffer, dwSectorSize );
-		if( dwChunkOffset == -1 )
+		//a single buffer can only hold so much
+		if( ( header != NULL && !WaveInfo::assign( *header ) ) || getDataLength() > XAUDIO2_MAX_BUFFER_BYTES )
 		{
-			_aligned_free( memBuffer );
-			CloseHandle( hFile );
+			delete source;
+			close();
 			return false;
 		}
 
-		//read in first the WAVEFORMATEX structure
-		//inFile.seekg( dwChunkOffset + 8, std::ios::beg );
-		//inFile.read( reinterpret_cast<char*>(&m_wf.Format), sizeof(m_wf.Format) );
-		if( sizeof(m_wf.Format) != readData( hFile, sizeof(m_wf.Format), dwChunkOffset + 8, &m_wf.Format, memBuffer, dwSectorSize ) )
+		//read every sector the data touches, a few megabytes at a time, then point the buffer past the leading slack
+		DWORD sectorSize = source->sectorSize();
+		UINT64 begin = getDataOffset() - getDataOffset() % sectorSize;
+		UINT64 end = (UINT64)getDataOffset() + getDataLength();
+		end = (end + sectorSize - 1) / sectorSize * sectorSize;
+		const DWORD chunkSize = (4 * 1024 * 1024) / sectorSize * sectorSize;
+
+		m_memory = (BYTE*)waveAlignedAlloc( (size_t)(end - begin) + sectorSize, sectorSize );
+		if( m_memory == NULL )
 		{
-			_aligned_free( memBuffer );
-			CloseHandle( hFile );
+			delete source;
+			close();
 			return false;
 		}
-		if( m_wf.Format.cbSize == (sizeof(m_wf) - sizeof(m_wf.Format)) )
+
+		UINT64 total = 0;
+		while( begin + total < end )
 		{
-			//read in whole WAVEFORMATEXTENSIBLE structure
-			//inFile.seekg( dwChunkOffset + 8, std::ios::beg );
-			//inFile.read( reinterpret_cast<char*>(&m_wf), sizeof(m_wf) );
-			if( sizeof(m_wf) != readData( hFile, sizeof(m_wf), dwChunkOffset + 8, &m_wf, memBuffer, dwSectorSize ) )
+			DWORD bytesRead = 0;
+			DWORD bytesToRead = (DWORD)(std::min)( (UINT64)chunkSize, end - begin - total );
+			if( !source->read( begin + total, m_memory + total, bytesToRead, &bytesRead ) )
 			{
-				_aligned_free( memBuffer );
-				CloseHandle( hFile );
+				delete source;
+				close();
 				return false;
 			}
+			total += bytesRead;
+			if( bytesRead < bytesToRead ) //the file is shorter than its data chunk says
+				break;
 		}
+		delete source;
 
-		//look for 'data' chunk
-		dwChunkOffset = findChunk( hFile, MAKEFOURCC( 'd', 'a', 't', 'a' ), memBuffer, dwSectorSize );
-		if(dwChunkOffset == -1)
+		DWORD leading = (DWORD)( getDataOffset() % sectorSize );
+		m_xaBuffer.pAudioData = m_memory + leading;
+		m_xaBuffer.AudioBytes = total > leading ? (DWORD)(std::min)( total - leading, (UINT64)getDataLength() ) : 0;
+		m_xaBuffer.Flags = XAUDIO2_END_OF_STREAM;
+		return true;
+	}
+
+	//frees the data, resetting this object's state
+	void close() {
+		if( m_memory != NULL )
+			waveAlignedFree( m_memory );
+		m_memory = NULL;
+		memset( &m_xaBuffer, 0, sizeof(m_xaBuffer) );
+
+		WaveInfo::load( NULL );
+	}
+
+	bool isLoaded() const { return m_memory != NULL; }
+	//the whole of the wave data, flagged as the end of the stream
+	const XAUDIO2_BUFFER* buffer() const { return &m_xaBuffer; }
+};
+
+
+//the default buffer geometry; see StreamingWave::setBufferSize(), setBufferCount() and setBufferDuration() to pick it per stream.
+//sizes are rounded up to a whole number of disk sectors and sample frames when a file is loaded
+#define STREAMINGWAVE_BUFFER_SIZE 65536
+//should never be less than 3
+#define STREAMINGWAVE_BUFFER_COUNT 3
+//marks a StreamingWave buffer that isn't pointing into a shared block
+#define STREAMINGWAVE_NO_BLOCK (~(UINT64)0)
+
+//rounds a buffer size up to a multiple of both the sector alignment and the block alignment, since reads must start
+//on a sector and buffers must hold whole sample frames
+inline DWORD waveRoundBufferSize( UINT64 size, DWORD sectorAlignment, DWORD blockAlign ) {
+	UINT64 a = sectorAlignment, b = blockAlign > 0 ? blockAlign : 1;
+	UINT64 frame = b;
+	while( b != 0 )
+	{
+		UINT64 t = a % b;
+		a = b;
+		b = t;
+	}
+	UINT64 unit = sectorAlignment / a * frame;
+
+	size = (size + unit - 1) / unit * unit;
+	if( size < unit )
+		size = unit;
+	//keep a buffer plus its slack well inside what a DWORD read can ask for
+	if( size > 0x10000000 )
+		size = (std::max)( 0x10000000 / unit * unit, unit );
+	return (DWORD)size;
+}
+
+//one wave file's data, read in fixed-size blocks as they're asked for and shared by every StreamingWave loaded from it,
+//so overlapping plays of the same file read each stretch of it from disk once. a block is kept while any buffer points
+//into it (it's pinned), and after that for as long as the blocks not pinned fit in the cache's budget, the least
+//recently used going first. safe to use from any number of threads
+class WaveBlockCache : public WaveInfo
+{
+private:
+	enum BLOCK_STATE {
+		BS_ISSUED = 0, //a read-ahead is in flight that nobody has waited on yet
+		BS_READING = 1, //someone is reading it, or waiting on its read-ahead; the rest wait on m_ready
+		BS_READY = 2,
+		BS_FAILED = 3,
+	};
+
+	struct Block
+	{
+		BYTE* pMemory; //the sector-aligned read; the block's wave data starts m_leading bytes in
+		DWORD valid; //the bytes of wave data read into it
+		DWORD pins; //buffers pointing into it, and threads waiting on its read
+		BLOCK_STATE state;
+		UINT64 lastUsed; //m_clock when it was last pinned
+		WaveReadRequest request;
+	};
+
+	WaveFileSource* m_source;
+	std::mutex m_mutex; //guards everything below, but never held for a read
+	std::condition_variable m_ready; //signalled when a block's read finishes
+	std::map<UINT64, Block*> m_blocks;
+	DWORD m_requestedBlockSize; //asked for with setBlockSize()
+	DWORD m_blockSize; //the wave data in each block; a multiple of the sector and block alignments
+	DWORD m_sectorAlignment;
+	DWORD m_leading; //how far into its first sector each block's data starts, the same for every block
+	DWORD m_readAhead;
+	UINT64 m_maxBytes;
+	UINT64 m_bytes; //the memory taken by m_blocks
+	UINT64 m_bytesRead;
+	UINT64 m_clock;
+
+	//not copyable; share it instead
+	WaveBlockCache( const WaveBlockCache& );
+	WaveBlockCache& operator=( const WaveBlockCache& );
+
+	UINT64 numBlocks() const { return m_blockSize > 0 ? ( getDataLength() + m_blockSize - 1 ) / m_blockSize : 0; }
+	//the wave data block i holds; only the last is short
+	DWORD blockLength( UINT64 i ) const { return (DWORD)(std::min)( (UINT64)m_blockSize, getDataLength() - i * m_blockSize ); }
+
+	//a block with its memory, set up to read block i; NULL if the memory couldn't be had
+	Block* newBlock( UINT64 i ) {
+		Block* b = new Block();
+		b->pMemory = (BYTE*)waveAlignedAlloc( m_blockSize + m_sectorAlignment, m_sectorAlignment );
+		if( b->pMemory == NULL )
 		{
-			_aligned_free( memBuffer );
-			CloseHandle( hFile );
-			return false;
+			delete b;
+			return NULL;
 		}
+		b->valid = 0;
+		b->pins = 0;
+		b->state = BS_READING;
+		b->lastUsed = m_clock;
+		b->request.offset = getDataOffset() + i * m_blockSize - m_leading;
+		b->request.pDest = b->pMemory;
+		b->request.bytesToRead = ( m_leading + blockLength( i ) + m_sectorAlignment - 1 ) / m_sectorAlignment * m_sectorAlignment;
+		m_blocks[i] = b;
+		m_bytes += m_blockSize + m_sectorAlignment;
+		return b;
+	}
 
-		//set the offset to the wave data, read in length, then return
-		m_dataOffset = dwChunkOffset + 8;
-		//inFile.seekg( dwChunkOffset + 4, std::ios::beg );
-		//inFile.read( reinterpret_cast<char*>(&m_dataLength), 4 );
-		if( sizeof(m_dataLength) != readData( hFile, sizeof(m_dataLength), dwChunkOffset + 4, &m_dataLength, memBuffer, dwSectorSize ) )
+	void deleteBlock( UINT64 i ) {
+		std::map<UINT64, Block*>::iterator it = m_blocks.find( i );
+		if( it == m_blocks.end() )
+			return;
+		waveAlignedFree( it->second->pMemory );
+		delete it->second;
+		m_blocks.erase( it );
+		m_bytes -= m_blockSize + m_sectorAlignment;
+	}
+
+	//records how a read of block i went; call with the lock held
+	void finishRead( Block* b, UINT64 i, bool succeeded, DWORD bytesRead ) {
+		b->valid = bytesRead > m_leading ? (std::min)( bytesRead - m_leading, blockLength( i ) ) : 0;
+		b->state = succeeded ? BS_READY : BS_FAILED;
+		if( succeeded )
+			m_bytesRead += bytesRead;
+		m_ready.notify_all();
+	}
+
+	//drops the least recently used blocks nobody is using until the rest fit in the budget; call with the lock held
+	void trim() {
+		while( m_bytes > m_maxBytes )
 		{
-			_aligned_free( memBuffer );
-			CloseHandle( hFile );
-			return false;
+			std::map<UINT64, Block*>::iterator oldest = m_blocks.end();
+			for( std::map<UINT64, Block*>::iterator it = m_blocks.begin(); it != m_blocks.end(); ++it )
+			{
+				const Block* b = it->second;
+				if( b->pins == 0 && ( b->state == BS_READY || b->state == BS_FAILED ) && ( oldest == m_blocks.end() || b->lastUsed < oldest->second->lastUsed ) )
+					oldest = it;
+			}
+			if( oldest == m_blocks.end() )
+				return;
+			deleteBlock( oldest->first );
+		}
+	}
+
+	//starts reads for the blocks after block i that aren't cached; call with the lock held
+	void issueReadAhead( UINT64 i ) {
+		for( UINT64 j = i + 1; j <= i + m_readAhead && j < numBlocks(); j++ )
+		{
+			if( m_blocks.count( j ) > 0 )
+				continue;
+			Block* b = newBlock( j );
+			if( b == NULL )
+				return;
+			b->state = BS_ISSUED;
+			if( !m_source->beginRead( &b->request ) )
+			{
+				deleteBlock( j );
+				return;
+			}
 		}
+	}
 
-		_aligned_free( memBuffer );
+public:
+	WaveBlockCache() : WaveInfo( NULL ), m_source(NULL), m_requestedBlockSize(STREAMINGWAVE_BUFFER_SIZE), m_blockSize(0), m_sectorAlignment(0), m_leading(0),
+		m_readAhead(2), m_maxBytes(16 * 1024 * 1024), m_bytes(0), m_bytesRead(0), m_clock(0) {}
+	~WaveBlockCache() { close(); }
+
+	//the size of each block, in bytes (default STREAMINGWAVE_BUFFER_SIZE); takes effect on the next open(),
+	//which rounds it up to whole sectors and sample frames. StreamingWaves loaded from the cache use it as their buffer size
+	void setBlockSize( DWORD bytes ) { m_requestedBlockSize = bytes; }
+	DWORD getBlockSize() const { return m_blockSize; }
+	//how many blocks past the one pinned are read ahead of being asked for (default 2)
+	void setReadAhead( DWORD numBlocks ) { std::lock_guard<std::mutex> lock( m_mutex ); m_readAhead = numBlocks; }
+	//the memory the cache may keep in blocks nobody is using (default 16MB); pinned blocks are never dropped, whatever it comes to
+	void setMaxBytes( UINT64 bytes ) { std::lock_guard<std::mutex> lock( m_mutex ); m_maxBytes = bytes; trim(); }
+
+	//opens the file and reads its header, or takes a header parsed before from the same file; no wave data is read yet
+	bool open( LPCTSTR szFile, const WaveInfo* header = NULL ) {
+		close();
+		if( szFile == NULL )
+			return false;
 
-		CloseHandle( hFile );
+		m_source = WaveFileSource::create();
+		if( !m_source->open( szFile ) || !( header != NULL ? WaveInfo::assign( *header ) : WaveInfo::parse( m_source ) ) )
+		{
+			close();
+			return false;
+		}
 
+		m_sectorAlignment = m_source->sectorSize();
+		m_blockSize = waveRoundBufferSize( m_requestedBlockSize, m_sectorAlignment, wf()->nBlockAlign );
+		m_leading = (DWORD)( getDataOffset() % m_sectorAlignment );
 		return true;
 	}
 
-	//returns true if the format is WAVEFORMATEXTENSIBLE; false if WAVEFORMATEX
-	bool isExtensible() const { return (m_wf.Format.cbSize > 0); }
-	//retrieves the WAVEFORMATEX structure
-	const WAVEFORMATEX* wf() const { return &m_wf.Format; }
-	//retrieves the WAVEFORMATEXTENSIBLE structure; meaningless if the wave is not WAVEFORMATEXTENSIBLE
-	const WAVEFORMATEXTENSIBLE* wfex() const { return &m_wf; }
-	//gets the offset from the beginning of the file to the actual wave data
-	DWORD getDataOffset() const { return m_dataOffset; }
-	//gets the length of the wave data
-	DWORD getDataLength() const { return m_dataLength; }
-};
+	//frees every block and closes the file; nothing may still have a block pinned
+	void close() {
+		std::lock_guard<std::mutex> lock( m_mutex );
+		for( std::map<UINT64, Block*>::iterator it = m_blocks.begin(); it != m_blocks.end(); ++it )
+		{
+			if( it->second->state == BS_ISSUED )
+				m_source->cancelRead( &it->second->request );
+			waveAlignedFree( it->second->pMemory );
+			delete it->second;
+		}
+		m_blocks.clear();
+		m_bytes = 0;
+
+		delete m_source;
+		m_source = NULL;
+		m_blockSize = 0;
+		WaveInfo::load( NULL );
+	}
 
+	bool isOpen() const { return m_source != NULL; }
+	DWORD getSectorAlignment() const { return m_sectorAlignment; }
+
+	//block i's wave data, the bytes of the data from i * getBlockSize() on, reading it first if it isn't cached;
+	//*pValid is how much of it there is, only short of a full block at the end of the file. the block stays put
+	//until a matching unpin(). returns NULL if the read failed, in which case there's nothing to unpin
+	const BYTE* pin( UINT64 i, DWORD* pValid ) {
+		*pValid = 0;
+		std::unique_lock<std::mutex> lock( m_mutex );
+		if( m_source == NULL || i >= numBlocks() )
+			return NULL;
+
+		m_clock++;
+		Block* b = NULL;
+		std::map<UINT64, Block*>::iterator it = m_blocks.find( i );
+		if( it == m_blocks.end() )
+		{
+			//nobody has asked for it yet; read it here, without the lock
+			b = newBlock( i );
+			if( b == NULL )
+				return NULL;
+			b->pins++;
+			issueReadAhead( i );
+			lock.unlock();
+			DWORD bytesRead = 0;
+			bool succeeded = m_source->read( b->request.offset, b->pMemory, b->request.bytesToRead, &bytesRead );
+			lock.lock();
+			finishRead( b, i, succeeded, bytesRead );
+		}
+		else
+		{
+			b = it->second;
+			b->pins++;
+			if( b->state == BS_ISSUED )
+			{
+				//the first to want a read-ahead collects it
+				b->state = BS_READING;
+				lock.unlock();
+				bool succeeded = m_source->waitRead( &b->request );
+				lock.lock();
+				finishRead( b, i, succeeded, b->request.bytesRead );
+			}
+			while( b->state == BS_READING )
+				m_ready.wait( lock );
+			issueReadAhead( i );
+		}
 
-//should remain a power of 2; should also stay 4096 or larger, just to guarantee a multiple of the disk sector size (most are at or below 4096)
-#define STREAMINGWAVE_BUFFER_SIZE 65536
-//should never be less than 3
-#define STREAMINGWAVE_BUFFER_COUNT 3
+		b->lastUsed = m_clock;
+		if( b->state == BS_FAILED )
+		{
+			//the block goes once everyone who waited on it has seen it fail, so the next pin() tries again
+			if( --b->pins == 0 )
+				deleteBlock( i );
+			return NULL;
+		}
+		*pValid = b->valid;
+		return b->pMemory + m_leading;
+	}
+
+	//lets go of a block pinned with pin()
+	void unpin( UINT64 i ) {
+		std::lock_guard<std::mutex> lock( m_mutex );
+		std::map<UINT64, Block*>::iterator it = m_blocks.find( i );
+		if( it == m_blocks.end() || it->second->pins == 0 )
+			return;
+		it->second->pins--;
+		trim();
+	}
+
+	//the memory the blocks take up, pinned or not, and the bytes read from the file so far
+	UINT64 getCachedBytes() { std::lock_guard<std::mutex> lock( m_mutex ); return m_bytes; }
+	UINT64 getBytesRead() { std::lock_guard<std::mutex> lock( m_mutex ); return m_bytesRead; }
+};
 
 class StreamingWave : public WaveInfo
 {
 private:
-	HANDLE m_hFile; //the file being streamed
-	DWORD m_currentReadPass; //the current pass for reading; this number multiplied by STREAMINGWAVE_BUFFER_SIZE, adding getDataOffset(), represents the file position
+	WaveFileSource* m_source; //the file being streamed
+	WaveFileMapping* m_mapping; //m_source, when it's memory mapped; NULL otherwise
+	WaveBlockCache* m_blocks; //where the wave data comes from instead of m_source, when it's shared; NULL otherwise
+	WaveDecoder* m_decoder; //decodes m_source into the wave data, when it's a compressed file; NULL otherwise
+	UINT64 m_decodePosition; //the offset into the wave data m_decoder carries on from; anywhere else takes a seek
+	UINT64* m_pinned; //the block of m_blocks each buffer points into, or STREAMINGWAVE_NO_BLOCK
+	WaveBufferPool* m_pool; //where m_dataBuffer and m_loopHead are leased from; NULL allocates them from the heap
+	bool m_useMapping; //whether the next load() maps the file instead of reading it unbuffered
+	bool m_useCache; //whether the next load() reads through the system cache, when it doesn't map the file
+	UINT64 m_readPosition; //the offset into the wave data of the next buffer to prepare
+	UINT64 m_preparedPosition; //the offset into the wave data the prepared buffer starts at
+	UINT64 m_presentedPosition; //the same, for the buffer last presented by swap()
 	DWORD m_currentReadBuffer; //the current buffer used for reading from file; the presentation buffer is the one right before this
 	bool m_isPrepared; //whether the buffer is prepared for the swap
-	BYTE *m_dataBuffer; //the wave buffers; the size is STREAMINGWAVE_BUFFER_COUNT * STREAMINGWAVE_BUFFER_SIZE + m_sectorAlignment
-	XAUDIO2_BUFFER m_xaBuffer[STREAMINGWAVE_BUFFER_COUNT]; //the xaudio2 buffer information
+	bool m_ended; //whether the buffer at the end of the data has been prepared; nothing follows it
+	BYTE *m_dataBuffer; //the wave buffers; the size is m_bufferCount * m_bufferStride + m_sectorAlignment. when mapped or shared, only allocated for splicing loops
+	XAUDIO2_BUFFER *m_xaBuffer; //the xaudio2 buffer information, one per buffer
 	DWORD m_sectorAlignment; //the sector alignment for reading; this value is added to the entire buffer's size for sector-aligned reading and reference
-	DWORD m_bufferBeginOffset; //the starting offset for each buffer (when the file reads are offset by an amount)
-public:
-	StreamingWave( LPCTSTR szFile = NULL ) : WaveInfo( NULL ), m_hFile(INVALID_HANDLE_VALUE), m_currentReadPass(0), m_currentReadBuffer(0), m_isPrepared(false), 
-		m_dataBuffer(NULL), m_sectorAlignment(0), m_bufferBeginOffset(0) {
-			memset( m_xaBuffer, 0, sizeof(m_xaBuffer) );
+	DWORD m_bufferSize; //the amount of wave data in a full buffer; a multiple of both the sector alignment and the block alignment
+	DWORD m_queueBufferCount; //the number of buffers the voice cycles through, at most one fewer queued at a time
+	DWORD m_bufferCount; //m_queueBufferCount, plus one for each read kept in flight
+	DWORD m_bufferStride; //the distance between buffers in m_dataBuffer
+	DWORD m_requestedBufferSize; //the buffer size asked for with setBufferSize()
+	DWORD m_requestedBufferCount; //the buffer count asked for with setBufferCount()
+	DWORD m_bufferDuration; //the milliseconds asked for with setBufferDuration(); 0 uses m_requestedBufferSize
+	DWORD m_readAhead; //the number of reads to keep in flight beyond the buffer being prepared, from the next load(); 0 reads synchronously in prepare()
+	WaveReadRequest *m_readRequests; //one per buffer when reading ahead, NULL otherwise
+	DWORD m_issueBuffer; //the buffer the next read-ahead lands in
+	UINT64 m_issuePosition; //the offset into the wave data the next read-ahead is for
+	bool m_looping; //whether playback wraps from the end of the loop back to its start, rather than ending
+	UINT64 m_loopBegin; //the loop's first byte in the wave data; the 'smpl' loop if there is one, otherwise the whole of the data
+	UINT64 m_loopEnd; //the byte just past the loop
+	BYTE *m_loopHead; //the start of the loop, repeated out to m_loopHeadSize; spliced onto the buffer that reaches the loop end. NULL until looping is first turned on
+	DWORD m_loopHeadSize; //m_bufferSize, plus the loop's length when the whole loop fits in a buffer
+
+	//works out the size of a full buffer for the loaded format; reads must start on a sector,
+	//and buffers must hold whole sample frames, so the size is rounded up to a multiple of both
+	DWORD chooseBufferSize( DWORD sectorAlignment ) const {
+		UINT64 size = m_requestedBufferSize;
+		if( m_bufferDuration > 0 )
+			size = (UINT64)wf()->nAvgBytesPerSec * m_bufferDuration / 1000;
+		return waveRoundBufferSize( size, sectorAlignment, wf()->nBlockAlign );
+	}
 
-			//figure the sector alignment
-			DWORD dw1, dw2, dw3;
-			GetDiskFreeSpace( NULL, &dw1, &m_sectorAlignment, &dw2, &dw3 );
+	//(re)allocates the buffers for the given geometry; the sector alignment is only known once a file is open.
+	//a mapped or shared file needs no memory of its own for the wave data, just the xaudio2 buffer information
+	bool allocateBuffers( DWORD sectorAlignment, DWORD bufferSize, DWORD queueBufferCount, DWORD readAhead, bool mapped ) {
+		//reads can complete out of order when reading ahead, so each buffer gets its own sector of slack to overrun into;
+		//synchronous reads always finish in order, so there the next buffer's start can be overwritten before it is read over again
+		DWORD bufferCount = queueBufferCount + readAhead;
+		DWORD bufferStride = readAhead > 0 ? bufferSize + sectorAlignment : bufferSize;
+		if( mapped )
+		{
+			readAhead = 0;
+			bufferCount = queueBufferCount;
+			bufferStride = bufferSize;
+		}
+		if( m_xaBuffer != NULL && m_sectorAlignment == sectorAlignment && m_bufferSize == bufferSize && m_queueBufferCount == queueBufferCount
+			&& m_bufferCount == bufferCount && m_bufferStride == bufferStride )
+			return mapped || m_dataBuffer != NULL || allocateData();
+
+		freeBuffers();
+
+		m_sectorAlignment = sectorAlignment;
+		m_bufferSize = bufferSize;
+		m_queueBufferCount = queueBufferCount;
+		m_bufferCount = bufferCount;
+		m_bufferStride = bufferStride;
+		m_xaBuffer = new XAUDIO2_BUFFER[ m_bufferCount ];
+		memset( m_xaBuffer, 0, m_bufferCount * sizeof(XAUDIO2_BUFFER) );
+		m_pinned = new UINT64[ m_bufferCount ];
+		for( DWORD i = 0; i < m_bufferCount; i++ )
+			m_pinned[i] = STREAMINGWAVE_NO_BLOCK;
+		if( readAhead > 0 )
+			m_readRequests = new WaveReadRequest[ m_bufferCount ];
+		if( mapped )
+			return true;
+
+		return allocateData();
+	}
 
-			//allocate the buffers
-			m_dataBuffer = (BYTE*)_aligned_malloc( STREAMINGWAVE_BUFFER_COUNT * STREAMINGWAVE_BUFFER_SIZE + m_sectorAlignment, m_sectorAlignment );
-			memset( m_dataBuffer, 0, STREAMINGWAVE_BUFFER_COUNT * STREAMINGWAVE_BUFFER_SIZE + m_sectorAlignment );
+	//sector-aligned memory from the pool, or from the heap without one; neither is zeroed
+	BYTE* allocateAligned( size_t size ) {
+		return m_pool != NULL ? m_pool->lease( size, m_sectorAlignment ) : (BYTE*)waveAlignedAlloc( size, m_sectorAlignment );
+	}
+	void freeAligned( BYTE* p, size_t size ) {
+		if( p == NULL )
+			return;
+		if( m_pool != NULL )
+			m_pool->release( p, size );
+		else
+			waveAlignedFree( p );
+	}
 
-			load( szFile );
+	//the size of m_dataBuffer for the current geometry
+	size_t dataSize() const { return (size_t)m_bufferCount * m_bufferStride + m_sectorAlignment; }
+
+	//allocates m_dataBuffer for the current geometry; buffers are only ever played as far as they've been filled,
+	//so whatever was in the memory before doesn't matter
+	bool allocateData() {
+		m_dataBuffer = allocateAligned( dataSize() );
+		return m_dataBuffer != NULL;
+	}
+
+	void freeData() {
+		freeAligned( m_dataBuffer, dataSize() );
+		m_dataBuffer = NULL;
+	}
+
+	void freeBuffers() {
+		freeData();
+		delete [] m_xaBuffer;
+		m_xaBuffer = NULL;
+		delete [] m_pinned;
+		m_pinned = NULL;
+		delete [] m_readRequests;
+		m_readRequests = NULL;
+	}
+
+	//lets go of the block buffer i points into, if it's pointing into one
+	void unpinBuffer( DWORD i ) {
+		if( m_pinned == NULL || m_pinned[i] == STREAMINGWAVE_NO_BLOCK )
+			return;
+		if( m_blocks != NULL )
+			m_blocks->unpin( m_pinned[i] );
+		m_pinned[i] = STREAMINGWAVE_NO_BLOCK;
 	}
-	StreamingWave( const StreamingWave& c ) : WaveInfo(c), m_hFile(c.m_hFile), m_currentReadPass(c.m_currentReadPass), m_currentReadBuffer(c.m_currentReadBuffer),
-		m_isPrepared(c.m_isPrepared), m_dataBuffer(NULL), m_sectorAlignment(c.m_sectorAlignment), m_bufferBeginOffset(c.m_bufferBeginOffset) {
-			if( m_sectorAlignment == 0 )
+
+	//copies length bytes of the wave data from pos on out of the shared blocks; false if a block couldn't be read
+	bool copyBlocks( UINT64 pos, BYTE* pDest, DWORD length ) {
+		while( length > 0 )
+		{
+			UINT64 index = pos / m_bufferSize;
+			DWORD within = (DWORD)( pos % m_bufferSize );
+			DWORD valid = 0;
+			const BYTE* data = m_blocks->pin( index, &valid );
+			if( data == NULL )
+				return false;
+			DWORD n = valid > within ? (std::min)( valid - within, length ) : 0;
+			memcpy( pDest, data + within, n );
+			m_blocks->unpin( index );
+			if( n == 0 )
+				return false;
+			pos += n;
+			pDest += n;
+			length -= n;
+		}
+		return true;
+	}
+
+	//whether there's a file to read from, of either kind
+	bool hasSource() const { return m_source != NULL || m_blocks != NULL; }
+
+	void freeLoopHead() {
+		freeAligned( m_loopHead, m_loopHeadSize );
+		m_loopHead = NULL;
+		m_loopHeadSize = 0;
+	}
+
+	//works out the loop region and reads the start of it into m_loopHead; done once per file, the first time looping is on.
+	//returns false if the start of the loop couldn't be read
+	bool buildLoopHead() {
+		if( m_loopHead != NULL || !m_looping || !hasSource() )
+			return true;
+
+		UINT64 blockAlign = wf()->nBlockAlign > 0 ? wf()->nBlockAlign : 1;
+		m_loopBegin = 0;
+		m_loopEnd = getDataLength() / blockAlign * blockAlign;
+		if( hasLoopPoints() )
+		{
+			m_loopBegin = getLoopStart() * blockAlign;
+			m_loopEnd = getLoopEnd() * blockAlign;
+		}
+		if( m_loopEnd <= m_loopBegin ) //nothing to loop; plays through to the end as though not looping
+			return true;
+
+		//a loop shorter than a buffer is repeated, so a buffer can start at any point of it and still be read out whole
+		UINT64 loopLength = m_loopEnd - m_loopBegin;
+		DWORD firstLength = (DWORD)(std::min)( loopLength, (UINT64)m_bufferSize );
+		DWORD headSize = m_bufferSize + ( loopLength < m_bufferSize ? (DWORD)loopLength : 0 );
+		BYTE* head = allocateAligned( headSize );
+		if( head == NULL )
+			return false;
+
+		UINT64 offset = getDataOffset() + m_loopBegin;
+		if( m_decoder != NULL )
+		{
+			DWORD decoded = 0;
+			if( !m_decoder->seek( m_loopBegin / blockAlign ) || !m_decoder->decode( head, firstLength / (DWORD)blockAlign, &decoded ) || decoded * blockAlign < firstLength )
+			{
+				freeAligned( head, headSize );
+				return false;
+			}
+			m_decodePosition = m_loopBegin + firstLength;
+		}
+		else if( m_blocks != NULL )
+		{
+			if( ( m_dataBuffer == NULL && !allocateData() ) || !copyBlocks( m_loopBegin, head, firstLength ) )
+			{
+				freeAligned( head, headSize );
+				return false;
+			}
+		}
+		else if( m_mapping != NULL )
+		{
+			if( offset + firstLength > m_mapping->size() || ( m_dataBuffer == NULL && !allocateData() ) )
+			{
+				freeAligned( head, headSize );
+				return false;
+			}
+			memcpy( head, m_mapping->data() + offset, firstLength );
+		}
+		else
+		{
+			//the loop start is rarely on a sector, so read the sectors around it and copy out
+			UINT64 sectorOffset = offset - offset % m_sectorAlignment;
+			DWORD readLength = (DWORD)( ( offset + firstLength - sectorOffset + m_sectorAlignment - 1 ) / m_sectorAlignment * m_sectorAlignment );
+			BYTE* sectors = (BYTE*)waveAlignedAlloc( readLength, m_sectorAlignment );
+			DWORD bytesRead = 0;
+			if( sectors == NULL || !m_source->read( sectorOffset, sectors, readLength, &bytesRead ) || bytesRead < offset - sectorOffset + firstLength )
+			{
+				if( sectors != NULL )
+					waveAlignedFree( sectors );
+				freeAligned( head, headSize );
+				return false;
+			}
+			memcpy( head, sectors + ( offset - sectorOffset ), firstLength );
+			waveAlignedFree( sectors );
+		}
+		for( DWORD i = firstLength; i < headSize; i += firstLength )
+			memcpy( head + i, head, (std::min)( firstLength, headSize - i ) );
+
+		m_loopHead = head;
+		m_loopHeadSize = headSize;
+		return true;
+	}
+
+	//whether buffers wrap at the loop end
+	bool loopActive() const { return m_looping && m_loopHead != NULL; }
+	//the end of the stretch of data a buffer starting at pos plays up to before it has to loop, or stop;
+	//looping from past the loop end plays out the rest of the data first
+	UINT64 segmentEnd( UINT64 pos ) const { return ( loopActive() && pos < m_loopEnd ) ? m_loopEnd : getDataLength(); }
+	//whether the buffer starting at pos comes whole from the loop head, without touching the file
+	bool fromLoopHead( UINT64 pos ) const { return loopActive() && m_loopEnd - m_loopBegin < m_bufferSize && pos >= m_loopBegin && pos < m_loopEnd; }
+	//the offset into the wave data of the buffer after the one starting at pos
+	UINT64 nextPosition( UINT64 pos ) const {
+		UINT64 end = pos + m_bufferSize;
+		if( !loopActive() || end < segmentEnd( pos ) )
+			return end;
+		return m_loopBegin + ( end - segmentEnd( pos ) ) % ( m_loopEnd - m_loopBegin );
+	}
+
+	//how far into the first sector of its read the buffer starting at pos begins
+	DWORD beginOffset( UINT64 pos ) const { return (DWORD)( ( getDataOffset() + pos ) % m_sectorAlignment ); }
+	//the file offset of the sector-aligned read for the buffer starting at pos
+	UINT64 readOffset( UINT64 pos ) const { return getDataOffset() + pos - beginOffset( pos ); }
+
+	//the buffer the next pass will be read into
+	DWORD nextReadBuffer() const { return m_isPrepared ? (m_currentReadBuffer + 1) % m_bufferCount : m_currentReadBuffer; }
+	//the number of read-aheads issued and not yet consumed by prepare()
+	DWORD outstandingReads() const { return (m_issueBuffer + m_bufferCount - nextReadBuffer()) % m_bufferCount; }
+
+	//keeps a read in flight for every read-ahead buffer past the one being prepared, stopping at the end of the data;
+	//buffers coming from the loop head take a slot but need no read. returns false if a read couldn't be issued
+	bool issueReads() {
+		//the voice holds at most m_queueBufferCount - 2 buffers behind the one being prepared,
+		//so with the read-aheads in front of it, a read never lands in a buffer that is still queued
+		while( outstandingReads() < m_bufferCount - m_queueBufferCount + 1 && m_issuePosition < segmentEnd( m_issuePosition ) )
+		{
+			if( !fromLoopHead( m_issuePosition ) )
 			{
-				//figure the sector alignment
-				DWORD dw1, dw2, dw3;
-				GetDiskFreeSpace( NULL, &dw1, &m_sectorAlignment, &dw2, &dw3 );
+				WaveReadRequest* r = &m_readRequests[ m_issueBuffer ];
+				r->offset = readOffset( m_issuePosition );
+				r->pDest = m_dataBuffer + m_bufferStride * m_issueBuffer;
+				r->bytesToRead = m_bufferSize + m_sectorAlignment;
+				r->priority = outstandingReads() == 0; //the next prepare() waits on this one
+
+				if( !m_source->beginRead( r ) )
+					return false;
 			}
 
-			//allocate the buffers
-			m_dataBuffer = (BYTE*)_aligned_malloc( STREAMINGWAVE_BUFFER_COUNT * STREAMINGWAVE_BUFFER_SIZE + m_sectorAlignment, m_sectorAlignment );
-			memset( m_dataBuffer, 0, STREAMINGWAVE_BUFFER_COUNT * STREAMINGWAVE_BUFFER_SIZE + m_sectorAlignment );
+			m_issueBuffer = (m_issueBuffer + 1) % m_bufferCount;
+			m_issuePosition = nextPosition( m_issuePosition );
+		}
+		return true;
+	}
+
+	//drops every read-ahead in flight, waiting out those already under way; the next prepare() reads from m_readPosition again
+	void cancelReads() {
+		if( m_readRequests == NULL )
+			return;
+
+		for( DWORD i = 0; i < m_bufferCount; i++ )
+		{
+			if( m_readRequests[i].pending )
+				m_source->cancelRead( &m_readRequests[i] );
+		}
+		m_issueBuffer = nextReadBuffer();
+		m_issuePosition = m_readPosition;
+	}
+
+	//marks the current buffer as holding nothing more to play
+	DWORD prepareEnd( DWORD result ) {
+		XAUDIO2_BUFFER& b = m_xaBuffer[ m_currentReadBuffer ];
+		b.AudioBytes = 0;
+		b.Flags = XAUDIO2_END_OF_STREAM;
+		b.pContext = result == PR_EOF ? this : NULL;
+		if( result == PR_EOF )
+		{
+			m_isPrepared = true;
+			m_ended = true;
+		}
+		return result;
+	}
+
+	//not copyable; a second stream of the same file loads it again
+	StreamingWave( const StreamingWave& );
+	StreamingWave& operator =( const StreamingWave& );
+
+	//takes over what c owns and where it's got to, leaving c closed with its settings kept; this mustn't own anything yet.
+	//nothing is copied or reopened: the file, the buffers and the reads in flight into them change hands as they are
+	void take( StreamingWave& c ) WAVE_NOEXCEPT {
+		m_source = waveTake( c.m_source );
+		m_mapping = waveTake( c.m_mapping );
+		m_blocks = waveTake( c.m_blocks );
+		m_decoder = waveTake( c.m_decoder );
+		m_decodePosition = c.m_decodePosition;
+		m_pinned = waveTake( c.m_pinned );
+		m_pool = c.m_pool;
+		m_useMapping = c.m_useMapping;
+		m_useCache = c.m_useCache;
+		m_readPosition = c.m_readPosition;
+		m_preparedPosition = c.m_preparedPosition;
+		m_presentedPosition = c.m_presentedPosition;
+		m_currentReadBuffer = c.m_currentReadBuffer;
+		m_isPrepared = c.m_isPrepared;
+		m_ended = c.m_ended;
+		m_dataBuffer = waveTake( c.m_dataBuffer );
+		m_xaBuffer = waveTake( c.m_xaBuffer );
+		m_sectorAlignment = c.m_sectorAlignment;
+		m_bufferSize = c.m_bufferSize;
+		m_queueBufferCount = c.m_queueBufferCount;
+		m_bufferCount = c.m_bufferCount;
+		m_bufferStride = c.m_bufferStride;
+		m_requestedBufferSize = c.m_requestedBufferSize;
+		m_requestedBufferCount = c.m_requestedBufferCount;
+		m_bufferDuration = c.m_bufferDuration;
+		m_readAhead = c.m_readAhead;
+		m_readRequests = waveTake( c.m_readRequests );
+		m_issueBuffer = c.m_issueBuffer;
+		m_issuePosition = c.m_issuePosition;
+		m_looping = c.m_looping;
+		m_loopBegin = c.m_loopBegin;
+		m_loopEnd = c.m_loopEnd;
+		m_loopHead = waveTake( c.m_loopHead );
+		m_loopHeadSize = c.m_loopHeadSize;
+
+		//the buffer at the end of the data names its stream
+		for( DWORD i = 0; i < m_bufferCount && m_xaBuffer != NULL; i++ )
+		{
+			if( m_xaBuffer[i].pContext == &c )
+				m_xaBuffer[i].pContext = this;
+		}
+
+		c.m_sectorAlignment = 0;
+		c.m_bufferSize = 0;
+		c.m_queueBufferCount = 0;
+		c.m_bufferCount = 0;
+		c.m_bufferStride = 0;
+		c.m_loopHeadSize = 0;
+		c.close();
+	}
 
-			memcpy( m_dataBuffer, c.m_dataBuffer, STREAMINGWAVE_BUFFER_COUNT * STREAMINGWAVE_BUFFER_SIZE + m_sectorAlignment );
-			memcpy( m_xaBuffer, c.m_xaBuffer, sizeof(m_xaBuffer) );
-			for( int i = 0; i < STREAMINGWAVE_BUFFER_COUNT; i++ )
-				m_xaBuffer[i].pAudioData = m_dataBuffer + m_bufferBeginOffset + i * STREAMINGWAVE_BUFFER_SIZE;
+public:
+	StreamingWave( LPCTSTR szFile = NULL ) : WaveInfo( NULL ), m_source(NULL), m_mapping(NULL), m_blocks(NULL), m_decoder(NULL), m_decodePosition(0), m_pinned(NULL), m_pool(NULL), m_useMapping(false), m_useCache(false), m_readPosition(0), m_preparedPosition(0), m_presentedPosition(0), m_currentReadBuffer(0), m_isPrepared(false), m_ended(false),
+		m_dataBuffer(NULL), m_xaBuffer(NULL), m_sectorAlignment(0), m_bufferSize(0), m_queueBufferCount(0), m_bufferCount(0),
+		m_bufferStride(0), m_requestedBufferSize(STREAMINGWAVE_BUFFER_SIZE), m_requestedBufferCount(STREAMINGWAVE_BUFFER_COUNT), m_bufferDuration(0), m_readAhead(0),
+		m_readRequests(NULL), m_issueBuffer(0), m_issuePosition(0), m_looping(false), m_loopBegin(0), m_loopEnd(0), m_loopHead(NULL), m_loopHeadSize(0) {
+			load( szFile );
+	}
+	//move-only, so streams can be kept by value and handed between threads. buffers already queued on a voice carry the
+	//old address as their end of stream context, so a playing stream is stopped and flushed before it's moved
+	StreamingWave( StreamingWave&& c ) WAVE_NOEXCEPT : WaveInfo( std::move( c ) ) {
+		take( c );
+	}
+	StreamingWave& operator =( StreamingWave&& c ) WAVE_NOEXCEPT {
+		if( this != &c )
+		{
+			close();
+			freeBuffers();
+			WaveInfo::operator =( std::move( c ) );
+			take( c );
+		}
+		return *this;
 	}
 	~StreamingWave() {
 		close();
+		freeBuffers();
+	}
 
-		if( m_dataBuffer != NULL )
-			_aligned_free( m_dataBuffer );
-		m_dataBuffer = NULL;
+	//sets how many reads are kept in flight ahead of the buffer being prepared; 0 (the default) reads each buffer
+	//synchronously in prepare(). each read-ahead costs one more buffer.
+	//takes effect on the next load()
+	void setReadAhead( DWORD numReads ) { m_readAhead = numReads; }
+	DWORD getReadAhead() const { return m_readAhead; }
+
+	//sets the size of each buffer, in bytes (default STREAMINGWAVE_BUFFER_SIZE); takes effect on the next load(),
+	//which rounds it up to whole sectors and sample frames. ignored while a buffer duration is set
+	void setBufferSize( DWORD bytes ) { m_requestedBufferSize = bytes; }
+	DWORD getRequestedBufferSize() const { return m_requestedBufferSize; }
+	//sets the number of buffers (default STREAMINGWAVE_BUFFER_COUNT, at least 3); all but one are queued on the voice.
+	//takes effect on the next load()
+	void setBufferCount( DWORD count ) { m_requestedBufferCount = (std::max)( count, (DWORD)3 ); }
+	//sizes the buffers on the next load() to hold about this many milliseconds of audio each, from the file's byte rate;
+	//the sector size puts a floor under it. 0 goes back to setBufferSize()
+	void setBufferDuration( DWORD milliseconds ) { m_bufferDuration = milliseconds; }
+	DWORD getBufferDuration() const { return m_bufferDuration; }
+
+	//maps the whole file into memory on the next load(), instead of streaming it with unbuffered reads;
+	//buffers then point straight into the mapping, which suits files likely to be in the system cache already.
+	//the read-ahead setting becomes how many buffers ahead of the one prepared are prefetched
+	void setMemoryMapped( bool mapped ) { m_useMapping = mapped; }
+	bool isMemoryMapped() const { return m_useMapping; }
+	//reads the file through the system cache on the next load() instead of around it, still into the stream's own buffers;
+	//a mapping goes through the cache regardless
+	void setSystemCached( bool cached ) { m_useCache = cached; }
+	bool isSystemCached() const { return m_useCache; }
+
+	//leases the buffers from the pool from now on, or allocates them from the heap with NULL (the default).
+	//leased buffers go back to the pool on close() for other streams to use; heap ones are kept for the next load().
+	//changing it closes the file. the pool must outlive this object, or its next setBufferPool()
+	void setBufferPool( WaveBufferPool* pool ) {
+		if( pool == m_pool )
+			return;
+		close();
+		freeData();
+		m_pool = pool;
+	}
+	WaveBufferPool* getBufferPool() const { return m_pool; }
+
+	//loops playback over the file's 'smpl' loop, or the whole of the data if it has none. buffers stay full across the seam:
+	//the one reaching the loop end carries on with the loop start, so the sample after the last of the loop is the first of it.
+	//takes effect from the next buffer prepared; the first time it's turned on for a file, the start of the loop is read in.
+	//returns false if that read failed, in which case the stream plays on to the end
+	bool setLooping( bool loop ) {
+		if( loop == m_looping )
+			return true;
+		m_looping = loop;
+		if( !hasSource() )
+			return true;
+
+		//the read-aheads in flight were issued for where the data would have gone before
+		cancelReads();
+		bool result = buildLoopHead();
+		if( loopActive() && m_readPosition >= getDataLength() )
+			m_readPosition = m_loopBegin;
+		m_issuePosition = m_readPosition;
+		m_ended = false;
+		return result;
 	}
+	bool isLooping() const { return m_looping; }
 
-	//loads the file for streaming wave data
-	bool load( LPCTSTR szFile ) {
+	//the size of a full buffer for the loaded file
+	DWORD getBufferSize() const { return m_bufferSize; }
+	//the number of buffers for the loaded file, not counting read-aheads; queue at most one fewer than this on the voice
+	DWORD getBufferCount() const { return m_queueBufferCount; }
+
+	//loads the file for streaming wave data; a header parsed earlier from the same file can be passed in to skip reading it again.
+	//a compressed file there's a WaveDecoder for is decoded a buffer at a time in prepare(), which reads it synchronously
+	bool load( LPCTSTR szFile, const WaveInfo* header = NULL ) {
 		close();
 
-		//test if the data can be loaded
-		if( !WaveInfo::load( szFile ) )
+		if( szFile == NULL )
 			return false;
 
-		//figure the offset for the wave data in allocated memory
-		m_bufferBeginOffset = getDataOffset() % m_sectorAlignment;
-
 		//open the file
-		m_hFile = CreateFileW( szFile, GENERIC_READ, FILE_SHARE_READ, NULL, OPEN_EXISTING, FILE_FLAG_NO_BUFFERING, NULL );
-		if( m_hFile == INVALID_HANDLE_VALUE )
+		if( m_useMapping )
+		{
+			m_mapping = new WaveFileMapping();
+			m_source = m_mapping;
+		}
+		else
+		{
+			m_source = WaveFileSource::create( m_useCache );
+		}
+		if( !m_source->open( szFile ) )
+		{
+			close();
 			return false;
+		}
 
-		//set the xaudio2 buffer struct to refer to appropriate buffer starting points (but leave size of the data as 0)
-		for( int i = 0; i < STREAMINGWAVE_BUFFER_COUNT; i++ )
-			m_xaBuffer[i].pAudioData = m_dataBuffer + m_bufferBeginOffset + i * STREAMINGWAVE_BUFFER_SIZE;
+		//test if the data can be loaded
+		bool parsed = header != NULL ? WaveInfo::assign( *header ) : WaveInfo::parse( m_source );
+		if( !parsed && header == NULL )
+		{
+			m_decoder = WaveDecoder::create( m_source );
+			m_decodePosition = 0;
+			parsed = m_decoder != NULL && WaveInfo::assignDecoded( *m_decoder->wfex(), m_decoder->getLength() * m_decoder->wfex()->Format.nBlockAlign );
+		}
+		if( !parsed || !allocateBuffers( m_source->sectorSize(), chooseBufferSize( m_source->sectorSize() ), m_requestedBufferCount, m_decoder != NULL ? 0 : m_readAhead, m_mapping != NULL && m_decoder == NULL )
+			|| !buildLoopHead() )
+		{
+			close();
+			return false;
+		}
+
+		//the buffers are pointed at their data as they're prepared
+		if( m_mapping != NULL )
+			m_mapping->prefetch( getDataOffset(), (UINT64)m_bufferSize * m_bufferCount );
 
 		return true;
 	}
 
+	//streams from a cache of the file's blocks shared with other StreamingWaves, instead of opening the file itself;
+	//buffers point straight into the blocks, so this takes no memory for the wave data beyond a loop's splice.
+	//the buffer size is the cache's block size and read-ahead is the cache's. the cache must outlive this object, or its next load()
+	bool load( WaveBlockCache* blocks ) {
+		close();
+
+		if( blocks == NULL || !blocks->isOpen() )
+			return false;
+
+		m_blocks = blocks;
+		if( !WaveInfo::assign( *blocks ) || !allocateBuffers( blocks->getSectorAlignment(), blocks->getBlockSize(), m_requestedBufferCount, 0, true ) || !buildLoopHead() )
+		{
+			close();
+			return false;
+		}
+		return true;
+	}
+
 	//closes the file stream, resetting this object's state
 	void close() {
-		if( m_hFile != INVALID_HANDLE_VALUE )
-			CloseHandle( m_hFile );
-		m_hFile = INVALID_HANDLE_VALUE;
-
-		m_bufferBeginOffset = 0;
-		memset( m_xaBuffer, 0, sizeof(m_xaBuffer) );
-		memset( m_dataBuffer, 0, STREAMINGWAVE_BUFFER_COUNT * STREAMINGWAVE_BUFFER_SIZE + m_sectorAlignment );
+		delete m_decoder;
+		m_decoder = NULL;
+		m_decodePosition = 0;
+		if( m_source != NULL )
+		{
+			cancelReads();
+			delete m_source;
+		}
+		m_source = NULL;
+		m_mapping = NULL;
+		for( DWORD i = 0; i < m_bufferCount && m_pinned != NULL; i++ )
+			unpinBuffer( i );
+		m_blocks = NULL;
+
+		if( m_xaBuffer != NULL )
+			memset( m_xaBuffer, 0, m_bufferCount * sizeof(XAUDIO2_BUFFER) );
+		if( m_pool != NULL )
+			freeData();
+		freeLoopHead();
+		m_loopBegin = 0;
+		m_loopEnd = 0;
 		m_isPrepared = false;
+		m_ended = false;
 		m_currentReadBuffer = 0;
-		m_currentReadPass = 0;
+		m_readPosition = 0;
+		m_issueBuffer = 0;
+		m_issuePosition = 0;
 
 		WaveInfo::load( NULL );
 	}
 
 	//swaps the presentation buffer to the next one
-	void swap() {m_currentReadBuffer = (m_currentReadBuffer + 1) % STREAMINGWAVE_BUFFER_COUNT; m_isPrepared = false;}
+	void swap() {m_currentReadBuffer = (m_currentReadBuffer + 1) % m_bufferCount; m_isPrepared = false; m_presentedPosition = m_preparedPosition;}
 
-	//gets the current buffer
-	const XAUDIO2_BUFFER* buffer() const {return &m_xaBuffer[ (m_currentReadBuffer + STREAMINGWAVE_BUFFER_COUNT - 1) % STREAMINGWAVE_BUFFER_COUNT ];}
+	//gets the current buffer. the one at the end of the data is flagged XAUDIO2_END_OF_STREAM, and its pContext is this StreamingWave,
+	//so a voice callback can tell the stream has finished rather than run dry
+	const XAUDIO2_BUFFER* buffer() const {return &m_xaBuffer[ (m_currentReadBuffer + m_bufferCount - 1) % m_bufferCount ];}
+
+	//the offset into the wave data that the current buffer starts at; a buffer spliced at the loop end, or taken from the loop head,
+	//carries on from getWrapBegin() once it reaches getWrapEnd()
+	UINT64 getBufferPosition() const { return m_presentedPosition; }
+	//the byte range of the wave data buffers wrap around in while looping; both 0 when they don't
+	UINT64 getWrapBegin() const { return loopActive() ? m_loopBegin : 0; }
+	UINT64 getWrapEnd() const { return loopActive() ? m_loopEnd : 0; }
+
+	//whether the buffer at the end of the data has been presented; prepare() has nothing more to give until resetFile()
+	bool isFinished() const { return m_ended && !m_isPrepared; }
 
 	//resets the file pointer to the beginning of the wave data;
 	//this will not wipe out buffers that have been prepared, so it is safe to call
 	//after a call to prepare() has returned PR_EOF, and before a call to swap() has
-	//been made to present the prepared buffer
-	void resetFile() {m_currentReadPass = 0;}
+	//been made to present the prepared buffer.
+	//when reading ahead, the reads for the start of the data are issued straight away
+	void resetFile() {
+		m_readPosition = 0;
+		m_ended = false;
+		if( m_mapping != NULL )
+			m_mapping->prefetch( getDataOffset(), (UINT64)m_bufferSize * ( m_readAhead + 1 ) );
+		if( m_readRequests != NULL && m_source != NULL )
+		{
+			cancelReads();
+			issueReads();
+		}
+	}
+
+	//moves the stream to a byte offset into the wave data, rounded down to a whole sample frame; any prepared buffer is dropped.
+	//the buffers already presented are left alone, so flush them from the voice first. the buffer starts on the exact frame,
+	//its read starting at the sector before it; when reading ahead, that read goes ahead of any others queued
+	void seek( UINT64 position ) {
+		if( !hasSource() )
+			return;
+
+		UINT64 blockAlign = wf()->nBlockAlign > 0 ? wf()->nBlockAlign : 1;
+		position = (std::min)( position, (UINT64)getDataLength() ) / blockAlign * blockAlign;
+		if( loopActive() && position >= getDataLength() )
+			position = m_loopBegin;
+
+		cancelReads();
+		m_isPrepared = false;
+		m_ended = false;
+		m_readPosition = position;
+		m_issuePosition = position;
+		m_issueBuffer = m_currentReadBuffer;
+
+		if( m_mapping != NULL )
+			m_mapping->prefetch( getDataOffset() + position, (UINT64)m_bufferSize * ( m_readAhead + 1 ) );
+		//a failure here turns up again in prepare()
+		if( m_readRequests != NULL )
+			issueReads();
+	}
+
+	//the offset into the wave data of the next buffer prepare() will fill
+	UINT64 getReadPosition() const { return m_readPosition; }
 
 	enum PREPARE_RESULT {
 		PR_SUCCESS = 0,
@@ -410,90 +1409,180 @@ public:
 	//prepares the next buffer for presentation;
 	//returns PR_SUCCESS on success,
 	//PR_FAILURE on failure,
-	//and PR_EOF when the end of the data has been reached
+	//and PR_EOF when the buffer prepared is the last of the data. a looping stream never ends
 	DWORD prepare() {
 		//validation check
-		if( m_hFile == INVALID_HANDLE_VALUE )
+		if( !hasSource() )
 		{
-			m_xaBuffer[ m_currentReadBuffer ].AudioBytes = 0;
-			m_xaBuffer[ m_currentReadBuffer ].Flags = XAUDIO2_END_OF_STREAM;
+			if( m_xaBuffer != NULL )
+				prepareEnd( PR_FAILURE );
 			return PR_FAILURE;
 		}
 
 		//are we already prepared?
 		if( m_isPrepared )
 			return PR_SUCCESS;
+		m_preparedPosition = m_readPosition;
 
-		//figure the offset of the file pointer
-		OVERLAPPED overlapped = {0};
-		overlapped.Offset = getDataOffset() - m_bufferBeginOffset + STREAMINGWAVE_BUFFER_SIZE * m_currentReadPass;
+		//top up the reads in flight; the one for this buffer is among them unless the data has run out
+		if( m_readRequests != NULL && !issueReads() )
+		{
+			cancelReads();
+			return prepareEnd( PR_FAILURE );
+		}
 
 		//preliminary end-of-data check
-		if( overlapped.Offset + m_bufferBeginOffset > getDataLength() + getDataOffset() )
+		UINT64 pos = m_readPosition;
+		if( pos >= segmentEnd( pos ) )
+			return prepareEnd( PR_EOF );
+
+		XAUDIO2_BUFFER& b = m_xaBuffer[ m_currentReadBuffer ];
+		BYTE* slot = m_dataBuffer != NULL ? m_dataBuffer + m_bufferStride * m_currentReadBuffer : NULL;
+		b.pContext = NULL;
+		//the voice is done with whatever this buffer held before
+		unpinBuffer( m_currentReadBuffer );
+
+		//a loop shorter than a buffer is played straight out of the loop head
+		if( fromLoopHead( pos ) )
 		{
-			m_xaBuffer[ m_currentReadBuffer ].AudioBytes = 0;
-			m_xaBuffer[ m_currentReadBuffer ].Flags = XAUDIO2_END_OF_STREAM;
+			b.pAudioData = m_loopHead + ( pos - m_loopBegin );
+			b.AudioBytes = m_bufferSize;
+			b.Flags = 0;
 			m_isPrepared = true;
-			return PR_EOF;
+			m_readPosition = nextPosition( pos );
+			return PR_SUCCESS;
 		}
 
-		//read in data from file
-		DWORD dwNumBytesRead = 0;
-		if( FALSE == ReadFile( m_hFile, m_dataBuffer + STREAMINGWAVE_BUFFER_SIZE * m_currentReadBuffer, STREAMINGWAVE_BUFFER_SIZE + m_sectorAlignment, &dwNumBytesRead, &overlapped ) )
+		//the wave data this buffer takes from the file; short of a full buffer only at the loop end, or the end of the data
+		DWORD length = (DWORD)(std::min)( (UINT64)m_bufferSize, segmentEnd( pos ) - pos );
+		bool splice = loopActive() && length < m_bufferSize;
+		DWORD valid = 0;
+		UINT64 next = nextPosition( pos );
+
+		if( m_decoder != NULL )
 		{
-			m_xaBuffer[ m_currentReadBuffer ].AudioBytes = 0;
-			m_xaBuffer[ m_currentReadBuffer ].Flags = XAUDIO2_END_OF_STREAM;
-			return PR_FAILURE;
+			//carry on decoding from the last buffer, unless this one starts somewhere else
+			DWORD blockAlign = wf()->nBlockAlign;
+			DWORD decoded = 0;
+			if( ( pos != m_decodePosition && !m_decoder->seek( pos / blockAlign ) ) || !m_decoder->decode( slot, length / blockAlign, &decoded ) )
+			{
+				m_decodePosition = ~(UINT64)0;
+				return prepareEnd( PR_FAILURE );
+			}
+			valid = decoded * blockAlign;
+			m_decodePosition = pos + valid;
+			b.pAudioData = slot;
 		}
-
-		//force dwNumBytesRead to be less than the actual amount read if reading past the end of the data chunk
-		if( dwNumBytesRead + STREAMINGWAVE_BUFFER_SIZE * m_currentReadPass > getDataLength() )
+		else if( m_blocks != NULL )
 		{
-			if( STREAMINGWAVE_BUFFER_SIZE * m_currentReadPass <= getDataLength() )
-				dwNumBytesRead = min( dwNumBytesRead, getDataLength() - STREAMINGWAVE_BUFFER_SIZE * m_currentReadPass ); //bytes read are from overlapping file chunks
+			//a buffer can't run on past the end of its block; one starting partway into a block (after a seek, or from the loop start)
+			//stops short at the end of it, and the next one lines up with the blocks again
+			UINT64 index = pos / m_bufferSize;
+			DWORD within = (DWORD)( pos % m_bufferSize );
+			if( length > m_bufferSize - within )
+			{
+				length = m_bufferSize - within;
+				splice = false;
+				next = pos + length;
+			}
+
+			DWORD blockValid = 0;
+			const BYTE* data = m_blocks->pin( index, &blockValid );
+			if( data == NULL )
+				return prepareEnd( PR_FAILURE );
+			valid = blockValid > within ? (std::min)( blockValid - within, length ) : 0;
+			if( splice )
+			{
+				memcpy( slot, data + within, valid );
+				b.pAudioData = slot;
+				m_blocks->unpin( index );
+			}
 			else
-				dwNumBytesRead = 0; //none of the bytes are from the correct data chunk; this should never happen due to the preliminary end-of-data check, unless the file was wrong
+			{
+				b.pAudioData = data + within;
+				m_pinned[ m_currentReadBuffer ] = index;
+			}
 		}
-
-		//end-of-file/data check
-		if( dwNumBytesRead < STREAMINGWAVE_BUFFER_SIZE + m_sectorAlignment )
+		else if( m_mapping != NULL )
 		{
-			//check for case where less than the sectorAlignment amount of data is still available in the file;
-			//of course, only do something if there isn't that amount of data left
-			if( dwNumBytesRead < m_bufferBeginOffset )
-			{//no valid data at all; this shouldn't happen since the preliminary end-of-data check happened already, unless the file was wrong
-				m_xaBuffer[ m_currentReadBuffer ].AudioBytes = 0;
-				m_xaBuffer[ m_currentReadBuffer ].Flags = XAUDIO2_END_OF_STREAM;
-				m_isPrepared = true;
+			//point the buffer straight into the mapped file; only a buffer spliced at the loop end needs copying
+			UINT64 offset = (UINT64)getDataOffset() + pos;
+			UINT64 available = offset < m_mapping->size() ? m_mapping->size() - offset : 0;
+			valid = (DWORD)(std::min)( (UINT64)length, available );
+			if( splice )
+			{
+				memcpy( slot, m_mapping->data() + offset, valid );
+				b.pAudioData = slot;
+			}
+			else
+			{
+				b.pAudioData = m_mapping->data() + (std::min)( offset, m_mapping->size() );
+			}
 
-				//increment the current read pass
-				m_currentReadPass++;
-				return PR_EOF;
+			//fault the buffer in here, rather than on the audio thread, and get the system reading the next stretch of the file
+			m_mapping->touch( offset, valid );
+			m_mapping->prefetch( getDataOffset() + next, (UINT64)m_bufferSize * ( m_readAhead + 1 ) );
+		}
+		else
+		{
+			//read in data from file, or collect the read-ahead issued for it
+			DWORD dwNumBytesRead = 0;
+			bool readSucceeded;
+			if( m_readRequests != NULL )
+			{
+				readSucceeded = m_source->waitRead( &m_readRequests[ m_currentReadBuffer ] );
+				dwNumBytesRead = m_readRequests[ m_currentReadBuffer ].bytesRead;
+			}
+			else
+			{
+				readSucceeded = m_source->read( readOffset( pos ), slot, m_bufferSize + m_sectorAlignment, &dwNumBytesRead );
 			}
-			else if( dwNumBytesRead - m_bufferBeginOffset <= STREAMINGWAVE_BUFFER_SIZE )
-			{//some valid data; this should always happen for the end-of-file and end-of-data conditions
-				m_xaBuffer[ m_currentReadBuffer ].AudioBytes = dwNumBytesRead - m_bufferBeginOffset; //do not include the data offset as valid data
-				m_xaBuffer[ m_currentReadBuffer ].Flags = XAUDIO2_END_OF_STREAM;
-				m_isPrepared = true;
-
-				//increment the current read pass
-				m_currentReadPass++;
-				return PR_EOF;
+			if( !readSucceeded )
+			{
+				//drop the rest of the read-aheads too, so a later prepare() starts over at this buffer
+				cancelReads();
+				return prepareEnd( PR_FAILURE );
 			}
+
+			//the read began beginOffset() bytes before the buffer's data, so those don't count towards it
+			DWORD leading = beginOffset( pos );
+			valid = dwNumBytesRead > leading ? (std::min)( dwNumBytesRead - leading, length ) : 0;
+			b.pAudioData = slot + leading;
 		}
 
-		//set the amount of data available;
-		//this should always be STREAMINGWAVE_BUFFER_SIZE, unless one of the previous conditions (end-of-file, end-of-data) were met
-		m_xaBuffer[ m_currentReadBuffer ].AudioBytes = STREAMINGWAVE_BUFFER_SIZE;
-		m_xaBuffer[ m_currentReadBuffer ].Flags = 0;
 		m_isPrepared = true;
+		m_readPosition = next;
 
-		//increment the current read pass
-		m_currentReadPass++;
+		//the file is shorter than its data chunk says; play what there is, and end there
+		if( valid < length )
+		{
+			b.AudioBytes = valid;
+			b.Flags = XAUDIO2_END_OF_STREAM;
+			b.pContext = this;
+			m_ended = true;
+			return PR_EOF;
+		}
 
-		//return success
+		//carry on from the loop start, filling the buffer out so no short buffer sits at the seam
+		if( splice )
+		{
+			memcpy( (BYTE*)b.pAudioData + length, m_loopHead, m_bufferSize - length );
+			b.AudioBytes = m_bufferSize;
+			b.Flags = 0;
+			return PR_SUCCESS;
+		}
+
+		b.AudioBytes = length;
+		if( !loopActive() && pos + length >= getDataLength() )
+		{
+			b.Flags = XAUDIO2_END_OF_STREAM;
+			b.pContext = this;
+			m_ended = true;
+			return PR_EOF;
+		}
+		b.Flags = 0;
 		return PR_SUCCESS;
 	}
 };
 
-#endif
\ No newline at end of file
+#endif
@@ -0,0 +1,253 @@
+//waveMix.h
+//sums voices into one interleaved float block, the way an output's mixer would, for the outputs that don't have one
+//(the null device, offline renders). each voice's gain and pan are ramped across the block from where the last block
+//left them, so changes don't zipper. the kernels have sse2, avx2 and neon versions as well as plain c++
+
+#ifndef WAVEMIX_H
+#define WAVEMIX_H
+
+#include "waveTypes.h"
+#include "waveConvert.h"
+
+#include <cmath>
+
+//the left and right gains pan (-1 to 1) gives a source of the given number of channels: a mono source is panned at
+//constant power, so it keeps its loudness across the field; a stereo one has the far side turned down
+inline void wavePanGains( float pan, UINT32 sourceChannels, float* pLeft, float* pRight ) {
+	pan = (std::max)( -1.0f, (std::min)( pan, 1.0f ) );
+	if( sourceChannels == 1 )
+	{
+		float angle = ( pan + 1 ) * 0.785398163f; //0 to pi/2
+		*pLeft = cosf( angle );
+		*pRight = sinf( angle );
+	}
+	else
+	{
+		*pLeft = pan > 0 ? 1 - pan : 1;
+		*pRight = pan < 0 ? 1 + pan : 1;
+	}
+}
+
+//what a voice is mixed at: the first two channels' gains, volume and pan together, and the volume the rest get
+struct WaveMixGains
+{
+	float left;
+	float right;
+	float other;
+};
+
+inline WaveMixGains waveMixGains( float volume, float pan, UINT32 sourceChannels ) {
+	WaveMixGains g;
+	wavePanGains( pan, sourceChannels, &g.left, &g.right );
+	g.left *= volume;
+	g.right *= volume;
+	g.other = volume;
+	return g;
+}
+
+//adds frames of mono or stereo input into a stereo block, from frame begin on; frame i gets the gains
+//left + i * leftStep and right + i * rightStep
+inline void waveMixScalar( const float* pIn, UINT32 inChannels, float* pOut, size_t begin, size_t frames, float left, float right, float leftStep, float rightStep ) {
+	for( size_t i = begin; i < frames; i++ )
+	{
+		float l = left + (float)i * leftStep, r = right + (float)i * rightStep;
+		float inL = pIn[ i * inChannels ], inR = pIn[ i * inChannels + inChannels - 1 ];
+		pOut[ 2 * i ] += inL * l;
+		pOut[ 2 * i + 1 ] += inR * r;
+	}
+}
+
+//the sse2, avx2 and neon kernels do what they can in whole vectors, returning the number of frames done;
+//waveMixScalar() finishes off the rest
+#ifdef WAVECONVERT_SSE2
+inline size_t waveMixSSE2( const float* pIn, UINT32 inChannels, float* pOut, size_t frames, float left, float right, float leftStep, float rightStep ) {
+	//two stereo frames a vector
+	const __m128 base = _mm_setr_ps( left, right, left, right );
+	const __m128 step = _mm_setr_ps( leftStep, rightStep, leftStep, rightStep );
+	const __m128 offset = _mm_setr_ps( 0, 0, 1, 1 );
+	size_t i = 0;
+	if( inChannels == 1 )
+	{
+		for( ; i + 4 <= frames; i += 4 )
+		{
+			__m128 m = _mm_loadu_ps( pIn + i );
+			__m128 g0 = _mm_add_ps( base, _mm_mul_ps( _mm_add_ps( _mm_set1_ps( (float)i ), offset ), step ) );
+			__m128 g1 = _mm_add_ps( base, _mm_mul_ps( _mm_add_ps( _mm_set1_ps( (float)( i + 2 ) ), offset ), step ) );
+			_mm_storeu_ps( pOut + 2 * i, _mm_add_ps( _mm_loadu_ps( pOut + 2 * i ), _mm_mul_ps( _mm_unpacklo_ps( m, m ), g0 ) ) );
+			_mm_storeu_ps( pOut + 2 * i + 4, _mm_add_ps( _mm_loadu_ps( pOut + 2 * i + 4 ), _mm_mul_ps( _mm_unpackhi_ps( m, m ), g1 ) ) );
+		}
+	}
+	else
+	{
+		for( ; i + 2 <= frames; i += 2 )
+		{
+			__m128 g = _mm_add_ps( base, _mm_mul_ps( _mm_add_ps( _mm_set1_ps( (float)i ), offset ), step ) );
+			_mm_storeu_ps( pOut + 2 * i, _mm_add_ps( _mm_loadu_ps( pOut + 2 * i ), _mm_mul_ps( _mm_loadu_ps( pIn + 2 * i ), g ) ) );
+		}
+	}
+	return i;
+}
+#endif
+
+#ifdef WAVECONVERT_AVX2
+WAVECONVERT_AVX2_TARGET inline size_t waveMixAVX2( const float* pIn, UINT32 inChannels, float* pOut, size_t frames, float left, float right, float leftStep, float rightStep ) {
+	//four stereo frames a vector
+	const __m256 base = _mm256_setr_ps( left, right, left, right, left, right, left, right );
+	const __m256 step = _mm256_setr_ps( leftStep, rightStep, leftStep, rightStep, leftStep, rightStep, leftStep, rightStep );
+	const __m256 offset = _mm256_setr_ps( 0, 0, 1, 1, 2, 2, 3, 3 );
+	size_t i = 0;
+	if( inChannels == 1 )
+	{
+		for( ; i + 4 <= frames; i += 4 )
+		{
+			__m128 m = _mm_loadu_ps( pIn + i );
+			__m256 in = _mm256_insertf128_ps( _mm256_castps128_ps256( _mm_unpacklo_ps( m, m ) ), _mm_unpackhi_ps( m, m ), 1 );
+			__m256 g = _mm256_add_ps( base, _mm256_mul_ps( _mm256_add_ps( _mm256_set1_ps( (float)i ), offset ), step ) );
+			_mm256_storeu_ps( pOut + 2 * i, _mm256_add_ps( _mm256_loadu_ps( pOut + 2 * i ), _mm256_mul_ps( in, g ) ) );
+		}
+	}
+	else
+	{
+		for( ; i + 4 <= frames; i += 4 )
+		{
+			__m256 g = _mm256_add_ps( base, _mm256_mul_ps( _mm256_add_ps( _mm256_set1_ps( (float)i ), offset ), step ) );
+			_mm256_storeu_ps( pOut + 2 * i, _mm256_add_ps( _mm256_loadu_ps( pOut + 2 * i ), _mm256_mul_ps( _mm256_loadu_ps( pIn + 2 * i ), g ) ) );
+		}
+	}
+	return i;
+}
+#endif
+
+#ifdef WAVECONVERT_NEON
+inline size_t waveMixNEON( const float* pIn, UINT32 inChannels, float* pOut, size_t frames, float left, float right, float leftStep, float rightStep ) {
+	//two stereo frames a vector
+	const float b[4] = { left, right, left, right };
+	const float s[4] = { leftStep, rightStep, leftStep, rightStep };
+	const float o[4] = { 0, 0, 1, 1 };
+	const float32x4_t base = vld1q_f32( b ), step = vld1q_f32( s ), offset = vld1q_f32( o );
+	size_t i = 0;
+	if( inChannels == 1 )
+	{
+		for( ; i + 4 <= frames; i += 4 )
+		{
+			float32x4_t m = vld1q_f32( pIn + i );
+			float32x4x2_t pairs = vzipq_f32( m, m );
+			float32x4_t g0 = vaddq_f32( base, vmulq_f32( vaddq_f32( vdupq_n_f32( (float)i ), offset ), step ) );
+			float32x4_t g1 = vaddq_f32( base, vmulq_f32( vaddq_f32( vdupq_n_f32( (float)( i + 2 ) ), offset ), step ) );
+			vst1q_f32( pOut + 2 * i, vaddq_f32( vld1q_f32( pOut + 2 * i ), vmulq_f32( pairs.val[0], g0 ) ) );
+			vst1q_f32( pOut + 2 * i + 4, vaddq_f32( vld1q_f32( pOut + 2 * i + 4 ), vmulq_f32( pairs.val[1], g1 ) ) );
+		}
+	}
+	else
+	{
+		for( ; i + 2 <= frames; i += 2 )
+		{
+			float32x4_t g = vaddq_f32( base, vmulq_f32( vaddq_f32( vdupq_n_f32( (float)i ), offset ), step ) );
+			vst1q_f32( pOut + 2 * i, vaddq_f32( vld1q_f32( pOut + 2 * i ), vmulq_f32( vld1q_f32( pIn + 2 * i ), g ) ) );
+		}
+	}
+	return i;
+}
+#endif
+
+//adds frames of mono or stereo input into a stereo block with the fastest kernel the processor has
+inline void waveMixStereo( const float* pIn, UINT32 inChannels, float* pOut, size_t frames, float left, float right, float leftStep, float rightStep ) {
+	size_t done = 0;
+#if defined(WAVECONVERT_AVX2)
+	static const bool avx2 = waveHasAVX2();
+	done = avx2 ? waveMixAVX2( pIn, inChannels, pOut, frames, left, right, leftStep, rightStep ) : waveMixSSE2( pIn, inChannels, pOut, frames, left, right, leftStep, rightStep );
+#elif defined(WAVECONVERT_SSE2)
+	done = waveMixSSE2( pIn, inChannels, pOut, frames, left, right, leftStep, rightStep );
+#elif defined(WAVECONVERT_NEON)
+	done = waveMixNEON( pIn, inChannels, pOut, frames, left, right, leftStep, rightStep );
+#endif
+	waveMixScalar( pIn, inChannels, pOut, done, frames, left, right, leftStep, rightStep );
+}
+
+//a block of interleaved float output that voices are summed into, a block at a time
+class WaveMixer
+{
+private:
+	float* m_block;
+	DWORD m_channels;
+	DWORD m_maxFrames;
+	DWORD m_frames; //the length of the block being mixed
+
+	//not copyable; it owns its block
+	WaveMixer( const WaveMixer& );
+	WaveMixer& operator=( const WaveMixer& );
+
+public:
+	WaveMixer() : m_block(NULL), m_channels(0), m_maxFrames(0), m_frames(0) {}
+	~WaveMixer() { close(); }
+
+	//gets ready to mix blocks of up to maxFrames with the given number of channels; returns false if the memory couldn't be had
+	bool setup( DWORD channels, DWORD maxFrames ) {
+		close();
+		if( channels == 0 || maxFrames == 0 )
+			return false;
+		m_block = (float*)waveAlignedAlloc( (size_t)channels * maxFrames * sizeof(float), 32 );
+		if( m_block == NULL )
+			return false;
+		m_channels = channels;
+		m_maxFrames = maxFrames;
+		return true;
+	}
+
+	void close() {
+		if( m_block != NULL )
+			waveAlignedFree( m_block );
+		m_block = NULL;
+		m_channels = 0;
+		m_maxFrames = 0;
+		m_frames = 0;
+	}
+
+	//starts a block of silence of this many frames (up to the most set up for)
+	void clear( DWORD frames ) {
+		m_frames = (std::min)( frames, m_maxFrames );
+		if( m_block != NULL )
+			memset( m_block, 0, (size_t)m_frames * m_channels * sizeof(float) );
+	}
+
+	//adds a block's worth of interleaved float input with inChannels channels, its gains ramped from from to to across it.
+	//the first two channels go to the block's first two, panned; any more go to the block's channels of the same number
+	void mix( const float* pIn, UINT32 inChannels, const WaveMixGains& from, const WaveMixGains& to ) {
+		if( m_block == NULL || m_frames == 0 || inChannels == 0 )
+			return;
+
+		float leftStep = ( to.left - from.left ) / m_frames, rightStep = ( to.right - from.right ) / m_frames;
+		if( m_channels == 2 && inChannels <= 2 )
+		{
+			waveMixStereo( pIn, inChannels, m_block, m_frames, from.left, from.right, leftStep, rightStep );
+			return;
+		}
+
+		//anything other than mono or stereo into stereo is rare enough to go through the plain loop
+		float otherStep = ( to.other - from.other ) / m_frames;
+		for( DWORD i = 0; i < m_frames; i++ )
+		{
+			const float* pFrame = pIn + (size_t)i * inChannels;
+			float* pDest = m_block + (size_t)i * m_channels;
+			if( m_channels == 1 )
+			{
+				float sum = 0;
+				for( UINT32 c = 0; c < inChannels; c++ )
+					sum += pFrame[c];
+				pDest[0] += sum / inChannels * ( from.other + (float)i * otherStep );
+				continue;
+			}
+			pDest[0] += pFrame[0] * ( from.left + (float)i * leftStep );
+			pDest[1] += pFrame[ inChannels > 1 ? 1 : 0 ] * ( from.right + (float)i * rightStep );
+			for( UINT32 c = 2; c < inChannels && c < m_channels; c++ )
+				pDest[c] += pFrame[c] * ( from.other + (float)i * otherStep );
+		}
+	}
+
+	const float* block() const { return m_block; }
+	DWORD getFrames() const { return m_frames; }
+	DWORD getMaxFrames() const { return m_maxFrames; }
+	DWORD getChannels() const { return m_channels; }
+};
+
+#endif
@@ -0,0 +1,458 @@
+//waveResample.h
+//a streaming windowed-sinc resampler for float wave data, carrying its filter history from one buffer to the next
+//so a stream can be taken to the output's sample rate a buffer at a time with no seams.
+//the filter is a polyphase table of kaiser-windowed sinc kernels, interpolated between phases for any ratio;
+//the quality tiers trade kernel length (and cpu) for stopband rejection. WaveFormatConverter puts it together with the
+//float conversion, as the one stage a stream's buffers go through on their way to the voice
+
+#ifndef WAVERESAMPLE_H
+#define WAVERESAMPLE_H
+
+#include "waveTypes.h"
+#include "waveConvert.h"
+
+#include <cmath>
+#include <vector>
+
+//the resampler's quality tiers, by the number of input frames each output frame is filtered from
+enum RESAMPLE_QUALITY {
+	RQ_FAST = 0, //8 taps; for many voices at once
+	RQ_GOOD = 1, //16 taps
+	RQ_HIGH = 2, //32 taps
+	RQ_BEST = 3, //64 taps; for a few voices where it matters
+};
+
+//the dot products of the input against two neighbouring phases of the kernel; taps is a multiple of 8
+inline void waveDot2Scalar( const float* pIn, const float* pC0, const float* pC1, DWORD taps, float* pD0, float* pD1 ) {
+	float d0 = 0, d1 = 0;
+	for( DWORD i = 0; i < taps; i++ )
+	{
+		d0 += pIn[i] * pC0[i];
+		d1 += pIn[i] * pC1[i];
+	}
+	*pD0 = d0;
+	*pD1 = d1;
+}
+
+#ifdef WAVECONVERT_SSE2
+inline void waveDot2SSE2( const float* pIn, const float* pC0, const float* pC1, DWORD taps, float* pD0, float* pD1 ) {
+	__m128 a0 = _mm_setzero_ps(), a1 = _mm_setzero_ps();
+	for( DWORD i = 0; i < taps; i += 4 )
+	{
+		__m128 x = _mm_loadu_ps( pIn + i );
+		a0 = _mm_add_ps( a0, _mm_mul_ps( x, _mm_load_ps( pC0 + i ) ) );
+		a1 = _mm_add_ps( a1, _mm_mul_ps( x, _mm_load_ps( pC1 + i ) ) );
+	}
+	//sum each accumulator's four lanes, the two side by side
+	__m128 lo = _mm_unpacklo_ps( a0, a1 ), hi = _mm_unpackhi_ps( a0, a1 );
+	__m128 s = _mm_add_ps( lo, hi );
+	s = _mm_add_ps( s, _mm_movehl_ps( s, s ) );
+	*pD0 = _mm_cvtss_f32( s );
+	*pD1 = _mm_cvtss_f32( _mm_shuffle_ps( s, s, 1 ) );
+}
+#endif
+
+#ifdef WAVECONVERT_AVX2
+WAVECONVERT_AVX2_TARGET inline void waveDot2AVX2( const float* pIn, const float* pC0, const float* pC1, DWORD taps, float* pD0, float* pD1 ) {
+	__m256 a0 = _mm256_setzero_ps(), a1 = _mm256_setzero_ps();
+	for( DWORD i = 0; i < taps; i += 8 )
+	{
+		__m256 x = _mm256_loadu_ps( pIn + i );
+		a0 = _mm256_add_ps( a0, _mm256_mul_ps( x, _mm256_load_ps( pC0 + i ) ) );
+		a1 = _mm256_add_ps( a1, _mm256_mul_ps( x, _mm256_load_ps( pC1 + i ) ) );
+	}
+	__m128 s0 = _mm_add_ps( _mm256_castps256_ps128( a0 ), _mm256_extractf128_ps( a0, 1 ) );
+	__m128 s1 = _mm_add_ps( _mm256_castps256_ps128( a1 ), _mm256_extractf128_ps( a1, 1 ) );
+	__m128 lo = _mm_unpacklo_ps( s0, s1 ), hi = _mm_unpackhi_ps( s0, s1 );
+	__m128 s = _mm_add_ps( lo, hi );
+	s = _mm_add_ps( s, _mm_movehl_ps( s, s ) );
+	*pD0 = _mm_cvtss_f32( s );
+	*pD1 = _mm_cvtss_f32( _mm_shuffle_ps( s, s, 1 ) );
+}
+#endif
+
+#ifdef WAVECONVERT_NEON
+inline void waveDot2NEON( const float* pIn, const float* pC0, const float* pC1, DWORD taps, float* pD0, float* pD1 ) {
+	float32x4_t a0 = vdupq_n_f32( 0 ), a1 = vdupq_n_f32( 0 );
+	for( DWORD i = 0; i < taps; i += 4 )
+	{
+		float32x4_t x = vld1q_f32( pIn + i );
+		a0 = vmlaq_f32( a0, x, vld1q_f32( pC0 + i ) );
+		a1 = vmlaq_f32( a1, x, vld1q_f32( pC1 + i ) );
+	}
+	float32x2_t s0 = vadd_f32( vget_low_f32( a0 ), vget_high_f32( a0 ) );
+	float32x2_t s1 = vadd_f32( vget_low_f32( a1 ), vget_high_f32( a1 ) );
+	float32x2_t s = vpadd_f32( s0, s1 );
+	*pD0 = vget_lane_f32( s, 0 );
+	*pD1 = vget_lane_f32( s, 1 );
+}
+#endif
+
+class WaveResampler
+{
+private:
+	typedef void (*DOT2)( const float*, const float*, const float*, DWORD, float*, float* );
+
+	DWORD m_channels;
+	DWORD m_taps;
+	DWORD m_phases;
+	double m_step; //input frames per output frame
+	float* m_table; //m_phases + 1 rows of m_taps coefficients; row p is the kernel offset by p / m_phases of a frame
+	std::vector<float> m_history; //the input still needed, one run of m_capacity frames per channel
+	DWORD m_capacity;
+	DWORD m_available; //the frames of each channel's run holding input
+	double m_time; //where the next output frame falls, in frames into the runs
+	DOT2 m_dot2;
+
+	//not copyable; each stream sets up its own
+	WaveResampler( const WaveResampler& );
+	WaveResampler& operator=( const WaveResampler& );
+
+	//the zeroth order modified bessel function, for the kaiser window
+	static double besselI0( double x ) {
+		double sum = 1, term = 1;
+		for( int k = 1; k < 50; k++ )
+		{
+			term *= ( x / ( 2 * k ) ) * ( x / ( 2 * k ) );
+			sum += term;
+			if( term < sum * 1e-12 )
+				break;
+		}
+		return sum;
+	}
+
+	//fills the table with kernels low-passed at the lower of the two nyquists, each row normalised to unity gain
+	bool buildTable( double beta ) {
+		if( m_table != NULL )
+			waveAlignedFree( m_table );
+		m_table = (float*)waveAlignedAlloc( (size_t)( m_phases + 1 ) * m_taps * sizeof(float), 32 );
+		if( m_table == NULL )
+			return false;
+
+		const double pi = 3.14159265358979323846;
+		double cutoff = ( m_step > 1 ? 1 / m_step : 1.0 ) * 0.97; //a little short of nyquist, for the transition band
+		double half = m_taps / 2.0;
+		double norm = besselI0( beta );
+		for( DWORD p = 0; p <= m_phases; p++ )
+		{
+			float* row = m_table + (size_t)p * m_taps;
+			double offset = (double)p / m_phases;
+			double sum = 0;
+			for( DWORD j = 0; j < m_taps; j++ )
+			{
+				//tap j reads the frame j - half + 1 from the one the output falls after
+				double x = (double)j - half + 1 - offset;
+				double sinc = x == 0 ? 1 : std::sin( pi * cutoff * x ) / ( pi * cutoff * x );
+				double r = x / half;
+				double window = r * r < 1 ? besselI0( beta * std::sqrt( 1 - r * r ) ) / norm : 0;
+				row[j] = (float)( sinc * window );
+				sum += row[j];
+			}
+			for( DWORD j = 0; j < m_taps; j++ )
+				row[j] = (float)( row[j] / sum );
+		}
+		return true;
+	}
+
+	//makes room for more frames of input in each channel's run
+	void reserve( DWORD frames ) {
+		if( m_available + frames <= m_capacity )
+			return;
+		DWORD capacity = (std::max)( m_available + frames, m_capacity * 2 );
+		std::vector<float> history( (size_t)capacity * m_channels, 0.0f );
+		for( DWORD c = 0; c < m_channels && m_available > 0; c++ )
+			memcpy( &history[ (size_t)c * capacity ], &m_history[ (size_t)c * m_capacity ], m_available * sizeof(float) );
+		m_history.swap( history );
+		m_capacity = capacity;
+	}
+
+public:
+	WaveResampler() : m_channels(0), m_taps(0), m_phases(0), m_step(1), m_table(NULL), m_capacity(0), m_available(0), m_time(0), m_dot2(waveDot2Scalar) {
+#if defined(WAVECONVERT_AVX2)
+		static const bool avx2 = waveHasAVX2();
+		m_dot2 = avx2 ? waveDot2AVX2 : waveDot2SSE2;
+#elif defined(WAVECONVERT_SSE2)
+		m_dot2 = waveDot2SSE2;
+#elif defined(WAVECONVERT_NEON)
+		m_dot2 = waveDot2NEON;
+#endif
+	}
+	~WaveResampler() { close(); }
+
+	//gets ready to take channels of interleaved float input at inRate to outRate; returns false if the memory couldn't be had
+	bool setup( DWORD channels, DWORD inRate, DWORD outRate, RESAMPLE_QUALITY quality ) {
+		close();
+		if( channels == 0 || inRate == 0 || outRate == 0 )
+			return false;
+
+		static const DWORD taps[] = { 8, 16, 32, 64 };
+		static const double betas[] = { 5.0, 6.5, 8.0, 9.5 };
+		int q = (std::min)( (std::max)( (int)quality, 0 ), 3 );
+		m_channels = channels;
+		m_taps = taps[q];
+		m_phases = 256;
+		m_step = (double)inRate / outRate;
+		if( !buildTable( betas[q] ) )
+		{
+			close();
+			return false;
+		}
+		reset();
+		return true;
+	}
+
+	void close() {
+		if( m_table != NULL )
+			waveAlignedFree( m_table );
+		m_table = NULL;
+		m_history.clear();
+		m_capacity = 0;
+		m_available = 0;
+		m_channels = 0;
+	}
+
+	bool isActive() const { return m_table != NULL; }
+	//the kernel's length in input frames; the output lags the input by half of it
+	DWORD getTaps() const { return m_taps; }
+
+	//forgets the input so far, as for a seek; the next input is treated as the start of the sound
+	void reset() {
+		//the first output frame is filtered from silence before the sound as much as from the sound
+		DWORD lead = m_taps / 2 - 1;
+		m_available = 0;
+		reserve( lead );
+		for( DWORD c = 0; c < m_channels; c++ )
+			memset( &m_history[ (size_t)c * m_capacity ], 0, lead * sizeof(float) );
+		m_available = lead;
+		m_time = lead;
+	}
+
+	//the most output frames process() can make from this many input frames, flushing or not
+	DWORD maxOutput( DWORD inFrames ) const {
+		return (DWORD)std::ceil( ( inFrames + m_taps ) / m_step ) + 1;
+	}
+
+	//resamples inFrames of interleaved input into pOut, returning the number of frames written (never more than maxOutput()).
+	//output is held back until the input it needs has arrived; flush pads the end of the sound with silence to let it all out
+	DWORD process( const float* pIn, DWORD inFrames, float* pOut, bool flush ) {
+		DWORD pad = flush ? m_taps / 2 : 0;
+		reserve( inFrames + pad );
+		for( DWORD c = 0; c < m_channels; c++ )
+		{
+			float* run = &m_history[ (size_t)c * m_capacity ];
+			for( DWORD i = 0; i < inFrames; i++ )
+				run[ m_available + i ] = pIn[ (size_t)i * m_channels + c ];
+			memset( run + m_available + inFrames, 0, pad * sizeof(float) );
+		}
+		m_available += inFrames + pad;
+
+		//an output at time t takes the taps from floor( t ) - taps / 2 + 1 on
+		DWORD written = 0;
+		DWORD half = m_taps / 2;
+		while( (DWORD)m_time + half < m_available )
+		{
+			DWORD base = (DWORD)m_time - half + 1;
+			double phase = ( m_time - (DWORD)m_time ) * m_phases;
+			DWORD p = (DWORD)phase;
+			float f = (float)( phase - p );
+			const float* c0 = m_table + (size_t)p * m_taps;
+			const float* c1 = c0 + m_taps;
+			for( DWORD c = 0; c < m_channels; c++ )
+			{
+				float d0, d1;
+				m_dot2( &m_history[ (size_t)c * m_capacity + base ], c0, c1, m_taps, &d0, &d1 );
+				pOut[ (size_t)written * m_channels + c ] = d0 + f * ( d1 - d0 );
+			}
+			written++;
+			m_time += m_step;
+		}
+
+		//drop what the next output no longer needs
+		DWORD drop = (DWORD)m_time >= half - 1 ? (DWORD)m_time - ( half - 1 ) : 0;
+		drop = (std::min)( drop, m_available );
+		if( drop > 0 )
+		{
+			for( DWORD c = 0; c < m_channels; c++ )
+			{
+				float* run = &m_history[ (size_t)c * m_capacity ];
+				memmove( run, run + drop, ( m_available - drop ) * sizeof(float) );
+			}
+			m_available -= drop;
+			m_time -= drop;
+		}
+		if( flush )
+			reset();
+		return written;
+	}
+};
+
+//hands the voice float copies of a stream's buffers, taken to the output's sample rate as well when the stream's differs.
+//it keeps its own ring of converted buffers, one per stream buffer, so a converted buffer stays put for as long as the
+//stream's original would have
+class WaveFormatConverter
+{
+private:
+	WAVEFORMATEXTENSIBLE m_wf; //the float format handed to the voice
+	WAVE_SAMPLE_TYPE m_type; //what's being converted from
+	float* m_memory;
+	float* m_scratch; //a buffer's float samples on their way into the resampler, when they aren't float already
+	XAUDIO2_BUFFER* m_xaBuffer;
+	DWORD m_inputSamples; //the most samples taken from each buffer
+	DWORD m_bufferSamples; //the room in each converted buffer
+	DWORD m_bufferCount;
+	DWORD m_next; //the converted buffer the next convert() fills
+	WaveResampler m_resampler; //set up when the rate changes
+
+	//not copyable; each stream sets up its own
+	WaveFormatConverter( const WaveFormatConverter& );
+	WaveFormatConverter& operator=( const WaveFormatConverter& );
+
+public:
+	WaveFormatConverter() : m_type(WST_UNKNOWN), m_memory(NULL), m_scratch(NULL), m_xaBuffer(NULL), m_inputSamples(0), m_bufferSamples(0), m_bufferCount(0), m_next(0) {
+		memset( &m_wf, 0, sizeof(m_wf) );
+	}
+	~WaveFormatConverter() { close(); }
+
+	//whether there's a conversion to do for the format: it's a plain sample type that isn't float already
+	static bool needsConversion( const WAVEFORMATEX* wf ) {
+		WAVE_SAMPLE_TYPE type = waveSampleType( wf );
+		return type != WST_UNKNOWN && type != WST_FLOAT32;
+	}
+	//whether there's resampling to do to play the format at outRate: it's a plain sample type at another rate
+	static bool needsResampling( const WAVEFORMATEX* wf, DWORD outRate ) {
+		return outRate != 0 && waveSampleType( wf ) != WST_UNKNOWN && wf->nSamplesPerSec != outRate;
+	}
+
+	//gets ready to convert buffers of up to maxBytes of the format, bufferCount of them queued at a time, resampling
+	//them to outRate at the given quality unless it's 0 or the format's own rate; returns false if the format can't be
+	//converted, or the memory couldn't be had
+	bool setup( const WAVEFORMATEX* wf, DWORD maxBytes, DWORD bufferCount, DWORD outRate = 0, RESAMPLE_QUALITY quality = RQ_GOOD ) {
+		close();
+
+		m_type = waveSampleType( wf );
+		if( m_type == WST_UNKNOWN || bufferCount == 0 )
+		{
+			m_type = WST_UNKNOWN;
+			return false;
+		}
+
+		//the same layout, with float samples; an extensible format keeps its speaker mask and valid bits don't apply any more
+		if( wf->wFormatTag == WAVE_FORMAT_EXTENSIBLE )
+		{
+			memcpy( &m_wf, wf, sizeof(m_wf) );
+			m_wf.Samples.wValidBitsPerSample = 32;
+			m_wf.SubFormat.Data1 = WAVE_FORMAT_IEEE_FLOAT;
+		}
+		else
+		{
+			m_wf.Format.wFormatTag = WAVE_FORMAT_IEEE_FLOAT;
+			m_wf.Format.nChannels = wf->nChannels;
+			m_wf.Format.nSamplesPerSec = wf->nSamplesPerSec;
+			m_wf.Format.cbSize = 0;
+		}
+		m_wf.Format.wBitsPerSample = 32;
+		m_wf.Format.nBlockAlign = m_wf.Format.nChannels * 4;
+
+		m_inputSamples = maxBytes / waveSampleSize( m_type );
+		m_bufferSamples = m_inputSamples;
+		if( needsResampling( wf, outRate ) )
+		{
+			m_wf.Format.nSamplesPerSec = outRate;
+			if( !m_resampler.setup( wf->nChannels, wf->nSamplesPerSec, outRate, quality ) )
+			{
+				close();
+				return false;
+			}
+			m_bufferSamples = m_resampler.maxOutput( m_inputSamples / wf->nChannels ) * wf->nChannels;
+			if( m_type != WST_FLOAT32 )
+			{
+				m_scratch = (float*)waveAlignedAlloc( (size_t)m_inputSamples * sizeof(float) + 32, 32 );
+				if( m_scratch == NULL )
+				{
+					close();
+					return false;
+				}
+			}
+		}
+		m_wf.Format.nAvgBytesPerSec = m_wf.Format.nSamplesPerSec * m_wf.Format.nBlockAlign;
+
+		m_bufferCount = bufferCount;
+		m_memory = (float*)waveAlignedAlloc( (size_t)m_bufferSamples * m_bufferCount * sizeof(float) + 32, 32 );
+		m_xaBuffer = new XAUDIO2_BUFFER[ m_bufferCount ];
+		memset( m_xaBuffer, 0, m_bufferCount * sizeof(XAUDIO2_BUFFER) );
+		if( m_memory == NULL )
+		{
+			close();
+			return false;
+		}
+		return true;
+	}
+
+	void close() {
+		if( m_memory != NULL )
+			waveAlignedFree( m_memory );
+		m_memory = NULL;
+		if( m_scratch != NULL )
+			waveAlignedFree( m_scratch );
+		m_scratch = NULL;
+		delete [] m_xaBuffer;
+		m_xaBuffer = NULL;
+		m_resampler.close();
+		m_type = WST_UNKNOWN;
+		m_inputSamples = 0;
+		m_bufferSamples = 0;
+		m_bufferCount = 0;
+		m_next = 0;
+		memset( &m_wf, 0, sizeof(m_wf) );
+	}
+
+	bool isActive() const { return m_memory != NULL; }
+	//whether the buffers are being taken to another rate; their lengths then differ from the stream's
+	bool isResampling() const { return m_resampler.isActive(); }
+	//the format of the converted buffers, for creating the voice
+	const WAVEFORMATEX* wf() const { return &m_wf.Format; }
+
+	//forgets the resampler's history, for when the stream jumps somewhere else (a seek, or starting over)
+	void reset() {
+		if( m_resampler.isActive() )
+			m_resampler.reset();
+	}
+
+	//a float copy of the buffer, taking the next of the ring's buffers; the flags and context carry over, and so do the
+	//play and loop regions (all in sample frames) unless it's resampled, when they no longer line up and are cleared.
+	//the end of the stream lets out what the resampler is holding back. anything past the room set up for is dropped
+	const XAUDIO2_BUFFER* convert( const XAUDIO2_BUFFER* pBuffer ) {
+		XAUDIO2_BUFFER& b = m_xaBuffer[ m_next ];
+		float* pDest = m_memory + (size_t)m_bufferSamples * m_next;
+		m_next = ( m_next + 1 ) % m_bufferCount;
+
+		DWORD samples = (std::min)( pBuffer->AudioBytes / waveSampleSize( m_type ), m_inputSamples );
+		b = *pBuffer;
+		b.pAudioData = (const BYTE*)pDest;
+		if( !m_resampler.isActive() )
+		{
+			b.AudioBytes = samples * sizeof(float);
+			if( samples > 0 )
+				waveConvertToFloat( m_type, pBuffer->pAudioData, pDest, samples );
+			return &b;
+		}
+
+		const float* pIn = (const float*)pBuffer->pAudioData;
+		if( m_scratch != NULL )
+		{
+			if( samples > 0 )
+				waveConvertToFloat( m_type, pBuffer->pAudioData, m_scratch, samples );
+			pIn = m_scratch;
+		}
+		DWORD frames = m_resampler.process( pIn, samples / m_wf.Format.nChannels, pDest, ( pBuffer->Flags & XAUDIO2_END_OF_STREAM ) != 0 );
+		b.AudioBytes = frames * m_wf.Format.nBlockAlign;
+		b.PlayBegin = 0;
+		b.PlayLength = 0;
+		b.LoopBegin = 0;
+		b.LoopLength = 0;
+		b.LoopCount = 0;
+		return &b;
+	}
+};
+
+#endif
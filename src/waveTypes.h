@@ -0,0 +1,167 @@
+//waveTypes.h
+//the handful of win32/xaudio2 types the streaming core is written against;
+//on windows these come from the sdk headers, everywhere else they are declared here
+//with the same layout so the wave parsing and streaming code compiles unchanged
+
+#ifndef WAVETYPES_H
+#define WAVETYPES_H
+
+#include <algorithm>
+#include <cstdlib>
+#include <cstring>
+
+#ifdef _MSC_VER
+#include <intrin.h>
+#endif
+
+#ifdef _WIN32
+
+#include <windows.h>
+#include <mmiscapi.h>
+#include <xaudio2.h>
+
+#else
+
+#include <stdint.h>
+
+typedef uint8_t BYTE;
+typedef uint16_t WORD;
+typedef uint32_t DWORD;
+typedef uint32_t UINT32;
+typedef int32_t INT32;
+typedef uint64_t UINT64;
+typedef int64_t INT64;
+typedef int BOOL;
+typedef DWORD FOURCC;
+typedef char TCHAR;
+typedef const TCHAR* LPCTSTR;
+
+#ifndef TRUE
+#define TRUE 1
+#endif
+#ifndef FALSE
+#define FALSE 0
+#endif
+
+#define TEXT(s) s
+
+#define MAKEFOURCC(ch0, ch1, ch2, ch3) \
+	((DWORD)(BYTE)(ch0) | ((DWORD)(BYTE)(ch1) << 8) | ((DWORD)(BYTE)(ch2) << 16) | ((DWORD)(BYTE)(ch3) << 24))
+
+#define WAVE_FORMAT_PCM 1
+#define WAVE_FORMAT_IEEE_FLOAT 3
+#define WAVE_FORMAT_EXTENSIBLE 0xFFFE
+
+struct GUID
+{
+	DWORD Data1;
+	WORD Data2;
+	WORD Data3;
+	BYTE Data4[8];
+};
+
+//packed exactly as mmreg.h declares them, so they can be read straight out of the 'fmt ' chunk
+#pragma pack(push, 1)
+struct WAVEFORMATEX
+{
+	WORD wFormatTag;
+	WORD nChannels;
+	DWORD nSamplesPerSec;
+	DWORD nAvgBytesPerSec;
+	WORD nBlockAlign;
+	WORD wBitsPerSample;
+	WORD cbSize;
+};
+
+struct WAVEFORMATEXTENSIBLE
+{
+	WAVEFORMATEX Format;
+	union
+	{
+		WORD wValidBitsPerSample;
+		WORD wSamplesPerBlock;
+		WORD wReserved;
+	} Samples;
+	DWORD dwChannelMask;
+	GUID SubFormat;
+};
+#pragma pack(pop)
+
+#define XAUDIO2_END_OF_STREAM 0x0040
+#define XAUDIO2_LOOP_INFINITE 255
+#define XAUDIO2_MAX_LOOP_COUNT 254
+#define XAUDIO2_MAX_BUFFER_BYTES 0x80000000
+#define XAUDIO2_MAX_QUEUED_BUFFERS 64
+#define XAUDIO2_MIN_FREQ_RATIO (1/1024.0f)
+#define XAUDIO2_MAX_FREQ_RATIO 1024.0f
+
+struct XAUDIO2_BUFFER
+{
+	UINT32 Flags;
+	UINT32 AudioBytes;
+	const BYTE* pAudioData;
+	UINT32 PlayBegin;
+	UINT32 PlayLength;
+	UINT32 LoopBegin;
+	UINT32 LoopLength;
+	UINT32 LoopCount;
+	void* pContext;
+};
+
+struct XAUDIO2_VOICE_STATE
+{
+	void* pCurrentBufferContext;
+	UINT32 BuffersQueued;
+	UINT64 SamplesPlayed;
+};
+
+#endif
+
+//marks moves that can't throw, so containers move rather than copy; visual studio before 2015 has no noexcept
+#if defined( _MSC_VER ) && _MSC_VER < 1900
+#define WAVE_NOEXCEPT throw()
+#else
+#define WAVE_NOEXCEPT noexcept
+#endif
+
+//hands over what p owns, leaving it NULL; for moving owned pointers out of another object
+template<class T> inline T* waveTake( T*& p ) WAVE_NOEXCEPT {
+	T* taken = p;
+	p = NULL;
+	return taken;
+}
+
+//sector-aligned allocations for unbuffered reads
+inline void* waveAlignedAlloc( size_t size, size_t alignment ) {
+#ifdef _WIN32
+	return _aligned_malloc( size, alignment );
+#else
+	void* p = NULL;
+	if( posix_memalign( &p, alignment, size ) != 0 )
+		return NULL;
+	return p;
+#endif
+}
+
+inline void waveAlignedFree( void* p ) {
+#ifdef _WIN32
+	_aligned_free( p );
+#else
+	free( p );
+#endif
+}
+
+//the number of zero bits above the highest set bit of x, which mustn't be 0
+inline DWORD waveLeadingZeros64( UINT64 x ) {
+#ifdef _MSC_VER
+	unsigned long i;
+	if( _BitScanReverse( &i, (unsigned long)( x >> 32 ) ) )
+		return 31 - i;
+	_BitScanReverse( &i, (unsigned long)x );
+	return 63 - i;
+#else
+	return (DWORD)__builtin_clzll( x );
+#endif
+}
+
+#endif
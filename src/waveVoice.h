@@ -0,0 +1,189 @@
+//waveVoice.h
+//the output side of the streaming code: somewhere to submit XAUDIO2_BUFFERs,
+//which calls back once it's finished with each one
+
+#ifndef WAVEVOICE_H
+#define WAVEVOICE_H
+
+#include "waveTypes.h"
+#include "waveInfo.h"
+#include "waveResample.h"
+#include "waveMix.h"
+
+#include <atomic>
+#include <cmath>
+
+//the voice callback contract the streaming code relies on
+class WaveVoiceCallback
+{
+public:
+	virtual ~WaveVoiceCallback() {}
+
+	//called from the voice's processing thread when a submitted buffer has been consumed (or flushed);
+	//pContext is the buffer's pContext
+	virtual void OnBufferEnd( void* pContext ) = 0;
+};
+
+//the subset of IXAudio2SourceVoice that the streaming code uses
+class WaveVoice
+{
+public:
+	virtual ~WaveVoice() {}
+
+	//queues a buffer; the memory it points to must stay valid until OnBufferEnd for it
+	virtual bool submit( const XAUDIO2_BUFFER* pBuffer ) = 0;
+	//gets the number of buffers queued (including the one playing) and samples played so far
+	virtual void getState( XAUDIO2_VOICE_STATE* pState ) = 0;
+	virtual void start() = 0;
+	virtual void stop() = 0;
+	//removes all pending buffers; OnBufferEnd is still called for each of them
+	virtual void flush() = 0;
+	//stops the buffer playing from looping again; it plays out the current pass of its loop, then the rest of the buffer
+	virtual void exitLoop() = 0;
+	//the gain applied to every channel; 1 leaves the samples as they are
+	virtual void setVolume( float volume ) = 0;
+	virtual float getVolume() = 0;
+	//places the sound between the left (-1) and right (1) outputs: a mono source is panned at constant power,
+	//a stereo one has the far side turned down. sources with more channels keep their default mapping
+	virtual void setPan( float pan ) = 0;
+	//the playback rate, which shifts the pitch with it; clamped to between XAUDIO2_MIN_FREQ_RATIO and the voice's maximum.
+	//returns the ratio applied
+	virtual float setFrequencyRatio( float ratio ) = 0;
+	//where buffer-end notifications go from now on, or nowhere with NULL; for handing a voice on to a new user
+	//once it has stopped and its buffers have all ended
+	virtual void setCallback( WaveVoiceCallback* pCallback ) = 0;
+};
+
+#ifdef _WIN32
+
+//WaveVoice on top of a real XAudio2 source voice
+class XAudio2WaveVoice : public WaveVoice
+{
+private:
+	//forwards the XAudio2 notifications to the WaveVoiceCallback
+	struct Callback : public IXAudio2VoiceCallback
+	{
+		std::atomic<WaveVoiceCallback*> m_pCallback; //swapped by setCallback() while the audio thread may be reading it
+
+		Callback( WaveVoiceCallback* pCallback ) : m_pCallback(pCallback) {}
+
+		STDMETHOD_( void, OnVoiceProcessingPassStart )( UINT32 bytesRequired ) {}
+		STDMETHOD_( void, OnVoiceProcessingPassEnd )() {}
+		STDMETHOD_( void, OnStreamEnd )() {}
+		STDMETHOD_( void, OnBufferStart )( void* pContext ) {}
+		STDMETHOD_( void, OnBufferEnd )( void* pContext ) { WaveVoiceCallback* pCallback = m_pCallback; if( pCallback != NULL ) pCallback->OnBufferEnd( pContext ); }
+		STDMETHOD_( void, OnLoopEnd )( void* pContext ) {}
+		STDMETHOD_( void, OnVoiceError )( void* pContext, HRESULT error ) {}
+	};
+
+	Callback m_callback;
+	IXAudio2SourceVoice* m_pVoice;
+	UINT32 m_sourceChannels;
+	UINT32 m_outputChannels; //the input channels of the voice this one sends to
+	float m_maxFrequencyRatio;
+
+	XAudio2WaveVoice( WaveVoiceCallback* pCallback ) : m_callback(pCallback), m_pVoice(NULL), m_sourceChannels(0), m_outputChannels(0), m_maxFrequencyRatio(0) {}
+
+public:
+	//creates the source voice, sending to the mastering voice with outputChannels inputs; returns NULL on failure
+	static XAudio2WaveVoice* create( IXAudio2* pEngine, const WAVEFORMATEX* wf, WaveVoiceCallback* pCallback, float maxFrequencyRatio = 2.0f, UINT32 outputChannels = 2 ) {
+		XAudio2WaveVoice* v = new XAudio2WaveVoice( pCallback );
+		v->m_sourceChannels = wf->nChannels;
+		v->m_outputChannels = outputChannels;
+		v->m_maxFrequencyRatio = maxFrequencyRatio;
+		if( FAILED( pEngine->CreateSourceVoice( &v->m_pVoice, wf, 0, maxFrequencyRatio, &v->m_callback ) ) )
+		{
+			delete v;
+			return NULL;
+		}
+		return v;
+	}
+
+	~XAudio2WaveVoice() {
+		if( m_pVoice != NULL )
+		{
+			m_pVoice->Stop();
+			m_pVoice->FlushSourceBuffers();
+			m_pVoice->DestroyVoice();
+		}
+		m_pVoice = NULL;
+	}
+
+	bool submit( const XAUDIO2_BUFFER* pBuffer ) { return SUCCEEDED( m_pVoice->SubmitSourceBuffer( pBuffer ) ); }
+	void getState( XAUDIO2_VOICE_STATE* pState ) { m_pVoice->GetState( pState ); }
+	void start() { m_pVoice->Start(); }
+	void stop() { m_pVoice->Stop(); }
+	void flush() { m_pVoice->FlushSourceBuffers(); }
+	void exitLoop() { m_pVoice->ExitLoop(); }
+	void setVolume( float volume ) { m_pVoice->SetVolume( volume ); }
+	float getVolume() { float volume = 0; m_pVoice->GetVolume( &volume ); return volume; }
+	void setCallback( WaveVoiceCallback* pCallback ) { m_callback.m_pCallback = pCallback; }
+	float setFrequencyRatio( float ratio ) {
+		ratio = (std::max)( XAUDIO2_MIN_FREQ_RATIO, (std::min)( ratio, m_maxFrequencyRatio ) );
+		m_pVoice->SetFrequencyRatio( ratio );
+		return ratio;
+	}
+	void setPan( float pan ) {
+		if( m_sourceChannels > 2 || m_outputChannels < 2 || m_outputChannels > XAUDIO2_MAX_AUDIO_CHANNELS )
+			return;
+
+		//the matrix has a row per output channel and a column per source channel; only the front left and right are fed
+		float matrix[XAUDIO2_MAX_AUDIO_CHANNELS * 2] = {0};
+		if( m_sourceChannels == 1 )
+			wavePanGains( pan, 1, &matrix[0], &matrix[1] );
+		else
+			wavePanGains( pan, 2, &matrix[0], &matrix[3] );
+		m_pVoice->SetOutputMatrix( NULL, m_sourceChannels, m_outputChannels, matrix );
+	}
+
+	//the underlying XAudio2 voice
+	IXAudio2SourceVoice* voice() const { return m_pVoice; }
+};
+
+#endif
+
+//told about each buffer queueStreamingBuffers() submits, just before the voice gets it
+class WaveSubmitListener
+{
+public:
+	virtual ~WaveSubmitListener() {}
+
+	//inFile's current buffer is the one about to be submitted; getBufferPosition() says where in the data it starts.
+	//pSubmitted is what the voice actually gets: the buffer itself, or the converter's copy of it.
+	//buffersQueued is how many the voice already has queued ahead of it
+	virtual void OnBufferSubmit( const StreamingWave& inFile, const XAUDIO2_BUFFER* pSubmitted, UINT32 buffersQueued ) = 0;
+};
+
+//fills and queues buffers from the stream until the voice has maxQueued buffers queued, or the last of the data has gone out;
+//a looping stream never runs out. with a converter set up, the voice gets float copies of the buffers, resampled if it's
+//set up for that (and must have been created with the converter's format). returns false if a read failed, or the voice
+//wouldn't take a buffer (it holds at most XAUDIO2_MAX_QUEUED_BUFFERS)
+inline bool queueStreamingBuffers( StreamingWave& inFile, WaveVoice* voice, UINT32 maxQueued, WaveSubmitListener* listener = NULL, WaveFormatConverter* converter = NULL ) {
+	XAUDIO2_VOICE_STATE voiceState = {0};
+	const XAUDIO2_BUFFER* pBuffer = NULL;
+	voice->getState( &voiceState );
+	while( voiceState.BuffersQueued < maxQueued && !inFile.isFinished() )
+	{
+		//read and fill the next buffer to present
+		switch( inFile.prepare() )
+		{
+		case StreamingWave::PR_EOF: //the end of the data; it goes out flagged as the end of the stream, and nothing follows it
+		case StreamingWave::PR_SUCCESS:
+			//present the next available buffer
+			inFile.swap();
+			//submit another buffer
+			pBuffer = converter != NULL && converter->isActive() ? converter->convert( inFile.buffer() ) : inFile.buffer();
+			if( listener != NULL )
+				listener->OnBufferSubmit( inFile, pBuffer, voiceState.BuffersQueued );
+			if( !voice->submit( pBuffer ) )
+				return false;
+			voice->getState( &voiceState );
+			break;
+		case StreamingWave::PR_FAILURE:
+			return false;
+		}
+	}
+	return true;
+}
+
+#endif